@@ -0,0 +1,503 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#include <map>
+#include <new>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <enet/enet.h>
+#include <magic_args/magic_args.hpp>
+#include "arena.h"
+#include "checksum.h"
+#include "compress.h"
+#include "dispatcher.h"
+#include "packet.h"
+#include "schema.h"
+#include "service.h"
+#include "state.h"
+#include "stream.h"
+#include "users.h"
+
+//
+// Allocation counters fed by the replaced global operator new
+//
+static std::atomic<std::uint64_t> allocations{ 0 };
+static std::atomic<std::uint64_t> allocated_bytes{ 0 };
+
+void* operator new(std::size_t _Size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	allocated_bytes.fetch_add(_Size, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(_Size == 0 ? 1 : _Size)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t _Size) {
+	return operator new(_Size);
+}
+
+void operator delete(void* _Ptr) noexcept {
+	std::free(_Ptr);
+}
+
+void operator delete[](void* _Ptr) noexcept {
+	std::free(_Ptr);
+}
+
+void operator delete(void* _Ptr, std::size_t) noexcept {
+	std::free(_Ptr);
+}
+
+void operator delete[](void* _Ptr, std::size_t) noexcept {
+	std::free(_Ptr);
+}
+
+namespace bench {
+	/*
+	 * Command-line arguments of the benchmark runner.
+	 */
+	struct cmd_args {
+		/*** Only run benchmarks whose name contains this text ***/
+		std::string filter;
+
+		/*** Write the results to this baseline file ***/
+		std::string save;
+
+		/*** Compare the results against this baseline file ***/
+		std::string compare;
+
+		/*** Allowed slowdown against the baseline, in percent ***/
+		std::uint32_t tolerance = 10;
+
+		/*** Minimum measuring time per repetition, in milliseconds ***/
+		std::uint32_t mintime = 200;
+	};
+
+	/* Measurements of one benchmark */
+	struct result {
+		std::string name;
+		double ns = 0;			//< Nanoseconds per operation (best repetition)
+		double bytes = 0;		//< Payload bytes processed per operation
+		double allocs = 0;		//< Heap allocations per operation
+	};
+
+	//< Repetitions per benchmark; the fastest one is reported
+	constexpr int repetitions = 5;
+
+	/*
+	 * Keeps the compiler from optimizing a value away.
+	 */
+#if defined(_MSC_VER) && !defined(__clang__)
+	inline const void* volatile sink = nullptr;
+
+	template<class _Ty>
+	void keep(const _Ty& _Value) noexcept {
+		sink = &_Value;
+		_ReadWriteBarrier();
+	}
+#else
+	template<class _Ty>
+	void keep(const _Ty& _Value) noexcept {
+		asm volatile("" : : "g"(&_Value) : "memory");
+	}
+#endif
+
+	/*
+	 * Runs a benchmark body until the time per repetition is reliable.
+	 *
+	 * @param _Name   Benchmark name.
+	 * @param _Bytes  Payload bytes one call of the body processes.
+	 * @param _Body   The operation to measure.
+	 * @param _Mintime Minimum measuring time per repetition.
+	 * @return The measurements.
+	 */
+	template<class _Fn>
+	result measure(std::string_view _Name, std::size_t _Bytes, _Fn&& _Body, std::chrono::milliseconds _Mintime) {
+		using clock = std::chrono::steady_clock;
+		//
+		// Grow the iteration count until one repetition takes long enough
+		//
+		std::uint64_t iterations = 1;
+		for (;;) {
+			const auto start = clock::now();
+			for (std::uint64_t i = 0; i < iterations; ++i) {
+				_Body();
+			}
+			if (clock::now() - start >= _Mintime / 10 || iterations >= (std::uint64_t{ 1 } << 40)) {
+				break;
+			}
+			iterations *= 2;
+		}
+		iterations *= 10;
+
+		result r{ std::string(_Name), 0, static_cast<double>(_Bytes), 0 };
+		double best = 0;
+		for (int rep = 0; rep < repetitions; ++rep) {
+			const std::uint64_t allocs = allocations.load(std::memory_order_relaxed);
+			const auto start = clock::now();
+			for (std::uint64_t i = 0; i < iterations; ++i) {
+				_Body();
+			}
+			const auto elapsed = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+			const double ns = elapsed / static_cast<double>(iterations);
+			if (rep == 0 || ns < best) {
+				best = ns;
+			}
+			r.allocs = static_cast<double>(allocations.load(std::memory_order_relaxed) - allocs) / static_cast<double>(iterations);
+		}
+		r.ns = best;
+		return r;
+	}
+
+	/* Movement update, the most frequent message of a session */
+	struct move_packet : cat::packet {
+		std::uint32_t user = 0;
+		std::uint16_t sequence = 0;
+		float position[3]{};
+		float yaw = 0;
+		float pitch = 0;
+
+		bool serialize(cat::ostream& _Stream) const override {
+			_Stream.write(user);
+			_Stream.write(sequence);
+			_Stream.write(position);
+			_Stream.write(yaw);
+			_Stream.write(pitch);
+			return true;
+		}
+
+		bool deserialize(cat::istream& _Stream) override {
+			return _Stream.read(user) && _Stream.read(sequence) && _Stream.read(position)
+				&& _Stream.read(yaw) && _Stream.read(pitch);
+		}
+	};
+
+	/* Chat line, a typical string-carrying message */
+	struct chat_packet : cat::packet {
+		std::uint32_t user = 0;
+		std::string text;
+
+		bool serialize(cat::ostream& _Stream) const override {
+			_Stream.write(user);
+			_Stream.write_str(text);
+			return true;
+		}
+
+		bool deserialize(cat::istream& _Stream) override {
+			return _Stream.read(user) && _Stream.read_str(text);
+		}
+	};
+
+	/* The movement update declared through a schema; same wire format as move_packet */
+	struct move_schema_packet : cat::schema_packet<move_schema_packet> {
+		std::uint32_t user = 0;
+		std::uint16_t sequence = 0;
+		float position[3]{};
+		float yaw = 0;
+		float pitch = 0;
+
+		using fields = cat::schema<
+			cat::raw<&move_schema_packet::user>,
+			cat::raw<&move_schema_packet::sequence>,
+			cat::raw<&move_schema_packet::position>,
+			cat::raw<&move_schema_packet::yaw>,
+			cat::raw<&move_schema_packet::pitch>>;
+	};
+
+	/* The chat line declared through a schema */
+	struct chat_schema_packet : cat::schema_packet<chat_schema_packet> {
+		std::uint32_t user = 0;
+		std::string text;
+
+		using fields = cat::schema<
+			cat::raw<&chat_schema_packet::user>,
+			cat::text<&chat_schema_packet::text, 255>>;
+	};
+
+	//< IDs the benchmark registers its packets under
+	constexpr std::uint8_t move_id = 1;
+	constexpr std::uint8_t chat_id = 2;
+
+	/*
+	 * Registers every benchmark and runs those matching the filter.
+	 */
+	std::vector<result> run_all(const cmd_args& _Args) {
+		const std::chrono::milliseconds mintime(_Args.mintime);
+		std::vector<result> results;
+		const auto add = [&](std::string_view _Name, std::size_t _Bytes, auto&& _Body) {
+			if (!_Args.filter.empty() && _Name.find(_Args.filter) == std::string_view::npos) {
+				return;
+			}
+			results.push_back(measure(_Name, _Bytes, _Body, mintime));
+			const result& r = results.back();
+			std::println("{:<36} {:>10.1f} ns/op {:>10.1f} B/op {:>8.3f} allocs/op", r.name, r.ns, r.bytes, r.allocs);
+		};
+
+		cat::packet_registry::register_type<move_packet>(move_id, { 1, cat::delivery::sequenced });
+		cat::packet_registry::register_type<chat_packet>(chat_id);
+		cat::packet_registry::freeze();
+
+		move_packet move;
+		move.user = 0x00010007;
+		move.position[0] = 1024.5f;
+		move.position[1] = -77.25f;
+		move.position[2] = 36.0f;
+
+		chat_packet chat;
+		chat.user = 0x00010007;
+		chat.text = "gg, rotate to B through the tunnels and hold the long corner until the round ends";
+
+		cat::ostream out;
+		const auto framed = [&](const cat::packet& _Packet, std::uint8_t _Id) {
+			cat::ostream s;
+			s.write(_Id);
+			_Packet.serialize(s);
+			return std::vector<std::byte>(s.buffer().begin(), s.buffer().end());
+		};
+		const std::vector<std::byte> move_frame = framed(move, move_id);
+		const std::vector<std::byte> chat_frame = framed(chat, chat_id);
+
+		//
+		// Streams
+		//
+		add("ostream/write_move", move_frame.size(), [&] {
+			out.flush();
+			out.write(move_id);
+			move.serialize(out);
+			keep(out.size());
+		});
+		add("ostream/write_str_chat", chat_frame.size(), [&] {
+			out.flush();
+			out.write(chat_id);
+			chat.serialize(out);
+			keep(out.size());
+		});
+		add("istream/read_move", move_frame.size(), [&] {
+			cat::istream in = cat::istream::view_of(move_frame.data(), move_frame.size());
+			std::uint8_t id;
+			move_packet decoded;
+			keep(in.read(id) && decoded.deserialize(in));
+		});
+		move_schema_packet move_schema;
+		move_schema.user = move.user;
+		std::copy(std::begin(move.position), std::end(move.position), move_schema.position);
+		chat_schema_packet chat_schema;
+		chat_schema.user = chat.user;
+		chat_schema.text = chat.text;
+		add("schema/write_move", move_frame.size(), [&] {
+			out.flush();
+			out.write(move_id);
+			move_schema.serialize(out);
+			keep(out.size());
+		});
+		add("schema/write_chat", chat_frame.size(), [&] {
+			out.flush();
+			out.write(chat_id);
+			chat_schema.serialize(out);
+			keep(out.size());
+		});
+		add("schema/read_move", move_frame.size(), [&] {
+			cat::istream in = cat::istream::view_of(move_frame.data(), move_frame.size());
+			std::uint8_t id;
+			move_schema_packet decoded;
+			keep(in.read(id) && decoded.deserialize(in));
+		});
+		add("istream/read_str_view", chat_frame.size(), [&] {
+			cat::istream in = cat::istream::view_of(chat_frame.data(), chat_frame.size());
+			std::uint8_t id;
+			std::uint32_t user;
+			std::string_view text;
+			keep(in.read(id) && in.read(user) && in.read_str(text));
+		});
+		add("istream/read_str_string", chat_frame.size(), [&] {
+			cat::istream in = cat::istream::view_of(chat_frame.data(), chat_frame.size());
+			std::uint8_t id;
+			chat_packet decoded;
+			keep(in.read(id) && decoded.deserialize(in));
+		});
+		//
+		// Registry and dispatch
+		//
+		add("registry/create_move", 0, [&] {
+			keep(cat::packet_registry::create(move_id));
+		});
+		add("registry/create_move_arena", 0, [&] {
+			keep(cat::packet_registry::create(move_id, cat::tick_arena::resource()));
+			cat::tick_arena::reset();
+		});
+		add("block_pool/alloc_free", 0, [&] {
+			void* block = cat::block_pool::allocate(256);
+			keep(block);
+			cat::block_pool::deallocate(block);
+		});
+
+		cat::dispatcher& dispatcher = cat::dispatcher::instance();
+		dispatcher.on<move_packet>([](peer_t, const move_packet& _Packet) { keep(_Packet.sequence); });
+		add("dispatcher/dispatch_move", move_frame.size(), [&] {
+			cat::istream in = cat::istream::view_of(move_frame.data(), move_frame.size());
+			keep(dispatcher.dispatch(nullptr, in));
+		});
+		//
+		// Service fan-out: metrics-style counter, dispatcher, and a logger
+		//
+		cat::service& service = cat::service::instance();
+		static std::uint64_t seen = 0;
+		service.on(cat::enet_service::enet_message, [](cat::enet_event&) { ++seen; }, -1);
+		cat::dispatcher::attach(service);
+		service.on(cat::enet_service::enet_message, [](cat::enet_event& _Event) { keep(_Event.size); }, 1);
+		add("service/call_message", move_frame.size(), [&] {
+			cat::enet_event event{ nullptr, move_frame.data(), move_frame.size(), nullptr };
+			service.call(cat::enet_service::enet_message, event);
+		});
+		//
+		// User slots, with zeroed ENet peers standing in for connections
+		//
+		constexpr std::size_t capacity = 1024;
+		cat::setup_user_system(capacity);
+		std::vector<ENetPeer> peers(capacity);
+		for (std::size_t i = 0; i < capacity / 2; ++i) {
+			keep(cat::acquire_user(&peers[i]));
+		}
+		std::size_t next = capacity / 2;
+		add("users/acquire_release", 0, [&] {
+			peer_t peer = &peers[next];
+			keep(cat::acquire_user(peer));
+			cat::release_user(peer);
+			next = next + 1 < capacity ? next + 1 : capacity / 2;
+		});
+		add("users/find_user", 0, [&] {
+			keep(cat::find_user(&peers[next % (capacity / 2)]));
+			next = next + 1 < capacity ? next + 1 : capacity / 2;
+		});
+		//
+		// Player state: a quarter of the users move every tick
+		//
+		std::int32_t step = 0;
+		add("state/commit_512", 0, [&] {
+			++step;
+			const std::span<const userid_t> users = cat::get_users();
+			for (std::size_t i = 0; i < users.size(); i += 4) {
+				cat::state_store::set_position(users[i], step, -step, 0);
+			}
+			keep(cat::state_store::commit());
+		});
+		cat::snapshot world;
+		std::uint32_t sequence = 0;
+		add("state/capture_512", 0, [&] {
+			cat::state_store::capture(world, ++sequence);
+			keep(world.entities.size());
+		});
+		//
+		// Compression of a large state message
+		//
+		cat::ostream snapshot;
+		snapshot.write(chat_id);
+		for (int i = 0; i < 64; ++i) {
+			snapshot.write(static_cast<std::uint32_t>(0x00010000 | i));
+			snapshot.write_str("player");
+			snapshot.write(static_cast<float>(i) * 1.5f);
+		}
+		cat::ostream packed;
+		add("compressor/pack_state", snapshot.total_size(), [&] {
+			keep(cat::compressor::pack(snapshot, packed));
+		});
+		//
+		// Datagram checksum at a typical MTU
+		//
+		const std::vector<std::byte> datagram(1200, std::byte{ 0x5A });
+		add("checksum/crc32c_1200", datagram.size(), [&] {
+			keep(cat::crc32c(datagram.data(), datagram.size()));
+		});
+		return results;
+	}
+
+	/*
+	 * Loads a baseline file written with --save.
+	 */
+	std::map<std::string, result> load(const std::string& _Path) {
+		std::map<std::string, result> baseline;
+		std::ifstream in(_Path);
+		result r;
+		while (in >> r.name >> r.ns >> r.bytes >> r.allocs) {
+			baseline[r.name] = r;
+		}
+		return baseline;
+	}
+
+	/*
+	 * Writes the results as a baseline file.
+	 */
+	bool save(const std::string& _Path, const std::vector<result>& _Results) {
+		std::ofstream out(_Path);
+		for (const result& r : _Results) {
+			out << r.name << ' ' << r.ns << ' ' << r.bytes << ' ' << r.allocs << '\n';
+		}
+		return static_cast<bool>(out);
+	}
+
+	/*
+	 * Compares results against a baseline.
+	 *
+	 * @return The number of regressions: slower beyond the tolerance, or
+	 *         allocating more often.
+	 */
+	int compare(const std::map<std::string, result>& _Baseline, const std::vector<result>& _Results, std::uint32_t _Tolerance) {
+		int regressions = 0;
+		for (const result& r : _Results) {
+			const auto it = _Baseline.find(r.name);
+			if (it == _Baseline.end()) {
+				continue;
+			}
+
+			const double change = (r.ns / it->second.ns - 1.0) * 100.0;
+			const bool slower = change > static_cast<double>(_Tolerance);
+			const bool allocates = r.allocs > it->second.allocs + 1e-3;
+			if (slower || allocates) {
+				++regressions;
+			}
+			std::println("{:<36} {:>+8.1f} % {:>8.3f} -> {:<8.3f} allocs/op{}", r.name, change,
+				it->second.allocs, r.allocs, slower || allocates ? "  REGRESSION" : "");
+		}
+		return regressions;
+	}
+}
+
+int main(int argc, char** argv) {
+	//
+	// Parse command-line arguments
+	//
+	const auto args = magic_args::parse<bench::cmd_args>(argc, argv);
+	//
+	// Run every benchmark matching the filter
+	//
+	const auto results = bench::run_all(*args);
+	//
+	// Store or check the baseline
+	//
+	if (!args->save.empty() && !bench::save(args->save, results)) {
+		std::println("- Failed to write baseline {}", args->save);
+		return 1;
+	}
+
+	if (!args->compare.empty()) {
+		const auto baseline = bench::load(args->compare);
+		if (baseline.empty()) {
+			std::println("- Baseline {} is missing or empty", args->compare);
+			return 1;
+		}
+
+		const int regressions = bench::compare(baseline, results, args->tolerance);
+		std::println("- {} regression(s) against {}", regressions, args->compare);
+		return regressions == 0 ? 0 : 1;
+	}
+	return 0;
+}
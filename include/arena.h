@@ -0,0 +1,131 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+
+#pragma once
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+namespace cat {
+	/*
+	 * @brief Per-thread monotonic arena for memory that dies with the tick.
+	 *
+	 * Allocation is a pointer bump in a preallocated buffer and
+	 * deallocation does nothing; reset() rewinds the whole arena at once.
+	 * The shard's I/O thread resets it after Core_enet_send() at the end
+	 * of every tick, as do server::flush() and client::flush(), and each
+	 * worker whenever its queue runs dry or worker_pool::drain() returns, so
+	 * anything a handler allocates from resource() is valid for the rest
+	 * of its call and must not be kept beyond it.
+	 *
+	 * A tick that outgrows the buffer continues in blocks from the heap,
+	 * and the next reset() enlarges the buffer to cover it, so steady-state
+	 * ticks never reach malloc.
+	 */
+	class tick_arena {
+	public:
+		//< Initial buffer size per thread
+		static constexpr std::size_t initial_size = 64 * 1024;
+
+		//< Largest buffer reset() grows to; beyond it overflow stays on the heap
+		static constexpr std::size_t max_size = 16 * 1024 * 1024;
+	public:
+		/*
+		 * Returns the calling thread's arena.
+		 */
+		[[nodiscard]] static std::pmr::memory_resource* resource() noexcept;
+
+		/*
+		 * Releases everything allocated from the calling thread's arena.
+		 */
+		static void reset() noexcept;
+
+		/*
+		 * Returns the calling thread's buffer size in bytes.
+		 */
+		[[nodiscard]] static std::size_t capacity() noexcept;
+	};
+
+	/* Counters of the block pool */
+	struct block_pool_stats {
+		std::uint64_t reserved = 0;		//< Bytes carved from the heap into blocks
+		std::uint64_t oversized = 0;	//< Allocations too large for a block, passed to the heap
+	};
+
+	/*
+	 * @brief Thread-safe pool of fixed-size blocks for longer-lived objects.
+	 *
+	 * Requests up to max_block bytes are rounded up to a power of two of
+	 * at least min_block and served from that size class. Each thread
+	 * keeps a small cache per class and trades batches with a shared free
+	 * list, so a block allocated on one thread and freed on another (an
+	 * ENet packet received on the I/O thread and released by a worker)
+	 * costs a lock only once per batch. Blocks are carved from large
+	 * slabs and never returned to the heap, which keeps long-running
+	 * servers from fragmenting it.
+	 *
+	 * Every block records its class, so deallocate() needs no size: core
+	 * installs the pool as ENet's malloc and free.
+	 */
+	class block_pool {
+	public:
+		//< Smallest block, including the class header
+		static constexpr std::size_t min_block = 64;
+
+		//< Largest block, including the class header
+		static constexpr std::size_t max_block = 4096;
+	public:
+		/*
+		 * Allocates a block of at least the given size.
+		 *
+		 * @param _Size The number of bytes needed.
+		 * @return Memory aligned for any scalar type, or nullptr if out of memory.
+		 */
+		[[nodiscard]] static void* allocate(std::size_t _Size) noexcept;
+
+		/*
+		 * Returns a block obtained from allocate().
+		 *
+		 * @param _Block The block, or nullptr.
+		 */
+		static void deallocate(void* _Block) noexcept;
+
+		/*
+		 * Returns the pool as a memory resource.
+		 */
+		[[nodiscard]] static std::pmr::memory_resource* resource() noexcept;
+
+		/*
+		 * Returns the pool's counters.
+		 */
+		[[nodiscard]] static block_pool_stats stats() noexcept;
+	};
+}
+
+#endif // ^^^ !_ARENA_H_
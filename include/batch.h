@@ -0,0 +1,143 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+#pragma once
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "packet.h"
+
+namespace cat {
+	/*
+	 * Batch frames carry several small messages for the same peer and
+	 * channel in one ENet packet, so they share one protocol header,
+	 * command and acknowledgement:
+	 *
+	 *   batch_frame_id, then per message: varint length, message bytes
+	 *
+	 * Each message keeps its own ID byte, so it reads exactly as if it had
+	 * arrived alone. Core_enet_send() builds the frames from the send
+	 * queue, and core dispatch splits them again before OnMessage(), which
+	 * receives views into the batch packet; nothing is copied on receive.
+	 * Frames never nest, and a compressed frame may be batched. Packets
+	 * shared by several peers, such as multicasts, are never batched, so
+	 * their payload is not copied once per recipient.
+	 */
+
+	//< Largest batch frame built, keeping a batch within one datagram at ENet's default MTU
+	inline constexpr std::size_t batch_limit = 1200;
+
+	/*
+	 * Returns the bytes a message takes inside a batch frame.
+	 *
+	 * @param _Size The message size.
+	 */
+	constexpr std::size_t batch_record_size(std::size_t _Size) noexcept {
+		std::size_t prefix = 1;
+		for (std::size_t value = _Size; value >= 0x80; value >>= 7) {
+			++prefix;
+		}
+		return prefix + _Size;
+	}
+
+	/*
+	 * Returns whether a queued message may be put into a batch frame.
+	 *
+	 * @param _Data The message bytes.
+	 * @param _Size The message size.
+	 */
+	inline bool batchable(const void* _Data, std::size_t _Size) noexcept {
+		return _Size != 0 && 1 + batch_record_size(_Size) <= batch_limit &&
+			*static_cast<const std::uint8_t*>(_Data) != batch_frame_id;
+	}
+
+	/*
+	 * Appends one message to a batch frame under construction.
+	 *
+	 * @param _Out  Write position, with room for batch_record_size(_Size) bytes.
+	 * @param _Data The message bytes.
+	 * @param _Size The message size.
+	 * @return The write position after the record.
+	 */
+	inline std::uint8_t* batch_append(std::uint8_t* _Out, const void* _Data, std::size_t _Size) noexcept {
+		std::size_t value = _Size;
+		while (value >= 0x80) {
+			*_Out++ = static_cast<std::uint8_t>(value | 0x80);
+			value >>= 7;
+		}
+		*_Out++ = static_cast<std::uint8_t>(value);
+		std::memcpy(_Out, _Data, _Size);
+		return _Out + _Size;
+	}
+
+	/*
+	 * Calls a function for every message of a batch frame.
+	 *
+	 * Messages are passed as views into the frame. A malformed record ends
+	 * the walk; the messages before it have already been passed on.
+	 *
+	 * @param _Data The frame, starting with batch_frame_id.
+	 * @param _Size The frame size.
+	 * @param _Fn   Called as _Fn(const std::uint8_t* data, std::size_t size).
+	 * @return true if the whole frame was well formed.
+	 */
+	template<class _Fn>
+	bool for_each_batched(const void* _Data, std::size_t _Size, _Fn&& _Callback) {
+		const auto* cursor = static_cast<const std::uint8_t*>(_Data) + 1;
+		const auto* const end = static_cast<const std::uint8_t*>(_Data) + _Size;
+		while (cursor != end) {
+			std::size_t size = 0;
+			unsigned shift = 0;
+			for (;;) {
+				if (cursor == end || shift >= 32) {
+					return false;
+				}
+				const std::uint8_t byte = *cursor++;
+				//
+				// The fifth byte holds bits 28 to 31 only
+				//
+				if (shift == 28 && byte > 0x0F) {
+					return false;
+				}
+				size |= static_cast<std::size_t>(byte & 0x7F) << shift;
+				shift += 7;
+				if ((byte & 0x80) == 0) {
+					break;
+				}
+			}
+			if (size == 0 || size > static_cast<std::size_t>(end - cursor) || *cursor == batch_frame_id) {
+				return false;
+			}
+			_Callback(cursor, size);
+			cursor += size;
+		}
+		return true;
+	}
+}
+
+#endif // ^^^ !_BATCH_H_
@@ -0,0 +1,144 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+#pragma once
+#ifndef _BUS_H_
+#define _BUS_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include "const.h"
+#include "ring.h"
+#include "shard.h"
+
+namespace cat {
+	/*
+	 * Message exchanged between shards.
+	 *
+	 * The topic and payload are defined by the application, e.g. a room
+	 * transfer carrying the user and a pointer to the state moving with it.
+	 * Ownership of whatever data points to passes to the receiving shard.
+	 */
+	struct bus_message {
+		std::uint32_t	topic;
+		std::uint16_t	source;
+		userid_t		user;
+		std::uint64_t	value;
+		void*			data;
+	};
+
+	/*
+	 * @brief Lock-free message bus between shards.
+	 *
+	 * Every shard owns a bounded MPSC mailbox. Any thread may post to any
+	 * open shard; the shard drains its own mailbox from its tick through
+	 * dispatch(), so handlers always run on the receiving shard's thread
+	 * and may touch its state without locking.
+	 */
+	class shard_bus {
+	public:
+		//< Handler invoked for each message received by a shard
+		using handler_fn = void(*)(void* _Context, const bus_message& _Message);
+
+		//< Capacity of each shard's mailbox
+		static constexpr std::size_t inbox_capacity = 1024;
+	public:
+		/*
+		 * @brief Open the calling shard's mailbox.
+		 *
+		 * Posts to a shard fail until it has opened its mailbox.
+		 *
+		 * @param _Handler Function receiving the shard's messages.
+		 * @param _Context Pointer passed back as the handler's first argument.
+		 */
+		void open(handler_fn _Handler, void* _Context) noexcept;
+
+		/*
+		 * @brief Close the calling shard's mailbox.
+		 *
+		 * Further posts to the shard fail. Messages already queued are
+		 * still delivered by the next dispatch().
+		 */
+		void close() noexcept;
+
+		/*
+		 * @brief Post a message to a shard (any thread).
+		 *
+		 * The source is set to the calling thread's shard.
+		 *
+		 * @param _Shard   The receiving shard.
+		 * @param _Message The message to post.
+		 * @return true if the message was queued, false if the shard is not
+		 *         open or its mailbox is full.
+		 */
+		bool post(std::size_t _Shard, bus_message _Message) noexcept;
+
+		/*
+		 * @brief Post a message to every other open shard.
+		 *
+		 * Messages carrying owned data should be posted individually.
+		 *
+		 * @param _Message The message to post.
+		 * @return The number of shards the message was queued for.
+		 */
+		std::size_t broadcast(const bus_message& _Message) noexcept;
+
+		/*
+		 * @brief Deliver queued messages to the calling shard's handler.
+		 *
+		 * @param _Budget The maximum number of messages to deliver.
+		 * @return The number of messages delivered.
+		 */
+		std::size_t dispatch(std::size_t _Budget = std::numeric_limits<std::size_t>::max()) noexcept;
+
+		/*
+		 * @brief Get the singleton instance of the bus.
+		 *
+		 * A single instance is shared by all shards.
+		 *
+		 * @return Reference to the global bus instance.
+		 */
+		static shard_bus& instance() {
+			static shard_bus instance;
+			return instance;
+		}
+	private:
+		/* Per-shard mailbox */
+		struct mailbox {
+			mpsc_ring<bus_message, inbox_capacity> inbox;
+			std::atomic<bool> open{ false };
+			handler_fn handler = nullptr;
+			void* context = nullptr;
+		};
+
+		//< Mailboxes indexed by shard
+		std::array<mailbox, shard_count> boxes;
+	};
+}
+
+#endif // ^^^ !_BUS_H_
@@ -34,8 +34,10 @@ namespace cat::core {
 	 * Callback invoked when a new peer connects to the server.
 	 *
 	 * @param _Peer  A handle representing the connected peer.
+	 * @param _Data  The session token the peer presented, or nullptr.
+	 * @param _Size  The size of the token in bytes, or 0.
 	 */
-	extern void OnConnect(peer_t _Peer);
+	extern void OnConnect(peer_t _Peer, pdata_t _Data, std::size_t _Size);
 
 	/*
 	 * Callback invoked when a peer disconnects from the server.
@@ -50,8 +52,9 @@ namespace cat::core {
 	 * @param _Peer  A handle representing the peer that sent the message.
 	 * @param _Data  A pointer to the received data.
 	 * @param _Size  The size of the received data in bytes.
+	 * @param _Handle The packet carrying the data, which a handler may retain.
 	 */
-	extern void OnMessage(peer_t _Peer, pdata_t _Data, std::size_t _Size);
+	extern void OnMessage(peer_t _Peer, pdata_t _Data, std::size_t _Size, phandle_t _Handle);
 }
 
 #endif // ^^^ !_CALLBACKS_H_
\ No newline at end of file
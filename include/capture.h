@@ -0,0 +1,179 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+#pragma once
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "const.h"
+#include "mapped_file.h"
+
+namespace cat {
+	/* Kinds of events stored in a capture */
+	enum class capture_event : std::uint8_t {
+		connect		= 1,
+		disconnect	= 2,
+		message		= 3,
+	};
+
+	/*
+	 * @brief Traffic capture of one shard.
+	 *
+	 * While a capture runs, core dispatch appends every connect, disconnect
+	 * and received message of the shard's host to a binary log. The tick
+	 * thread only encodes records into an in-memory buffer; once the buffer
+	 * passes swap_size it is swapped with a second one, and a writer
+	 * thread copies the full buffer into a memory-mapped file, growing the
+	 * mapping as it goes. If the writer falls behind, the tick thread keeps
+	 * appending to its buffer rather than waiting.
+	 *
+	 * Log layout: a 16-byte header ("CSOVCAP" NUL, u32 version, u32 zero)
+	 * followed by records of
+	 *   varint microseconds since the previous record, u8 capture_event,
+	 *   varint peer slot, and for messages varint size plus the bytes.
+	 * The peer slot is the peer's index within its host, so a replay can
+	 * tell peers apart without any addresses.
+	 */
+	class capture {
+	public:
+		//< Buffered bytes that trigger a hand-off to the writer thread
+		static constexpr std::size_t swap_size = 1 << 20;
+
+		//< Step by which the mapped log file grows
+		static constexpr std::size_t grow_size = 64 << 20;
+
+		//< Log format version
+		static constexpr std::uint32_t version = 1;
+	public:
+		/*
+		 * Starts capturing the calling shard's traffic.
+		 *
+		 * @param _Path The log file to create; an existing file is replaced.
+		 * @throws std::runtime_error if the file cannot be created or a
+		 *         capture is already running on the shard.
+		 */
+		static void start(const std::string& _Path);
+
+		/*
+		 * Stops the calling shard's capture and writes out what is buffered.
+		 *
+		 * @return The size of the finished log in bytes, or 0 if no capture ran.
+		 */
+		static std::size_t stop();
+
+		/*
+		 * Returns whether the calling shard is capturing.
+		 */
+		[[nodiscard]] static bool active() noexcept;
+
+		/*
+		 * Returns whether the calling shard's capture hit a write error.
+		 *
+		 * Once the log cannot be grown, the writer stops and no more
+		 * records are taken; stop() still closes the file at the bytes
+		 * written before the error. Cleared by start().
+		 */
+		[[nodiscard]] static bool failed() noexcept;
+
+		/*
+		 * Appends one event to the calling shard's capture, if one runs.
+		 *
+		 * Called by core dispatch on the shard's I/O thread.
+		 *
+		 * @param _Event The kind of event.
+		 * @param _Slot  The peer's slot within its host.
+		 * @param _Data  The message bytes, or nullptr.
+		 * @param _Size  The number of message bytes.
+		 */
+		static void record(capture_event _Event, std::uint32_t _Slot,
+			pdata_t _Data = nullptr, std::size_t _Size = 0) noexcept;
+	};
+
+	/*
+	 * @brief Deterministic replay of a capture.
+	 *
+	 * Feeds a log written by capture into the calling shard's callbacks
+	 * (OnConnect, OnDisconnect, OnMessage), exactly as core dispatch
+	 * would, without any sockets. Peers are stand-ins indexed by their
+	 * captured slot, so the user table, service and dispatcher see the
+	 * same connection pattern as the recorded host. Sends queued by the
+	 * handlers are drained and discarded after every event.
+	 */
+	class replay {
+	public:
+		/*
+		 * Outcome of a replay run.
+		 *
+		 * @member events Records dispatched.
+		 * @member connects Connect events dispatched.
+		 * @member disconnects Disconnect events dispatched.
+		 * @member messages Messages dispatched.
+		 * @member bytes_in Message bytes dispatched.
+		 * @member bytes_out Bytes the handlers queued for sending.
+		 * @member elapsed Wall time of the run.
+		 * @member truncated Whether the log ended inside a record.
+		 */
+		struct result {
+			std::uint64_t events = 0;
+			std::uint64_t connects = 0;
+			std::uint64_t disconnects = 0;
+			std::uint64_t messages = 0;
+			std::uint64_t bytes_in = 0;
+			std::uint64_t bytes_out = 0;
+			std::chrono::nanoseconds elapsed{ 0 };
+			bool truncated = false;
+		};
+	public:
+		/*
+		 * Opens a capture log.
+		 *
+		 * @param _Path The log file.
+		 * @throws std::runtime_error if the file cannot be read or is not a capture.
+		 */
+		explicit replay(const std::string& _Path);
+
+		/*
+		 * Dispatches every record of the log on the calling shard.
+		 *
+		 * Peers still connected when the log ends get a disconnect, so the
+		 * shard is left without stand-in peers.
+		 *
+		 * @param _Speed 0 replays as fast as possible; otherwise records are
+		 *               paced at the captured timing scaled by the factor
+		 *               (1 = real time, 2 = twice as fast).
+		 * @return Counts and timing of the run.
+		 */
+		result run(double _Speed = 0);
+	private:
+		//< The mapped log
+		mapped_file file;
+	};
+}
+
+#endif // ^^^ !_CAPTURE_H_
@@ -0,0 +1,56 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+
+#pragma once
+#ifndef _CHECKSUM_H_
+#define _CHECKSUM_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cat {
+	/*
+	 * @brief Compute the CRC-32C (Castagnoli) of a buffer.
+	 *
+	 * Uses the SSE4.2 crc32 instruction, eight bytes at a time, when the
+	 * CPU has it, and a slicing-by-8 table otherwise; both give the same
+	 * result. Calls chain: crc32c(b, crc32c(a)) equals the CRC of a
+	 * followed by b.
+	 *
+	 * @param _Data The bytes to checksum.
+	 * @param _Size The number of bytes.
+	 * @param _Crc  The CRC of the preceding bytes, 0 to start.
+	 * @return The CRC of everything so far.
+	 */
+	[[nodiscard]] std::uint32_t crc32c(const void* _Data, std::size_t _Size, std::uint32_t _Crc = 0) noexcept;
+
+	/*
+	 * @brief Returns whether crc32c() runs on the SSE4.2 instruction.
+	 */
+	[[nodiscard]] bool crc32c_accelerated() noexcept;
+}
+
+#endif // ^^^ !_CHECKSUM_H_
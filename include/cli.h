@@ -28,6 +28,9 @@
 
 #include <cstdint>
 #include <string>
+#include <string_view>
+#include "const.h"
+#include "core.h"
 
 namespace cli {
 	/*
@@ -42,7 +45,120 @@ namespace cli {
 
 		/*** Port number ***/
 		std::uint16_t port = 8080;
+
+		/*** Maximum number of concurrent users ***/
+		std::uint32_t maxusers = MAX_USERS;
+
+		/*** Server tick rate in Hz ***/
+		std::uint32_t tickrate = 64;
+
+		/*** Number of hosts served on consecutive ports, one thread each ***/
+		std::uint32_t shards = 1;
+
+		/*** Worker threads for message handling (0 = handle on the I/O thread) ***/
+		std::uint32_t workers = 0;
+
+		/*** TCP port serving Prometheus metrics (0 = disabled) ***/
+		std::uint16_t metrics = 0;
+
+		/*** Capture traffic to this file; shards after the first append .<shard> ***/
+		std::string capture;
+
+		/*** Keep user slots and session state in this file across restarts; shards after the first append .<shard> ***/
+		std::string sessions;
+
+		/*** Replay this capture instead of opening the host ***/
+		std::string replay;
+
+		/*** Replay pacing (0 = as fast as possible, 1 = real time, 2 = twice as fast) ***/
+		std::uint32_t speed = 0;
+
+		/*** Write trace zones to this Chrome trace file on exit (CSOVMWARE_TRACE builds) ***/
+		std::string trace;
+
+		/*** Also dump the trace whenever a tick takes longer than this many ms (0 = never) ***/
+		std::uint32_t hitch = 0;
+
+		/*** Messages each peer may send per second, charged by packet cost (0 = unlimited) ***/
+		std::uint32_t rate = 0;
+
+		/*** Largest burst a peer may send (0 = one second of rate) ***/
+		std::uint32_t burst = 0;
+
+		/*** Messages handled per peer per tick (0 = unlimited) ***/
+		std::uint32_t pertick = 0;
+
+		/*** What to do with messages beyond the limits: drop, defer or kick ***/
+		std::string overflow = "defer";
+
+		/*** Queued ENet commands beyond which a peer's unreliable sends are shed (0 = never) ***/
+		std::uint32_t backlog = 0;
+
+		/*** Datagram integrity check: none, crc32c or auto (client only; follows the server) ***/
+		std::string integrity = "none";
+	};
+
+	/*
+	 * Command-line arguments structure for the load generator.
+	 *
+	 * The message mix is a comma-separated list of `id:weight:min-max`
+	 * entries, optionally suffixed with `:u` for unreliable delivery; each
+	 * message picks an entry by weight and a size uniformly in [min, max].
+	 */
+	struct load_args {
+		/*** Server IP address ***/
+		std::string host = "127.0.0.1";
+
+		/*** Server port number ***/
+		std::uint16_t port = 8080;
+
+		/*** Number of simulated clients ***/
+		std::uint32_t clients = 1000;
+
+		/*** Threads driving the client hosts ***/
+		std::uint32_t threads = 4;
+
+		/*** Client hosts per thread; the clients are spread over them ***/
+		std::uint32_t hosts = 4;
+
+		/*** Test duration in seconds ***/
+		std::uint32_t duration = 30;
+
+		/*** Messages per second sent by each client ***/
+		std::uint32_t rate = 20;
+
+		/*** New connections started per second across all threads ***/
+		std::uint32_t ramp = 500;
+
+		/*** Scripted message mix ***/
+		std::string mix = "1:80:24-32:u,2:15:64-256,3:5:512-1200";
+
+		/*** Server metrics port to read server-side throughput from (0 = none) ***/
+		std::uint16_t metrics = 0;
+
+		/*** Datagram integrity check, matching the server's: none or crc32c ***/
+		std::string integrity = "none";
 	};
+
+	/*
+	 * Reads an integrity mode name.
+	 *
+	 * @param _Name none, crc32c or auto.
+	 * @param _Mode Receives the mode.
+	 * @return Whether the name is known.
+	 */
+	inline bool parse_integrity(std::string_view _Name, cat::core::integrity& _Mode) noexcept {
+		if (_Name == "none") {
+			_Mode = cat::core::integrity::none;
+		} else if (_Name == "crc32c") {
+			_Mode = cat::core::integrity::crc32c;
+		} else if (_Name == "auto") {
+			_Mode = cat::core::integrity::automatic;
+		} else {
+			return false;
+		}
+		return true;
+	}
 }
 
 #endif // ^^^ !_CLI_H_
\ No newline at end of file
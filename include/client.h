@@ -26,16 +26,39 @@
 #ifndef _CLIENT_H_
 #define _CLIENT_H_
 
+#include <cstdint>
+#include "core.h"
 #include "net.h"
 
 namespace cat {
+	/* Connection state of a client */
+	enum class client_state : std::uint8_t {
+		disconnected	= 0,
+		connecting		= 1,
+		connected		= 2,
+	};
+
 	/*
 	 * Represents a client endpoint for network communication.
 	 *
 	 * This class extends the base `net` class to provide client-specific
 	 * functionality, including connecting to a server and handling data exchange.
+	 *
+	 * Connecting never blocks: connect() only issues the request and
+	 * flush() drives the connection state machine. The outcome is
+	 * reported through the service's connect and disconnect events. A
+	 * lost or failed connection is retried with jittered exponential
+	 * backoff until disconnect() is called, and every attempt presents
+	 * the session token the server granted last, so the server can
+	 * resume the user.
 	 */
 	class client : public net {
+	public:
+		//< Delay before the first reconnect attempt, in milliseconds
+		static constexpr std::uint32_t reconnect_base = 250;
+
+		//< Upper bound of the reconnect delay, in milliseconds
+		static constexpr std::uint32_t reconnect_max = 30000;
 	public:
 		/*
 		 * Constructs a client endpoint descriptor with the specified host and port.
@@ -43,22 +66,28 @@ namespace cat {
 		 * The constructor performs no validation and does not establish any
 		 * networking resources. It simply stores the provided parameters.
 		 *
-		 * @param _Host  A string view representing the server's host/IP to which
-		 *               the client should connect. The referenced string must
-		 *               remain valid for the lifetime of this object.
+		 * @param _Host    A string view representing the server's host/IP to which
+		 *                 the client should connect. The referenced string must
+		 *                 remain valid for the lifetime of this object.
+		 *
+		 * @param _Port    The port number on which the server is expected to be
+		 *                 listening.
 		 *
-		 * @param _Port  The port number on which the server is expected to be
-		 *               listening.
+		 * @param _Timeout The longest time flush() waits for network events,
+		 *                 in milliseconds.
 		 */
-		constexpr client(std::string_view _Host, uint16_t _Port) noexcept
-			: net(_Host, _Port) {
+		constexpr client(std::string_view _Host, uint16_t _Port, std::uint32_t _Timeout = 10) noexcept
+			: net(_Host, _Port), timeout(_Timeout) {
 		}
 
 		/*
-		 * Establishes a connection to the server.
+		 * Starts connecting to the server.
 		 *
-		 * This function performs the necessary initialization and setup,
-		 * such as creating network hosts and preparing for data transmission.
+		 * Creates the client host and issues the first connection attempt
+		 * without waiting for the handshake.
+		 *
+		 * @throws std::runtime_error If the host cannot be created or the
+		 *         server address cannot be resolved.
 		 */
 		void connect() const override;
 
@@ -66,17 +95,36 @@ namespace cat {
 		 * Disconnects from the server and cleans up resources.
 		 *
 		 * This function ensures that all network resources are properly released
-		 * and that the client is gracefully disconnected from the server.
+		 * and that the client is gracefully disconnected from the server. No
+		 * further reconnect is attempted.
 		 */
 		void disconnect() const override;
 
 		/*
 		 * Polls for incoming events or messages from the server.
 		 *
-		 * This function checks for any new data or events and processes them
-		 * accordingly, allowing the client to respond to server communications.
+		 * Waits at most `timeout` milliseconds, and starts the next
+		 * connection attempt once the reconnect delay has passed.
 		 */
 		void flush() const override;
+
+		/*
+		 * Returns the current connection state.
+		 */
+		[[nodiscard]] client_state state() const noexcept;
+
+		/*
+		 * Returns the session token the server granted the connection.
+		 *
+		 * The token changes with every connection and is lost with
+		 * disconnect(), which starts the next connect() as a new session.
+		 *
+		 * @return The token, all zero until the server granted one.
+		 */
+		[[nodiscard]] const core::session_token& session() const noexcept;
+	public:
+		//< Longest wait for network events in flush(), in milliseconds
+		const std::uint32_t timeout;
 	};
 }
 
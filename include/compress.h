@@ -0,0 +1,129 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+#pragma once
+#ifndef _COMPRESS_H_
+#define _COMPRESS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "stream.h"
+
+namespace cat {
+	/* Counters describing the work done by the compression stage */
+	struct compression_stats {
+		std::uint64_t packed = 0;			//< Messages sent compressed
+		std::uint64_t skipped = 0;			//< Messages over the threshold that did not shrink
+		std::uint64_t raw_bytes = 0;		//< Size of the packed messages before compression
+		std::uint64_t packed_bytes = 0;		//< Size of the packed messages after compression
+		std::uint64_t pack_ns = 0;			//< Time spent compressing, in nanoseconds
+		std::uint64_t unpacked = 0;			//< Compressed messages received
+		std::uint64_t unpack_ns = 0;		//< Time spent decompressing, in nanoseconds
+		std::uint64_t failures = 0;			//< Compressed messages that could not be decoded
+	};
+
+	/*
+	 * @brief Payload compression with an optional shared dictionary.
+	 *
+	 * Typed sends whose framed size exceeds their packet type's
+	 * compress_above threshold are compressed with a small LZ77 codec
+	 * using the LZ4 block layout, and sent as a compressed frame:
+	 *
+	 *   compressed_frame_id, dictionary ID, varint original size, block
+	 *
+	 * The dispatcher unpacks such frames transparently. Messages that do
+	 * not shrink are sent unchanged.
+	 *
+	 * A dictionary trained on captured traffic primes the codec with the
+	 * byte sequences that recur across messages, which is what makes small
+	 * and medium messages compressible at all. Both ends must load the same
+	 * dictionary under the same ID during startup, before any traffic.
+	 */
+	class compressor {
+	public:
+		//< Largest supported dictionary (matches reach back at most 64 KiB)
+		static constexpr std::size_t max_dictionary = 0xFFFF;
+
+		//< Largest message a compressed frame may expand to; larger ones are sent unchanged
+		static constexpr std::size_t max_frame = std::size_t{ 1 } << 20;
+	public:
+		/*
+		 * Installs the dictionary used by both directions.
+		 *
+		 * @param _Dictionary The dictionary bytes (at most max_dictionary).
+		 * @param _Id         Non-zero ID sent with every frame; 0 removes the dictionary.
+		 * @return true if the dictionary was installed, false if it is too large.
+		 */
+		static bool set_dictionary(std::span<const std::byte> _Dictionary, std::uint8_t _Id);
+
+		/*
+		 * Builds a dictionary from sample messages.
+		 *
+		 * Keeps the byte sequences that occur most often across the
+		 * samples, the most frequent last so that they sit at the shortest
+		 * match distances.
+		 *
+		 * @param _Samples  Captured messages, e.g. from a capture file.
+		 * @param _Capacity Size of the dictionary to build (at most max_dictionary).
+		 * @return The dictionary bytes.
+		 */
+		[[nodiscard]] static std::vector<std::byte> train(std::span<const std::span<const std::byte>> _Samples, std::size_t _Capacity);
+
+		/*
+		 * Compresses a framed message into a compressed frame.
+		 *
+		 * @param _Frame The framed message (packet ID and body).
+		 * @param _Out   Receives the compressed frame; its previous contents are discarded.
+		 * @return true if the frame shrank and _Out holds it, false to send _Frame as is.
+		 */
+		static bool pack(const ostream& _Frame, ostream& _Out);
+
+		/*
+		 * Decompresses a compressed frame.
+		 *
+		 * @param _Stream Stream positioned just after the compressed_frame_id byte.
+		 * @param _Out    Receives the original framed message.
+		 * @return true if the frame was decoded, false if it is malformed,
+		 *         expands beyond max_frame or uses a different dictionary.
+		 */
+		static bool unpack(istream& _Stream, std::vector<std::byte>& _Out);
+
+		/*
+		 * Returns the counters accumulated by all threads.
+		 */
+		[[nodiscard]] static compression_stats stats() noexcept;
+
+		/*
+		 * Returns the worst-case block size for an input size.
+		 */
+		[[nodiscard]] static constexpr std::size_t bound(std::size_t _Size) noexcept {
+			return _Size + _Size / 255 + 16;
+		}
+	};
+}
+
+#endif // ^^^ !_COMPRESS_H_
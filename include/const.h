@@ -27,16 +27,23 @@
 #define _CONST_H_
 
 //
-// Define the maximum number of users supported by the server
+// Define the default maximum number of users supported by the server
 //
 
 constexpr int MAX_USERS = 32;
 
+//
+// Define the maximum number of hosts (shards) served by one process
+//
+
+constexpr int MAX_SHARDS = 16;
+
 //
 // Define custom types for better code readability
 //
 typedef void*			peer_t;
 typedef const void*		pdata_t;
 typedef unsigned int 	userid_t;
+typedef void*			phandle_t;
 
 #endif // ^^^ !_CONST_H_
\ No newline at end of file
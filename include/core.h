@@ -26,21 +26,57 @@
 #ifndef _CORE_H_
 #define _CORE_H_
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <limits>
+#include <span>
 #include <string_view>
+#include "const.h"
+
+namespace cat {
+	class worker_pool;
+}
 
 namespace cat::core {
+	/* Connection quality of one peer, as measured by ENet */
+	struct peer_stats {
+		std::uint32_t id;			//< The peer's slot in its host
+		std::uint32_t rtt;			//< Mean round-trip time in milliseconds
+		std::uint32_t rtt_variance;	//< Round-trip time variance in milliseconds
+		std::uint32_t loss;			//< Packet loss, scaled so that 65536 is 100 %
+		std::uint32_t in_transit;	//< Reliable bytes sent but not yet acknowledged
+	};
+
+	/*
+	 * Secret a server issues to each connection so it can resume its session.
+	 *
+	 * All zero stands for no session.
+	 */
+	using session_token = std::array<std::uint8_t, 16>;
+
+	/* Integrity check applied to every datagram of a host */
+	enum class integrity : std::uint8_t {
+		none,		//< No checksum, as plain ENet
+		crc32c,		//< CRC-32C over the datagram and the connection ID, through ENet's checksum hook
+		automatic,	//< Client only: try crc32c, and switch modes after each failed handshake until one connects
+	};
+
 	/*
 	 * Initializes the ENet library for networking.
 	 *
-	 * Must be called before any ENet operations.
+	 * Must be called before any ENet operations. All core state is kept
+	 * per shard (see shard.h); each shard initializes separately and the
+	 * library itself is initialized by the first one.
 	 */
 	void Core_enet_initialize();
 
 	/*
 	 * Deinitializes the ENet library and cleans up resources.
 	 *
-	 * Must be called after all ENet operations are finished.
+	 * Destroys the calling shard's host. Must be called after all of the
+	 * shard's ENet operations are finished; the library is shut down once
+	 * the last shard has deinitialized.
 	 */
 	void Core_enet_deinitialize();
 
@@ -50,12 +86,35 @@ namespace cat::core {
 	 * @param _Host The hostname or IP address to bind the server to.
 	 * @param _Port The port number on which the server will listen for incoming connections.
 	 * @param _Cltnum The maximum number of clients that can connect to the server.
+	 * @param _Chnum The number of channels allocated for each peer.
 	 */
-	void Core_enet_server_create(std::string_view _Host, std::uint32_t _Port, std::uint32_t _Cltnum);
+	void Core_enet_server_create(std::string_view _Host, std::uint32_t _Port, std::uint32_t _Cltnum, std::uint32_t _Chnum);
+
+	/*
+	 * Selects the integrity check of the calling shard's host.
+	 *
+	 * Both ends of a connection must use the same mode, as the checksum
+	 * changes the datagram header; a mismatched handshake never completes.
+	 * A client in automatic mode finds the server's mode by itself: its
+	 * handshakes time out quickly and alternate between the modes until
+	 * one succeeds, which is kept for later reconnects. Applies to the
+	 * next host created and, if it has no connections yet, the current one.
+	 *
+	 * @param _Mode The integrity check to use.
+	 */
+	void Core_enet_set_integrity(integrity _Mode) noexcept;
+
+	/*
+	 * Returns whether the calling shard's host currently checksums its datagrams.
+	 */
+	[[nodiscard]] bool Core_enet_checksummed() noexcept;
 
 	/*
 	 * Kicks a connected peer from the host.
 	 *
+	 * Call it on the thread driving the host; handlers that may run on a
+	 * worker thread use pool_manager::kick() instead.
+	 *
 	 * @param _Peer The peer to be disconnected.
 	 */
 	void Core_enet_server_kick(void* _Peer);
@@ -64,36 +123,221 @@ namespace cat::core {
 	 * Creates an ENet client host.
 	 *
 	 * @param _Cltnum The maximum number of channels to be used for communication.
+	 * @param _Peers  The number of connections the host can hold.
 	 */
-	void Core_enet_client_create(std::uint32_t _Cltnum);
+	void Core_enet_client_create(std::uint32_t _Cltnum, std::uint32_t _Peers = 1);
 
 	/*
-	 * Connects the ENet client to a remote server.
+	 * Starts connecting the ENet client to a remote server.
+	 *
+	 * Does not wait for the handshake. The result is reported by a later
+	 * Core_enet_poll() as a connect event, or as a disconnect event for
+	 * the server peer if the attempt fails or times out.
 	 *
 	 * @param _Server The hostname or IP address of the remote server.
 	 * @param _Port The port number of the remote server.
+	 * @param _Chnum The number of channels to request from the server.
+	 * @param _Data Value delivered to the server with the connection request.
+	 * @throws std::runtime_error If no client host exists, a connection is
+	 *         already in progress, or the address cannot be resolved.
 	 */
-	void Core_enet_client_connect(std::string_view _Server, std::uint32_t _Port);
+	void Core_enet_client_connect(std::string_view _Server, std::uint32_t _Port, std::uint32_t _Chnum, std::uint32_t _Data = 0);
+
+	/*
+	 * Starts an additional connection from the client host.
+	 *
+	 * Unlike Core_enet_client_connect(), the peer is not tracked as the
+	 * client's server connection and the caller keeps the handle, so one
+	 * host can carry many connections (e.g. for load generation). Its
+	 * outcome is reported through Core_enet_poll() the same way.
+	 *
+	 * @param _Server The hostname or IP address of the remote server.
+	 * @param _Port The port number of the remote server.
+	 * @param _Chnum The number of channels to request from the server.
+	 * @param _Data Value delivered to the server with the connection request.
+	 * @return The new peer.
+	 * @throws std::runtime_error If no client host exists, all of its peers
+	 *         are in use, or the address cannot be resolved.
+	 */
+	peer_t Core_enet_client_open(std::string_view _Server, std::uint32_t _Port, std::uint32_t _Chnum, std::uint32_t _Data = 0);
 
 	/*
 	 * Disconnects the client from its connected server.
 	 */
 	void Core_enet_client_disconnect();
 
+	/*
+	 * Returns the peer representing the client's connection to the server.
+	 *
+	 * @return The server peer while connecting or connected, otherwise nullptr.
+	 */
+	[[nodiscard]] peer_t Core_enet_client_peer() noexcept;
+
+	/*
+	 * Returns the session token the server granted the client's server connection.
+	 *
+	 * Every connection starts with a session frame, session_frame_id
+	 * followed by the 16 token bytes: the client's first message presents the token it holds, and the
+	 * server answers with the token granted for the new connection. The
+	 * token is kept across reconnects of the same host, so a reconnecting
+	 * client proves which session it had; it is cleared with the host.
+	 *
+	 * @return The token, all zero until the server granted one.
+	 */
+	[[nodiscard]] const session_token& Core_enet_client_session() noexcept;
+
 	/*
 	 * Polls for incoming network events such as connections,
 	 * disconnections, and data packets.
 	 *
-	 * This function blocks for a specified duration while waiting
-	 * for events, then returns control to the caller.
+	 * This function blocks for up to `_Timeout` milliseconds waiting for
+	 * the first event, then dispatches already-available events without
+	 * blocking, up to `_Budget` events per call.
+	 *
+	 * @param _Timeout Maximum time to wait for the first event, in milliseconds.
+	 * @param _Budget  Maximum number of events to dispatch in this call.
+	 * @return The number of events dispatched.
+	 */
+	std::size_t Core_enet_poll(std::uint32_t _Timeout = 1000,
+		std::size_t _Budget = std::numeric_limits<std::size_t>::max());
+
+	/*
+	 * Switches event dispatch between inline and threaded mode.
+	 *
+	 * By default Core_enet_poll() runs the callbacks inline. With a worker
+	 * pool attached it only decodes events and posts them to the workers,
+	 * and pool_manager accepts sends from any thread. The polling thread
+	 * then acts as the dedicated I/O thread and must also call
+	 * Core_enet_send(). Switch modes only while no events are in flight.
+	 *
+	 * @param _Pool The worker pool to hand events to, or nullptr for inline dispatch.
+	 */
+	void Core_enet_attach_workers(worker_pool* _Pool) noexcept;
+
+	/*
+	 * Enables or disables batching of outgoing messages.
+	 *
+	 * When enabled (the default), Core_enet_send() packs consecutive small
+	 * messages queued for the same peer, channel and delivery flags into
+	 * one batch frame (see batch.h). Receiving always understands batch
+	 * frames, whatever this setting.
+	 *
+	 * @param _Enabled Whether to build batch frames.
+	 */
+	void Core_enet_set_batching(bool _Enabled) noexcept;
+
+	/*
+	 * Returns the application data attached to a peer.
+	 *
+	 * @param _Peer The peer to query.
+	 * @return The pointer last stored with Core_enet_peer_set_data(), or nullptr.
+	 */
+	[[nodiscard]] void* Core_enet_peer_data(peer_t _Peer) noexcept;
+
+	/*
+	 * Attaches application data to a peer.
+	 *
+	 * The pointer is cleared automatically once the peer's disconnect has
+	 * been dispatched.
+	 *
+	 * @param _Peer The peer to update.
+	 * @param _Data The pointer to store.
+	 */
+	void Core_enet_peer_set_data(peer_t _Peer, void* _Data) noexcept;
+
+	/*
+	 * Reads the connection quality of the host's connected peers.
+	 *
+	 * Call it on the thread driving the host.
+	 *
+	 * @param _Out Receives one entry per connected peer, as far as it has room.
+	 * @return The number of connected peers, which may exceed _Out.size().
+	 */
+	std::size_t Core_enet_peer_stats(std::span<peer_stats> _Out) noexcept;
+
+	/*
+	 * Returns the value a peer sent with its connection request.
+	 *
+	 * On the server this is the _Data the client passed to
+	 * Core_enet_client_connect(); valid from the peer's connect event on.
+	 * It travels in the clear before any handshake, so it must not be
+	 * trusted to identify a client; see Core_enet_connect_session().
+	 *
+	 * @param _Peer The peer to query.
+	 * @return The connect data, or 0 if none was sent.
+	 */
+	[[nodiscard]] std::uint32_t Core_enet_peer_connect_data(peer_t _Peer) noexcept;
+
+	/*
+	 * Reads the session token a peer presented from its connect event.
+	 *
+	 * A server raises a peer's connect event only once the peer's opening
+	 * session frame has arrived, and drops peers that send none within a
+	 * few seconds; messages sent ahead of the frame are held back and
+	 * dispatched after the connect event. The event's data is the token,
+	 * carried with the event so a worker never reads the I/O thread's
+	 * state. The token is whatever the client held, so it must be checked
+	 * against the token granted earlier before any state is handed over.
+	 *
+	 * @param _Data The connect event's data.
+	 * @param _Size The connect event's size.
+	 * @return The presented token, all zero for a new session or a
+	 *         connect event that carries none, such as a replayed one.
+	 */
+	[[nodiscard]] session_token Core_enet_connect_session(pdata_t _Data, std::size_t _Size) noexcept;
+
+	/*
+	 * Queues the session frame granting a peer its session token.
+	 *
+	 * The frame is sent reliably on channel 0 through pool_manager, so it
+	 * may be called wherever sends to the peer are allowed.
+	 *
+	 * @param _Peer  The peer to grant the token to.
+	 * @param _Token The token the peer must present to resume its session.
+	 * @return true if the frame was queued, false otherwise.
+	 */
+	bool Core_enet_peer_grant(peer_t _Peer, const session_token& _Token);
+
+	/*
+	 * Returns whether a peer's send queue has reached the backlog limit.
+	 *
+	 * While it has, Core_enet_send() sheds the peer's unreliable packets,
+	 * so callers may skip building them. Always false unless
+	 * rate_limit::max_backlog is set. Call it on the thread driving the host.
+	 *
+	 * @param _Peer The peer to inspect.
+	 * @return Whether unreliable sends to the peer are being shed.
+	 */
+	[[nodiscard]] bool Core_enet_peer_backlogged(peer_t _Peer) noexcept;
+
+	/*
+	 * Keeps a received packet alive beyond its OnMessage() dispatch.
+	 *
+	 * By default a packet is destroyed as soon as its handlers return.
+	 * Each retain must be balanced by a call to Core_enet_packet_release().
+	 * The reference count is changed atomically, so packets may be
+	 * retained and released from any thread.
+	 *
+	 * @param _Handle The packet handle passed to OnMessage().
+	 * @param _Count  The number of references to take.
+	 */
+	void Core_enet_packet_retain(phandle_t _Handle, std::size_t _Count = 1) noexcept;
+
+	/*
+	 * Releases a packet previously kept alive by Core_enet_packet_retain().
+	 *
+	 * The packet is destroyed once its last reference is released.
+	 *
+	 * @param _Handle The retained packet handle.
 	 */
-	void Core_enet_poll();
+	void Core_enet_packet_release(phandle_t _Handle) noexcept;
 
 	/*
 	 * Sends queued outgoing packets to connected peers.
 	 * 
-	 * This function ensures that all pending data is transmitted
-	 * for both server and client hosts.
+	 * Drains the pool_manager queues filled by handlers during
+	 * Core_enet_poll() and flushes the host once, so every packet
+	 * of the tick is transmitted in a single burst.
 	 */
 	void Core_enet_send();
 }
@@ -0,0 +1,250 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+#pragma once
+#ifndef _DISPATCHER_H_
+#define _DISPATCHER_H_
+
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include "compress.h"
+#include "const.h"
+#include "packet.h"
+#include "service.h"
+#include "shard.h"
+#include "stream.h"
+
+namespace cat {
+	/* Outcome of dispatching a single message */
+	enum class dispatch_result : std::uint8_t {
+		handled		= 0,	//< Decoded and delivered to its handler
+		empty		= 1,	//< The message carried no ID byte
+		unknown		= 2,	//< The ID is not registered in packet_registry
+		unhandled	= 3,	//< The ID is registered but has no handler
+		malformed	= 4,	//< The body failed to deserialize
+	};
+
+	/*
+	 * @brief Typed message dispatcher.
+	 *
+	 * Routes incoming messages straight from their packet ID to a statically
+	 * typed handler. A message on the wire is one ID byte followed by the
+	 * packet body. For each message the dispatcher reads the ID, indexes a
+	 * flat 256-entry route table, deserializes into a stack instance of the
+	 * concrete packet type, and calls the handler with it. No packet is
+	 * heap-allocated and no virtual call is made on this path; the
+	 * deserialize call is qualified with the concrete type. Compressed
+	 * frames are unpacked first and then dispatched the same way.
+	 *
+	 * Routes are registered during startup, the same as packet types.
+	 */
+	class dispatcher {
+	public:
+		/*
+		 * @brief Register a handler for a packet type.
+		 *
+		 * The packet type must already be registered in packet_registry,
+		 * which supplies its ID. A later registration for the same type
+		 * replaces the earlier one.
+		 *
+		 * @tparam _Pkt     The packet type to handle.
+		 * @param _Handler  Function called with the decoded packet.
+		 * @return true  If the route was installed
+		 * @return false If the packet type is not registered
+		 */
+		template<packet_binder _Pkt>
+		bool on(void (*_Handler)(peer_t, const _Pkt&)) noexcept {
+			return install<_Pkt>(&invoke<_Pkt>, reinterpret_cast<erased_fn>(_Handler), nullptr);
+		}
+
+		/*
+		 * @brief Register a handler with a context pointer for a packet type.
+		 *
+		 * @tparam _Pkt     The packet type to handle.
+		 * @param _Handler  Function called with the context and decoded packet.
+		 * @param _Context  Opaque pointer passed back to the handler.
+		 * @return true if the route was installed, false otherwise.
+		 */
+		template<packet_binder _Pkt>
+		bool on(void (*_Handler)(void*, peer_t, const _Pkt&), void* _Context) noexcept {
+			return install<_Pkt>(&invoke_with<_Pkt>, reinterpret_cast<erased_fn>(_Handler), _Context);
+		}
+
+		/*
+		 * @brief Register a capture-less lambda as the handler for a packet type.
+		 *
+		 * @tparam _Pkt The packet type to handle.
+		 * @param _Fn   A callable convertible to void(*)(peer_t, const _Pkt&).
+		 * @return true if the route was installed, false otherwise.
+		 */
+		template<packet_binder _Pkt, class _Fn>
+			requires std::convertible_to<_Fn, void (*)(peer_t, const _Pkt&)>
+		bool on(_Fn _Handler) noexcept {
+			return on<_Pkt>(static_cast<void (*)(peer_t, const _Pkt&)>(_Handler));
+		}
+
+		/*
+		 * @brief Remove the handler of a packet type.
+		 *
+		 * @tparam _Pkt The packet type whose route is removed.
+		 */
+		template<packet_binder _Pkt>
+		void off() noexcept {
+			if (const auto id = packet_registry::id_of<_Pkt>()) {
+				routes[*id] = {};
+			}
+		}
+
+		/*
+		 * @brief Decode and dispatch one message.
+		 *
+		 * @param _Peer   The peer that sent the message.
+		 * @param _Stream Stream positioned at the message's ID byte.
+		 * @return The outcome of the dispatch.
+		 */
+		dispatch_result dispatch(peer_t _Peer, istream& _Stream) const {
+			std::uint8_t id;
+			if (!_Stream.read(id)) {
+				return dispatch_result::empty;
+			}
+
+			if (id == compressed_frame_id) {
+				return dispatch_compressed(_Peer, _Stream);
+			}
+
+			const route& r = routes[id];
+			if (r.thunk == nullptr) {
+				return packet_registry::contains(id) ? dispatch_result::unhandled : dispatch_result::unknown;
+			}
+
+			return r.thunk(r, _Peer, _Stream) ? dispatch_result::handled : dispatch_result::malformed;
+		}
+
+		/*
+		 * @brief Decode and dispatch the message carried by an event.
+		 *
+		 * The payload is parsed in place through a non-owning istream.
+		 *
+		 * @param _Event An enet_message event.
+		 * @return The outcome of the dispatch.
+		 */
+		dispatch_result dispatch(const enet_event& _Event) const {
+			istream stream = istream::view_of(_Event.data, _Event.size);
+			return dispatch(_Event.peer, stream);
+		}
+
+		/*
+		 * @brief Route the service's message events through this dispatcher.
+		 *
+		 * Installs the dispatcher as the enet_message handler of a service.
+		 *
+		 * @param _Service The service whose message events are dispatched.
+		 */
+		static void attach(service& _Service) {
+			_Service.on(enet_service::enet_message, [](service::param_t _Event) {
+				instance().dispatch(_Event); });
+		}
+
+		/*
+		 * @brief Get the singleton instance of the dispatcher.
+		 *
+		 * @return Reference to the calling shard's dispatcher instance.
+		 */
+		static dispatcher& instance() {
+			return shard_local<dispatcher>();
+		}
+	private:
+		/*
+		 * @brief Unpack a compressed frame and dispatch the message inside.
+		 *
+		 * The message is decompressed into a per-thread buffer, so views a
+		 * handler takes into it are only valid during the handler call.
+		 *
+		 * @param _Peer   The peer that sent the message.
+		 * @param _Stream Stream positioned just after the compressed_frame_id byte.
+		 * @return The outcome of the dispatch.
+		 */
+		dispatch_result dispatch_compressed(peer_t _Peer, istream& _Stream) const {
+			static thread_local std::vector<std::byte> frame;
+			if (!compressor::unpack(_Stream, frame) || frame.front() == std::byte{ compressed_frame_id }) {
+				return dispatch_result::malformed;
+			}
+
+			istream inner = istream::view_of(frame.data(), frame.size());
+			return dispatch(_Peer, inner);
+		}
+
+		//< Type-erased handler pointer (restored to its real type in the thunk)
+		using erased_fn = void (*)();
+
+		/* A single entry of the route table */
+		struct route {
+			bool		(*thunk)(const route&, peer_t, istream&) = nullptr;
+			erased_fn	handler = nullptr;
+			void*		context = nullptr;
+		};
+
+		template<packet_binder _Pkt>
+		bool install(bool (*_Thunk)(const route&, peer_t, istream&), erased_fn _Handler, void* _Context) noexcept {
+			const auto id = packet_registry::id_of<_Pkt>();
+			if (!id || _Handler == nullptr) {
+				return false;
+			}
+			routes[*id] = { _Thunk, _Handler, _Context };
+			return true;
+		}
+
+		template<packet_binder _Pkt>
+		static bool invoke(const route& _Route, peer_t _Peer, istream& _Stream) {
+			_Pkt pkt = make_packet<_Pkt>();
+			{
+				CAT_TRACE_ZONE("packet::deserialize");
+				if (!pkt._Pkt::deserialize(_Stream)) {
+					return false;
+				}
+			}
+			reinterpret_cast<void (*)(peer_t, const _Pkt&)>(_Route.handler)(_Peer, pkt);
+			return true;
+		}
+
+		template<packet_binder _Pkt>
+		static bool invoke_with(const route& _Route, peer_t _Peer, istream& _Stream) {
+			_Pkt pkt = make_packet<_Pkt>();
+			{
+				CAT_TRACE_ZONE("packet::deserialize");
+				if (!pkt._Pkt::deserialize(_Stream)) {
+					return false;
+				}
+			}
+			reinterpret_cast<void (*)(void*, peer_t, const _Pkt&)>(_Route.handler)(_Route.context, _Peer, pkt);
+			return true;
+		}
+
+		//< Route table indexed by packet ID
+		std::array<route, 256> routes{};
+	};
+}
+
+#endif // ^^^ !_DISPATCHER_H_
@@ -0,0 +1,134 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+#pragma once
+#ifndef _LEASE_H_
+#define _LEASE_H_
+
+#include <cstddef>
+#include <span>
+#include <utility>
+#include "const.h"
+#include "core.h"
+#include "service.h"
+#include "stream.h"
+
+namespace cat {
+	/*
+	 * @brief Keeps a received packet alive past its message callback.
+	 *
+	 * Message handlers normally parse the packet in place through a
+	 * non-owning istream, and the packet is destroyed once they return.
+	 * A handler that needs the bytes later (e.g. to process them on the
+	 * next tick) takes a lease instead of copying the payload; the packet
+	 * is released when the last lease goes away.
+	 */
+	class packet_lease {
+	public:
+		constexpr packet_lease() noexcept = default;
+
+		/*
+		 * Retains the packet carried by a message event.
+		 *
+		 * @param _Event The enet_message event whose packet should be kept.
+		 */
+		explicit packet_lease(const enet_event& _Event) noexcept
+			: handle(_Event.handle), data(_Event.data), length(_Event.size) {
+			if (handle != nullptr) {
+				core::Core_enet_packet_retain(handle);
+			}
+		}
+
+		packet_lease(const packet_lease&) = delete;
+		packet_lease& operator=(const packet_lease&) = delete;
+
+		packet_lease(packet_lease&& _Other) noexcept
+			: handle(std::exchange(_Other.handle, nullptr)),
+			  data(std::exchange(_Other.data, nullptr)),
+			  length(std::exchange(_Other.length, 0)) {
+		}
+
+		packet_lease& operator=(packet_lease&& _Other) noexcept {
+			if (this != &_Other) {
+				reset();
+				handle = std::exchange(_Other.handle, nullptr);
+				data = std::exchange(_Other.data, nullptr);
+				length = std::exchange(_Other.length, 0);
+			}
+			return *this;
+		}
+
+		~packet_lease() {
+			reset();
+		}
+
+		/*
+		 * Releases the held packet, if any.
+		 */
+		void reset() noexcept {
+			if (handle != nullptr) {
+				core::Core_enet_packet_release(handle);
+				handle = nullptr;
+				data = nullptr;
+				length = 0;
+			}
+		}
+
+		/*
+		 * Returns the leased packet bytes.
+		 *
+		 * @return A span over the packet payload
+		 */
+		[[nodiscard]] std::span<const std::byte> bytes() const noexcept {
+			return { static_cast<const std::byte*>(data), length };
+		}
+
+		/*
+		 * Returns a non-owning input stream over the leased packet.
+		 *
+		 * @return An istream viewing the packet payload
+		 */
+		[[nodiscard]] istream stream() const noexcept {
+			return istream::view_of(data, length);
+		}
+
+		/*
+		 * Returns whether the lease currently holds a packet.
+		 */
+		[[nodiscard]] explicit operator bool() const noexcept {
+			return handle != nullptr;
+		}
+	private:
+		//< Retained packet handle
+		phandle_t handle = nullptr;
+
+		//< Pointer to the packet payload
+		pdata_t data = nullptr;
+
+		//< Size of the packet payload in bytes
+		std::size_t length = 0;
+	};
+}
+
+#endif // ^^^ !_LEASE_H_
@@ -0,0 +1,147 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+#pragma once
+#ifndef _LIMITER_H_
+#define _LIMITER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cat {
+	/* What happens to a message its sender has no budget left for */
+	enum class overflow_policy : std::uint8_t {
+		drop,		//< Discard the message
+		defer,		//< Keep it for the next tick, in order; discard once max_deferred are waiting
+		kick,		//< Disconnect the sender
+	};
+
+	/* Verdict of the limiter on one received message */
+	enum class admission : std::uint8_t {
+		accept,
+		drop,
+		defer,
+		kick,
+	};
+
+	/*
+	 * Limits of the per-peer rate limiter. A zero disables the matching limit.
+	 */
+	struct rate_limit {
+		//< Tokens added to each peer's bucket per second
+		std::uint32_t rate = 0;
+
+		//< Bucket capacity, the largest burst a peer may send (0 = one second of rate)
+		std::uint32_t burst = 0;
+
+		//< Messages handled per peer per tick, whatever the bucket holds
+		std::uint32_t per_tick = 0;
+
+		//< Action taken on messages beyond the limits
+		overflow_policy policy = overflow_policy::defer;
+
+		//< Messages kept per peer under overflow_policy::defer
+		std::uint32_t max_deferred = 256;
+
+		//< ENet commands queued for a peer beyond which its unreliable sends are shed
+		std::uint32_t max_backlog = 0;
+	};
+
+	/*
+	 * @brief Per-peer token buckets guarding the tick budget of a shard.
+	 *
+	 * Every received message is charged its packet type's qos().cost from
+	 * its sender's bucket, which fills at rate tokens per second up to
+	 * burst, and counts against the sender's per_tick allowance. A message
+	 * that finds either exhausted gets the configured overflow policy, so
+	 * a flooding peer spends its own budget instead of the other peers'
+	 * latency. Core dispatch asks for admission on the I/O thread and
+	 * holds deferred messages itself; peers are identified by their slot
+	 * within the host.
+	 *
+	 * The limiter is off until configure() sets a limit. All functions
+	 * act on the calling shard.
+	 */
+	class limiter {
+	public:
+		/*
+		 * Sets the limits and sizes the per-peer state.
+		 *
+		 * @param _Limits The limits to apply.
+		 * @param _Peers  The number of peer slots of the shard's host.
+		 */
+		static void configure(const rate_limit& _Limits, std::size_t _Peers);
+
+		/*
+		 * Returns the calling shard's limits.
+		 */
+		[[nodiscard]] static const rate_limit& limits() noexcept;
+
+		/*
+		 * Returns whether any receive limit is set.
+		 */
+		[[nodiscard]] static bool enabled() noexcept;
+
+		/*
+		 * Refills the buckets and restarts the per-tick allowances.
+		 *
+		 * Called by Core_enet_poll() before it dispatches anything.
+		 */
+		static void begin_tick() noexcept;
+
+		/*
+		 * Decides what to do with a received message.
+		 *
+		 * An accepted message is charged to its sender. A deferred one is
+		 * counted as waiting until it is released with retry().
+		 *
+		 * @param _Slot The sender's slot.
+		 * @param _Id   The message's packet ID.
+		 * @return The verdict.
+		 */
+		[[nodiscard]] static admission admit(std::size_t _Slot, std::uint8_t _Id) noexcept;
+
+		/*
+		 * Decides again on a message deferred by an earlier tick.
+		 *
+		 * Deferred messages must be retried in arrival order, before any
+		 * newly received message is admitted.
+		 *
+		 * @param _Slot The sender's slot.
+		 * @param _Id   The message's packet ID.
+		 * @return The verdict; defer means it stays waiting.
+		 */
+		[[nodiscard]] static admission retry(std::size_t _Slot, std::uint8_t _Id) noexcept;
+
+		/*
+		 * Forgets a slot's state when its peer connects or disconnects.
+		 *
+		 * @param _Slot The peer's slot.
+		 */
+		static void reset(std::size_t _Slot) noexcept;
+	};
+}
+
+#endif // ^^^ !_LIMITER_H_
@@ -0,0 +1,163 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+#pragma once
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace cat {
+	/*
+	 * @brief Memory-mapped file.
+	 *
+	 * Maps a whole file into memory for reading, creates one of a given
+	 * size for writing, or maps an existing file for updating in place.
+	 * A writable mapping can be grown in place, and its
+	 * file is trimmed to the bytes actually used when it is closed, so
+	 * writers can map generously ahead of their data.
+	 */
+	class mapped_file {
+	public:
+		/* Access mode of a mapping */
+		enum class mode : std::uint8_t {
+			read,		//< Map an existing file read-only
+			write,		//< Create or truncate a file
+			update,		//< Open or create a file, keeping its contents
+		};
+	public:
+		mapped_file() = default;
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		mapped_file(mapped_file&& _Other) noexcept;
+		mapped_file& operator=(mapped_file&& _Other) noexcept;
+
+		~mapped_file() {
+			close();
+		}
+
+		/*
+		 * Opens and maps a file.
+		 *
+		 * @param _Path The file to map.
+		 * @param _Mode mode::read maps an existing file; mode::write creates
+		 *              or truncates the file and sizes it to `_Size`;
+		 *              mode::update keeps the contents and sizes the file to
+		 *              `_Size`, zero-filling any growth.
+		 * @param _Size Initial size of a writable mapping, in bytes.
+		 * @return true if the file is mapped.
+		 */
+		bool open(const std::string& _Path, mode _Mode, std::size_t _Size = 0);
+
+		/*
+		 * Grows or shrinks a writable mapping.
+		 *
+		 * The address of the mapping may change. If the file cannot be
+		 * resized or remapped, the mapping keeps its previous size, or
+		 * becomes empty when that cannot be restored either.
+		 *
+		 * @param _Size The new size in bytes.
+		 * @return true if the file was resized and remapped.
+		 */
+		bool resize(std::size_t _Size);
+
+		/*
+		 * Starts writing a range of a writable mapping back to disk,
+		 * without waiting for it to complete.
+		 *
+		 * @param _Offset Start of the range.
+		 * @param _Size   Length of the range.
+		 */
+		void flush(std::size_t _Offset, std::size_t _Size) noexcept;
+
+		/*
+		 * Unmaps and closes the file.
+		 *
+		 * @param _Used For writable mappings, the number of bytes to keep;
+		 *              the file is truncated to it. Defaults to the full mapping.
+		 */
+		void close(std::size_t _Used = static_cast<std::size_t>(-1)) noexcept;
+
+		/*
+		 * Returns whether a file is mapped.
+		 */
+		[[nodiscard]] bool is_open() const noexcept {
+			return base != nullptr || handle != invalid;
+		}
+
+		/*
+		 * Returns the mapped bytes.
+		 */
+		[[nodiscard]] std::span<std::byte> bytes() noexcept {
+			return { base, length };
+		}
+
+		/*
+		 * Returns the mapped bytes.
+		 */
+		[[nodiscard]] std::span<const std::byte> bytes() const noexcept {
+			return { base, length };
+		}
+
+		/*
+		 * Returns the size of the mapping in bytes.
+		 */
+		[[nodiscard]] std::size_t size() const noexcept {
+			return length;
+		}
+	private:
+		/*
+		 * Maps `length` bytes of the open file.
+		 */
+		bool map() noexcept;
+
+		/*
+		 * Unmaps the file, keeping it open.
+		 */
+		void unmap() noexcept;
+
+		//< Marker for a closed file handle
+		static constexpr std::intptr_t invalid = -1;
+
+		//< Start of the mapping, nullptr if unmapped
+		std::byte* base = nullptr;
+
+		//< Size of the mapping
+		std::size_t length = 0;
+
+		//< Native file handle or descriptor
+		std::intptr_t handle = invalid;
+
+		//< Access mode of the open file
+		mode access = mode::read;
+	};
+}
+
+#endif // ^^^ !_MAPPED_FILE_H_
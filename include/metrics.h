@@ -0,0 +1,262 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+#pragma once
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "limiter.h"
+
+namespace cat {
+	/*
+	 * @brief Lock-free log-linear latency histogram.
+	 *
+	 * Values below 16 get a bucket each; above that every power of two is
+	 * split into 16 linear sub-buckets, so any recorded value is known to
+	 * within 1/16 (about 6 %) over the whole 64-bit range, in the HDR
+	 * histogram style. Recording is a single relaxed increment, and any
+	 * thread may record while another reads.
+	 */
+	class histogram {
+	public:
+		//< Sub-buckets per power of two, as a power of two
+		static constexpr unsigned sub_bits = 4;
+
+		//< Number of buckets covering every 64-bit value
+		static constexpr std::size_t bucket_count = (64 - sub_bits + 1) << sub_bits;
+	public:
+		/*
+		 * Records one value.
+		 *
+		 * @param _Value The value, typically a duration in nanoseconds.
+		 */
+		void record(std::uint64_t _Value) noexcept {
+			buckets[index(_Value)].fetch_add(1, std::memory_order_relaxed);
+			total.fetch_add(_Value, std::memory_order_relaxed);
+		}
+
+		/*
+		 * Records a duration in nanoseconds.
+		 */
+		void record(std::chrono::nanoseconds _Duration) noexcept {
+			record(static_cast<std::uint64_t>(_Duration.count() < 0 ? 0 : _Duration.count()));
+		}
+
+		/*
+		 * Returns the value below which a fraction of the samples lie.
+		 *
+		 * @param _Quantile The fraction, between 0 and 1.
+		 * @return The upper bound of the bucket holding the quantile, or 0 if empty.
+		 */
+		[[nodiscard]] std::uint64_t quantile(double _Quantile) const noexcept;
+
+		/*
+		 * Returns the number of recorded values.
+		 */
+		[[nodiscard]] std::uint64_t count() const noexcept;
+
+		/*
+		 * Returns the sum of all recorded values.
+		 */
+		[[nodiscard]] std::uint64_t sum() const noexcept {
+			return total.load(std::memory_order_relaxed);
+		}
+
+		/*
+		 * Maps a value to its bucket.
+		 */
+		[[nodiscard]] static constexpr std::size_t index(std::uint64_t _Value) noexcept {
+			constexpr std::uint64_t linear = std::uint64_t{ 1 } << sub_bits;
+			if (_Value < linear) {
+				return static_cast<std::size_t>(_Value);
+			}
+			const unsigned exponent = static_cast<unsigned>(std::bit_width(_Value)) - 1;
+			return ((exponent - sub_bits + 1) << sub_bits) | ((_Value >> (exponent - sub_bits)) & (linear - 1));
+		}
+
+		/*
+		 * Returns the smallest value mapped to a bucket.
+		 */
+		[[nodiscard]] static constexpr std::uint64_t lower_bound(std::size_t _Index) noexcept {
+			constexpr std::uint64_t linear = std::uint64_t{ 1 } << sub_bits;
+			if (_Index < linear) {
+				return _Index;
+			}
+			const unsigned exponent = static_cast<unsigned>(_Index >> sub_bits) + sub_bits - 1;
+			return (linear | (_Index & (linear - 1))) << (exponent - sub_bits);
+		}
+	private:
+		//< Sample counts per bucket
+		std::array<std::atomic<std::uint64_t>, bucket_count> buckets{};
+
+		//< Sum of all recorded values
+		std::atomic<std::uint64_t> total{ 0 };
+	};
+
+	/*
+	 * @brief Always-on runtime metrics.
+	 *
+	 * Counters are relaxed atomics kept per shard, so the hot paths pay one
+	 * uncontended increment. Per-packet-ID traffic is counted as it passes
+	 * OnMessage() and Core_enet_send(); dispatch latency is timed for one
+	 * message in dispatch_sample_rate per thread; tick duration, peer
+	 * RTT/loss and user occupancy are recorded by the shard's own loop.
+	 * render() formats everything in the Prometheus text format and may be
+	 * called from any thread.
+	 */
+	class metrics {
+	public:
+		//< One message in this many is timed for the dispatch latency histogram
+		static constexpr std::uint32_t dispatch_sample_rate = 16;
+	public:
+		/*
+		 * Counts a received message (hot path).
+		 *
+		 * @param _Id   The message's packet ID byte.
+		 * @param _Size The message size in bytes.
+		 */
+		static void count_in(std::uint8_t _Id, std::size_t _Size) noexcept;
+
+		/*
+		 * Counts a packet handed to ENet for one peer (hot path).
+		 *
+		 * @param _Id   The packet's first byte (its packet ID).
+		 * @param _Size The packet size in bytes.
+		 */
+		static void count_out(std::uint8_t _Id, std::size_t _Size) noexcept;
+
+		/*
+		 * Counts a received message the rate limiter did not accept.
+		 *
+		 * @param _Verdict The limiter's verdict (drop, defer or kick).
+		 */
+		static void count_limited(admission _Verdict) noexcept;
+
+		/*
+		 * Counts an unreliable send shed because its peer was backlogged.
+		 */
+		static void count_shed() noexcept;
+
+		/*
+		 * Returns whether the calling thread should time the current dispatch.
+		 */
+		[[nodiscard]] static bool sample_dispatch() noexcept {
+			static thread_local std::uint32_t counter = 0;
+			return ++counter % dispatch_sample_rate == 0;
+		}
+
+		/*
+		 * Records the duration of one sampled message dispatch.
+		 */
+		static void record_dispatch(std::chrono::nanoseconds _Duration) noexcept;
+
+		/*
+		 * Records the duration of one server tick.
+		 */
+		static void record_tick(std::chrono::nanoseconds _Duration) noexcept;
+
+		/*
+		 * Publishes the shard's user slot occupancy.
+		 *
+		 * @param _Active   Users currently connected.
+		 * @param _Capacity Size of the user table.
+		 */
+		static void set_users(std::size_t _Active, std::size_t _Capacity) noexcept;
+
+		/*
+		 * Samples RTT, packet loss and in-flight data of the shard's peers.
+		 *
+		 * Runs on the shard's I/O thread, which owns the host, typically
+		 * about once per second.
+		 */
+		static void sample_peers();
+
+		/*
+		 * Formats every metric in the Prometheus text exposition format.
+		 *
+		 * @return The exposition text.
+		 */
+		[[nodiscard]] static std::string render();
+	};
+
+	/*
+	 * @brief Minimal HTTP endpoint serving metrics::render().
+	 *
+	 * A background thread accepts one TCP connection at a time on the
+	 * given port, answers whatever was requested with the current metrics
+	 * and closes the connection. It never touches an ENet host, so it
+	 * adds nothing to the shards' ticks beyond the counters themselves.
+	 */
+	class metrics_exporter {
+	public:
+		metrics_exporter() = default;
+
+		metrics_exporter(const metrics_exporter&) = delete;
+		metrics_exporter& operator=(const metrics_exporter&) = delete;
+
+		~metrics_exporter() {
+			stop();
+		}
+
+		/*
+		 * Starts serving metrics.
+		 *
+		 * @param _Host Address to bind to.
+		 * @param _Port TCP port to listen on.
+		 * @throws std::runtime_error If the socket cannot be bound.
+		 */
+		void start(std::string_view _Host, std::uint16_t _Port);
+
+		/*
+		 * Stops serving metrics and closes the socket.
+		 */
+		void stop();
+	private:
+		/*
+		 * Accept loop.
+		 */
+		void run();
+
+		//< Listening socket (an ENetSocket)
+		std::intptr_t socket = -1;
+
+		//< Accept thread
+		std::thread thread;
+
+		//< Cleared to ask the accept loop to finish
+		std::atomic<bool> running{ false };
+	};
+}
+
+#endif // ^^^ !_METRICS_H_
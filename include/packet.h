@@ -26,10 +26,15 @@
 #ifndef _PACKET_H_
 #define _PACKET_H_
 
+#include <array>
+#include <atomic>
 #include <concepts>
 #include <cstdint>
 #include <memory>
-#include <unordered_map>
+#include <memory_resource>
+#include <new>
+#include <optional>
+#include "arena.h"
 #include "stream.h"
 
 namespace cat {
@@ -75,33 +80,309 @@ namespace cat {
 		std::derived_from<_Pkt, packet>&&
 		std::is_default_constructible_v<_Pkt>;
 
+	/*
+	 * Concept for packets whose members allocate through a polymorphic
+	 * allocator (std::pmr::string, std::pmr::vector), taken by a
+	 * constructor from std::pmr::polymorphic_allocator<>.
+	 *
+	 * @tparam _Pkt Type to check.
+	 */
+	template<class _Pkt>
+	concept allocator_aware_packet =
+		packet_binder<_Pkt> &&
+		std::constructible_from<_Pkt, std::pmr::polymorphic_allocator<>>;
+
+	/*
+	 * Constructs a packet to decode a received message into.
+	 *
+	 * Allocator-aware packets get the calling thread's tick arena, so
+	 * their strings and containers never reach the heap; they must not
+	 * outlive the handler call.
+	 *
+	 * @tparam _Pkt The packet type.
+	 * @return The default-constructed packet.
+	 */
+	template<packet_binder _Pkt>
+	[[nodiscard]] _Pkt make_packet() {
+		if constexpr (allocator_aware_packet<_Pkt>) {
+			return _Pkt(std::pmr::polymorphic_allocator<>(tick_arena::resource()));
+		} else {
+			return _Pkt{};
+		}
+	}
+
+	/*
+	 * Destroys a packet created on a memory resource.
+	 */
+	struct packet_deleter {
+		std::pmr::memory_resource*	resource = nullptr;
+		std::size_t					size = 0;
+		std::size_t					align = 0;
+
+		void operator()(packet* _Packet) const noexcept {
+			void* storage = dynamic_cast<void*>(_Packet);
+			_Packet->~packet();
+			resource->deallocate(storage, size, align);
+		}
+	};
+
+	//< Owning pointer to a packet created on a memory resource
+	using packet_ptr = std::unique_ptr<packet, packet_deleter>;
+
+	/*
+	 * Delivery class of a packet type.
+	 *
+	 * Only reliable packets are retransmitted and block later packets of
+	 * their channel until acknowledged. Anything that is superseded by its
+	 * next update (movement, positions) should use one of the unreliable
+	 * classes on its own channel.
+	 */
+	enum class delivery : std::uint8_t {
+		reliable,		//< Retransmitted until acknowledged, delivered in order
+		sequenced,		//< Never retransmitted; stale packets are dropped on arrival
+		unsequenced		//< Never retransmitted, delivered in any order
+	};
+
+	/*
+	 * Channel, delivery class and compression threshold a packet type is
+	 * sent with, and the rate limiter tokens a received one costs.
+	 */
+	struct packet_qos {
+		std::uint8_t	channel = 0;
+		delivery		mode = delivery::reliable;
+		std::uint32_t	compress_above = 0;	//< Compress framed messages larger than this (0 = never)
+		std::uint16_t	cost = 1;			//< Tokens charged to the sender's bucket per message (see limiter.h)
+	};
+
+	//< Upper bound on the number of channels a protocol may use
+	inline constexpr std::size_t max_channels = 16;
+
+	//< Packet ID reserved for compressed frames (see compress.h)
+	inline constexpr std::uint8_t compressed_frame_id = 0xFF;
+
+	//< Packet ID reserved for batch frames (see batch.h)
+	inline constexpr std::uint8_t batch_frame_id = 0xFE;
+
+	//< Packet ID reserved for session frames (see Core_enet_connect_session())
+	inline constexpr std::uint8_t session_frame_id = 0xFD;
+
+	/*
+	 * Returns whether an ID is reserved for framing and cannot be registered.
+	 */
+	constexpr bool is_reserved_id(std::uint8_t _Id) noexcept {
+		return _Id == compressed_frame_id || _Id == batch_frame_id || _Id == session_frame_id;
+	}
+
+	/*
+	 * Compile-time registration entry binding a packet type to its ID.
+	 *
+	 * @tparam _Id      Unique identifier for the packet type.
+	 * @tparam _Pkt     Packet type to register (must satisfy packet_binder concept).
+	 * @tparam _Channel Channel the packet type is sent on.
+	 * @tparam _Mode    Delivery class of the packet type.
+	 * @tparam _CompressAbove Compress messages of this type larger than this many bytes (0 = never).
+	 * @tparam _Cost    Rate limiter tokens a received message of this type costs.
+	 */
+	template<std::uint8_t _Id, packet_binder _Pkt,
+		std::uint8_t _Channel = 0, delivery _Mode = delivery::reliable, std::uint32_t _CompressAbove = 0,
+		std::uint16_t _Cost = 1>
+	struct packet_entry {
+		static_assert(_Channel < max_channels, "packet_entry channel exceeds max_channels");
+		static_assert(!is_reserved_id(_Id), "packet_entry uses a reserved packet ID");
+
+		static constexpr std::uint8_t id = _Id;
+		static constexpr packet_qos qos{ _Channel, _Mode, _CompressAbove, _Cost };
+		using type = _Pkt;
+	};
+
+	/*
+	 * Compile-time packet registration list.
+	 *
+	 * Builds the complete 256-entry creator table as a constant expression,
+	 * so a protocol's ID assignments are checked (duplicates fail to compile)
+	 * and laid out before the program starts. Load it with
+	 * packet_registry::load<list>().
+	 *
+	 * @tparam _Entries A pack of packet_entry<Id, Type> registrations.
+	 */
+	template<class... _Entries>
+	struct packet_list {
+		//< Type alias for packet creator function pointer.
+		using creator_fn = std::unique_ptr<packet>(*)();
+
+		//< Type alias for the creator on a memory resource.
+		using emplace_fn = packet_ptr(*)(std::pmr::memory_resource*);
+
+		/*
+		 * Creates a default-constructed packet of the given type.
+		 */
+		template<packet_binder _Pkt>
+		static std::unique_ptr<packet> make() {
+			return std::make_unique<_Pkt>();
+		}
+
+		/*
+		 * Creates a default-constructed packet of the given type on a memory resource.
+		 *
+		 * Allocator-aware packets also allocate their members from it.
+		 */
+		template<packet_binder _Pkt>
+		static packet_ptr emplace(std::pmr::memory_resource* _Resource) {
+			void* storage = _Resource->allocate(sizeof(_Pkt), alignof(_Pkt));
+			try {
+				_Pkt* pkt;
+				if constexpr (allocator_aware_packet<_Pkt>) {
+					pkt = ::new (storage) _Pkt(std::pmr::polymorphic_allocator<>(_Resource));
+				} else {
+					pkt = ::new (storage) _Pkt();
+				}
+				return packet_ptr(pkt, { _Resource, sizeof(_Pkt), alignof(_Pkt) });
+			}
+			catch (...) {
+				_Resource->deallocate(storage, sizeof(_Pkt), alignof(_Pkt));
+				throw;
+			}
+		}
+
+		//< Flat creator table indexed by packet ID
+		static constexpr std::array<creator_fn, 256> table = [] {
+			std::array<creator_fn, 256> table{};
+			((table[_Entries::id] = &make<typename _Entries::type>), ...);
+			return table;
+		}();
+
+		//< Flat creator table on a memory resource, indexed by packet ID
+		static constexpr std::array<emplace_fn, 256> emplacers = [] {
+			std::array<emplace_fn, 256> table{};
+			((table[_Entries::id] = &emplace<typename _Entries::type>), ...);
+			return table;
+		}();
+
+		static_assert(((table[_Entries::id] == &make<typename _Entries::type>) && ...),
+			"packet_list contains duplicate packet IDs");
+	};
+
 	/*
 	 * Packet type registry for dynamic packet creation.
 	 *
 	 * Allows registration of packet types with unique IDs and
 	 * creation of packet instances based on those IDs.
+	 *
+	 * The registry is a flat 256-entry table indexed by the ID byte, so a
+	 * lookup is a single load with no hashing. Registration happens during
+	 * startup; freeze() then makes the table read-only, after which any
+	 * number of threads may look packets up without synchronization.
 	 */
 	class packet_registry {
+	public:
+		//< Type alias for packet creator function pointer.
+		using creator_fn = std::unique_ptr<packet>(*)();
+
+		//< Type alias for the creator on a memory resource.
+		using emplace_fn = packet_list<>::emplace_fn;
 	public:
 		/*
 		 * Registers a packet type with a unique identifier.
 		 *
 		 * @tparam _Pkt Packet type to register (must satisfy packet_binder concept).
 		 * @param _Id   Unique identifier for the packet type.
+		 * @param _Qos  Channel and delivery class the packet type is sent with.
 		 * @return true  If registration was successful
-		 * @return false If the ID is already registered
+		 * @return false If the ID is reserved or already registered, the channel
+		 *               is out of range or the registry is frozen
 		 */
 		template<packet_binder _Pkt>
-		static bool register_type(std::uint8_t _Id) {
-			auto& map = types();
-			if (map.find(_Id) != map.end()) {
+		static bool register_type(std::uint8_t _Id, packet_qos _Qos = {}) {
+			if (frozen() || is_reserved_id(_Id) || table[_Id] != nullptr || _Qos.channel >= max_channels) {
 				return false;
 			}
-			map[_Id] = []() -> std::unique_ptr<packet> {
-				return std::make_unique<_Pkt>(); };
+			table[_Id] = &packet_list<>::make<_Pkt>;
+			emplacers[_Id] = &packet_list<>::emplace<_Pkt>;
+			type_id<_Pkt> = _Id;
+			assign_qos(_Id, _Qos);
 			return true;
 		}
 
+		/*
+		 * Loads a compile-time registration list into the registry.
+		 *
+		 * Either every entry of the list is registered or, if the registry
+		 * is frozen or any ID is already taken, none is.
+		 *
+		 * @tparam _List A packet_list<...> instantiation.
+		 * @return true if the list was loaded, false otherwise.
+		 */
+		template<class _List>
+		static bool load() {
+			return load_impl(static_cast<_List*>(nullptr));
+		}
+
+		/*
+		 * Makes the registry read-only.
+		 *
+		 * Called once startup registration is complete. Subsequent
+		 * registrations fail, and lookups become safe from any thread.
+		 */
+		static void freeze() noexcept {
+			locked.store(true, std::memory_order_release);
+		}
+
+		/*
+		 * Returns whether the registry has been frozen.
+		 */
+		[[nodiscard]] static bool frozen() noexcept {
+			return locked.load(std::memory_order_acquire);
+		}
+
+		/*
+		 * Checks whether an ID is registered.
+		 *
+		 * Lets the receive path drop malformed or unknown traffic before
+		 * any allocation takes place.
+		 *
+		 * @param _Id Identifier to check.
+		 * @return true if a packet type is registered for the ID.
+		 */
+		[[nodiscard]] static bool contains(std::uint8_t _Id) noexcept {
+			return table[_Id] != nullptr;
+		}
+
+		/*
+		 * Returns the ID a packet type was registered with.
+		 *
+		 * @tparam _Pkt Packet type to look up.
+		 * @return The packet ID, or std::nullopt if the type is not registered.
+		 */
+		template<packet_binder _Pkt>
+		[[nodiscard]] static std::optional<std::uint8_t> id_of() noexcept {
+			if (type_id<_Pkt> < 0) {
+				return std::nullopt;
+			}
+			return static_cast<std::uint8_t>(type_id<_Pkt>);
+		}
+
+		/*
+		 * Returns the channel and delivery class registered for an ID.
+		 *
+		 * @param _Id Identifier to look up.
+		 * @return The registered QoS, or the reliable channel 0 default.
+		 */
+		[[nodiscard]] static packet_qos qos(std::uint8_t _Id) noexcept {
+			return qos_table[_Id];
+		}
+
+		/*
+		 * Returns the number of channels the registered packet types use.
+		 *
+		 * Hosts are created with this many channels, so it must be read
+		 * after startup registration is complete.
+		 *
+		 * @return One more than the highest registered channel, at least 1.
+		 */
+		[[nodiscard]] static std::size_t channel_count() noexcept {
+			return channels;
+		}
+
 		/*
 		 * Creates a packet instance based on the given ID.
 		 *
@@ -109,22 +390,63 @@ namespace cat {
 		 * @return A unique pointer to the created packet instance, or nullptr if ID not found.
 		 */
 		static std::unique_ptr<packet> create(std::uint8_t _Id) {
-			auto it = types().find(_Id);
-			return (it != types().end()) ? it->second() : nullptr;
+			const creator_fn fn = table[_Id];
+			return (fn != nullptr) ? fn() : nullptr;
 		}
-	private:
-		//< Type alias for packet creator function pointer.
-		using creator_fn = std::unique_ptr<packet>(*)();
 
 		/*
-		 * Returns the static map of registered packet types.
+		 * Creates a packet instance on a memory resource.
+		 *
+		 * With tick_arena::resource() the packet and, for allocator-aware
+		 * types, its members cost no heap allocation; it must then be
+		 * destroyed before the arena is reset.
 		 *
-		 * @return Reference to the map of packet type creators.
+		 * @param _Id       Unique identifier for the packet type.
+		 * @param _Resource Memory resource to allocate from.
+		 * @return The created packet, or nullptr if ID not found.
 		 */
-		static std::unordered_map<std::uint8_t, creator_fn>& types() {
-			static std::unordered_map<std::uint8_t, creator_fn> instance;
-			return instance;
+		static packet_ptr create(std::uint8_t _Id, std::pmr::memory_resource* _Resource) {
+			const emplace_fn fn = emplacers[_Id];
+			return (fn != nullptr) ? fn(_Resource) : nullptr;
+		}
+	private:
+		template<class... _Entries>
+		static bool load_impl(packet_list<_Entries...>*) {
+			if (frozen() || (contains(_Entries::id) || ...)) {
+				return false;
+			}
+			((table[_Entries::id] = packet_list<_Entries...>::table[_Entries::id]), ...);
+			((emplacers[_Entries::id] = packet_list<_Entries...>::emplacers[_Entries::id]), ...);
+			((type_id<typename _Entries::type> = _Entries::id), ...);
+			(assign_qos(_Entries::id, _Entries::qos), ...);
+			return true;
+		}
+
+		static void assign_qos(std::uint8_t _Id, packet_qos _Qos) noexcept {
+			qos_table[_Id] = _Qos;
+			if (_Qos.channel >= channels) {
+				channels = _Qos.channel + 1u;
+			}
 		}
+
+		//< Flat creator table indexed by packet ID (constant-initialized, no guard)
+		static inline constinit std::array<creator_fn, 256> table{};
+
+		//< Creators on a memory resource indexed by packet ID
+		static inline constinit std::array<emplace_fn, 256> emplacers{};
+
+		//< Channel and delivery class indexed by packet ID
+		static inline constinit std::array<packet_qos, 256> qos_table{};
+
+		//< Number of channels used by the registered packet types
+		static inline constinit std::size_t channels = 1;
+
+		//< Set once startup registration is complete
+		static inline constinit std::atomic<bool> locked{ false };
+
+		//< ID assigned to each registered packet type, or -1
+		template<class _Pkt>
+		static inline constinit int type_id = -1;
 	};
 }
 
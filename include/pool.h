@@ -0,0 +1,461 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+#pragma once
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <vector>
+#include "compress.h"
+#include "const.h"
+#include "packet.h"
+#include "ring.h"
+#include "shard.h"
+#include "stream.h"
+#include "trace.h"
+
+namespace cat {
+	/* Delivery flags for outgoing packets (values mirror ENet's packet flags) */
+	enum class pool_flags : std::uint32_t {
+		unreliable			= 0,
+		reliable			= 1 << 0,
+		unsequenced			= 1 << 1,
+		unreliable_fragment = 1 << 3,
+	};
+
+	/*
+	 * @brief Map a registered delivery class to ENet packet flags.
+	 *
+	 * Unreliable classes are also fragmented unreliably, so an oversized
+	 * state update is dropped as a whole instead of falling back to
+	 * reliable fragments that would stall its channel.
+	 *
+	 * @param _Mode The delivery class of the packet type.
+	 * @return The matching pool flags.
+	 */
+	constexpr pool_flags to_flags(delivery _Mode) noexcept {
+		switch (_Mode) {
+		case delivery::sequenced:
+			return pool_flags::unreliable_fragment;
+		case delivery::unsequenced:
+			return static_cast<pool_flags>(
+				static_cast<std::uint32_t>(pool_flags::unsequenced) |
+				static_cast<std::uint32_t>(pool_flags::unreliable_fragment));
+		default:
+			return pool_flags::reliable;
+		}
+	}
+
+	/* Outgoing packet record queued for the next Core_enet_send() */
+	struct pool_entry {
+		peer_t			peer;
+		void*			packet;		//< nullptr marks a control record: retire_marker or kick_marker in channel
+		std::uint8_t	channel;
+	};
+
+	/*
+	 * @brief Per-peer outbound packet queue.
+	 *
+	 * Handlers enqueue outgoing data while Core_enet_poll() is dispatching
+	 * events; nothing touches the socket at that point. The queued packets
+	 * are handed to ENet once per tick by Core_enet_send(), which then issues
+	 * a single enet_host_flush() so every send of the tick goes out in one burst.
+	 *
+	 * Each queued record owns one reference on its ENet packet, which is
+	 * released after the packet has been handed to the peer.
+	 */
+	class pool_manager {
+	public:
+		//< Channel of a control record retiring its peer (see retire())
+		static constexpr std::uint8_t retire_marker = 0;
+
+		//< Channel of a control record disconnecting its peer (see kick())
+		static constexpr std::uint8_t kick_marker = 1;
+	public:
+		/*
+		 * @brief Queue raw bytes for delivery to a peer.
+		 *
+		 * @param _Peer    The peer that should receive the data.
+		 * @param _Data    Pointer to the payload.
+		 * @param _Size    Size of the payload in bytes.
+		 * @param _Channel The ENet channel to send the payload on.
+		 * @param _Flags   Delivery flags for the payload.
+		 * @return true  If the payload was queued
+		 * @return false If the peer is invalid or the packet could not be allocated
+		 */
+		bool push(peer_t _Peer, const void* _Data, std::size_t _Size,
+			std::uint8_t _Channel = 0, pool_flags _Flags = pool_flags::reliable);
+
+		/*
+		 * @brief Queue the contents of an output stream for delivery to a peer.
+		 *
+		 * Referenced fragments of the stream are gathered straight into the
+		 * ENet packet, so each byte is copied exactly once.
+		 *
+		 * @param _Peer    The peer that should receive the data.
+		 * @param _Stream  The stream whose buffer is sent.
+		 * @param _Channel The ENet channel to send the payload on.
+		 * @param _Flags   Delivery flags for the payload.
+		 * @return true if the payload was queued, false otherwise.
+		 */
+		bool push(peer_t _Peer, const ostream& _Stream,
+			std::uint8_t _Channel = 0, pool_flags _Flags = pool_flags::reliable);
+
+		/*
+		 * @brief Serialize a typed packet and queue it with its registered QoS.
+		 *
+		 * The channel and delivery class come from the packet's registration,
+		 * so state updates go out unreliably on their own channel without
+		 * every call site repeating it.
+		 *
+		 * @tparam _Pkt    The packet type (must be registered in packet_registry).
+		 * @param _Peer    The peer that should receive the packet.
+		 * @param _Packet  The packet to send.
+		 * @return true if the packet was queued, false otherwise.
+		 */
+		template<packet_binder _Pkt>
+		bool send(peer_t _Peer, const _Pkt& _Packet) {
+			const auto id = packet_registry::id_of<_Pkt>();
+			if (!id) {
+				return false;
+			}
+
+			const packet_qos qos = packet_registry::qos(*id);
+			return send(_Peer, _Packet, qos.channel, to_flags(qos.mode));
+		}
+
+		/*
+		 * @brief Serialize a typed packet and queue it for delivery to a peer.
+		 *
+		 * The message is framed as the packet's registered ID byte followed
+		 * by its body, which is what dispatcher::dispatch() expects.
+		 *
+		 * @tparam _Pkt    The packet type (must be registered in packet_registry).
+		 * @param _Peer    The peer that should receive the packet.
+		 * @param _Packet  The packet to send.
+		 * @param _Channel The ENet channel to send the packet on, overriding its registration.
+		 * @param _Flags   Delivery flags for the packet, overriding its registration.
+		 * @return true if the packet was queued, false otherwise.
+		 */
+		template<packet_binder _Pkt>
+		bool send(peer_t _Peer, const _Pkt& _Packet, std::uint8_t _Channel, pool_flags _Flags) {
+			const auto id = packet_registry::id_of<_Pkt>();
+			if (!id) {
+				return false;
+			}
+
+			const ostream* framed = frame(*id, _Packet);
+			return framed != nullptr && push(_Peer, *framed, _Channel, _Flags);
+		}
+
+		/*
+		 * @brief Queue the same raw bytes for delivery to several peers.
+		 *
+		 * A single ENet packet is created and shared by every recipient
+		 * through its reference count, so the payload is copied once no
+		 * matter how many peers receive it. Core_enet_send() never packs a
+		 * shared packet into a batch frame, which would copy it per peer.
+		 *
+		 * @param _Peers   The peers that should receive the data (nullptr entries are skipped).
+		 * @param _Data    Pointer to the payload.
+		 * @param _Size    Size of the payload in bytes.
+		 * @param _Channel The ENet channel to send the payload on.
+		 * @param _Flags   Delivery flags for the payload.
+		 * @return The number of peers the payload was queued for.
+		 */
+		std::size_t multicast(std::span<const peer_t> _Peers, const void* _Data, std::size_t _Size,
+			std::uint8_t _Channel = 0, pool_flags _Flags = pool_flags::reliable);
+
+		/*
+		 * @brief Queue the contents of an output stream for delivery to several peers.
+		 *
+		 * @param _Peers   The peers that should receive the data (nullptr entries are skipped).
+		 * @param _Stream  The stream whose contents are sent.
+		 * @param _Channel The ENet channel to send the payload on.
+		 * @param _Flags   Delivery flags for the payload.
+		 * @return The number of peers the payload was queued for.
+		 */
+		std::size_t multicast(std::span<const peer_t> _Peers, const ostream& _Stream,
+			std::uint8_t _Channel = 0, pool_flags _Flags = pool_flags::reliable);
+
+		/*
+		 * @brief Serialize a typed packet once and queue it for several peers.
+		 *
+		 * The packet is sent with its registered QoS.
+		 *
+		 * @tparam _Pkt    The packet type (must be registered in packet_registry).
+		 * @param _Peers   The peers that should receive the packet.
+		 * @param _Packet  The packet to send.
+		 * @return The number of peers the packet was queued for.
+		 */
+		template<packet_binder _Pkt>
+		std::size_t multicast(std::span<const peer_t> _Peers, const _Pkt& _Packet) {
+			const auto id = packet_registry::id_of<_Pkt>();
+			if (!id) {
+				return 0;
+			}
+
+			const packet_qos qos = packet_registry::qos(*id);
+			const ostream* framed = frame(*id, _Packet);
+			return framed != nullptr ? multicast(_Peers, *framed, qos.channel, to_flags(qos.mode)) : 0;
+		}
+
+		/*
+		 * @brief Serialize a typed packet once and queue it for the peers a predicate selects.
+		 *
+		 * @tparam _Pkt    The packet type (must be registered in packet_registry).
+		 * @param _Peers   A range of candidate peers.
+		 * @param _Packet  The packet to send.
+		 * @param _Predicate Predicate called with each candidate peer; true selects it.
+		 * @param _Exclude A peer to skip regardless of the predicate, typically the sender.
+		 * @return The number of peers the packet was queued for.
+		 */
+		template<packet_binder _Pkt, std::ranges::input_range _Range, class _Pred>
+		std::size_t multicast_if(const _Range& _Peers, const _Pkt& _Packet, _Pred&& _Predicate, peer_t _Exclude = nullptr) {
+			static thread_local std::vector<peer_t> targets;
+			targets.clear();
+			for (const peer_t peer : _Peers) {
+				if (peer != nullptr && peer != _Exclude && _Predicate(peer)) {
+					targets.push_back(peer);
+				}
+			}
+			return multicast(std::span<const peer_t>(targets), _Packet);
+		}
+
+		/*
+		 * @brief Discard every packet still queued for a peer.
+		 *
+		 * Called when the peer disconnects so that its slot can be reused
+		 * without delivering stale data to the next connection.
+		 *
+		 * @param _Peer The peer whose queue should be dropped.
+		 */
+		void drop(peer_t _Peer) noexcept;
+
+		/*
+		 * @brief Discard a disconnected peer's queue once its handlers are done.
+		 *
+		 * Call it after the peer's disconnect handlers. Outside concurrent
+		 * mode this is drop(). In concurrent mode the calling worker may
+		 * still have replies to the peer in flight, so a marker follows
+		 * them through the inbox and the I/O thread drops the queue when
+		 * it reaches the marker: the replies never reach the next
+		 * connection of the slot, and sends queued after the marker are
+		 * kept for it. Like a send, the marker is lost if the inbox is full.
+		 *
+		 * @param _Peer The peer that disconnected.
+		 */
+		void retire(peer_t _Peer);
+
+		/*
+		 * @brief Disconnect a peer once the packets queued before are sent.
+		 *
+		 * Unlike Core_enet_server_kick(), this may be called wherever sends
+		 * to the peer are allowed, e.g. from a handler on a worker thread:
+		 * the request joins the peer's queue and Core_enet_send() starts
+		 * the disconnect on the I/O thread. Like a send, the request is
+		 * lost if the inbox is full.
+		 *
+		 * @param _Peer The peer to disconnect.
+		 */
+		void kick(peer_t _Peer);
+
+		/*
+		 * @brief Move all queued packets out of the per-peer queues.
+		 *
+		 * The returned records are grouped by peer, in the order each peer
+		 * first queued data during the tick, and keep their enqueue order
+		 * within a peer. The vector is owned by the manager and is reused on
+		 * the next call; the caller must consume it before pushing again.
+		 *
+		 * @return Reference to the drained packet records.
+		 */
+		[[nodiscard]] std::vector<pool_entry>& flush_packets();
+
+		/*
+		 * @brief Enable or disable pushes from multiple threads.
+		 *
+		 * In concurrent mode every push goes through a lock-free MPSC
+		 * inbox that flush_packets() drains on the I/O thread, so worker
+		 * threads can queue sends while the I/O thread owns the host.
+		 * drop() and flush_packets() remain I/O-thread only.
+		 *
+		 * @param _Concurrent Whether pushes may come from several threads.
+		 */
+		void set_concurrent(bool _Concurrent);
+
+		/*
+		 * @brief Start collecting the calling thread's pushes into one batch.
+		 *
+		 * In concurrent mode, every push from this thread after the call is
+		 * held back until commit_batch() publishes them together, so they
+		 * all leave in the same Core_enet_send(). Outside concurrent mode
+		 * pushes are already flushed together and this has no effect.
+		 */
+		void begin_batch();
+
+		/*
+		 * @brief Publish the pushes collected since begin_batch().
+		 *
+		 * The batch reaches the I/O thread all at once or not at all. A
+		 * batch that does not fit the inbox is dropped.
+		 *
+		 * @return The number of packet records published.
+		 */
+		std::size_t commit_batch();
+
+		/*
+		 * @brief Get the number of packets waiting for the next flush.
+		 *
+		 * @return The number of queued packets across all peers (excluding
+		 *         packets still in the concurrent inbox).
+		 */
+		[[nodiscard]] constexpr std::size_t pending() const noexcept {
+			return count;
+		}
+
+		/*
+		 * @brief Get the singleton instance of the pool manager.
+		 *
+		 * @return Reference to the calling shard's pool manager instance.
+		 */
+		static pool_manager& instance() {
+			return shard_local<pool_manager>();
+		}
+	private:
+		/*
+		 * @brief Frame a typed packet into the thread's scratch stream.
+		 *
+		 * The message is the packet's ID byte followed by its body. The
+		 * serialize call is resolved statically and the scratch stream is
+		 * reused between calls. Messages larger than the packet type's
+		 * compress_above threshold are replaced by a compressed frame when
+		 * that makes them smaller.
+		 *
+		 * @param _Id     The packet's registered ID.
+		 * @param _Packet The packet to serialize.
+		 * @return The framed stream, or nullptr if serialization failed.
+		 */
+		template<packet_binder _Pkt>
+		static const ostream* frame(std::uint8_t _Id, const _Pkt& _Packet) {
+			static thread_local ostream scratch;
+			scratch.flush();
+			scratch.write(_Id);
+			{
+				CAT_TRACE_ZONE("packet::serialize");
+				if (!_Packet._Pkt::serialize(scratch)) {
+					return nullptr;
+				}
+			}
+
+			const std::uint32_t threshold = packet_registry::qos(_Id).compress_above;
+			if (threshold != 0 && scratch.total_size() > threshold) {
+				static thread_local ostream packed;
+				if (compressor::pack(scratch, packed)) {
+					return &packed;
+				}
+			}
+			return &scratch;
+		}
+
+		/*
+		 * @brief Create an ENet packet holding an output stream's contents.
+		 *
+		 * @param _Stream The stream whose contents are copied.
+		 * @param _Flags  Delivery flags for the packet.
+		 * @return The new packet, or nullptr if it could not be allocated.
+		 */
+		static void* make_packet(const ostream& _Stream, pool_flags _Flags);
+
+		/*
+		 * @brief Append one shared ENet packet to several peers' queues.
+		 *
+		 * In concurrent mode the records are published to the inbox as one
+		 * batch, so the packet's reference count is never touched once
+		 * another thread can see it.
+		 *
+		 * @param _Peers   The peers that should receive the packet (nullptr entries are skipped).
+		 * @param _Packet  The packet to queue; the queues take one reference per peer.
+		 * @param _Channel The ENet channel to send the packet on.
+		 * @return The number of peers the packet was queued for.
+		 */
+		std::size_t enqueue_many(std::span<const peer_t> _Peers, void* _Packet, std::uint8_t _Channel);
+
+		/*
+		 * @brief Append an ENet packet to a peer's queue.
+		 *
+		 * @param _Peer    The peer that should receive the packet.
+		 * @param _Packet  The packet to queue; the queue takes a reference on it.
+		 * @param _Channel The ENet channel to send the packet on.
+		 * @return true if the packet was queued, false if the inbox is full.
+		 */
+		bool enqueue(peer_t _Peer, void* _Packet, std::uint8_t _Channel);
+
+		/*
+		 * @brief Append a record to its peer's queue (I/O thread only).
+		 *
+		 * @param _Entry The record to append; it already owns a packet reference.
+		 */
+		void append(const pool_entry& _Entry);
+
+		/*
+		 * @brief Take a record off the inbox (I/O thread only).
+		 *
+		 * @param _Entry The record to append, or a retire() marker to apply.
+		 */
+		void accept(const pool_entry& _Entry);
+
+		/*
+		 * @brief Queue a control record behind the calling thread's sends.
+		 *
+		 * @param _Marker The record, whose packet is nullptr.
+		 */
+		void post_marker(const pool_entry& _Marker);
+
+		//< Outgoing packets, one queue per ENet peer slot
+		std::vector<std::vector<pool_entry>> queues;
+
+		//< Peer slots that have queued data this tick, in first-push order
+		std::vector<std::uint16_t> dirty;
+
+		//< Flattened records returned by flush_packets()
+		std::vector<pool_entry> drained;
+
+		//< Number of packets currently queued
+		std::size_t count = 0;
+
+		//< Capacity of the concurrent inbox
+		static constexpr std::size_t inbox_capacity = 16384;
+
+		//< Cross-thread inbox, allocated in concurrent mode
+		std::unique_ptr<mpsc_ring<pool_entry, inbox_capacity>> inbox;
+	};
+}
+
+#endif // ^^^ !_POOL_H_
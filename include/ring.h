@@ -0,0 +1,242 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+#pragma once
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace cat {
+	//< Assumed cache line size, used to keep producer and consumer state apart
+	constexpr std::size_t cache_line = 64;
+
+	/*
+	 * @brief Bounded lock-free single-producer / single-consumer ring.
+	 *
+	 * Exactly one thread may push and exactly one thread may pop. Both
+	 * operations are wait-free and never allocate.
+	 *
+	 * @tparam _Ty  A trivially copyable element type.
+	 * @tparam _Cap Capacity; must be a power of two.
+	 */
+	template<class _Ty, std::size_t _Cap>
+	class spsc_ring {
+		static_assert(std::is_trivially_copyable_v<_Ty>, "ring elements must be trivially copyable");
+		static_assert(_Cap != 0 && (_Cap & (_Cap - 1)) == 0, "ring capacity must be a power of two");
+	public:
+		/*
+		 * Appends an element (producer thread only).
+		 *
+		 * @param _Value The element to append.
+		 * @return true if the element was stored, false if the ring is full.
+		 */
+		bool push(const _Ty& _Value) noexcept {
+			const std::size_t t = tail.load(std::memory_order_relaxed);
+			if (t - head.load(std::memory_order_acquire) == _Cap) {
+				return false;
+			}
+			items[t & (_Cap - 1)] = _Value;
+			tail.store(t + 1, std::memory_order_release);
+			return true;
+		}
+
+		/*
+		 * Removes the oldest element (consumer thread only).
+		 *
+		 * @param _Value Receives the element.
+		 * @return true if an element was removed, false if the ring is empty.
+		 */
+		bool pop(_Ty& _Value) noexcept {
+			const std::size_t h = head.load(std::memory_order_relaxed);
+			if (h == tail.load(std::memory_order_acquire)) {
+				return false;
+			}
+			_Value = items[h & (_Cap - 1)];
+			head.store(h + 1, std::memory_order_release);
+			return true;
+		}
+
+		/*
+		 * Returns whether the ring currently holds no elements.
+		 */
+		[[nodiscard]] bool empty() const noexcept {
+			return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+		}
+
+		/*
+		 * Returns the approximate number of queued elements.
+		 */
+		[[nodiscard]] std::size_t size() const noexcept {
+			return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+		}
+	private:
+		//< Consumer position
+		alignas(cache_line) std::atomic<std::size_t> head{ 0 };
+
+		//< Producer position
+		alignas(cache_line) std::atomic<std::size_t> tail{ 0 };
+
+		//< Element storage
+		alignas(cache_line) std::array<_Ty, _Cap> items{};
+	};
+
+	/*
+	 * @brief Bounded lock-free multi-producer / single-consumer ring.
+	 *
+	 * Any number of threads may push concurrently; one thread pops. Each
+	 * cell carries a sequence number (Vyukov's bounded queue), so producers
+	 * only contend on a single compare-and-swap and never block each other.
+	 *
+	 * @tparam _Ty  A trivially copyable element type.
+	 * @tparam _Cap Capacity; must be a power of two.
+	 */
+	template<class _Ty, std::size_t _Cap>
+	class mpsc_ring {
+		static_assert(std::is_trivially_copyable_v<_Ty>, "ring elements must be trivially copyable");
+		static_assert(_Cap != 0 && (_Cap & (_Cap - 1)) == 0, "ring capacity must be a power of two");
+	public:
+		mpsc_ring() noexcept {
+			for (std::size_t i = 0; i < _Cap; ++i) {
+				cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		/*
+		 * Appends an element (any thread).
+		 *
+		 * @param _Value The element to append.
+		 * @return true if the element was stored, false if the ring is full.
+		 */
+		bool push(const _Ty& _Value) noexcept {
+			std::size_t pos = tail.load(std::memory_order_relaxed);
+			for (;;) {
+				cell& c = cells[pos & (_Cap - 1)];
+				const std::size_t seq = c.sequence.load(std::memory_order_acquire);
+				const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+				if (diff == 0) {
+					if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						c.value = _Value;
+						c.sequence.store(pos + 1, std::memory_order_release);
+						return true;
+					}
+				} else if (diff < 0) {
+					return false;
+				} else {
+					pos = tail.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/*
+		 * Appends a batch of elements as a whole (any thread).
+		 *
+		 * Either every element is stored, in one contiguous run, or none is.
+		 * Cells are freed in order, so the run is free once its last cell is.
+		 *
+		 * @param _Count Number of elements to append.
+		 * @param _Fill  Callable returning the element for each index in [0, _Count).
+		 * @return true if all elements were stored, false if they do not fit.
+		 */
+		template<class _Fn>
+		bool push_bulk(std::size_t _Count, _Fn&& _Fill) noexcept {
+			if (_Count == 0) {
+				return true;
+			}
+			if (_Count > _Cap) {
+				return false;
+			}
+
+			std::size_t pos = tail.load(std::memory_order_relaxed);
+			for (;;) {
+				const std::size_t last = pos + _Count - 1;
+				const std::size_t seq = cells[last & (_Cap - 1)].sequence.load(std::memory_order_acquire);
+				const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(last);
+				if (diff == 0) {
+					if (tail.compare_exchange_weak(pos, pos + _Count, std::memory_order_relaxed)) {
+						break;
+					}
+				} else if (diff < 0) {
+					return false;
+				} else {
+					pos = tail.load(std::memory_order_relaxed);
+				}
+			}
+
+			for (std::size_t i = 0; i < _Count; ++i) {
+				cell& c = cells[(pos + i) & (_Cap - 1)];
+				c.value = _Fill(i);
+				c.sequence.store(pos + i + 1, std::memory_order_release);
+			}
+			return true;
+		}
+
+		/*
+		 * Removes the oldest element (consumer thread only).
+		 *
+		 * @param _Value Receives the element.
+		 * @return true if an element was removed, false if the ring is empty.
+		 */
+		bool pop(_Ty& _Value) noexcept {
+			const std::size_t pos = head.load(std::memory_order_relaxed);
+			cell& c = cells[pos & (_Cap - 1)];
+			if (c.sequence.load(std::memory_order_acquire) != pos + 1) {
+				return false;
+			}
+			_Value = c.value;
+			c.sequence.store(pos + _Cap, std::memory_order_release);
+			head.store(pos + 1, std::memory_order_relaxed);
+			return true;
+		}
+
+		/*
+		 * Returns whether the ring currently holds no committed elements.
+		 */
+		[[nodiscard]] bool empty() const noexcept {
+			const std::size_t pos = head.load(std::memory_order_relaxed);
+			return cells[pos & (_Cap - 1)].sequence.load(std::memory_order_acquire) != pos + 1;
+		}
+	private:
+		/* A ring cell tagged with its sequence number */
+		struct cell {
+			std::atomic<std::size_t> sequence;
+			_Ty value;
+		};
+
+		//< Consumer position
+		alignas(cache_line) std::atomic<std::size_t> head{ 0 };
+
+		//< Producer position
+		alignas(cache_line) std::atomic<std::size_t> tail{ 0 };
+
+		//< Element storage
+		alignas(cache_line) std::array<cell, _Cap> cells;
+	};
+}
+
+#endif // ^^^ !_RING_H_
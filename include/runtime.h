@@ -0,0 +1,156 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+#pragma once
+#ifndef _RUNTIME_H_
+#define _RUNTIME_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include "client.h"
+#include "core.h"
+#include "worker.h"
+
+namespace cat {
+	/*
+	 * @brief Self-managed networking runtime of the client DLL.
+	 *
+	 * A background pump thread owns the ENet host and drives the client's
+	 * connection. The host application never touches the network.
+	 * Received events are decoded on the pump and queued in a lock-free
+	 * ring. Once per frame, frame() delivers them on the application's
+	 * thread through the usual service and dispatcher handlers, then
+	 * publishes every send the frame made as one batch. The frame cost
+	 * therefore depends only on the number of queued events, never on
+	 * network latency.
+	 *
+	 * start() and stop() must not be called from DllMain. Thread creation
+	 * and joining under the loader lock can deadlock.
+	 */
+	class client_runtime {
+	public:
+		//< Longest time the pump waits for network events per loop, in milliseconds
+		static constexpr std::uint32_t pump_timeout = 1;
+	public:
+		client_runtime() = default;
+
+		client_runtime(const client_runtime&) = delete;
+		client_runtime& operator=(const client_runtime&) = delete;
+
+		~client_runtime();
+
+		/*
+		 * Starts connecting to a server and launches the pump thread.
+		 *
+		 * Called on the application thread that will call frame(). Does
+		 * nothing if the runtime is already running; a runtime whose pump
+		 * has died is stopped first and started anew. By default the
+		 * client finds the server's integrity mode by itself (see
+		 * Core_enet_set_integrity()).
+		 *
+		 * @param _Host   The server's host name or IP address.
+		 * @param _Port   The server's port.
+		 * @param _Checks The integrity check to use.
+		 * @throws std::runtime_error If the ENet host cannot be created or
+		 *         the address cannot be resolved.
+		 */
+		void start(std::string_view _Host, std::uint16_t _Port, core::integrity _Checks = core::integrity::automatic);
+
+		/*
+		 * Runs one frame on the application thread.
+		 *
+		 * Delivers up to `_Budget` queued events to the handlers, then
+		 * hands every packet sent since the previous frame to the pump as
+		 * a single batch.
+		 *
+		 * @param _Budget Maximum number of events to deliver.
+		 * @return The number of events delivered.
+		 */
+		std::size_t frame(std::size_t _Budget = std::numeric_limits<std::size_t>::max());
+
+		/*
+		 * Stops the pump thread and disconnects.
+		 *
+		 * Called on the application thread. While the pump winds down,
+		 * still-queued events are delivered from within this call.
+		 */
+		void stop();
+
+		/*
+		 * Returns whether the pump thread is running.
+		 *
+		 * False once the pump has ended on an error, such as a reconnect
+		 * that could not be issued, even before stop() cleans up.
+		 */
+		[[nodiscard]] bool running() const noexcept {
+			return endpoint != nullptr && !finished.load(std::memory_order_acquire);
+		}
+
+		/*
+		 * Returns the connection state of the runtime's client.
+		 */
+		[[nodiscard]] client_state state() const noexcept {
+			return running() ? endpoint->state() : client_state::disconnected;
+		}
+
+		/*
+		 * Returns the process-wide runtime instance.
+		 */
+		static client_runtime& instance() {
+			static client_runtime runtime;
+			return runtime;
+		}
+	private:
+		/*
+		 * Pump thread body.
+		 */
+		void pump();
+
+		//< The client endpoint, nullptr while stopped
+		std::unique_ptr<client> endpoint;
+
+		//< Event queue the pump fills and frame() drains
+		std::unique_ptr<worker_pool> events;
+
+		//< The pump thread
+		std::thread thread;
+
+		//< Shard of the thread that called start(), served by the pump
+		std::size_t shard = 0;
+
+		//< Set to ask the pump to finish
+		std::atomic<bool> stopping{ false };
+
+		//< Set by the pump once it no longer touches the host
+		std::atomic<bool> finished{ false };
+	};
+}
+
+#endif // ^^^ !_RUNTIME_H_
@@ -0,0 +1,173 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+#pragma once
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "timer.h"
+
+namespace cat {
+	/* Tick timing statistics collected by the scheduler */
+	struct tick_stats {
+		//< Number of ticks executed
+		std::uint64_t ticks = 0;
+
+		//< Ticks whose work took longer than the tick period
+		std::uint64_t overruns = 0;
+
+		//< Tick deadlines dropped after falling too far behind
+		std::uint64_t skipped = 0;
+
+		//< Network events dispatched
+		std::uint64_t events = 0;
+
+		//< Ticks that stopped draining events because the budget ran out
+		std::uint64_t budget_hits = 0;
+
+		//< Duration of the most recent tick's work
+		std::chrono::nanoseconds last{};
+
+		//< Longest tick observed
+		std::chrono::nanoseconds max{};
+
+		//< Sum of all tick durations
+		std::chrono::nanoseconds total{};
+	};
+
+	/*
+	 * @brief Fixed-timestep server loop.
+	 *
+	 * Each tick drains network events up to a bounded budget without
+	 * blocking, advances the timer wheel, runs the registered tick hooks
+	 * (game logic), flushes the send queue, and then sleeps until the next
+	 * tick deadline. Events past the budget are left for the next tick, so
+	 * a burst of traffic cannot starve sends or game logic.
+	 *
+	 * When a tick overruns, the next one starts immediately; if the loop
+	 * falls more than a few periods behind, the missed deadlines are dropped
+	 * instead of running a burst of catch-up ticks.
+	 */
+	class scheduler {
+	public:
+		using clock = std::chrono::steady_clock;
+		using tick_fn = void (*)(void*, std::uint64_t);
+
+		//< Maximum number of periods the loop may lag before deadlines are dropped
+		static constexpr std::uint32_t max_lag = 4;
+	public:
+		/*
+		 * Constructs a scheduler.
+		 *
+		 * @param _TickRate    Ticks per second (e.g. 64 or 128).
+		 * @param _EventBudget Maximum network events dispatched per tick.
+		 */
+		explicit scheduler(std::uint32_t _TickRate = 64, std::size_t _EventBudget = 1024) noexcept;
+
+		/*
+		 * Registers a hook called once per tick, after timers and before sends.
+		 *
+		 * @param _Fn      Function called with the context and the tick number.
+		 * @param _Context Opaque pointer passed back to the hook.
+		 */
+		void on_tick(tick_fn _Fn, void* _Context);
+
+		/*
+		 * Executes a single tick without sleeping.
+		 */
+		void tick();
+
+		/*
+		 * Runs ticks at the configured rate until cat::is_connect() turns false.
+		 */
+		void run();
+
+		/*
+		 * Converts a duration into a number of ticks, rounding up.
+		 *
+		 * @param _Duration The duration to convert.
+		 * @return The number of ticks covering the duration.
+		 */
+		[[nodiscard]] std::uint64_t ticks(std::chrono::nanoseconds _Duration) const noexcept {
+			return static_cast<std::uint64_t>((_Duration + interval - std::chrono::nanoseconds(1)) / interval);
+		}
+
+		/*
+		 * Returns the timer wheel driven by this scheduler.
+		 */
+		[[nodiscard]] constexpr timer_wheel& timers() noexcept {
+			return wheel;
+		}
+
+		/*
+		 * Returns the tick timing statistics.
+		 */
+		[[nodiscard]] constexpr const tick_stats& stats() const noexcept {
+			return counters;
+		}
+
+		/*
+		 * Returns the tick period.
+		 */
+		[[nodiscard]] constexpr std::chrono::nanoseconds period() const noexcept {
+			return interval;
+		}
+	private:
+		/* A registered tick hook */
+		struct hook {
+			tick_fn fn;
+			void* context;
+		};
+
+		/*
+		 * Sleeps until the deadline, finishing the last stretch with a
+		 * yield loop for precision.
+		 */
+		static void wait_until(clock::time_point _Deadline);
+
+		//< Tick period
+		std::chrono::nanoseconds interval;
+
+		//< Maximum network events dispatched per tick
+		std::size_t budget;
+
+		//< Ticks the timer wheel still has to catch up on (from dropped deadlines)
+		std::uint64_t lag = 0;
+
+		//< Timer wheel advanced once per tick
+		timer_wheel wheel;
+
+		//< Game-logic hooks
+		std::vector<hook> hooks;
+
+		//< Timing statistics
+		tick_stats counters;
+	};
+}
+
+#endif // ^^^ !_SCHEDULER_H_
@@ -0,0 +1,373 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+#pragma once
+#ifndef _SCHEMA_H_
+#define _SCHEMA_H_
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "packet.h"
+#include "stream.h"
+
+namespace cat {
+	/*
+	 * Declarative packet layouts.
+	 *
+	 * A packet lists its fields once, in wire order, and derives from
+	 * schema_packet instead of writing serialize() and deserialize() by
+	 * hand:
+	 *
+	 *   struct move_packet : schema_packet<move_packet> {
+	 *       std::uint32_t user = 0;
+	 *       float position[3]{};
+	 *       std::string name;
+	 *
+	 *       using fields = schema<
+	 *           raw<&move_packet::user>,
+	 *           raw<&move_packet::position>,
+	 *           text<&move_packet::name, 32>>;
+	 *   };
+	 *
+	 * The encoding is the one the equivalent hand-written stream calls
+	 * produce (write/read, write_varint/read_varint, write_zigzag/
+	 * read_zigzag, write_str/read_str), so a packet can switch to a
+	 * schema without changing the protocol.
+	 *
+	 * Every field has a compile-time size bound, and their sum is
+	 * schema::max_serialized_size. Serializing reserves that bound once and
+	 * writes through an unchecked cursor. Consecutive raw fields form a run
+	 * that is read with one bounds check, and copied with a single memcpy
+	 * when the members are laid out back to back in the packet.
+	 */
+
+	namespace detail {
+		template<class _Member>
+		struct member_traits;
+
+		template<class _Owner, class _Ty>
+		struct member_traits<_Ty _Owner::*> {
+			using owner_type = _Owner;
+			using value_type = _Ty;
+		};
+
+		/*
+		 * Returns the largest number of bytes a LEB128 varint of `_Bits` bits takes.
+		 */
+		constexpr std::size_t varint_bound(std::size_t _Bits) noexcept {
+			return (_Bits + 6) / 7;
+		}
+	}
+
+	/*
+	 * A trivially copyable member stored as its raw bytes.
+	 *
+	 * @tparam _Member Pointer to the member.
+	 */
+	template<auto _Member>
+	struct raw {
+		using value_type = typename detail::member_traits<decltype(_Member)>::value_type;
+		static_assert(std::is_trivially_copyable_v<value_type>, "raw fields must be trivially copyable");
+
+		//< Raw fields are merged into runs
+		static constexpr bool fixed = true;
+
+		//< Exact encoded size
+		static constexpr std::size_t max_size = sizeof(value_type);
+
+		template<class _Pkt>
+		static const std::byte* address(const _Pkt& _Packet) noexcept {
+			return reinterpret_cast<const std::byte*>(&(_Packet.*_Member));
+		}
+
+		template<class _Pkt>
+		static std::byte* address(_Pkt& _Packet) noexcept {
+			return reinterpret_cast<std::byte*>(&(_Packet.*_Member));
+		}
+	};
+
+	/*
+	 * An unsigned integral member stored as a LEB128 varint.
+	 *
+	 * @tparam _Member Pointer to the member.
+	 */
+	template<auto _Member>
+	struct varint {
+		using value_type = typename detail::member_traits<decltype(_Member)>::value_type;
+		static_assert(std::unsigned_integral<value_type>, "varint fields must be unsigned integers");
+
+		static constexpr bool fixed = false;
+		static constexpr std::size_t max_size = detail::varint_bound(sizeof(value_type) * 8);
+
+		template<class _Pkt>
+		static bool valid(const _Pkt&) noexcept {
+			return true;
+		}
+
+		template<class _Pkt>
+		static void write(ostream::cursor& _Cursor, const _Pkt& _Packet) noexcept {
+			_Cursor.write_varint(_Packet.*_Member);
+		}
+
+		template<class _Pkt>
+		static bool read(istream& _Stream, _Pkt& _Packet) noexcept {
+			return _Stream.read_varint(_Packet.*_Member);
+		}
+	};
+
+	/*
+	 * A signed integral member stored as a zig-zag varint.
+	 *
+	 * @tparam _Member Pointer to the member.
+	 */
+	template<auto _Member>
+	struct zigzag {
+		using value_type = typename detail::member_traits<decltype(_Member)>::value_type;
+		static_assert(std::signed_integral<value_type>, "zigzag fields must be signed integers");
+
+		static constexpr bool fixed = false;
+		static constexpr std::size_t max_size = detail::varint_bound(sizeof(value_type) * 8);
+
+		template<class _Pkt>
+		static bool valid(const _Pkt&) noexcept {
+			return true;
+		}
+
+		template<class _Pkt>
+		static void write(ostream::cursor& _Cursor, const _Pkt& _Packet) noexcept {
+			_Cursor.write_zigzag(_Packet.*_Member);
+		}
+
+		template<class _Pkt>
+		static bool read(istream& _Stream, _Pkt& _Packet) noexcept {
+			return _Stream.read_zigzag(_Packet.*_Member);
+		}
+	};
+
+	/*
+	 * A std::string, std::pmr::string or std::string_view member stored length-prefixed.
+	 *
+	 * A std::string_view member is read as a view into the received
+	 * packet, so it is only valid while the handler runs.
+	 *
+	 * @tparam _Member    Pointer to the member.
+	 * @tparam _MaxLength Longest accepted string; longer ones fail to
+	 *                    serialize and to deserialize.
+	 */
+	template<auto _Member, std::size_t _MaxLength>
+	struct text {
+		using value_type = typename detail::member_traits<decltype(_Member)>::value_type;
+		static_assert(std::is_same_v<value_type, std::string> || std::is_same_v<value_type, std::pmr::string> ||
+			std::is_same_v<value_type, std::string_view>,
+			"text fields must be std::string, std::pmr::string or std::string_view");
+
+		static constexpr bool fixed = false;
+		static constexpr std::size_t max_size =
+			std::max(sizeof(std::size_t), detail::varint_bound(std::bit_width(_MaxLength))) + _MaxLength;
+
+		template<class _Pkt>
+		static bool valid(const _Pkt& _Packet) noexcept {
+			return (_Packet.*_Member).size() <= _MaxLength;
+		}
+
+		template<class _Pkt>
+		static void write(ostream::cursor& _Cursor, const _Pkt& _Packet) noexcept {
+			_Cursor.write_str(_Packet.*_Member);
+		}
+
+		template<class _Pkt>
+		static bool read(istream& _Stream, _Pkt& _Packet) {
+			return _Stream.read_str(_Packet.*_Member) && (_Packet.*_Member).size() <= _MaxLength;
+		}
+	};
+
+	/*
+	 * @brief An ordered list of field descriptors and their generated codec.
+	 *
+	 * @tparam _Fields raw, varint, zigzag and text descriptors in wire order.
+	 */
+	template<class... _Fields>
+	class schema {
+		using fields = std::tuple<_Fields...>;
+
+		template<std::size_t _Index>
+		using field_at = std::tuple_element_t<_Index, fields>;
+
+		static constexpr std::size_t count = sizeof...(_Fields);
+	public:
+		//< Upper bound on the encoded size of any packet of this layout
+		static constexpr std::size_t max_serialized_size = (std::size_t{ 0 } + ... + _Fields::max_size);
+
+		/*
+		 * Serializes a packet.
+		 *
+		 * @param _Packet The packet.
+		 * @param _Stream The stream to append to.
+		 * @return false if a text field is longer than its bound; nothing is written then.
+		 */
+		template<class _Pkt>
+		static bool write(const _Pkt& _Packet, ostream& _Stream) {
+			if (!valid(_Packet, std::make_index_sequence<count>{})) {
+				return false;
+			}
+			auto cursor = _Stream.reserve_write(max_serialized_size);
+			write_from<0>(_Packet, cursor);
+			return true;
+		}
+
+		/*
+		 * Deserializes a packet.
+		 *
+		 * @param _Packet The packet to fill.
+		 * @param _Stream The stream to read from.
+		 * @return false if the data is truncated or a field is malformed.
+		 */
+		template<class _Pkt>
+		static bool read(_Pkt& _Packet, istream& _Stream) {
+			return read_from<0>(_Packet, _Stream);
+		}
+	private:
+		/*
+		 * Returns one past the last field of the raw run starting at `_Index`.
+		 */
+		static constexpr std::size_t run_end(std::size_t _Index) noexcept {
+			constexpr bool fixed[] = { _Fields::fixed..., false };
+			while (_Index < count && fixed[_Index]) {
+				++_Index;
+			}
+			return _Index;
+		}
+
+		/*
+		 * Returns the encoded size of the fields in [_First, _Last).
+		 */
+		static constexpr std::size_t run_size(std::size_t _First, std::size_t _Last) noexcept {
+			constexpr std::size_t sizes[] = { _Fields::max_size..., 0 };
+			std::size_t size = 0;
+			for (std::size_t i = _First; i < _Last; ++i) {
+				size += sizes[i];
+			}
+			return size;
+		}
+
+		template<class _Pkt, std::size_t... _Index>
+		static bool valid(const _Pkt& _Packet, std::index_sequence<_Index...>) noexcept {
+			return ([&] {
+				if constexpr (field_at<_Index>::fixed) {
+					return true;
+				} else {
+					return field_at<_Index>::valid(_Packet);
+				}
+			}() && ...);
+		}
+
+		/*
+		 * Returns whether the members of a raw run are stored back to back.
+		 *
+		 * The addresses are fixed by the layout, so this folds to a constant.
+		 */
+		template<std::size_t _First, std::size_t _Last, class _Pkt>
+		static bool contiguous(const _Pkt& _Packet) noexcept {
+			return [&]<std::size_t... _Index>(std::index_sequence<_Index...>) {
+				return ((field_at<_First + _Index>::address(_Packet) + field_at<_First + _Index>::max_size
+					== field_at<_First + _Index + 1>::address(_Packet)) && ...);
+			}(std::make_index_sequence<_Last - _First - 1>{});
+		}
+
+		template<std::size_t _Index, class _Pkt>
+		static void write_from(const _Pkt& _Packet, ostream::cursor& _Cursor) noexcept {
+			if constexpr (_Index < count) {
+				if constexpr (field_at<_Index>::fixed) {
+					constexpr std::size_t last = run_end(_Index);
+					if (contiguous<_Index, last>(_Packet)) {
+						_Cursor.write_bytes(field_at<_Index>::address(_Packet), run_size(_Index, last));
+					} else {
+						[&]<std::size_t... _Run>(std::index_sequence<_Run...>) {
+							(_Cursor.write_bytes(field_at<_Index + _Run>::address(_Packet), field_at<_Index + _Run>::max_size), ...);
+						}(std::make_index_sequence<last - _Index>{});
+					}
+					write_from<last>(_Packet, _Cursor);
+				} else {
+					field_at<_Index>::write(_Cursor, _Packet);
+					write_from<_Index + 1>(_Packet, _Cursor);
+				}
+			}
+		}
+
+		template<std::size_t _Index, class _Pkt>
+		static bool read_from(_Pkt& _Packet, istream& _Stream) {
+			if constexpr (_Index == count) {
+				return true;
+			} else if constexpr (field_at<_Index>::fixed) {
+				constexpr std::size_t last = run_end(_Index);
+				const std::byte* data = _Stream.consume(run_size(_Index, last));
+				if (data == nullptr) {
+					return false;
+				}
+				if (contiguous<_Index, last>(_Packet)) {
+					std::memcpy(field_at<_Index>::address(_Packet), data, run_size(_Index, last));
+				} else {
+					[&]<std::size_t... _Run>(std::index_sequence<_Run...>) {
+						((std::memcpy(field_at<_Index + _Run>::address(_Packet), data, field_at<_Index + _Run>::max_size),
+							data += field_at<_Index + _Run>::max_size), ...);
+					}(std::make_index_sequence<last - _Index>{});
+				}
+				return read_from<last>(_Packet, _Stream);
+			} else {
+				return field_at<_Index>::read(_Stream, _Packet) && read_from<_Index + 1>(_Packet, _Stream);
+			}
+		}
+	};
+
+	/*
+	 * @brief Packet base implementing serialize() and deserialize() from a schema.
+	 *
+	 * The derived packet declares its layout as a nested `fields` alias of
+	 * a schema specialization.
+	 *
+	 * @tparam _Derived The packet type (CRTP).
+	 */
+	template<class _Derived>
+	struct schema_packet : packet {
+		bool serialize(ostream& _Stream) const override {
+			return _Derived::fields::write(static_cast<const _Derived&>(*this), _Stream);
+		}
+
+		bool deserialize(istream& _Stream) override {
+			return _Derived::fields::read(static_cast<_Derived&>(*this), _Stream);
+		}
+	};
+}
+
+#endif // ^^^ !_SCHEMA_H_
@@ -26,6 +26,7 @@
 #ifndef _SERVER_H_
 #define _SERVER_H_
 
+#include "const.h"
 #include "net.h"
 
 namespace cat {
@@ -49,9 +50,11 @@ namespace cat {
 		 *               the lifetime of this object.
 		 *
 		 * @param _Port  The port number on which the server is expected to bind.
+		 *
+		 * @param _Capacity The maximum number of clients the server accepts.
 		 */
-		constexpr server(std::string_view _Host, uint16_t _Port) noexcept 
-			: net(_Host, _Port) {
+		constexpr server(std::string_view _Host, uint16_t _Port, std::uint32_t _Capacity = MAX_USERS) noexcept 
+			: net(_Host, _Port), capacity(_Capacity) {
 		}
 
 		/*
@@ -78,6 +81,9 @@ namespace cat {
 		 * for events, then returns control to the caller.
 		 */
 		void flush() const override;
+	public:
+		//< Maximum number of clients the host accepts
+		const std::uint32_t capacity;
 	};
 }
 
@@ -26,9 +26,22 @@
 #ifndef _SERVICE_H_
 #define _SERVICE_H_
 
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
 #include <cstdint>
-#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include "const.h"
+#include "shard.h"
+#include "trace.h"
 
 namespace cat {
 	/* Network event structure */
@@ -36,6 +49,7 @@ namespace cat {
 		peer_t		peer;
 		pdata_t		data;
 		std::size_t size;
+		phandle_t	handle;
 	};
 
 	/* Service types for network events */
@@ -45,69 +59,294 @@ namespace cat {
 		enet_message	= 3,
 	};
 
+	//< Number of slots needed to index the service table by enet_service
+	constexpr std::size_t enet_service_count = 4;
+
+	/*
+	 * @brief Small-buffer callable for service handlers.
+	 *
+	 * Holds either a plain function pointer with a context pointer, or a
+	 * small trivially copyable callable (e.g. a lambda capturing a couple
+	 * of pointers) stored inline. A delegate never allocates; callables
+	 * that do not fit the inline buffer are rejected at compile time.
+	 */
+	class delegate {
+	public:
+		using param_t = enet_event&;
+
+		//< Size of the inline storage in bytes
+		static constexpr std::size_t capacity = 2 * sizeof(void*);
+	public:
+		constexpr delegate() noexcept = default;
+
+		/*
+		 * Wraps a function pointer taking an opaque context.
+		 *
+		 * @param _Fn      Function to call.
+		 * @param _Context Pointer passed back as the function's first argument.
+		 */
+		delegate(void (*_Fn)(void*, param_t), void* _Context) noexcept
+			: delegate([_Fn, _Context](param_t _Event) { _Fn(_Context, _Event); }) {
+		}
+
+		/*
+		 * Wraps a small trivially copyable callable.
+		 *
+		 * @param _Fn A callable invocable with an enet_event&.
+		 */
+		template<class _Fn>
+			requires (!std::same_as<std::remove_cvref_t<_Fn>, delegate>)
+				&& std::invocable<std::remove_cvref_t<_Fn>&, param_t>
+		delegate(_Fn&& _Callable) noexcept {
+			using callable_t = std::remove_cvref_t<_Fn>;
+			static_assert(sizeof(callable_t) <= capacity, "handler does not fit the delegate's inline storage");
+			static_assert(alignof(callable_t) <= alignof(void*), "handler is over-aligned for the delegate's inline storage");
+			static_assert(std::is_trivially_copyable_v<callable_t>, "handler must be trivially copyable");
+			::new (static_cast<void*>(storage)) callable_t(std::forward<_Fn>(_Callable));
+			invoker = [](const void* _Storage, param_t _Event) {
+				(*std::launder(static_cast<callable_t*>(const_cast<void*>(_Storage))))(_Event); };
+		}
+
+		/*
+		 * Invokes the wrapped callable.
+		 *
+		 * @param _Event The event to forward.
+		 */
+		void operator()(param_t _Event) const {
+			invoker(storage, _Event);
+		}
+
+		/*
+		 * Returns whether the delegate holds a callable.
+		 */
+		[[nodiscard]] explicit operator bool() const noexcept {
+			return invoker != nullptr;
+		}
+	private:
+		//< Inline storage for the callable
+		alignas(void*) unsigned char storage[capacity]{};
+
+		//< Type-restoring trampoline, nullptr when empty
+		void (*invoker)(const void*, param_t) = nullptr;
+	};
+
+	/* Handle identifying a subscription, used to unsubscribe */
+	struct subscription {
+		enet_service	type;
+		std::uint16_t	serial;
+	};
+
 	/*
 	 * @brief Lightweight event dispatch service.
 	 *
 	 * Provides a centralized registry for handling ENet-related events
-	 * based on service_type. Each service type can register a single
-	 * callback, which will be invoked when the corresponding event occurs.
+	 * based on service_type. Each service type holds a small fixed list of
+	 * subscribers, all of which are invoked when the corresponding event
+	 * occurs, in ascending priority order (ties keep registration order).
+	 *
+	 * Handlers live in a flat array indexed by the service type and are
+	 * stored as allocation-free delegates, so dispatch is a handful of
+	 * indirect calls.
 	 *
 	 * This class follows the singleton pattern and is intended to be used
 	 * as a global event router within the networking subsystem.
+	 *
+	 * call() may run concurrently from several worker threads, and
+	 * handlers may be added or removed at any time, also from within a
+	 * handler. Each service type's handler list is copy-on-write: a
+	 * dispatch runs the list as it was when the dispatch began, and
+	 * changes take effect from the next dispatch on.
 	 */
 	class service {
 	public:
 		using param_t = enet_event&;
-		using callback_t = std::function<void(param_t)>;
-		using handlers_t = std::unordered_map<enet_service, callback_t>;
+		using callback_t = delegate;
+
+		//< Maximum number of subscribers per service type
+		static constexpr std::size_t max_subscribers = 8;
 	public:
 		/*
-		 * @brief Register or replace an event handler for a service type.
+		 * @brief Add an event handler for a service type.
 		 *
-		 * If a handler is already registered for the given type, it will
-		 * be replaced by the new callback.
+		 * Handlers registered for the same type are all invoked; a new
+		 * handler does not replace an existing one.
 		 *
-		 * @param type The service type to associate with the handler.
-		 * @param cb   The callback to invoke when the event is dispatched.
+		 * @param type     The service type to associate with the handler.
+		 * @param cb       The callback to invoke when the event is dispatched.
+		 * @param priority Handlers with a lower priority run first.
 		 * @return Reference to this service instance (for chaining).
+		 * @throws std::runtime_error If the type already has max_subscribers handlers.
 		 */
-		service& on(enet_service type, callback_t cb) {
-			handlers[type] = std::move(cb);
+		service& on(enet_service type, callback_t cb, int priority = 0) {
+			if (!subscribe(type, cb, priority)) {
+				throw std::runtime_error("Too many handlers registered for a single service type.");
+			}
 			return *this;
 		}
 
 		/*
-		 * @brief Dispatch an event to the registered handler.
+		 * @brief Add an event handler and return a handle for removing it.
 		 *
-		 * Looks up the handler associated with the given service type
-		 * and invokes it if found. If no handler is registered, the
-		 * call is silently ignored.
+		 * @param type     The service type to associate with the handler.
+		 * @param cb       The callback to invoke when the event is dispatched.
+		 * @param priority Handlers with a lower priority run first.
+		 * @return The subscription handle, or std::nullopt if the type is full.
+		 */
+		std::optional<subscription> subscribe(enet_service type, callback_t cb, int priority = 0) noexcept {
+			slot& s = slots[static_cast<std::size_t>(type)];
+			std::lock_guard guard(lock);
+			const table* old = s.current.load(std::memory_order_relaxed);
+			if ((old != nullptr && old->count == max_subscribers) || !cb) {
+				return std::nullopt;
+			}
+
+			auto next = std::unique_ptr<table>(old != nullptr ? new (std::nothrow) table(*old) : new (std::nothrow) table());
+			if (next == nullptr) {
+				return std::nullopt;
+			}
+			//
+			// Insert after every handler with a lower or equal priority
+			//
+			std::size_t at = next->count;
+			while (at > 0 && next->entries[at - 1].priority > priority) {
+				next->entries[at] = next->entries[at - 1];
+				--at;
+			}
+			const std::uint16_t serial = ++serials;
+			next->entries[at] = { cb, priority, serial };
+			++next->count;
+			try {
+				publish(s, std::move(next));
+			} catch (const std::bad_alloc&) {
+				return std::nullopt;
+			}
+			return subscription{ type, serial };
+		}
+
+		/*
+		 * @brief Remove a handler added with subscribe().
+		 *
+		 * Safe to call from within a handler. Dispatches already under way,
+		 * including the calling one, may still run the handler, so whatever
+		 * it refers to must outlive them; later dispatches skip it.
+		 *
+		 * @param sub The subscription handle to remove.
+		 * @throws std::bad_alloc If the new handler list cannot be allocated.
+		 */
+		void off(subscription sub) {
+			slot& s = slots[static_cast<std::size_t>(sub.type)];
+			std::lock_guard guard(lock);
+			const table* old = s.current.load(std::memory_order_relaxed);
+			if (old == nullptr) {
+				return;
+			}
+
+			auto next = std::make_unique<table>();
+			for (std::size_t i = 0; i < old->count; ++i) {
+				if (old->entries[i].serial != sub.serial) {
+					next->entries[next->count++] = old->entries[i];
+				}
+			}
+			if (next->count != old->count) {
+				publish(s, std::move(next));
+			}
+		}
+
+		/*
+		 * @brief Dispatch an event to every registered handler.
+		 *
+		 * Invokes the handlers of the given service type in priority order.
+		 * If no handler is registered, the call is silently ignored.
 		 *
 		 * @param type  The service type of the event.
-		 * @param event The ENet event to forward to the handler.
+		 * @param event The ENet event to forward to the handlers.
 		 */
 		void call(enet_service type, param_t event) {
-			auto it = handlers.find(type);
-			if (it != handlers.end()) {
-				it->second(event);
+			CAT_TRACE_ZONE("service::call");
+			slot& s = slots[static_cast<std::size_t>(type)];
+			//
+			// Announce the dispatch before taking the list; see publish()
+			//
+			s.depth.fetch_add(1, std::memory_order_seq_cst);
+			if (const table* t = s.current.load(std::memory_order_seq_cst)) {
+				for (std::size_t i = 0; i < t->count; ++i) {
+					t->entries[i].cb(event);
+				}
 			}
+			s.depth.fetch_sub(1, std::memory_order_release);
 		}
 
 		/*
 		 * @brief Get the singleton instance of the service.
 		 *
-		 * The instance is lazily initialized on first use and is
-		 * guaranteed to be thread-safe since C++11.
+		 * Every shard has its own instance, so each host routes its
+		 * events to its own handlers.
 		 *
-		 * @return Reference to the global service instance.
+		 * @return Reference to the calling shard's service instance.
 		 */
 		static service& instance() {
-			static service instance;
-			return instance;
+			return shard_local<service>();
 		}
 	private:
-		//< The map of event handlers
-		std::unordered_map<enet_service, callback_t> handlers;
+		/* A registered handler */
+		struct entry {
+			callback_t		cb;
+			int				priority = 0;
+			std::uint16_t	serial = 0;
+		};
+
+		/* An immutable handler list, in dispatch order */
+		struct table {
+			std::array<entry, max_subscribers> entries{};
+			std::size_t count = 0;
+		};
+
+		/* Handlers of a single service type */
+		struct slot {
+			//< The list dispatches take, owned by live; nullptr until the first handler
+			std::atomic<const table*> current{ nullptr };
+
+			//< Number of dispatches under way
+			std::atomic<std::uint32_t> depth{ 0 };
+
+			//< Owner of the current list
+			std::unique_ptr<table> live;
+
+			//< Replaced lists that a dispatch under way may still run
+			std::vector<std::unique_ptr<table>> retired;
+		};
+
+		/*
+		 * Makes a new handler list current (under lock).
+		 *
+		 * A dispatch raises depth before it loads the list; both sides use
+		 * sequentially consistent operations, so a dispatch this store does
+		 * not reach shows in depth. Replaced lists are therefore freed only
+		 * once no dispatch is under way, at this or a later change.
+		 *
+		 * @param s    The service type's handlers.
+		 * @param next The new list.
+		 */
+		static void publish(slot& s, std::unique_ptr<table> next) {
+			s.retired.reserve(s.retired.size() + 1);
+			s.current.store(next.get(), std::memory_order_seq_cst);
+			if (s.live != nullptr) {
+				s.retired.push_back(std::move(s.live));
+			}
+			s.live = std::move(next);
+			if (s.depth.load(std::memory_order_seq_cst) == 0) {
+				s.retired.clear();
+			}
+		}
+
+		//< Handler table indexed by enet_service
+		std::array<slot, enet_service_count> slots{};
+
+		//< Serializes changes to the handler lists
+		std::mutex lock;
+
+		//< Last subscription serial handed out
+		std::uint16_t serials = 0;
 	};
 }
 
@@ -0,0 +1,121 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+
+#pragma once
+#ifndef _SESSION_STORE_H_
+#define _SESSION_STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include "core.h"
+
+namespace cat {
+	/* Persistent record of one user slot */
+	struct session_record {
+		core::session_token session;	//< Token granted to the last session that held the slot, all zero if none
+		std::uint16_t generation;		//< Number of times the slot has been released
+		std::uint16_t reserved;			//< Zero
+	};
+
+	/*
+	 * @brief Memory-mapped snapshot of the user table for fast restarts.
+	 *
+	 * The file holds a header, one session_record per user slot and
+	 * state_size bytes of per-user session state per slot:
+	 *
+	 *   "CSOVSES\0", u32 version, u32 capacity, u32 state_size, u32 0,
+	 *   records, state
+	 *
+	 * The user table writes its record on every acquire and release, and
+	 * handlers keep whatever they need to resume a user in its state
+	 * block (see session_state()), so the file is always current; sync()
+	 * only asks the OS to write the dirty pages back. A restarted server
+	 * maps the same file, and as the mapping is the storage nothing is
+	 * read or decoded: reconnecting clients that present the session
+	 * token the server granted them get their slot back with its state
+	 * intact. As the tokens are the resume secrets, the file is created
+	 * readable by its owner only.
+	 *
+	 * Records and state are plain bytes; state must only hold trivially
+	 * copyable data without pointers. All functions act on the calling
+	 * shard.
+	 */
+	class session_store {
+	public:
+		//< Snapshot format version
+		static constexpr std::uint32_t version = 2;
+
+		//< Bytes of session state kept per user slot
+		static constexpr std::size_t state_size = 256;
+	public:
+		/*
+		 * Maps a snapshot file, creating or resetting it if it does not
+		 * match the capacity and format.
+		 *
+		 * Call it before setup_user_system(), with the same capacity.
+		 *
+		 * @param _Path     The snapshot file.
+		 * @param _Capacity The number of user slots.
+		 * @return true if an earlier snapshot was resumed, false if it starts empty.
+		 * @throws std::runtime_error If the file cannot be mapped.
+		 */
+		static bool open(const std::string& _Path, std::size_t _Capacity);
+
+		/*
+		 * Writes the snapshot back and unmaps it.
+		 */
+		static void close() noexcept;
+
+		/*
+		 * Returns whether a snapshot is mapped.
+		 */
+		[[nodiscard]] static bool active() noexcept;
+
+		/*
+		 * Starts writing changed pages back to disk, without waiting.
+		 *
+		 * The mapping survives a crash of the process without it; sync()
+		 * bounds what an OS crash can lose. Call it about once per second.
+		 */
+		static void sync() noexcept;
+
+		/*
+		 * Returns the slot records, empty while no snapshot is mapped.
+		 */
+		[[nodiscard]] static std::span<session_record> records() noexcept;
+
+		/*
+		 * Returns a slot's session state, empty while no snapshot is mapped.
+		 *
+		 * @param _Slot The user slot.
+		 */
+		[[nodiscard]] static std::span<std::byte> state(std::size_t _Slot) noexcept;
+	};
+}
+
+#endif // ^^^ !_SESSION_STORE_H_
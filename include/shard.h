@@ -0,0 +1,90 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+#pragma once
+#ifndef _SHARD_H_
+#define _SHARD_H_
+
+#include <array>
+#include <cstddef>
+#include "const.h"
+
+namespace cat {
+	/*
+	 * A shard is one thread driving one ENet host, together with the core
+	 * context, service, dispatcher, send queues and user table of that host.
+	 * Those singletons live in shard_local storage, so the code using them
+	 * is unchanged while a process serves several hosts side by side.
+	 *
+	 * Shard 0 is the default, so single-host programs never need to select
+	 * a shard. Worker threads inherit the shard of the pool that owns them.
+	 */
+
+	//< Number of shard slots reserved for every shard-local object
+	constexpr std::size_t shard_count = MAX_SHARDS;
+
+	namespace detail {
+		//< Shard driven by the calling thread
+		inline thread_local std::size_t shard_index = 0;
+	}
+
+	/*
+	 * @brief Get the shard driven by the calling thread.
+	 *
+	 * @return The shard index, below shard_count.
+	 */
+	[[nodiscard]] inline std::size_t current_shard() noexcept {
+		return detail::shard_index;
+	}
+
+	/*
+	 * @brief Bind the calling thread to a shard.
+	 *
+	 * Call it first thing on a shard's thread, before touching any
+	 * shard-local object.
+	 *
+	 * @param _Shard The shard index, below shard_count.
+	 */
+	inline void set_current_shard(std::size_t _Shard) noexcept {
+		detail::shard_index = _Shard < shard_count ? _Shard : 0;
+	}
+
+	/*
+	 * @brief Access the calling shard's instance of a type.
+	 *
+	 * Each type gets one value-initialized instance per shard slot, and a
+	 * lookup is a thread-local load plus an array index.
+	 *
+	 * @tparam _Ty The type of the shard-local object.
+	 * @return Reference to the calling shard's instance.
+	 */
+	template<class _Ty>
+	[[nodiscard]] _Ty& shard_local() noexcept {
+		static std::array<_Ty, shard_count> instances{};
+		return instances[detail::shard_index];
+	}
+}
+
+#endif // ^^^ !_SHARD_H_
@@ -0,0 +1,225 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+#pragma once
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "packet.h"
+#include "schema.h"
+#include "stream.h"
+
+namespace cat {
+	//< Number of integer fields carried by every entity
+	constexpr std::size_t snapshot_fields = 16;
+
+	//< Number of recent snapshots kept for delta baselines (a power of two)
+	constexpr std::size_t snapshot_window = 32;
+
+	static_assert((snapshot_window & (snapshot_window - 1)) == 0, "snapshot_window must be a power of two");
+
+	/*
+	 * State of a single entity within a snapshot.
+	 *
+	 * Fields are plain integers; quantize floating-point state before
+	 * storing it so that unchanged values compare equal and small changes
+	 * produce small deltas.
+	 */
+	struct entity_state {
+		std::uint32_t id = 0;
+		std::array<std::int32_t, snapshot_fields> fields{};
+	};
+
+	/*
+	 * World state at one tick, as seen by one peer.
+	 *
+	 * Entities are kept sorted by ID so that two snapshots can be diffed
+	 * with a single merge pass. The storage is reused across clear() calls.
+	 */
+	class snapshot {
+	public:
+		/*
+		 * Removes every entity and sets the sequence number.
+		 *
+		 * @param _Sequence The snapshot's sequence number; must be non-zero
+		 *                  and increase from one snapshot to the next.
+		 */
+		void clear(std::uint32_t _Sequence) noexcept {
+			sequence = _Sequence;
+			entities.clear();
+		}
+
+		/*
+		 * Appends an entity with all fields zeroed.
+		 *
+		 * Entities may be added in any order; call seal() once done.
+		 *
+		 * @param _Id The entity's ID.
+		 * @return Reference to the new entity's state.
+		 */
+		entity_state& add(std::uint32_t _Id) {
+			entity_state& state = entities.emplace_back();
+			state.id = _Id;
+			return state;
+		}
+
+		/*
+		 * Sorts the entities by ID. Required before the snapshot is encoded.
+		 */
+		void seal();
+
+		/*
+		 * Looks an entity up by ID (the snapshot must be sealed).
+		 *
+		 * @param _Id The entity's ID.
+		 * @return The entity's state, or nullptr if it is not part of the snapshot.
+		 */
+		[[nodiscard]] const entity_state* find(std::uint32_t _Id) const noexcept;
+	public:
+		//< Sequence number, 0 for an empty slot
+		std::uint32_t sequence = 0;
+
+		//< Entities sorted by ID
+		std::vector<entity_state> entities;
+	};
+
+	/*
+	 * @brief Server-side delta encoder for one peer.
+	 *
+	 * Keeps the last snapshot_window snapshots sent to the peer and encodes
+	 * each new one against the most recent snapshot the peer acknowledged.
+	 * When nothing usable has been acknowledged (on connect, or after
+	 * losing acks for a whole window) a full snapshot is sent instead.
+	 *
+	 * Encoded layout:
+	 *   varint sequence, varint distance to the baseline (0 = full snapshot),
+	 *   then one record per changed, created or removed entity, ending with
+	 *   an end record. A record is a varint (id gap << 2 | kind); updates
+	 *   and creations follow it with a varint field mask and a zig-zag
+	 *   delta for every field in the mask. Unchanged entities cost nothing.
+	 */
+	class snapshot_encoder {
+	public:
+		/*
+		 * Encodes a snapshot against the peer's acknowledged baseline.
+		 *
+		 * The snapshot is copied into the history, so the caller may reuse it.
+		 *
+		 * @param _Current The sealed snapshot to send.
+		 * @param _Stream  The stream receiving the encoding.
+		 * @return true if a delta was written, false if it was a full snapshot.
+		 */
+		bool encode(const snapshot& _Current, ostream& _Stream);
+
+		/*
+		 * Records an acknowledgement from the peer.
+		 *
+		 * Acks may arrive out of order or be duplicated; only newer ones
+		 * move the baseline. Acks for sequences never encoded, or no
+		 * longer in the history, are ignored.
+		 *
+		 * @param _Sequence The sequence number the peer received.
+		 */
+		void acknowledge(std::uint32_t _Sequence) noexcept;
+
+		/*
+		 * Forgets the history and the baseline, forcing a full snapshot.
+		 */
+		void reset() noexcept;
+
+		/*
+		 * Returns the sequence number of the current baseline, or 0.
+		 */
+		[[nodiscard]] std::uint32_t baseline() const noexcept {
+			return acked;
+		}
+	private:
+		//< Snapshots recently sent to the peer, indexed by sequence
+		std::array<snapshot, snapshot_window> history;
+
+		//< Newest sequence number acknowledged by the peer, or 0
+		std::uint32_t acked = 0;
+
+		//< Newest sequence number encoded, or 0
+		std::uint32_t last = 0;
+	};
+
+	/*
+	 * @brief Client-side delta decoder.
+	 *
+	 * Keeps the last snapshot_window decoded snapshots so that deltas can
+	 * be applied to whichever baseline the server chose.
+	 */
+	class snapshot_decoder {
+	public:
+		/*
+		 * Decodes a snapshot written by snapshot_encoder::encode().
+		 *
+		 * @param _Stream The stream holding the encoding.
+		 * @return The decoded snapshot, or nullptr if the data is malformed,
+		 *         stale or refers to a baseline that is no longer available.
+		 *         The pointer stays valid until the slot is reused.
+		 */
+		const snapshot* decode(istream& _Stream);
+
+		/*
+		 * Returns the newest decoded sequence number, or 0.
+		 *
+		 * This is the value to acknowledge to the server.
+		 */
+		[[nodiscard]] std::uint32_t latest() const noexcept {
+			return newest;
+		}
+
+		/*
+		 * Forgets every decoded snapshot.
+		 */
+		void reset() noexcept;
+	private:
+		//< Snapshots recently decoded, indexed by sequence
+		std::array<snapshot, snapshot_window> history;
+
+		//< Newest decoded sequence number, or 0
+		std::uint32_t newest = 0;
+	};
+
+	/*
+	 * Acknowledgement of a received snapshot, sent by the client.
+	 *
+	 * Register it with delivery::sequenced on the snapshot's channel:
+	 * a lost ack is superseded by the next one.
+	 */
+	struct snapshot_ack : schema_packet<snapshot_ack> {
+		std::uint32_t sequence = 0;
+
+		using fields = schema<varint<&snapshot_ack::sequence>>;
+	};
+}
+
+#endif // ^^^ !_SNAPSHOT_H_
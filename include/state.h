@@ -0,0 +1,280 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+
+#pragma once
+#ifndef _STATE_H_
+#define _STATE_H_
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include "const.h"
+#include "snapshot.h"
+
+namespace cat {
+	/* Columns of the player state store, each kept in its own aligned array */
+	enum class state_column : std::uint8_t {
+		position_x,
+		position_y,
+		position_z,
+		pitch,
+		yaw,
+		roll,
+		health,
+		flags,
+	};
+
+	//< Number of state columns
+	constexpr std::size_t state_columns = 8;
+
+	/* Field groups tracked by the dirty bitsets */
+	enum class state_field : std::uint8_t {
+		position,	//< position_x, position_y and position_z
+		angles,		//< pitch, yaw and roll
+		health,		//< health
+		flags,		//< flags
+	};
+
+	//< Number of field groups
+	constexpr std::size_t state_fields = 4;
+
+	//< Set of field groups, one bit per state_field
+	using state_mask = std::uint32_t;
+
+	//< Every field group
+	constexpr state_mask all_state_fields = (state_mask{ 1 } << state_fields) - 1;
+
+	/*
+	 * Returns the mask bit of a field group.
+	 */
+	[[nodiscard]] constexpr state_mask field_bit(state_field _Field) noexcept {
+		return state_mask{ 1 } << static_cast<std::uint8_t>(_Field);
+	}
+
+	//< Snapshot field carrying the user ID that owns the entity, after the columns
+	constexpr std::size_t state_owner_field = state_columns;
+
+	static_assert(state_owner_field < snapshot_fields, "the state columns must fit into a snapshot entity");
+
+	/*
+	 * @brief Real-time player state of one shard, stored as structure of arrays.
+	 *
+	 * Every column holds one std::int32_t per user slot in a cache-line
+	 * aligned array, so a pass over one property of all players is a
+	 * linear scan the compiler can vectorize; quantize floating-point
+	 * values before storing them, as snapshots carry integers. Slots are
+	 * user_slot() of their user's ID and the capacity is rounded up to
+	 * whole bitset words of state_lane slots.
+	 *
+	 * commit() closes a tick: it compares every column of the occupied
+	 * words against the previous tick with SSE2 (a scalar loop elsewhere),
+	 * sets one dirty bit per slot and field group, and keeps the current
+	 * values as the next baseline in the same pass. The bitsets select the
+	 * users to broadcast with for_each_changed(), or serve as the predicate
+	 * of broadcast_if() through changed(); capture() writes the whole
+	 * state into a snapshot for the per-peer delta encoder.
+	 *
+	 * The user table spawns and despawns the slots as users come and go,
+	 * under its lock. All functions act on the calling shard; in threaded
+	 * mode handlers may write their own user's columns, but commit() and
+	 * capture() read every slot and must only run while no worker handles
+	 * an event, as a slot being spawned or a position half written would
+	 * be read torn. The server therefore calls worker_pool::quiesce()
+	 * before its per-tick commit().
+	 */
+	class state_store {
+	public:
+		//< Slots covered by one bitset word
+		static constexpr std::size_t state_lane = 64;
+	public:
+		/*
+		 * Sizes the store and despawns every slot.
+		 *
+		 * Called by setup_user_system() with the user capacity.
+		 *
+		 * @param _Capacity The number of user slots.
+		 */
+		static void setup(std::size_t _Capacity);
+
+		/*
+		 * Zeroes a user's columns and marks every field dirty for the next commit().
+		 *
+		 * @param _User The user taking the slot.
+		 */
+		static void spawn(userid_t _User) noexcept;
+
+		/*
+		 * Frees a user's slot; it no longer shows in snapshots or dirty bits.
+		 *
+		 * @param _User The user leaving the slot.
+		 */
+		static void despawn(userid_t _User) noexcept;
+
+		/*
+		 * Returns whether a user currently owns its slot.
+		 *
+		 * @param _User The user ID to check.
+		 */
+		[[nodiscard]] static bool alive(userid_t _User) noexcept;
+
+		/*
+		 * Returns the number of slots, a multiple of state_lane.
+		 */
+		[[nodiscard]] static std::size_t capacity() noexcept;
+
+		/*
+		 * Returns a column, indexed by user slot.
+		 *
+		 * Values of free slots are unspecified.
+		 *
+		 * @param _Column The column to access.
+		 */
+		[[nodiscard]] static std::span<std::int32_t> column(state_column _Column) noexcept;
+
+		/*
+		 * Returns the occupancy bitset, one bit per slot.
+		 */
+		[[nodiscard]] static std::span<const std::uint64_t> occupied() noexcept;
+
+		/*
+		 * Returns the user owning a slot; only meaningful while the slot is occupied.
+		 *
+		 * @param _Slot The slot to query.
+		 */
+		[[nodiscard]] static userid_t owner(std::size_t _Slot) noexcept;
+
+		/*
+		 * Sets a user's position.
+		 *
+		 * @param _User The user to update.
+		 * @return false if the user ID is stale.
+		 */
+		static bool set_position(userid_t _User, std::int32_t _X, std::int32_t _Y, std::int32_t _Z) noexcept;
+
+		/*
+		 * Sets a user's view angles.
+		 *
+		 * @param _User The user to update.
+		 * @return false if the user ID is stale.
+		 */
+		static bool set_angles(userid_t _User, std::int32_t _Pitch, std::int32_t _Yaw, std::int32_t _Roll) noexcept;
+
+		/*
+		 * Sets a user's health.
+		 *
+		 * @param _User The user to update.
+		 * @return false if the user ID is stale.
+		 */
+		static bool set_health(userid_t _User, std::int32_t _Health) noexcept;
+
+		/*
+		 * Sets a user's flags.
+		 *
+		 * @param _User The user to update.
+		 * @return false if the user ID is stale.
+		 */
+		static bool set_flags(userid_t _User, std::uint32_t _Flags) noexcept;
+
+		/*
+		 * Closes the tick: rebuilds the dirty bitsets against the previous
+		 * commit() and makes the current values the next baseline.
+		 *
+		 * The server calls it from a tick hook, after the tick's handlers.
+		 *
+		 * @return The number of users with at least one dirty field.
+		 */
+		static std::size_t commit() noexcept;
+
+		/*
+		 * Returns the dirty bitset of a field group, one bit per slot.
+		 *
+		 * @param _Field The field group.
+		 */
+		[[nodiscard]] static std::span<const std::uint64_t> dirty(state_field _Field) noexcept;
+
+		/*
+		 * Returns the field groups of a user that changed in the last commit().
+		 *
+		 * @param _User The user ID to query.
+		 * @return The dirty field groups, 0 if none or the ID is stale.
+		 */
+		[[nodiscard]] static state_mask changed(userid_t _User) noexcept;
+
+		/*
+		 * Calls a function for every user with a dirty field among the given groups.
+		 *
+		 * Users come in slot order, and the scan only touches the bitset
+		 * words of the selected groups.
+		 *
+		 * @param _Fields   The field groups of interest.
+		 * @param _Function Function called with the user ID and its dirty groups.
+		 */
+		template<class _Fn>
+		static void for_each_changed(state_mask _Fields, _Fn&& _Function) {
+			std::span<const std::uint64_t> masks[state_fields];
+			for (std::size_t f = 0; f < state_fields; ++f) {
+				masks[f] = dirty(static_cast<state_field>(f));
+			}
+
+			const std::size_t words = capacity() / state_lane;
+			for (std::size_t w = 0; w < words; ++w) {
+				std::uint64_t bits = 0;
+				for (std::size_t f = 0; f < state_fields; ++f) {
+					if (_Fields & (state_mask{ 1 } << f)) {
+						bits |= masks[f][w];
+					}
+				}
+				while (bits != 0) {
+					const std::size_t slot = w * state_lane + static_cast<std::size_t>(std::countr_zero(bits));
+					bits &= bits - 1;
+
+					state_mask fields = 0;
+					for (std::size_t f = 0; f < state_fields; ++f) {
+						fields |= static_cast<state_mask>(masks[f][w] >> (slot % state_lane) & 1) << f;
+					}
+					_Function(owner(slot), fields & _Fields);
+				}
+			}
+		}
+
+		/*
+		 * Writes the state of every occupied slot into a snapshot.
+		 *
+		 * Entity IDs are the user slots and come out in order, so the
+		 * snapshot is sealed already. Each entity carries the columns in
+		 * state_column order followed by its owner's user ID in
+		 * state_owner_field, so a slot taken over by another user shows
+		 * as an update of that field.
+		 *
+		 * @param _Out      The snapshot to fill; its storage is reused.
+		 * @param _Sequence The snapshot's sequence number.
+		 */
+		static void capture(snapshot& _Out, std::uint32_t _Sequence);
+	};
+}
+
+#endif // ^^^ !_STATE_H_
@@ -26,12 +26,33 @@
 #ifndef _STREAM_H_
 #define _STREAM_H_
 
+#include <concepts>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
 #include <string>
+#include <string_view>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace cat {
+	/*
+	 * Wire encodings understood by the streams.
+	 *
+	 * legacy  : Version 1. Length prefixes are a raw std::size_t, so their
+	 *           width depends on the platform (4 bytes on x86, 8 on x64).
+	 * compact : Version 2. Lengths and counts are LEB128 varints, which
+	 *           keeps short strings down to a single prefix byte and makes
+	 *           the format identical between 32-bit and 64-bit builds.
+	 */
+	enum class wire_format : std::uint8_t {
+		legacy	= 1,
+		compact = 2,
+	};
+
 	/*
 	 * The _stream class provides a simple wrapper around a dynamic byte buffer.
 	 * It allows reading the current buffer, querying its size, and clearing its contents
@@ -41,6 +62,13 @@ namespace cat {
 	protected:
 		using byte_type = std::byte;
 		using buffer_type = std::vector<byte_type>;
+	public:
+		//< Maximum number of bytes a 64-bit LEB128 varint can occupy
+		static constexpr std::size_t max_varint_size = 10;
+
+		//< Maximum number of bytes a length prefix can occupy in any format
+		static constexpr std::size_t max_size_prefix = max_varint_size > sizeof(std::size_t)
+			? max_varint_size : sizeof(std::size_t);
 	public:
 		constexpr _stream() noexcept = default;
 
@@ -111,15 +139,74 @@ namespace cat {
 		constexpr void reserve(std::size_t _Size) noexcept {
 			buf.reserve(_Size);
 		}
+
+		/*
+		 * Returns the wire encoding used for length prefixes.
+		 *
+		 * @return The stream's wire format
+		 */
+		[[nodiscard]] constexpr wire_format format() const noexcept {
+			return fmt;
+		}
+
+		/*
+		 * Selects the wire encoding used for length prefixes.
+		 * Both ends of a connection must use the same format.
+		 *
+		 * @param _Format The wire format to use
+		 */
+		constexpr void set_format(wire_format _Format) noexcept {
+			fmt = _Format;
+		}
+	protected:
+		/*
+		 * Encodes an unsigned value as a LEB128 varint.
+		 *
+		 * @param _Out   Destination with room for at least max_varint_size bytes
+		 * @param _Value The value to encode
+		 * @return The number of bytes written
+		 */
+		static constexpr std::size_t encode_varint(byte_type* _Out, std::uint64_t _Value) noexcept {
+			std::size_t size = 0;
+			while (_Value >= 0x80) {
+				_Out[size++] = static_cast<byte_type>(_Value | 0x80);
+				_Value >>= 7;
+			}
+			_Out[size++] = static_cast<byte_type>(_Value);
+			return size;
+		}
+
+		/*
+		 * Maps a signed value onto an unsigned one so that small magnitudes
+		 * of either sign encode to short varints (0, -1, 1, -2 -> 0, 1, 2, 3).
+		 */
+		static constexpr std::uint64_t zigzag_encode(std::int64_t _Value) noexcept {
+			return (static_cast<std::uint64_t>(_Value) << 1) ^ static_cast<std::uint64_t>(_Value >> 63);
+		}
+
+		/*
+		 * Inverse of zigzag_encode().
+		 */
+		static constexpr std::int64_t zigzag_decode(std::uint64_t _Value) noexcept {
+			return static_cast<std::int64_t>(_Value >> 1) ^ -static_cast<std::int64_t>(_Value & 1);
+		}
 	protected:
 		// Internal storage for raw byte data
 		buffer_type buf;
+
+		// Encoding used for length prefixes
+		wire_format fmt = wire_format::compact;
 	};
 
 	/*
 	 * Input stream class for reading from a _stream buffer.
 	 * Supports copy, move, and raw pointer initialization, and provides
 	 * multiple read methods for primitive types and strings.
+	 *
+	 * An input stream either owns its bytes (the internal buffer) or is a
+	 * non-owning view over memory that lives elsewhere, such as the data of
+	 * a received ENet packet. All reads go through the view, so both modes
+	 * share the same parsing code.
 	 */
 	class istream : public _stream {
 	public:
@@ -130,7 +217,7 @@ namespace cat {
 		 * @param _Size   Number of bytes to copy from the buffer
 		 */
 		istream(const byte_type* _Buffer, std::size_t _Size)
-			: _stream(_Buffer, _Buffer + _Size), pos(0) {
+			: _stream(_Buffer, _Buffer + _Size), view(buf), pos(0) {
 		}
 
 		/*
@@ -139,7 +226,7 @@ namespace cat {
 		 * @param _Buffer A constant reference to a vector of bytes to copy
 		 */
 		istream(const buffer_type& _Buffer)
-			: _stream(_Buffer), pos(0) {
+			: _stream(_Buffer), view(buf), pos(0) {
 		}
 
 		/*
@@ -148,7 +235,87 @@ namespace cat {
 		 * @param _Buffer An rvalue reference to a vector of bytes
 		 */
 		istream(buffer_type&& _Buffer) noexcept
-			: _stream(std::move(_Buffer)), pos(0) {
+			: _stream(std::move(_Buffer)), view(buf), pos(0) {
+		}
+
+		/*
+		 * Constructs a non-owning input stream over an existing byte range.
+		 *
+		 * No bytes are copied. The referenced memory must remain valid for
+		 * as long as the stream, or any string view read from it, is used.
+		 *
+		 * @param _View The byte range to read from
+		 */
+		explicit istream(std::span<const byte_type> _View) noexcept
+			: view(_View), pos(0) {
+		}
+
+		istream(const istream& _Other)
+			: _stream(_Other), view(_Other.owning() ? std::span<const byte_type>(buf) : _Other.view), pos(_Other.pos) {
+		}
+
+		istream& operator=(const istream& _Other) {
+			if (this != &_Other) {
+				buf = _Other.buf;
+				fmt = _Other.fmt;
+				view = _Other.owning() ? std::span<const byte_type>(buf) : _Other.view;
+				pos = _Other.pos;
+			}
+			return *this;
+		}
+
+		istream(istream&&) noexcept = default;
+		istream& operator=(istream&&) noexcept = default;
+
+		/*
+		 * Creates a non-owning input stream over raw memory.
+		 *
+		 * Typically used on the data pointer of a received packet, which
+		 * lets handlers parse the payload in place.
+		 *
+		 * @param _Data Pointer to the first byte of the range
+		 * @param _Size Number of bytes in the range
+		 * @return An input stream viewing the given range
+		 */
+		[[nodiscard]] static istream view_of(const void* _Data, std::size_t _Size) noexcept {
+			return istream(std::span<const byte_type>(static_cast<const byte_type*>(_Data), _Size));
+		}
+
+		/*
+		 * Returns the number of readable bytes in the stream.
+		 *
+		 * @return The size of the viewed byte range
+		 */
+		[[nodiscard]] constexpr std::size_t size() const noexcept {
+			return view.size();
+		}
+
+		/*
+		 * Returns the number of bytes that have not been read yet.
+		 *
+		 * @return The number of bytes between the read position and the end
+		 */
+		[[nodiscard]] constexpr std::size_t remaining() const noexcept {
+			return view.size() - pos;
+		}
+
+		/*
+		 * Returns the bytes that have not been read yet.
+		 *
+		 * @return A span over the unread part of the stream
+		 */
+		[[nodiscard]] constexpr std::span<const byte_type> unread() const noexcept {
+			return view.subspan(pos);
+		}
+
+		/*
+		 * Returns whether the stream reads from its own buffer.
+		 *
+		 * @return true  If the stream owns its bytes
+		 * @return false If the stream views external memory
+		 */
+		[[nodiscard]] constexpr bool owning() const noexcept {
+			return view.data() == buf.data();
 		}
 
 		/*
@@ -166,36 +333,155 @@ namespace cat {
 		bool read(_Ty& _Value) noexcept {
 			static_assert(std::is_trivially_copyable_v<_Ty>, "requires trivially copyable type");
 			constexpr std::size_t SIZE = sizeof(_Ty);
-			if (pos + SIZE > buf.size()) {
+			if (SIZE > view.size() - pos) {
 				return false;
 			}
-			std::memcpy(&_Value, buf.data() + pos, SIZE);
+			std::memcpy(&_Value, view.data() + pos, SIZE);
 			pos += SIZE;
 			return true;
 		}
 
+		/*
+		 * Consumes a block of bytes with a single bounds check.
+		 *
+		 * The returned pointer refers to the stream's bytes and is only
+		 * valid while that memory is alive.
+		 *
+		 * @param _Size Number of bytes to consume
+		 * @return Pointer to the consumed bytes, or nullptr (leaving the
+		 *         read position unchanged) if fewer than `_Size` remain
+		 */
+		[[nodiscard]] const byte_type* consume(std::size_t _Size) noexcept {
+			if (_Size > view.size() - pos) {
+				return nullptr;
+			}
+			const byte_type* data = view.data() + pos;
+			pos += _Size;
+			return data;
+		}
+
+		/*
+		 * Reads an unsigned LEB128 varint.
+		 * The read position is left unchanged on failure.
+		 *
+		 * @tparam _Ty    An unsigned integral type
+		 * @param  _Value Reference to the output variable
+		 *
+		 * @return true  If a complete varint that fits in _Ty was read
+		 * @return false If the data is truncated, overlong or out of range
+		 */
+		template<std::unsigned_integral _Ty>
+		bool read_varint(_Ty& _Value) noexcept {
+			std::uint64_t result = 0;
+			std::size_t cur = pos;
+			for (unsigned shift = 0; shift < 64 && cur < view.size(); shift += 7) {
+				const auto byte = std::to_integer<std::uint64_t>(view[cur++]);
+				//
+				// The tenth byte holds bit 63 only; anything above it would be shifted out
+				//
+				if (shift == 63 && byte > 0x01) {
+					return false;
+				}
+				result |= (byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0) {
+					if (result > std::numeric_limits<_Ty>::max()) {
+						return false;
+					}
+					_Value = static_cast<_Ty>(result);
+					pos = cur;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/*
+		 * Reads a zig-zag encoded signed varint.
+		 *
+		 * @tparam _Ty    A signed integral type
+		 * @param  _Value Reference to the output variable
+		 * @return true if a value was read, false otherwise.
+		 */
+		template<std::signed_integral _Ty>
+		bool read_zigzag(_Ty& _Value) noexcept {
+			std::uint64_t raw;
+			const std::size_t start = pos;
+			if (!read_varint(raw)) {
+				return false;
+			}
+			const std::int64_t value = zigzag_decode(raw);
+			if (value < std::numeric_limits<_Ty>::min() || value > std::numeric_limits<_Ty>::max()) {
+				pos = start;
+				return false;
+			}
+			_Value = static_cast<_Ty>(value);
+			return true;
+		}
+
+		/*
+		 * Reads a length or count prefix in the stream's wire format.
+		 *
+		 * @param _Value Reference to the output variable
+		 * @return true if a prefix was read, false otherwise.
+		 */
+		bool read_size(std::size_t& _Value) noexcept {
+			return fmt == wire_format::legacy ? read(_Value) : read_varint(_Value);
+		}
+
 		/*
 		 * Reads a length-prefixed string from the stream buffer.
 		 *
-		 * The function first reads the size prefix (size_t), checks if
+		 * The function first reads the size prefix (see read_size), checks if
 		 * there are enough bytes remaining in the buffer, and then
 		 * extracts the string into _Value.
 		 *
-		 * @param _Value Reference to the std::string where the result will be stored
+		 * Any allocator works, so a std::pmr::string on the tick arena reads
+		 * without touching the heap.
+		 *
+		 * @tparam _Alloc The string's allocator
+		 * @param _Value Reference to the string where the result will be stored
 		 * @return true  If the string was successfully read
 		 * @return false If there is not enough data left in the buffer
 		 */
-		bool read_str(std::string& _Value) noexcept {
+		template<class _Alloc>
+		bool read_str(std::basic_string<char, std::char_traits<char>, _Alloc>& _Value) {
+			std::string_view value;
+			if (!read_str(value)) {
+				return false;
+			}
+			_Value.assign(value);
+			return true;
+		}
+
+		/*
+		 * Reads a length-prefixed string without copying it.
+		 *
+		 * The resulting view points into the stream's bytes and is only
+		 * valid while that memory is alive (for a packet view, until the
+		 * packet is destroyed).
+		 *
+		 * @param _Value Reference to the std::string_view where the result will be stored
+		 * @return true  If the string was successfully read
+		 * @return false If there is not enough data left in the buffer
+		 */
+		bool read_str(std::string_view& _Value) noexcept {
 			std::size_t size;
-			if (!read(size) || pos + size > buf.size()) {
+			const std::size_t start = pos;
+			if (!read_size(size)) {
 				return false;
 			}
-			_Value.resize(size);
-			std::memcpy(_Value.data(), buf.data() + pos, size);
+			if (size > view.size() - pos) {
+				pos = start;
+				return false;
+			}
+			_Value = std::string_view(reinterpret_cast<const char*>(view.data() + pos), size);
 			pos += size;
 			return true;
 		}
 	private:
+		// Bytes the stream reads from (the internal buffer or external memory)
+		std::span<const byte_type> view;
+
 		// Current read position within the buffer
 		std::size_t pos;
 	};
@@ -206,6 +492,141 @@ namespace cat {
 	 * offering mechanisms to construct and manipulate output data.
 	 */
 	class ostream : public _stream {
+	public:
+		/*
+		 * A block of external memory referenced by the stream instead of
+		 * being copied into it. Fragments are spliced in at `offset`, the
+		 * position of the internal buffer at the time they were added.
+		 */
+		struct fragment {
+			std::size_t			offset;
+			const byte_type*	data;
+			std::size_t			size;
+		};
+
+		/*
+		 * Unchecked write cursor over a region reserved in an ostream.
+		 *
+		 * Obtained from ostream::reserve_write(). The region is sized once
+		 * up front, every write is a plain copy through a pointer, and the
+		 * stream is trimmed to the bytes actually written when the cursor
+		 * is committed or destroyed. Writing past the reserved bound is
+		 * undefined behaviour; the bound must be exact or an upper bound.
+		 * The stream must not be modified while a cursor is active.
+		 */
+		class cursor {
+		public:
+			cursor(const cursor&) = delete;
+			cursor& operator=(const cursor&) = delete;
+
+			cursor(cursor&& _Other) noexcept
+				: owner(std::exchange(_Other.owner, nullptr)), ptr(_Other.ptr), end(_Other.end) {
+			}
+
+			~cursor() {
+				commit();
+			}
+
+			/*
+			 * Writes a trivially copyable type without bounds checking.
+			 *
+			 * @tparam _Ty    A trivially copyable type
+			 * @param  _Value A constant reference to the value to be written
+			 */
+			template<class _Ty>
+			void write(const _Ty& _Value) noexcept {
+				static_assert(std::is_trivially_copyable_v<_Ty>, "requires trivially copyable type");
+				std::memcpy(ptr, &_Value, sizeof(_Ty));
+				ptr += sizeof(_Ty);
+			}
+
+			/*
+			 * Writes raw bytes without bounds checking.
+			 *
+			 * @param _Data Pointer to the bytes to copy
+			 * @param _Size Number of bytes to copy
+			 */
+			void write_bytes(const void* _Data, std::size_t _Size) noexcept {
+				std::memcpy(ptr, _Data, _Size);
+				ptr += _Size;
+			}
+
+			/*
+			 * Writes an unsigned LEB128 varint without bounds checking.
+			 *
+			 * @param _Value The value to write (at most max_varint_size bytes)
+			 */
+			void write_varint(std::uint64_t _Value) noexcept {
+				ptr += encode_varint(ptr, _Value);
+			}
+
+			/*
+			 * Writes a zig-zag encoded signed varint without bounds checking.
+			 *
+			 * @param _Value The value to write
+			 */
+			void write_zigzag(std::int64_t _Value) noexcept {
+				write_varint(zigzag_encode(_Value));
+			}
+
+			/*
+			 * Writes a length or count prefix in the stream's wire format.
+			 *
+			 * @param _Value The value to write (at most max_size_prefix bytes)
+			 */
+			void write_size(std::size_t _Value) noexcept {
+				if (owner->fmt == wire_format::legacy) {
+					write(_Value);
+				} else {
+					write_varint(_Value);
+				}
+			}
+
+			/*
+			 * Writes a length-prefixed string without bounds checking.
+			 * Uses the same encoding as ostream::write_str(); reserve
+			 * max_size_prefix bytes for the prefix.
+			 *
+			 * @param _Value The string to write
+			 */
+			void write_str(std::string_view _Value) noexcept {
+				write_size(_Value.size());
+				write_bytes(_Value.data(), _Value.size());
+			}
+
+			/*
+			 * Returns the number of reserved bytes that are still unused.
+			 */
+			[[nodiscard]] std::size_t remaining() const noexcept {
+				return static_cast<std::size_t>(end - ptr);
+			}
+
+			/*
+			 * Trims the stream to the written bytes and detaches the cursor.
+			 * Called automatically on destruction.
+			 */
+			void commit() noexcept {
+				if (owner != nullptr) {
+					owner->buf.resize(owner->buf.size() - remaining());
+					owner = nullptr;
+				}
+			}
+		private:
+			friend class ostream;
+
+			cursor(ostream& _Owner, byte_type* _Begin, byte_type* _End) noexcept
+				: owner(&_Owner), ptr(_Begin), end(_End) {
+			}
+
+			//< Stream the region was reserved in
+			ostream* owner;
+
+			//< Current write position
+			byte_type* ptr;
+
+			//< One past the last reserved byte
+			byte_type* end;
+		};
 	public:
 		constexpr ostream() = default;
 
@@ -233,22 +654,294 @@ namespace cat {
 			std::memcpy(buf.data() + buf.size() - SIZE, &_Value, SIZE);
 		}
 
+		/*
+		 * Writes an unsigned LEB128 varint into the stream.
+		 *
+		 * @param _Value The value to write
+		 */
+		void write_varint(std::uint64_t _Value) {
+			byte_type tmp[max_varint_size];
+			const std::size_t size = encode_varint(tmp, _Value);
+			buf.insert(buf.end(), tmp, tmp + size);
+		}
+
+		/*
+		 * Writes a zig-zag encoded signed varint into the stream.
+		 * Suited for signed deltas, where values cluster around zero.
+		 *
+		 * @param _Value The value to write
+		 */
+		void write_zigzag(std::int64_t _Value) {
+			write_varint(zigzag_encode(_Value));
+		}
+
+		/*
+		 * Writes a length or count prefix in the stream's wire format.
+		 *
+		 * @param _Value The value to write
+		 */
+		void write_size(std::size_t _Value) {
+			if (fmt == wire_format::legacy) {
+				write(_Value);
+			} else {
+				write_varint(_Value);
+			}
+		}
+
 		/*
 		 * Writes a length-prefixed string into the stream buffer.
 		 *
-		 * The string is stored as a size prefix (size_t) followed by the raw
+		 * The string is stored as a size prefix (see write_size) followed by the raw
 		 * string data (not null-terminated). This allows the corresponding
 		 * read_str function to know exactly how many bytes to read.
 		 *
-		 * @param _Value The std::string to write into the buffer
+		 * @param _Value The string to write into the buffer
 		 */
-		void write_str(const std::string& _Value) {
-			write(_Value.size());
+		void write_str(std::string_view _Value) {
+			write_size(_Value.size());
 			const std::size_t size = buf.size();
 			buf.resize(buf.size() + _Value.size());
 			std::memcpy(buf.data() + size, _Value.data(), _Value.length());
 		}
+
+		/*
+		 * Reserves `_Bound` bytes at the end of the stream and returns an
+		 * unchecked cursor over them.
+		 *
+		 * The buffer is resized once for the whole region, replacing one
+		 * resize per field with a single one per message.
+		 *
+		 * @param _Bound Exact or upper-bound number of bytes that will be written
+		 * @return A cursor writing into the reserved region
+		 */
+		[[nodiscard]] cursor reserve_write(std::size_t _Bound) {
+			const std::size_t size = buf.size();
+			buf.resize(size + _Bound);
+			return cursor(*this, buf.data() + size, buf.data() + size + _Bound);
+		}
+
+		/*
+		 * Appends a reference to external memory instead of copying it.
+		 *
+		 * The bytes are copied only once, directly into the outgoing packet,
+		 * when the stream is gathered (see gather()). The referenced memory
+		 * must stay valid until then.
+		 *
+		 * @param _Data The bytes to reference
+		 */
+		void write_ref(std::span<const byte_type> _Data) {
+			if (!_Data.empty()) {
+				refs.push_back({ buf.size(), _Data.data(), _Data.size() });
+				extern_size += _Data.size();
+			}
+		}
+
+		/*
+		 * Returns the referenced fragments in stream order.
+		 */
+		[[nodiscard]] constexpr const std::vector<fragment>& fragments() const noexcept {
+			return refs;
+		}
+
+		/*
+		 * Returns the size of the serialized message, including referenced
+		 * fragments.
+		 *
+		 * @return The number of bytes gather() will produce
+		 */
+		[[nodiscard]] constexpr std::size_t total_size() const noexcept {
+			return buf.size() + extern_size;
+		}
+
+		/*
+		 * Writes the complete message into contiguous memory, splicing
+		 * referenced fragments between the inline bytes.
+		 *
+		 * @param _Dest Destination with room for at least total_size() bytes
+		 */
+		void gather(void* _Dest) const noexcept {
+			byte_type* out = static_cast<byte_type*>(_Dest);
+			std::size_t offset = 0;
+			for (const auto& ref : refs) {
+				std::memcpy(out, buf.data() + offset, ref.offset - offset);
+				out += ref.offset - offset;
+				std::memcpy(out, ref.data, ref.size);
+				out += ref.size;
+				offset = ref.offset;
+			}
+			std::memcpy(out, buf.data() + offset, buf.size() - offset);
+		}
+
+		/*
+		 * Clears the buffer and all referenced fragments, retaining capacity.
+		 */
+		constexpr void flush() noexcept {
+			buf.clear();
+			refs.clear();
+			extern_size = 0;
+		}
 	private:
+		//< Referenced fragments, ordered by offset
+		std::vector<fragment> refs;
+
+		//< Total size of all referenced fragments
+		std::size_t extern_size = 0;
+	};
+
+	/*
+	 * Packs small fields (bools, short enums, bounded integers) into as few
+	 * bytes as possible. Bits are appended LSB-first and written to the
+	 * underlying stream a byte at a time; the final partial byte is padded
+	 * with zeros by flush(), which also runs on destruction.
+	 */
+	class bit_writer {
+	public:
+		explicit bit_writer(ostream& _Stream) noexcept
+			: stream(_Stream) {
+		}
+
+		bit_writer(const bit_writer&) = delete;
+		bit_writer& operator=(const bit_writer&) = delete;
+
+		~bit_writer() {
+			flush();
+		}
+
+		/*
+		 * Appends the low `_Count` bits of a value.
+		 *
+		 * @param _Value The bits to write
+		 * @param _Count Number of bits to write (0-32)
+		 */
+		void write_bits(std::uint32_t _Value, unsigned _Count) {
+			const std::uint64_t mask = (std::uint64_t{ 1 } << _Count) - 1;
+			scratch |= (_Value & mask) << bits;
+			bits += _Count;
+			while (bits >= 8) {
+				stream.write(static_cast<std::uint8_t>(scratch));
+				scratch >>= 8;
+				bits -= 8;
+			}
+		}
+
+		/*
+		 * Appends a single flag bit.
+		 *
+		 * @param _Value The flag to write
+		 */
+		void write_bool(bool _Value) {
+			write_bits(_Value ? 1u : 0u, 1);
+		}
+
+		/*
+		 * Appends an enumerator using `_Count` bits.
+		 *
+		 * @param _Value The enumerator to write
+		 * @param _Count Number of bits the enumeration needs
+		 */
+		template<class _Enum> requires std::is_enum_v<_Enum>
+		void write_enum(_Enum _Value, unsigned _Count) {
+			write_bits(static_cast<std::uint32_t>(_Value), _Count);
+		}
+
+		/*
+		 * Writes out any pending bits, padding the last byte with zeros.
+		 */
+		void flush() {
+			if (bits > 0) {
+				stream.write(static_cast<std::uint8_t>(scratch));
+				scratch = 0;
+				bits = 0;
+			}
+		}
+	private:
+		//< Stream receiving the packed bytes
+		ostream& stream;
+
+		//< Bits not yet written to the stream
+		std::uint64_t scratch = 0;
+
+		//< Number of valid bits in scratch
+		unsigned bits = 0;
+	};
+
+	/*
+	 * Reads fields packed by bit_writer. Bytes are pulled from the
+	 * underlying stream on demand; unused bits of the last byte are
+	 * discarded, which matches the writer's padding.
+	 */
+	class bit_reader {
+	public:
+		explicit bit_reader(istream& _Stream) noexcept
+			: stream(_Stream) {
+		}
+
+		bit_reader(const bit_reader&) = delete;
+		bit_reader& operator=(const bit_reader&) = delete;
+
+		/*
+		 * Reads `_Count` bits.
+		 *
+		 * @param _Value Reference to the output variable
+		 * @param _Count Number of bits to read (0-32)
+		 * @return true if the bits were available, false otherwise.
+		 */
+		bool read_bits(std::uint32_t& _Value, unsigned _Count) noexcept {
+			while (bits < _Count) {
+				std::uint8_t byte;
+				if (!stream.read(byte)) {
+					return false;
+				}
+				scratch |= static_cast<std::uint64_t>(byte) << bits;
+				bits += 8;
+			}
+			const std::uint64_t mask = (std::uint64_t{ 1 } << _Count) - 1;
+			_Value = static_cast<std::uint32_t>(scratch & mask);
+			scratch >>= _Count;
+			bits -= _Count;
+			return true;
+		}
+
+		/*
+		 * Reads a single flag bit.
+		 *
+		 * @param _Value Reference to the output variable
+		 * @return true if the bit was available, false otherwise.
+		 */
+		bool read_bool(bool& _Value) noexcept {
+			std::uint32_t bit;
+			if (!read_bits(bit, 1)) {
+				return false;
+			}
+			_Value = bit != 0;
+			return true;
+		}
+
+		/*
+		 * Reads an enumerator stored in `_Count` bits.
+		 *
+		 * @param _Value Reference to the output variable
+		 * @param _Count Number of bits the enumeration uses
+		 * @return true if the bits were available, false otherwise.
+		 */
+		template<class _Enum> requires std::is_enum_v<_Enum>
+		bool read_enum(_Enum& _Value, unsigned _Count) noexcept {
+			std::uint32_t raw;
+			if (!read_bits(raw, _Count)) {
+				return false;
+			}
+			_Value = static_cast<_Enum>(raw);
+			return true;
+		}
+	private:
+		//< Stream supplying the packed bytes
+		istream& stream;
+
+		//< Bits read from the stream but not yet consumed
+		std::uint64_t scratch = 0;
+
+		//< Number of valid bits in scratch
+		unsigned bits = 0;
 	};
 }
 
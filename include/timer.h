@@ -0,0 +1,157 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+#pragma once
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cat {
+	/* Handle identifying a scheduled timer */
+	struct timer_id {
+		std::uint32_t index = 0;
+		std::uint32_t generation = 0;
+	};
+
+	/*
+	 * @brief Hierarchical timer wheel driven by the server tick.
+	 *
+	 * Time is measured in ticks. Level 0 has one slot per tick for the next
+	 * 64 ticks; each further level covers 64 times the span of the previous
+	 * one, so four levels reach 2^24 ticks (about 73 hours at 64 Hz). Timers
+	 * further out than that park in the last slot and are re-filed when it
+	 * comes due. Insertion and cancellation are O(1); advancing costs O(1)
+	 * per tick plus the timers that actually fire or cascade.
+	 *
+	 * Timer nodes are recycled through a free list, so the steady state
+	 * performs no allocation. Callbacks may schedule or cancel timers,
+	 * including their own.
+	 */
+	class timer_wheel {
+	public:
+		using callback_t = void (*)(void*);
+
+		//< Number of slot bits per level
+		static constexpr unsigned slot_bits = 6;
+
+		//< Number of slots per level
+		static constexpr std::size_t slots = std::size_t{ 1 } << slot_bits;
+
+		//< Number of levels
+		static constexpr std::size_t levels = 4;
+	public:
+		timer_wheel();
+
+		/*
+		 * @brief Schedule a callback.
+		 *
+		 * @param _Delay    Ticks from now until the first expiry (0 fires on the next tick).
+		 * @param _Callback Function to call on expiry.
+		 * @param _Context  Opaque pointer passed to the callback.
+		 * @param _Interval Reload interval in ticks for repeating timers, or 0 for one-shot.
+		 * @return A handle that can be passed to cancel().
+		 */
+		timer_id schedule(std::uint64_t _Delay, callback_t _Callback, void* _Context, std::uint64_t _Interval = 0);
+
+		/*
+		 * @brief Cancel a pending timer.
+		 *
+		 * @param _Id The handle returned by schedule().
+		 * @return true  If the timer was pending and has been cancelled
+		 * @return false If the timer already fired or was cancelled
+		 */
+		bool cancel(timer_id _Id) noexcept;
+
+		/*
+		 * @brief Advance the wheel, firing every timer that comes due.
+		 *
+		 * @param _Ticks Number of ticks to advance.
+		 * @return The number of callbacks invoked.
+		 */
+		std::size_t advance(std::uint64_t _Ticks = 1);
+
+		/*
+		 * @brief Get the current tick of the wheel.
+		 */
+		[[nodiscard]] constexpr std::uint64_t now() const noexcept {
+			return current;
+		}
+
+		/*
+		 * @brief Get the number of pending timers.
+		 */
+		[[nodiscard]] constexpr std::size_t size() const noexcept {
+			return pending;
+		}
+	private:
+		//< Sentinel index marking the end of a list
+		static constexpr std::uint32_t npos = 0xFFFFFFFF;
+
+		//< Slot value of a node that is not linked into the wheel
+		static constexpr std::uint16_t detached = 0xFFFF;
+
+		/* A timer node, linked into one wheel slot or the free list */
+		struct node {
+			std::uint64_t	expires = 0;
+			std::uint64_t	interval = 0;
+			callback_t		callback = nullptr;
+			void*			context = nullptr;
+			std::uint32_t	prev = npos;
+			std::uint32_t	next = npos;
+			std::uint32_t	generation = 0;
+			std::uint16_t	slot = detached;
+			bool			active = false;
+		};
+
+		void link(std::uint32_t _Index);
+		void unlink(std::uint32_t _Index) noexcept;
+		void cascade(std::size_t _Level);
+		void release(std::uint32_t _Index) noexcept;
+		std::size_t fire(std::size_t _Slot);
+
+		//< Node storage; indices are stable
+		std::vector<node> nodes;
+
+		//< Timers collected from the slot being fired (reused between ticks)
+		std::vector<timer_id> due;
+
+		//< Head of the free node list
+		std::uint32_t free_head = npos;
+
+		//< List heads of every slot of every level
+		std::array<std::uint32_t, slots * levels> heads;
+
+		//< Current tick
+		std::uint64_t current = 0;
+
+		//< Number of pending timers
+		std::size_t pending = 0;
+	};
+}
+
+#endif // ^^^ !_TIMER_H_
@@ -0,0 +1,185 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+#pragma once
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(CSOVMWARE_TRACE_TRACY)
+#include <tracy/Tracy.hpp>
+#endif
+
+namespace cat {
+	/*
+	 * @brief Scoped trace zones for attributing slow ticks.
+	 *
+	 * Built with CSOVMWARE_TRACE, every CAT_TRACE_ZONE records its name,
+	 * start and end into a ring owned by the calling thread. Recording is
+	 * two clock reads and a few relaxed stores; nothing is shared between
+	 * threads except the rings' registration. dump() writes the most
+	 * recent ring_size zones of every thread as Chrome trace JSON, for
+	 * chrome://tracing or Perfetto.
+	 *
+	 * Built with CSOVMWARE_TRACE_TRACY instead, the zones are Tracy zones
+	 * and stream to a connected Tracy profiler; the rings stay empty.
+	 * Without either option the zones compile to nothing.
+	 */
+	class trace {
+	public:
+		//< Whether zones are recorded into the rings
+#if defined(CSOVMWARE_TRACE) && !defined(CSOVMWARE_TRACE_TRACY)
+		static constexpr bool enabled = true;
+#else
+		static constexpr bool enabled = false;
+#endif
+
+		//< Zones kept per thread (a power of two)
+		static constexpr std::size_t ring_size = 1 << 15;
+
+		//< Minimum time between two hitch dumps
+		static constexpr std::chrono::seconds hitch_interval{ 1 };
+
+		//< Maximum number of hitch dumps written per process
+		static constexpr std::uint32_t max_hitch_dumps = 16;
+
+		static_assert((ring_size & (ring_size - 1)) == 0, "ring_size must be a power of two");
+	public:
+		/*
+		 * Returns the trace clock in nanoseconds.
+		 */
+		[[nodiscard]] static std::uint64_t now() noexcept {
+			return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		/*
+		 * Records a finished zone into the calling thread's ring.
+		 *
+		 * @param _Name  The zone name; must outlive the trace (a literal).
+		 * @param _Start Start time from now().
+		 * @param _End   End time from now().
+		 */
+		static void record(const char* _Name, std::uint64_t _Start, std::uint64_t _End) noexcept;
+
+		/*
+		 * Names the calling thread in dumps.
+		 *
+		 * @param _Name The thread's name.
+		 */
+		static void name_thread(const std::string& _Name);
+
+		/*
+		 * Writes the recorded zones of every thread as Chrome trace JSON.
+		 *
+		 * Threads may keep recording while the dump runs; zones overwritten
+		 * during the copy are left out.
+		 *
+		 * @param _Path The file to write.
+		 * @return true if the file was written.
+		 */
+		static bool dump(const std::string& _Path);
+
+		/*
+		 * Dumps the zones automatically when a tick runs long.
+		 *
+		 * The slow tick only copies the rings; the file is written on a
+		 * background thread.
+		 *
+		 * @param _Path      Dump files are named <path>.hitch<n>-<ms>ms.json, <ms> being the tick duration.
+		 * @param _Threshold Tick duration that counts as a hitch; 0 disables.
+		 */
+		static void watch_hitches(const std::string& _Path, std::chrono::nanoseconds _Threshold);
+
+		/*
+		 * Reports a tick's duration; dumps the zones if it was a hitch.
+		 *
+		 * Called by the scheduler after every tick.
+		 *
+		 * @param _Elapsed The tick's duration.
+		 */
+		static void end_tick(std::chrono::nanoseconds _Elapsed) {
+			if constexpr (enabled) {
+				const auto threshold = hitch_threshold.load(std::memory_order_relaxed);
+				if (threshold != 0 && _Elapsed.count() > threshold) {
+					hitch(_Elapsed);
+				}
+			}
+		}
+	private:
+		/*
+		 * Starts a hitch dump on a background thread, rate limited by hitch_interval.
+		 */
+		static void hitch(std::chrono::nanoseconds _Elapsed);
+
+		//< Hitch threshold in nanoseconds, 0 when not watching
+		static inline std::atomic<std::int64_t> hitch_threshold{ 0 };
+	};
+
+	/*
+	 * @brief A zone recorded from construction to destruction.
+	 */
+	class trace_zone {
+	public:
+		explicit trace_zone(const char* _Name) noexcept
+			: name(_Name), start(trace::now()) {
+		}
+
+		trace_zone(const trace_zone&) = delete;
+		trace_zone& operator=(const trace_zone&) = delete;
+
+		~trace_zone() {
+			trace::record(name, start, trace::now());
+		}
+	private:
+		//< Zone name
+		const char* name;
+
+		//< Start time from trace::now()
+		std::uint64_t start;
+	};
+}
+
+#define CAT_TRACE_CONCAT_(a, b) a##b
+#define CAT_TRACE_CONCAT(a, b) CAT_TRACE_CONCAT_(a, b)
+
+/*
+ * Opens a trace zone named by a string literal that lasts until the end
+ * of the enclosing scope.
+ */
+#if defined(CSOVMWARE_TRACE_TRACY)
+#define CAT_TRACE_ZONE(name) ZoneScopedN(name)
+#elif defined(CSOVMWARE_TRACE)
+#define CAT_TRACE_ZONE(name) ::cat::trace_zone CAT_TRACE_CONCAT(cat_trace_zone_, __LINE__){ name }
+#else
+#define CAT_TRACE_ZONE(name) static_cast<void>(0)
+#endif
+
+#endif // ^^^ !_TRACE_H_
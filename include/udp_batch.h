@@ -0,0 +1,102 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+
+
+#pragma once
+#ifndef _UDP_BATCH_H_
+#define _UDP_BATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cat {
+	/* Counters of the batched socket layer */
+	struct udp_batch_stats {
+		std::uint64_t receive_calls = 0;	//< recvmmsg() calls that returned datagrams
+		std::uint64_t received = 0;			//< Datagrams received through them
+		std::uint64_t send_calls = 0;		//< sendmmsg() calls
+		std::uint64_t sent = 0;				//< Datagrams sent through them
+		std::uint64_t segmented = 0;		//< Datagrams sent as UDP GSO segments
+		std::uint64_t dropped = 0;			//< Datagrams the kernel refused
+	};
+
+	/*
+	 * @brief Batched UDP I/O for a host's socket (Linux).
+	 *
+	 * ENet moves every datagram with its own recvmsg()/sendmsg(). Builds
+	 * linked with --wrap for enet_socket_receive, enet_socket_send,
+	 * enet_socket_wait and enet_socket_destroy (CSOVMWARE_UDP_BATCH)
+	 * route an attached socket through this layer instead: receives are
+	 * served from a ring refilled by one recvmmsg() per recv_batch
+	 * datagrams, and sends are staged and leave with one sendmmsg() per
+	 * flush. Consecutive equal-sized datagrams to the same address, such
+	 * as the fragments of a large reliable packet, are coalesced into one
+	 * UDP GSO send where the kernel supports UDP_SEGMENT.
+	 *
+	 * Staged datagrams leave when the stage is full, before the socket is
+	 * waited on or destroyed, and at every flush(); core flushes after
+	 * each poll and send. Sockets that are not attached, and every socket
+	 * in other builds, keep ENet's own path, where all functions here do
+	 * nothing.
+	 *
+	 * A socket is attached to the thread that attaches it, which must be
+	 * the thread driving its host.
+	 */
+	class udp_batch {
+	public:
+		//< Whether this build routes attached sockets through the batched layer
+		static constexpr bool enabled =
+#if defined(CSOVMWARE_UDP_BATCH)
+			true;
+#else
+			false;
+#endif
+
+		//< Datagrams received per recvmmsg() call
+		static constexpr std::size_t recv_batch = 64;
+
+		//< Datagrams staged before a send is forced
+		static constexpr std::size_t send_batch = 64;
+	public:
+		/*
+		 * Routes a host socket through the batched layer.
+		 *
+		 * @param _Socket The host's ENetSocket.
+		 */
+		static void attach(std::intptr_t _Socket);
+
+		/*
+		 * Sends the datagrams staged on the calling thread's sockets.
+		 */
+		static void flush() noexcept;
+
+		/*
+		 * Returns the counters of every attached socket so far.
+		 */
+		[[nodiscard]] static udp_batch_stats stats() noexcept;
+	};
+}
+
+#endif // ^^^ !_UDP_BATCH_H_
@@ -26,40 +26,195 @@
 #ifndef _USERS_H_
 #define _USERS_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <optional>
+#include <span>
 #include <vector>
 #include "const.h"
+#include "core.h"
+#include "packet.h"
+#include "pool.h"
 
 namespace cat {
+	/*
+	 * User IDs are generation-tagged: the low 16 bits index the user slot and
+	 * the high 16 bits count how often that slot has been reused, so a stale
+	 * ID kept past its user's disconnect no longer resolves.
+	 */
+
+	//< Largest capacity: one ENet host holds at most ENET_PROTOCOL_MAXIMUM_PEER_ID peers
+	constexpr std::size_t max_user_capacity = 0xFFF;
+
+	/*
+	 * @brief Get the slot index encoded in a user ID.
+	 *
+	 * Slots are below user_capacity(), so per-user state can live in flat
+	 * arrays indexed by this value.
+	 *
+	 * @param _User The user ID.
+	 * @return The slot index of the user.
+	 */
+	[[nodiscard]] constexpr std::size_t user_slot(const userid_t _User) noexcept {
+		return _User & 0xFFFFu;
+	}
+
+	/*
+	 * @brief Initialize the user table and hook it into the service.
+	 *
+	 * Sizes the table for the given capacity and registers connect and
+	 * disconnect handlers that acquire and release users. The connect
+	 * handler runs before, and the disconnect handler after, every other
+	 * handler, so those can always look their user up. Call it once at
+	 * startup, with the same capacity the host is created with.
+	 *
+	 * @param _Capacity The maximum number of concurrent users.
+	 * @throws std::invalid_argument If the capacity is 0 or exceeds max_user_capacity.
+	 */
+	void setup_user_system(std::size_t _Capacity = MAX_USERS);
+
+	/*
+	 * @brief Get the maximum number of concurrent users.
+	 *
+	 * @return The capacity passed to setup_user_system().
+	 */
+	[[nodiscard]] std::size_t user_capacity() noexcept;
+
 	/*
 	 * @brief Acquire a user ID for a given peer.
 	 *
+	 * Takes a free slot in constant time and records it in the peer's data
+	 * pointer. Acquiring a peer that already has a user returns its ID.
+	 *
+	 * A peer that presented the session token granted to the slot's last
+	 * holder (see Core_enet_connect_session()) gets that slot back, if it is
+	 * still free. The ID carries a new generation, but per-slot state can
+	 * be resumed. Either way the slot is given a new random token, which
+	 * the connect handler grants to the peer.
+	 *
 	 * @param _Peer The peer for which to acquire a user ID.
-	 * @return The acquired user ID, or std::nullopt if acquisition failed.
+	 * @param _Presented The session token the peer presented, all zero for a new session.
+	 * @return The acquired user ID, or std::nullopt if the table is full.
+	 */
+	[[nodiscard]] std::optional<userid_t> acquire_user(const peer_t _Peer, const core::session_token& _Presented = {}) noexcept;
+
+	/*
+	 * @brief Get the user ID of a given peer.
+	 *
+	 * Reads the slot stored in the peer's data pointer, so the lookup is
+	 * constant time and lock-free.
+	 *
+	 * @param _Peer The peer whose user ID is to be retrieved.
+	 * @return The peer's user ID, or std::nullopt if the peer has no user.
 	 */
-	[[nodiscard]] std::optional<userid_t> acquire_user(const peer_t _Peer) noexcept;
+	[[nodiscard]] std::optional<userid_t> find_user(const peer_t _Peer) noexcept;
 
 	/*
 	 * @brief Get the peer associated with a given user ID.
 	 *
 	 * @param _User The user ID whose peer is to be retrieved.
-	 * @return The peer associated with the given user ID, or std::nullopt if not found.
+	 * @return The peer associated with the given user ID, or std::nullopt if
+	 *         not found or the ID is stale.
 	 */
 	[[nodiscard]] std::optional<peer_t> get_peer(const userid_t _User) noexcept;
 
 	/*
-	 * @brief Get a list of all user IDs.
+	 * @brief Get the session token granted to a user.
 	 *
-	 * @return A vector containing all user IDs.
+	 * @param _User The user ID to query.
+	 * @return The token the user must present to resume, or all zero if
+	 *         none could be drawn or the ID is stale.
 	 */
-	[[nodiscard]] std::vector<userid_t> get_users() noexcept;
+	[[nodiscard]] core::session_token user_session(const userid_t _User) noexcept;
+
+	/*
+	 * @brief Check whether a user took over its session's previous slot.
+	 *
+	 * True when the peer presented the session token granted to the
+	 * slot's last holder, also across a server restart with a
+	 * session_store mapped.
+	 * Handlers can then skip the full state download and continue from
+	 * session_state().
+	 *
+	 * @param _User The user ID to query.
+	 * @return true if the user resumed a session, false otherwise or if the ID is stale.
+	 */
+	[[nodiscard]] bool user_resumed(const userid_t _User) noexcept;
+
+	/*
+	 * @brief Get the session state kept for a user across reconnects and restarts.
+	 *
+	 * A block of session_store::state_size bytes in the session snapshot,
+	 * zeroed whenever the slot goes to a new session. Handlers store
+	 * whatever they need to resume the user there; it must be trivially
+	 * copyable and hold no pointers.
+	 *
+	 * @param _User The user ID to query.
+	 * @return The user's state block, or an empty span if no snapshot is
+	 *         mapped or the ID is stale.
+	 */
+	[[nodiscard]] std::span<std::byte> session_state(const userid_t _User) noexcept;
+
+	/*
+	 * @brief Get the IDs of all active users.
+	 *
+	 * Returns a view over the table's dense list of active users, so no
+	 * allocation takes place. The view is invalidated by the next acquire
+	 * or release, and the order changes as users leave; in threaded mode
+	 * only use it while no connect or disconnect is being handled.
+	 *
+	 * @return A view of all active user IDs.
+	 */
+	[[nodiscard]] std::span<const userid_t> get_users() noexcept;
 
 	/*
 	 * @brief Release the user ID associated with a given peer.
 	 *
+	 * Returns the slot to the free list in constant time and clears the
+	 * peer's data pointer.
+	 *
 	 * @param _Peer The peer whose user ID is to be released.
 	 */
 	void release_user(const peer_t _Peer) noexcept;
+
+	/*
+	 * @brief Send a packet to every active user a predicate selects.
+	 *
+	 * The packet is serialized once into a single ENet packet shared by all
+	 * recipients. The predicate receives the user ID, so team, room or
+	 * area-of-interest filters can index per-user state by user_slot().
+	 *
+	 * @tparam _Pkt    The packet type (must be registered in packet_registry).
+	 * @param _Packet  The packet to send.
+	 * @param _Predicate Predicate called with each active user ID; true selects it.
+	 * @param _Exclude A peer to skip regardless of the predicate, typically the sender.
+	 * @return The number of users the packet was queued for.
+	 */
+	template<packet_binder _Pkt, class _Pred>
+	std::size_t broadcast_if(const _Pkt& _Packet, _Pred&& _Predicate, const peer_t _Exclude = nullptr) {
+		static thread_local std::vector<peer_t> targets;
+		targets.clear();
+		for (const userid_t user : get_users()) {
+			const auto peer = get_peer(user);
+			if (peer && *peer != _Exclude && _Predicate(user)) {
+				targets.push_back(*peer);
+			}
+		}
+		return pool_manager::instance().multicast(std::span<const peer_t>(targets), _Packet);
+	}
+
+	/*
+	 * @brief Send a packet to every active user.
+	 *
+	 * @tparam _Pkt    The packet type (must be registered in packet_registry).
+	 * @param _Packet  The packet to send.
+	 * @param _Exclude A peer to skip, typically the sender.
+	 * @return The number of users the packet was queued for.
+	 */
+	template<packet_binder _Pkt>
+	std::size_t broadcast(const _Pkt& _Packet, const peer_t _Exclude = nullptr) {
+		return broadcast_if(_Packet, [](userid_t) { return true; }, _Exclude);
+	}
 }
 
 #endif // ^^^ !_USERS_H_
\ No newline at end of file
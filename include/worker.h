@@ -0,0 +1,161 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+#pragma once
+#ifndef _WORKER_H_
+#define _WORKER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "const.h"
+#include "ring.h"
+#include "service.h"
+
+namespace cat {
+	/* A network event handed from the I/O thread to a worker */
+	struct net_event {
+		enet_service	type;
+		peer_t			peer;
+		pdata_t			data;
+		std::size_t		size;
+		phandle_t		handle;
+	};
+
+	/*
+	 * @brief Worker threads consuming network events off the I/O thread.
+	 *
+	 * In threaded mode the thread that owns the ENet host only receives
+	 * and sends; every decoded event is posted to a worker, which runs the
+	 * OnConnect/OnDisconnect/OnMessage callbacks. Events are routed by an
+	 * affinity key (the peer's slot), so all events of one peer land on the
+	 * same worker and are handled in order. Each worker owns a lock-free
+	 * SPSC ring fed only by the I/O thread.
+	 *
+	 * Workers must not call into ENet directly; replies go through
+	 * pool_manager, which forwards them to the I/O thread.
+	 */
+	class worker_pool {
+	public:
+		//< Capacity of each worker's event ring
+		static constexpr std::size_t queue_capacity = 4096;
+	public:
+		/*
+		 * Constructs a pool of idle workers.
+		 *
+		 * The workers serve the shard of the constructing thread.
+		 *
+		 * @param _Workers Number of worker threads (at least one).
+		 */
+		explicit worker_pool(std::size_t _Workers);
+
+		worker_pool(const worker_pool&) = delete;
+		worker_pool& operator=(const worker_pool&) = delete;
+
+		~worker_pool();
+
+		/*
+		 * Starts the worker threads.
+		 */
+		void start();
+
+		/*
+		 * Stops the worker threads after they have drained their queues.
+		 */
+		void stop();
+
+		/*
+		 * Posts an event to the worker owning an affinity key (I/O thread only).
+		 *
+		 * If the worker's ring is full the I/O thread yields until space is
+		 * available, which backpressures the receive loop.
+		 *
+		 * @param _Key   Affinity key; equal keys always map to the same worker.
+		 * @param _Event The event to deliver.
+		 */
+		void post(std::size_t _Key, const net_event& _Event);
+
+		/*
+		 * Delivers queued events on the calling thread.
+		 *
+		 * For a pool that is never started: the calling thread then acts as
+		 * the pool's worker, e.g. a host application draining network
+		 * events once per frame. Must not race with a started pool.
+		 * Resets the calling thread's tick_arena before returning.
+		 *
+		 * @param _Budget Maximum number of events to deliver.
+		 * @return The number of events delivered.
+		 */
+		std::size_t drain(std::size_t _Budget = std::numeric_limits<std::size_t>::max());
+
+		/*
+		 * Waits until the workers have delivered every event posted so far (I/O thread only).
+		 *
+		 * Meant for a tick boundary, where the I/O thread reads state the
+		 * handlers write, e.g. for state_store::commit(): once it returns,
+		 * every write the handlers made is visible to the caller, and no
+		 * handler runs until the next post(). The I/O thread stalls for as
+		 * long as the workers take to catch up. Returns at once for a pool
+		 * that is not started.
+		 */
+		void quiesce() const;
+
+		/*
+		 * Returns the number of workers.
+		 */
+		[[nodiscard]] std::size_t size() const noexcept {
+			return workers.size();
+		}
+	private:
+		/* Per-worker state */
+		struct worker {
+			spsc_ring<net_event, queue_capacity> queue;
+			alignas(cache_line) std::atomic<std::uint32_t> signal{ 0 };
+			std::uint64_t posted = 0;	//< Events posted, written by the I/O thread only
+			alignas(cache_line) std::atomic<std::uint64_t> delivered{ 0 };
+			std::atomic<bool> sleeping{ false };
+			std::thread thread;
+		};
+
+		/*
+		 * Worker thread body.
+		 */
+		void run(worker& _Worker);
+
+		//< Worker threads and their queues
+		std::vector<std::unique_ptr<worker>> workers;
+
+		//< Cleared to ask the workers to finish
+		std::atomic<bool> running{ false };
+
+		//< Shard whose callbacks the workers run
+		std::size_t shard = 0;
+	};
+}
+
+#endif // ^^^ !_WORKER_H_
@@ -0,0 +1,367 @@
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include "arena.h"
+
+namespace cat {
+	/*
+		Heap upstream of a tick arena that keeps track of how much the
+		arena had to take from it since the last reset.
+	 */
+	class overflow_resource : public std::pmr::memory_resource {
+	public:
+		//< Bytes requested since the last reset
+		std::size_t overflow = 0;
+	private:
+		void* do_allocate(std::size_t _Bytes, std::size_t _Align) override {
+			overflow += _Bytes;
+			return std::pmr::new_delete_resource()->allocate(_Bytes, _Align);
+		}
+
+		void do_deallocate(void* _Ptr, std::size_t _Bytes, std::size_t _Align) override {
+			std::pmr::new_delete_resource()->deallocate(_Ptr, _Bytes, _Align);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& _Other) const noexcept override {
+			return this == &_Other;
+		}
+	};
+
+	/*
+		Tick arena of one thread.
+	 */
+	struct arena_state {
+		//< Preallocated buffer the arena bumps through
+		std::unique_ptr<std::byte[]> buffer;
+
+		//< Size of the buffer
+		std::size_t size = 0;
+
+		//< Where the arena continues once the buffer is used up
+		overflow_resource upstream;
+
+		//< The arena, built on first use
+		std::optional<std::pmr::monotonic_buffer_resource> arena;
+	};
+
+	static thread_local arena_state arena;
+
+	/*
+		(Re)builds the calling thread's arena over a buffer of the given size.
+
+		@param _Size The buffer size; keeps the current buffer if it cannot be allocated.
+	 */
+	static void
+	build_arena(std::size_t _Size) noexcept {
+		arena.arena.reset();
+		if (std::byte* buffer = new (std::nothrow) std::byte[_Size]) {
+			arena.buffer.reset(buffer);
+			arena.size = _Size;
+		}
+		arena.upstream.overflow = 0;
+		arena.arena.emplace(arena.buffer.get(), arena.size, &arena.upstream);
+	}
+
+	/*
+		Returns the calling thread's arena.
+	 */
+	std::pmr::memory_resource*
+	tick_arena::resource() noexcept {
+		if (!arena.arena) {
+			build_arena(initial_size);
+		}
+		return &*arena.arena;
+	}
+
+	/*
+		Releases everything allocated from the calling thread's arena.
+	 */
+	void
+	tick_arena::reset() noexcept {
+		if (!arena.arena) {
+			return;
+		}
+
+		const std::size_t overflow = arena.upstream.overflow;
+		arena.arena->release();
+		arena.upstream.overflow = 0;
+		//
+		// Make room for the whole of this tick next time
+		//
+		if (overflow != 0 && arena.size < max_size) {
+			build_arena(std::min(max_size, std::bit_ceil(arena.size + overflow)));
+		}
+	}
+
+	/*
+		Returns the calling thread's buffer size in bytes.
+	 */
+	std::size_t
+	tick_arena::capacity() noexcept {
+		return arena.size;
+	}
+
+	//< Bytes in front of every block, recording its class; keeps blocks aligned for any scalar
+	static constexpr std::size_t header_size = 16;
+
+	//< Number of size classes, min_block to max_block
+	static constexpr std::size_t class_count = std::bit_width(block_pool::max_block / block_pool::min_block);
+
+	//< Class tag of allocations passed to the heap
+	static constexpr std::uint8_t oversized_class = 0xFF;
+
+	//< Blocks moved between a thread cache and the shared list at once
+	static constexpr std::size_t batch_size = 32;
+
+	//< Blocks a thread caches per class before returning a batch
+	static constexpr std::size_t cache_limit = 2 * batch_size;
+
+	//< Smallest slab carved into blocks
+	static constexpr std::size_t slab_size = 64 * 1024;
+
+	/*
+		A free block, linked through its first bytes.
+	 */
+	struct free_block {
+		free_block* next;
+	};
+
+	/*
+		Free list of one size class shared by all threads.
+	 */
+	struct shared_class {
+		std::mutex lock;
+		free_block* head = nullptr;
+	};
+
+	static std::array<shared_class, class_count> shared;
+
+	static std::atomic<std::uint64_t> reserved{ 0 };
+	static std::atomic<std::uint64_t> oversized{ 0 };
+
+	/*
+		Returns the block size of a class.
+	 */
+	static constexpr std::size_t
+	class_size(std::size_t _Class) noexcept {
+		return block_pool::min_block << _Class;
+	}
+
+	/*
+		Returns the class of the smallest block holding a request with its header.
+	 */
+	static constexpr std::size_t
+	class_of(std::size_t _Total) noexcept {
+		return _Total <= block_pool::min_block ? 0 : std::bit_width((_Total - 1) / block_pool::min_block);
+	}
+
+	/*
+		Per-thread block cache, handed back to the shared lists when the thread ends.
+	 */
+	struct thread_cache {
+		std::array<free_block*, class_count> head{};
+		std::array<std::size_t, class_count> count{};
+		bool alive = true;
+
+		~thread_cache() {
+			for (std::size_t c = 0; c < class_count; ++c) {
+				while (head[c] != nullptr) {
+					free_block* block = head[c];
+					head[c] = block->next;
+					std::lock_guard guard(shared[c].lock);
+					block->next = shared[c].head;
+					shared[c].head = block;
+				}
+			}
+			alive = false;
+		}
+	};
+
+	static thread_local thread_cache cache;
+
+	/*
+		Takes a batch of blocks from the shared list, carving a new slab if it is empty.
+
+		@param _Class The size class.
+		@param _Cache The calling thread's cache, or nullptr to take a single block.
+		@return A block, the rest of the batch in the cache; nullptr if out of memory.
+	 */
+	static free_block*
+	refill(std::size_t _Class, thread_cache* _Cache) noexcept {
+		shared_class& s = shared[_Class];
+		{
+			std::lock_guard guard(s.lock);
+			if (free_block* block = s.head) {
+				s.head = block->next;
+				for (std::size_t i = 1; _Cache != nullptr && i < batch_size && s.head != nullptr; ++i) {
+					free_block* next = s.head;
+					s.head = next->next;
+					next->next = _Cache->head[_Class];
+					_Cache->head[_Class] = next;
+					++_Cache->count[_Class];
+				}
+				return block;
+			}
+		}
+
+		const std::size_t size = class_size(_Class);
+		const std::size_t slab = std::max(slab_size, size * batch_size);
+		auto* base = static_cast<std::byte*>(::operator new(slab, std::nothrow));
+		if (base == nullptr) {
+			return nullptr;
+		}
+		reserved.fetch_add(slab, std::memory_order_relaxed);
+
+		const std::size_t blocks = slab / size;
+		for (std::size_t i = 1; i < blocks; ++i) {
+			auto* block = reinterpret_cast<free_block*>(base + i * size);
+			if (_Cache != nullptr) {
+				block->next = _Cache->head[_Class];
+				_Cache->head[_Class] = block;
+				++_Cache->count[_Class];
+			} else {
+				std::lock_guard guard(s.lock);
+				block->next = s.head;
+				s.head = block;
+			}
+		}
+		return reinterpret_cast<free_block*>(base);
+	}
+
+	/*
+		Allocates a block of at least the given size.
+
+		@param _Size The number of bytes needed.
+		@return The memory, or nullptr if out of memory.
+	 */
+	void*
+	block_pool::allocate(std::size_t _Size) noexcept {
+		if (_Size > max_block - header_size) {
+			auto* raw = static_cast<std::byte*>(std::malloc(_Size + header_size));
+			if (raw == nullptr) {
+				return nullptr;
+			}
+			oversized.fetch_add(1, std::memory_order_relaxed);
+			*reinterpret_cast<std::uint8_t*>(raw) = oversized_class;
+			return raw + header_size;
+		}
+
+		const std::size_t c = class_of(_Size + header_size);
+		free_block* block = nullptr;
+		if (cache.alive && cache.head[c] != nullptr) {
+			block = cache.head[c];
+			cache.head[c] = block->next;
+			--cache.count[c];
+		} else {
+			block = refill(c, cache.alive ? &cache : nullptr);
+			if (block == nullptr) {
+				return nullptr;
+			}
+		}
+
+		auto* raw = reinterpret_cast<std::byte*>(block);
+		*reinterpret_cast<std::uint8_t*>(raw) = static_cast<std::uint8_t>(c);
+		return raw + header_size;
+	}
+
+	/*
+		Returns a block obtained from allocate().
+
+		@param _Block The block, or nullptr.
+	 */
+	void
+	block_pool::deallocate(void* _Block) noexcept {
+		if (_Block == nullptr) {
+			return;
+		}
+
+		std::byte* raw = static_cast<std::byte*>(_Block) - header_size;
+		const std::uint8_t c = *reinterpret_cast<std::uint8_t*>(raw);
+		if (c == oversized_class) {
+			std::free(raw);
+			return;
+		}
+
+		auto* block = reinterpret_cast<free_block*>(raw);
+		if (!cache.alive) {
+			std::lock_guard guard(shared[c].lock);
+			block->next = shared[c].head;
+			shared[c].head = block;
+			return;
+		}
+
+		block->next = cache.head[c];
+		cache.head[c] = block;
+		if (++cache.count[c] <= cache_limit) {
+			return;
+		}
+		//
+		// Hand a batch back, so blocks freed on a thread that does not allocate flow back
+		//
+		free_block* first = cache.head[c];
+		free_block* last = first;
+		for (std::size_t i = 1; i < batch_size; ++i) {
+			last = last->next;
+		}
+		cache.head[c] = last->next;
+		cache.count[c] -= batch_size;
+
+		std::lock_guard guard(shared[c].lock);
+		last->next = shared[c].head;
+		shared[c].head = first;
+	}
+
+	/*
+		The block pool as a memory resource. Over-aligned requests go to the heap.
+	 */
+	class block_resource : public std::pmr::memory_resource {
+	private:
+		void* do_allocate(std::size_t _Bytes, std::size_t _Align) override {
+			if (_Align > header_size) {
+				return std::pmr::new_delete_resource()->allocate(_Bytes, _Align);
+			}
+			void* block = block_pool::allocate(_Bytes);
+			if (block == nullptr) {
+				throw std::bad_alloc();
+			}
+			return block;
+		}
+
+		void do_deallocate(void* _Ptr, std::size_t _Bytes, std::size_t _Align) override {
+			if (_Align > header_size) {
+				std::pmr::new_delete_resource()->deallocate(_Ptr, _Bytes, _Align);
+				return;
+			}
+			block_pool::deallocate(_Ptr);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& _Other) const noexcept override {
+			return this == &_Other;
+		}
+	};
+
+	/*
+		Returns the pool as a memory resource.
+	 */
+	std::pmr::memory_resource*
+	block_pool::resource() noexcept {
+		static block_resource instance;
+		return &instance;
+	}
+
+	/*
+		Returns the pool's counters.
+	 */
+	block_pool_stats
+	block_pool::stats() noexcept {
+		return {
+			reserved.load(std::memory_order_relaxed),
+			oversized.load(std::memory_order_relaxed),
+		};
+	}
+}
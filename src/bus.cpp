@@ -0,0 +1,87 @@
+#include "bus.h"
+
+namespace cat {
+	/*
+		@brief Open the calling shard's mailbox.
+
+		@param _Handler Function receiving the shard's messages.
+		@param _Context Pointer passed back as the handler's first argument.
+	 */
+	void
+	shard_bus::open(handler_fn _Handler, void* _Context) noexcept {
+		mailbox& box = boxes[current_shard()];
+		box.handler = _Handler;
+		box.context = _Context;
+		box.open.store(true, std::memory_order_release);
+	}
+
+	/*
+		@brief Close the calling shard's mailbox.
+	 */
+	void
+	shard_bus::close() noexcept {
+		boxes[current_shard()].open.store(false, std::memory_order_release);
+	}
+
+	/*
+		@brief Post a message to a shard (any thread).
+
+		@param _Shard   The receiving shard.
+		@param _Message The message to post.
+		@return true if the message was queued, false otherwise.
+	 */
+	bool
+	shard_bus::post(std::size_t _Shard, bus_message _Message) noexcept {
+		if (_Shard >= boxes.size()) {
+			return false;
+		}
+
+		mailbox& box = boxes[_Shard];
+		if (!box.open.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		_Message.source = static_cast<std::uint16_t>(current_shard());
+		return box.inbox.push(_Message);
+	}
+
+	/*
+		@brief Post a message to every other open shard.
+
+		@param _Message The message to post.
+		@return The number of shards the message was queued for.
+	 */
+	std::size_t
+	shard_bus::broadcast(const bus_message& _Message) noexcept {
+		const std::size_t self = current_shard();
+		std::size_t sent = 0;
+		for (std::size_t i = 0; i < boxes.size(); ++i) {
+			if (i != self && post(i, _Message)) {
+				++sent;
+			}
+		}
+		return sent;
+	}
+
+	/*
+		@brief Deliver queued messages to the calling shard's handler.
+
+		@param _Budget The maximum number of messages to deliver.
+		@return The number of messages delivered.
+	 */
+	std::size_t
+	shard_bus::dispatch(std::size_t _Budget) noexcept {
+		mailbox& box = boxes[current_shard()];
+		if (box.handler == nullptr) {
+			return 0;
+		}
+
+		std::size_t delivered = 0;
+		bus_message message;
+		while (delivered < _Budget && box.inbox.pop(message)) {
+			box.handler(box.context, message);
+			++delivered;
+		}
+		return delivered;
+	}
+}
@@ -1,18 +1,25 @@
+#include <chrono>
+#include <cstddef>
 #include "callbacks.h"
+#include "metrics.h"
 #include "service.h"
+#include "trace.h"
 
 namespace cat::core {
 	/*
 		Callback invoked when a new peer connects to the server.
 		
 		@param _Peer  A handle representing the connected peer.
+		@param _Data  The session token the peer presented, or nullptr.
+		@param _Size  The size of the token in bytes, or 0.
 	 */
 	void 
-	OnConnect(peer_t _Peer) {
+	OnConnect(peer_t _Peer, pdata_t _Data, std::size_t _Size) {
+		CAT_TRACE_ZONE("OnConnect");
 		//
 		// Call the registered CONNECT callbacks
 		//
-		enet_event event{ _Peer, nullptr, 0 };
+		enet_event event{ _Peer, _Data, _Size, nullptr };
 		service::instance().call(enet_service::enet_connect, event);
 	}
 
@@ -23,10 +30,11 @@ namespace cat::core {
 	 */
 	void 
 	OnDisconnect(peer_t _Peer) {
+		CAT_TRACE_ZONE("OnDisconnect");
 		//
 		// Call the registered DISCONNECT callbacks
 		//
-		enet_event event{ _Peer, nullptr, 0 };
+		enet_event event{ _Peer, nullptr, 0, nullptr };
 		service::instance().call(enet_service::enet_disconnect, event);
 	}
 
@@ -36,13 +44,26 @@ namespace cat::core {
 		@param _Peer  A handle representing the peer that sent the message.
 		@param _Data  A pointer to the received data.
 		@param _Size  The size of the received data in bytes.
+		@param _Handle The packet carrying the data, which a handler may retain.
 	 */
 	void 
-	OnMessage(peer_t _Peer, pdata_t _Data, std::size_t _Size) {
+	OnMessage(peer_t _Peer, pdata_t _Data, std::size_t _Size, phandle_t _Handle) {
+		CAT_TRACE_ZONE("OnMessage");
 		//
 		// Call the registered MESSAGE callbacks
 		//
-		enet_event event{ _Peer, _Data, _Size };
+		if (_Size != 0) {
+			metrics::count_in(std::to_integer<std::uint8_t>(*static_cast<const std::byte*>(_Data)), _Size);
+		}
+
+		enet_event event{ _Peer, _Data, _Size, _Handle };
+		if (!metrics::sample_dispatch()) {
+			service::instance().call(enet_service::enet_message, event);
+			return;
+		}
+
+		const auto start = std::chrono::steady_clock::now();
 		service::instance().call(enet_service::enet_message, event);
+		metrics::record_dispatch(std::chrono::steady_clock::now() - start);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,468 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <enet/enet.h>
+#include "batch.h"
+#include "callbacks.h"
+#include "capture.h"
+#include "core.h"
+#include "pool.h"
+#include "shard.h"
+
+namespace cat {
+	//< Magic bytes opening every capture log
+	static constexpr std::array<std::byte, 8> capture_magic{
+		std::byte{ 'C' }, std::byte{ 'S' }, std::byte{ 'O' }, std::byte{ 'V' },
+		std::byte{ 'C' }, std::byte{ 'A' }, std::byte{ 'P' }, std::byte{ 0 },
+	};
+
+	//< Size of the log header
+	static constexpr std::size_t header_size = 16;
+
+	/*
+		@brief Capture state of one shard.
+
+		@member active Whether records are being taken.
+		@member front Buffer the tick thread appends records to.
+		@member back Buffer handed to the writer, empty while the writer is idle.
+		@member last Time of the previous record.
+		@member file The mapped log, owned by the writer while it runs.
+		@member written Bytes of the log written so far.
+		@member failed Set by the writer when the log could not be grown; no more records are taken.
+		@member stopping Tells the writer to exit once the back buffer is empty.
+		@member lock Guards back and stopping.
+		@member ready Signals the writer that back is full or stopping is set.
+		@member writer Thread copying buffers into the mapped file.
+	 */
+	struct capture_state {
+		bool active = false;
+		std::vector<std::byte> front;
+		std::vector<std::byte> back;
+		std::chrono::steady_clock::time_point last;
+		mapped_file file;
+		std::size_t written = 0;
+		std::atomic<bool> failed{ false };
+		bool stopping = false;
+		std::mutex lock;
+		std::condition_variable ready;
+		std::thread writer;
+	};
+
+	/*
+		@brief Get the calling shard's capture state.
+	 */
+	static capture_state& state() noexcept {
+		return shard_local<capture_state>();
+	}
+
+	/*
+		@brief Append a varint to a buffer.
+	 */
+	static void put_varint(std::vector<std::byte>& _Out, std::uint64_t _Value) {
+		while (_Value >= 0x80) {
+			_Out.push_back(static_cast<std::byte>(_Value | 0x80));
+			_Value >>= 7;
+		}
+		_Out.push_back(static_cast<std::byte>(_Value));
+	}
+
+	/*
+		@brief Read a varint from a byte range.
+
+		@param _Cursor Read position, advanced past the varint.
+		@param _End End of the readable bytes.
+		@param _Value Receives the decoded value.
+		@return false if the range ends inside the varint or it is too long.
+	 */
+	static bool get_varint(const std::byte*& _Cursor, const std::byte* _End, std::uint64_t& _Value) noexcept {
+		_Value = 0;
+		for (unsigned shift = 0; shift < 64; shift += 7) {
+			if (_Cursor == _End) {
+				return false;
+			}
+			const auto byte = std::to_integer<std::uint64_t>(*_Cursor++);
+			if (shift == 63 && byte > 0x01) {
+				return false;
+			}
+			_Value |= (byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/*
+		@brief Copy a buffer to the end of the log, growing the mapping as needed.
+
+		Runs on the writer thread, or on the stopping thread once the writer has exited.
+
+		@param _State The shard's capture state.
+		@param _Bytes The encoded records.
+		@return false if the file could not be grown; the records are lost
+		        and the log must not be written to again.
+	 */
+	static bool write_out(capture_state& _State, const std::vector<std::byte>& _Bytes) noexcept {
+		if (_Bytes.empty()) {
+			return true;
+		}
+
+		const std::size_t need = _State.written + _Bytes.size();
+		if (_State.failed.load(std::memory_order_relaxed)) {
+			return false;
+		}
+		if (need > _State.file.size()) {
+			const std::size_t grown = (need + capture::grow_size - 1) / capture::grow_size * capture::grow_size;
+			if (!_State.file.resize(grown) || _State.file.size() < need) {
+				_State.failed.store(true, std::memory_order_relaxed);
+				return false;
+			}
+		}
+
+		std::memcpy(_State.file.bytes().data() + _State.written, _Bytes.data(), _Bytes.size());
+		_State.file.flush(_State.written, _Bytes.size());
+		_State.written = need;
+		return true;
+	}
+
+	/*
+		@brief Writer thread body: copies handed-off buffers into the log.
+
+		@param _State The shard's capture state.
+	 */
+	static void writer_loop(capture_state& _State) {
+		std::vector<std::byte> chunk;
+		for (;;) {
+			{
+				std::unique_lock guard(_State.lock);
+				_State.ready.wait(guard, [&] { return !_State.back.empty() || _State.stopping; });
+				if (_State.back.empty()) {
+					return;
+				}
+				chunk.swap(_State.back);
+			}
+
+			//
+			// A log that cannot grow is finished; stop() closes it at what was written
+			//
+			if (!write_out(_State, chunk)) {
+				std::lock_guard guard(_State.lock);
+				_State.back.clear();
+				return;
+			}
+			chunk.clear();
+			//
+			// Hand the emptied buffer back so its capacity is reused
+			//
+			std::lock_guard guard(_State.lock);
+			if (_State.back.empty()) {
+				_State.back.swap(chunk);
+			}
+		}
+	}
+
+	/*
+		@brief Start capturing the calling shard's traffic.
+
+		@param _Path The log file to create.
+	 */
+	void
+	capture::start(const std::string& _Path) {
+		capture_state& s = state();
+		if (s.active) {
+			throw std::runtime_error("A capture is already running on this shard.");
+		}
+		if (!s.file.open(_Path, mapped_file::mode::write, grow_size)) {
+			throw std::runtime_error("Failed to create capture file " + _Path + ".");
+		}
+
+		std::memcpy(s.file.bytes().data(), capture_magic.data(), capture_magic.size());
+		const std::uint32_t header[2] = { version, 0 };
+		std::memcpy(s.file.bytes().data() + capture_magic.size(), header, sizeof(header));
+		s.written = header_size;
+		s.failed.store(false, std::memory_order_relaxed);
+
+		s.front.clear();
+		s.front.reserve(swap_size + swap_size / 4);
+		s.back.clear();
+		s.back.reserve(swap_size + swap_size / 4);
+		s.stopping = false;
+		s.last = std::chrono::steady_clock::now();
+		s.writer = std::thread(writer_loop, std::ref(s));
+		s.active = true;
+	}
+
+	/*
+		@brief Stop the calling shard's capture.
+
+		@return The size of the finished log in bytes, or 0 if no capture ran.
+	 */
+	std::size_t
+	capture::stop() {
+		capture_state& s = state();
+		if (!s.active) {
+			return 0;
+		}
+		s.active = false;
+
+		{
+			std::lock_guard guard(s.lock);
+			s.stopping = true;
+		}
+		s.ready.notify_one();
+		s.writer.join();
+		//
+		// The writer is gone; whatever is left is written from here
+		//
+		if (write_out(s, s.back)) {
+			write_out(s, s.front);
+		}
+		s.back.clear();
+		s.front.clear();
+
+		const std::size_t size = s.written;
+		s.file.close(size);
+		s.written = 0;
+		return size;
+	}
+
+	/*
+		@brief Check whether the calling shard is capturing.
+	 */
+	bool
+	capture::active() noexcept {
+		return state().active;
+	}
+
+	/*
+		@brief Check whether the calling shard's capture stopped on a write error.
+	 */
+	bool
+	capture::failed() noexcept {
+		return state().failed.load(std::memory_order_relaxed);
+	}
+
+	/*
+		@brief Append one event to the calling shard's capture.
+
+		@param _Event The kind of event.
+		@param _Slot  The peer's slot within its host.
+		@param _Data  The message bytes, or nullptr.
+		@param _Size  The number of message bytes.
+	 */
+	void
+	capture::record(capture_event _Event, std::uint32_t _Slot, pdata_t _Data, std::size_t _Size) noexcept {
+		capture_state& s = state();
+		if (!s.active || s.failed.load(std::memory_order_relaxed)) {
+			return;
+		}
+
+		const auto now = std::chrono::steady_clock::now();
+		const auto delta = std::chrono::duration_cast<std::chrono::microseconds>(now - s.last).count();
+		//
+		// A capture loses records rather than disturbing the tick when memory runs out
+		//
+		try {
+			put_varint(s.front, static_cast<std::uint64_t>(delta < 0 ? 0 : delta));
+			s.front.push_back(static_cast<std::byte>(_Event));
+			put_varint(s.front, _Slot);
+			if (_Event == capture_event::message) {
+				put_varint(s.front, _Size);
+				const auto* bytes = static_cast<const std::byte*>(_Data);
+				s.front.insert(s.front.end(), bytes, bytes + _Size);
+			}
+		}
+		catch (const std::bad_alloc&) {
+			return;
+		}
+		//
+		// Advance by whole microseconds so rounding does not accumulate
+		//
+		s.last += std::chrono::microseconds(delta < 0 ? 0 : delta);
+
+		if (s.front.size() < swap_size) {
+			return;
+		}
+		//
+		// Hand the buffer to the writer, unless it is still busy with the last one
+		//
+		bool handed = false;
+		{
+			std::lock_guard guard(s.lock);
+			if (s.back.empty()) {
+				s.front.swap(s.back);
+				handed = true;
+			}
+		}
+		if (handed) {
+			s.ready.notify_one();
+		}
+	}
+
+	/*
+		@brief Open a capture log for replay.
+
+		@param _Path The log file.
+	 */
+	replay::replay(const std::string& _Path) {
+		if (!file.open(_Path, mapped_file::mode::read)) {
+			throw std::runtime_error("Failed to open capture file " + _Path + ".");
+		}
+
+		const auto bytes = file.bytes();
+		std::uint32_t header[2] = {};
+		if (bytes.size() >= header_size) {
+			std::memcpy(header, bytes.data() + capture_magic.size(), sizeof(header));
+		}
+		if (bytes.size() < header_size ||
+			!std::equal(capture_magic.begin(), capture_magic.end(), bytes.begin()) ||
+			header[0] != capture::version) {
+			throw std::runtime_error(_Path + " is not a supported capture file.");
+		}
+	}
+
+	/*
+		@brief Release the packets the handlers queued, counting their bytes.
+
+		@return The number of bytes discarded.
+	 */
+	static std::uint64_t discard_sends() {
+		std::uint64_t bytes = 0;
+		auto& res = pool_manager::instance().flush_packets();
+		for (auto& r : res) {
+			ENetPacket* packet = static_cast<ENetPacket*>(r.packet);
+			if (packet == nullptr) {
+				continue;
+			}
+			bytes += packet->dataLength;
+			core::Core_enet_packet_release(packet);
+		}
+		res.clear();
+		return bytes;
+	}
+
+	/*
+		@brief Dispatch every record of the log on the calling shard.
+
+		@param _Speed 0 for as fast as possible, otherwise the pacing factor.
+		@return Counts and timing of the run.
+	 */
+	replay::result
+	replay::run(double _Speed) {
+		using clock = std::chrono::steady_clock;
+
+		result res;
+		//
+		// Stand-in peers, allocated on first use of a slot; pointers must stay stable
+		//
+		std::vector<std::unique_ptr<ENetPeer>> peers;
+		std::vector<bool> connected;
+
+		const auto bytes = file.bytes();
+		const std::byte* cursor = bytes.data() + header_size;
+		const std::byte* const end = bytes.data() + bytes.size();
+
+		const auto start = clock::now();
+		std::uint64_t stamp = 0;
+		while (cursor != end) {
+			std::uint64_t delta = 0, slot = 0, size = 0;
+			if (!get_varint(cursor, end, delta) || cursor == end) {
+				res.truncated = true;
+				break;
+			}
+			const auto event = static_cast<capture_event>(*cursor++);
+			if (!get_varint(cursor, end, slot) || slot > 0xFFFF) {
+				res.truncated = true;
+				break;
+			}
+			if (event == capture_event::message &&
+				(!get_varint(cursor, end, size) || size > static_cast<std::uint64_t>(end - cursor))) {
+				res.truncated = true;
+				break;
+			}
+
+			stamp += delta;
+			if (_Speed > 0) {
+				std::this_thread::sleep_until(start + std::chrono::duration_cast<clock::duration>(
+					std::chrono::duration<double, std::micro>(static_cast<double>(stamp) / _Speed)));
+			}
+
+			if (slot >= peers.size()) {
+				peers.resize(slot + 1);
+				connected.resize(slot + 1);
+			}
+			if (!peers[slot]) {
+				peers[slot] = std::make_unique<ENetPeer>();
+				peers[slot]->incomingPeerID = static_cast<enet_uint16>(slot);
+			}
+			ENetPeer* peer = peers[slot].get();
+
+			switch (event) {
+			case capture_event::connect:
+				connected[slot] = true;
+				core::OnConnect(peer, nullptr, 0);
+				++res.connects;
+				break;
+
+			case capture_event::disconnect:
+				connected[slot] = false;
+				core::OnDisconnect(peer);
+				pool_manager::instance().drop(peer);
+				peer->data = nullptr;
+				++res.disconnects;
+				break;
+
+			case capture_event::message: {
+				//
+				// Copy into a packet like ENet does on receive, so handlers may retain it
+				//
+				ENetPacket* packet = enet_packet_create(cursor, static_cast<std::size_t>(size), 0);
+				cursor += size;
+				if (packet == nullptr) {
+					throw std::bad_alloc();
+				}
+				core::Core_enet_packet_retain(packet);
+				if (packet->dataLength != 0 && packet->data[0] == batch_frame_id) {
+					for_each_batched(packet->data, packet->dataLength, [&](const std::uint8_t* _Data, std::size_t _Size) {
+						core::OnMessage(peer, _Data, _Size, packet);
+					});
+				} else {
+					core::OnMessage(peer, packet->data, packet->dataLength, packet);
+				}
+				core::Core_enet_packet_release(packet);
+				++res.messages;
+				res.bytes_in += size;
+				break;
+			}
+
+			default:
+				res.truncated = true;
+				cursor = end;
+				continue;
+			}
+
+			++res.events;
+			res.bytes_out += discard_sends();
+		}
+		//
+		// Close the connections the log left open
+		//
+		for (std::size_t i = 0; i < peers.size(); ++i) {
+			if (connected[i]) {
+				core::OnDisconnect(peers[i].get());
+				pool_manager::instance().drop(peers[i].get());
+			}
+		}
+		res.bytes_out += discard_sends();
+		res.elapsed = clock::now() - start;
+		return res;
+	}
+}
@@ -0,0 +1,153 @@
+#include <array>
+#include <bit>
+#include <cstring>
+#include "checksum.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#include <nmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CAT_TARGET_SSE42
+#else
+#define CAT_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+#define CAT_CRC32C_SSE42 1
+#else
+#define CAT_CRC32C_SSE42 0
+#endif
+
+namespace cat {
+	//< CRC-32C polynomial, bit-reflected
+	constexpr std::uint32_t crc32c_polynomial = 0x82F63B78u;
+
+	/*
+		Slicing-by-8 tables: table[0] is the bytewise table, table[k]
+		advances a byte's contribution by k further bytes.
+	 */
+	constexpr auto crc32c_table = [] {
+		std::array<std::array<std::uint32_t, 256>, 8> table{};
+		for (std::uint32_t i = 0; i < 256; ++i) {
+			std::uint32_t crc = i;
+			for (int bit = 0; bit < 8; ++bit) {
+				crc = (crc >> 1) ^ ((crc & 1) ? crc32c_polynomial : 0);
+			}
+			table[0][i] = crc;
+		}
+		for (std::size_t k = 1; k < 8; ++k) {
+			for (std::uint32_t i = 0; i < 256; ++i) {
+				table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+			}
+		}
+		return table;
+	}();
+
+	/*
+		Portable CRC-32C over the inverted running value, eight bytes per step.
+	 */
+	static std::uint32_t
+	crc32c_portable(const std::uint8_t* _Data, std::size_t _Size, std::uint32_t _Crc) noexcept {
+		const auto& t = crc32c_table;
+		while (_Size >= 8) {
+			std::uint32_t lo;
+			std::uint32_t hi;
+			std::memcpy(&lo, _Data, 4);
+			std::memcpy(&hi, _Data + 4, 4);
+			if constexpr (std::endian::native == std::endian::big) {
+				lo = std::byteswap(lo);
+				hi = std::byteswap(hi);
+			}
+			lo ^= _Crc;
+			_Crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+				t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+			_Data += 8;
+			_Size -= 8;
+		}
+		while (_Size-- > 0) {
+			_Crc = (_Crc >> 8) ^ t[0][(_Crc ^ *_Data++) & 0xFF];
+		}
+		return _Crc;
+	}
+
+#if CAT_CRC32C_SSE42
+	/*
+		CRC-32C on the SSE4.2 crc32 instruction over the inverted running value.
+
+		x64 consumes eight bytes per instruction, 32-bit x86 four.
+	 */
+	CAT_TARGET_SSE42 static std::uint32_t
+	crc32c_sse42(const std::uint8_t* _Data, std::size_t _Size, std::uint32_t _Crc) noexcept {
+		auto c = _Crc;
+#if defined(_M_X64) || defined(__x86_64__)
+		std::uint64_t crc = c;
+		while (_Size >= 8) {
+			std::uint64_t word;
+			std::memcpy(&word, _Data, 8);
+			crc = _mm_crc32_u64(crc, word);
+			_Data += 8;
+			_Size -= 8;
+		}
+		c = static_cast<std::uint32_t>(crc);
+#endif
+		while (_Size >= 4) {
+			std::uint32_t word;
+			std::memcpy(&word, _Data, 4);
+			c = _mm_crc32_u32(c, word);
+			_Data += 4;
+			_Size -= 4;
+		}
+		while (_Size-- > 0) {
+			c = _mm_crc32_u8(c, *_Data++);
+		}
+		return c;
+	}
+
+	/*
+		Checks the CPU for SSE4.2.
+	 */
+	static bool
+	has_sse42() noexcept {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 20)) != 0;
+#else
+		return __builtin_cpu_supports("sse4.2");
+#endif
+	}
+#endif
+
+	//< Implementation picked for this CPU at startup
+	static const auto crc32c_impl = [] {
+#if CAT_CRC32C_SSE42
+		if (has_sse42()) {
+			return &crc32c_sse42;
+		}
+#endif
+		return &crc32c_portable;
+	}();
+
+	/*
+		Computes the CRC-32C of a buffer.
+
+		@param _Data The bytes to checksum.
+		@param _Size The number of bytes.
+		@param _Crc  The CRC of the preceding bytes, 0 to start.
+		@return The CRC of everything so far.
+	 */
+	std::uint32_t
+	crc32c(const void* _Data, std::size_t _Size, std::uint32_t _Crc) noexcept {
+		return ~crc32c_impl(static_cast<const std::uint8_t*>(_Data), _Size, ~_Crc);
+	}
+
+	/*
+		Returns whether crc32c() runs on the SSE4.2 instruction.
+	 */
+	bool
+	crc32c_accelerated() noexcept {
+#if CAT_CRC32C_SSE42
+		return crc32c_impl == &crc32c_sse42;
+#else
+		return false;
+#endif
+	}
+}
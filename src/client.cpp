@@ -1,14 +1,88 @@
 #include <windows.h>
+#include <exception>
 #include "client.h"
+#include "runtime.h"
 
-static BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved) {
+//
+// Reference on our own module held while the pump runs, so unloading the
+// DLL without Client_runtime_stop() cannot pull the code from under it
+//
+static HMODULE pinned = nullptr;
+
+/*
+ * Starts the networking runtime and connects to a server.
+ *
+ * Must be called from the application thread that calls
+ * Client_runtime_frame(), never from DllMain. The client checksums
+ * its datagrams if the server does, whichever mode it runs.
+ *
+ * @param _Host The server's host name or IP address.
+ * @param _Port The server's port.
+ * @return TRUE if the runtime is running.
+ */
+extern "C" __declspec(dllexport) BOOL Client_runtime_start(const char* _Host, unsigned short _Port) {
+    auto& runtime = cat::client_runtime::instance();
+    if (runtime.running()) {
+        return TRUE;
+    }
+
+    try {
+        runtime.start(_Host, _Port);
+    }
+    catch (const std::exception&) {
+        return FALSE;
+    }
+
+    GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+        reinterpret_cast<LPCWSTR>(&Client_runtime_start), &pinned);
+    return TRUE;
+}
+
+/*
+ * Delivers queued network events and sends the frame's packets.
+ *
+ * Call once per frame on the application thread.
+ *
+ * @return The number of events delivered.
+ */
+extern "C" __declspec(dllexport) unsigned int Client_runtime_frame() {
+    return static_cast<unsigned int>(cat::client_runtime::instance().frame());
+}
+
+/*
+ * Stops the networking runtime and disconnects.
+ *
+ * Must be called before the DLL is unloaded, never from DllMain.
+ */
+extern "C" __declspec(dllexport) void Client_runtime_stop() {
+    cat::client_runtime::instance().stop();
+    if (pinned != nullptr) {
+        //
+        // The caller still holds its own reference, so this never unloads us
+        //
+        HMODULE module = pinned;
+        pinned = nullptr;
+        FreeLibrary(module);
+    }
+}
+
+BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved) {
     switch (fdwReason) {
     case DLL_PROCESS_ATTACH:
+        //
+        // No runtime work under the loader lock; the pump starts from
+        // Client_runtime_start() on the application thread
+        //
+        DisableThreadLibraryCalls(hinstDLL);
         break;
 
     case DLL_PROCESS_DETACH:
+        //
+        // The pin keeps a running pump from reaching here through
+        // FreeLibrary; at process exit its thread is already gone
+        //
         break;
     }
 
     return TRUE;
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #include <print>
 #include <magic_args/magic_args.hpp>
 #include "cli.h"
+#include "dispatcher.h"
 #include "client.h"
 
 int main(int argc, char** argv) {
@@ -8,16 +9,26 @@ int main(int argc, char** argv) {
 	// Parse command-line arguments
 	//
 	const auto args = magic_args::parse<cli::cmd_args>(argc, argv);
+	cat::core::integrity integrity;
+	if (!cli::parse_integrity(args->integrity, integrity)) {
+		std::println("- Unknown integrity mode {}; expected none, crc32c or auto", args->integrity);
+		return 1;
+	}
+	cat::core::Core_enet_set_integrity(integrity);
+	//
+	// Route incoming messages through the typed dispatcher
+	//
+	cat::dispatcher::attach(cat::service::instance());
 	//
 	// Create a server instance listening on localhost:8080
 	//
 	cat::client client(args->host, args->port);
 	std::println("- Client listening on {}", client.ipaddress().c_str());
 	//
-	// Connect the server
+	// Start connecting; flush() completes the handshake and reconnects
 	//
 	client.connect();
-	std::println("- Client connected");
+	std::println("- Client connecting");
 	//
 	// Main server loop
 	//
@@ -0,0 +1,454 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+#include "compress.h"
+#include "packet.h"
+
+namespace cat {
+	//< Shortest match the codec encodes
+	constexpr std::size_t min_match = 4;
+
+	//< Input bytes at the end of a block that are always literals
+	constexpr std::size_t last_literals = 5;
+
+	//< Matches must start this far before the end of the input
+	constexpr std::size_t match_margin = 12;
+
+	//< Longest match distance (two-byte offsets)
+	constexpr std::size_t max_distance = 0xFFFF;
+
+	//< Size of the match finder hash table, as a power of two
+	constexpr unsigned hash_log = 12;
+
+	//< Length of the byte sequences counted by train()
+	constexpr std::size_t train_segment = 8;
+
+	/*
+		Installed dictionary, written only during startup.
+	 */
+	static std::vector<std::byte> dictionary;
+	static std::uint8_t dictionary_id = 0;
+
+	/*
+		Bumped on every set_dictionary() so threads re-prime their encoder.
+	 */
+	static std::atomic<std::uint32_t> dictionary_generation{ 0 };
+
+	/*
+		Counters shared by all threads.
+	 */
+	static struct {
+		std::atomic<std::uint64_t> packed{ 0 };
+		std::atomic<std::uint64_t> skipped{ 0 };
+		std::atomic<std::uint64_t> raw_bytes{ 0 };
+		std::atomic<std::uint64_t> packed_bytes{ 0 };
+		std::atomic<std::uint64_t> pack_ns{ 0 };
+		std::atomic<std::uint64_t> unpacked{ 0 };
+		std::atomic<std::uint64_t> unpack_ns{ 0 };
+		std::atomic<std::uint64_t> failures{ 0 };
+	} counters;
+
+	/*
+		Per-thread encoder state.
+
+		The window holds the dictionary followed by the message, so matches
+		into the dictionary are ordinary backward references. The match
+		table primed with the dictionary is kept and copied per message.
+	 */
+	struct encoder_state {
+		std::uint32_t generation = ~0u;
+		std::vector<std::byte> window;
+		std::vector<std::uint32_t> primed;
+		std::vector<std::uint32_t> table;
+		std::vector<std::byte> block;
+	};
+
+	static std::uint32_t read32(const std::byte* _Ptr) noexcept {
+		std::uint32_t value;
+		std::memcpy(&value, _Ptr, sizeof(value));
+		return value;
+	}
+
+	static std::uint32_t hash32(std::uint32_t _Value) noexcept {
+		return (_Value * 2654435761u) >> (32 - hash_log);
+	}
+
+	/*
+		Writes a length continuation: runs of 255 followed by the remainder.
+	 */
+	static std::byte* write_length(std::byte* _Out, std::size_t _Length) noexcept {
+		for (; _Length >= 255; _Length -= 255) {
+			*_Out++ = std::byte{ 255 };
+		}
+		*_Out++ = static_cast<std::byte>(_Length);
+		return _Out;
+	}
+
+	/*
+		Emits one sequence: a token, its literals and, unless it is the
+		last sequence, the match.
+	 */
+	static std::byte* write_sequence(std::byte* _Out, const std::byte* _Literals, std::size_t _LiteralCount,
+		std::size_t _Offset, std::size_t _MatchLength) noexcept {
+		const std::size_t match = _MatchLength != 0 ? _MatchLength - min_match : 0;
+		std::byte* token = _Out++;
+		*token = static_cast<std::byte>((std::min<std::size_t>(_LiteralCount, 15) << 4) | std::min<std::size_t>(match, 15));
+		if (_LiteralCount >= 15) {
+			_Out = write_length(_Out, _LiteralCount - 15);
+		}
+		std::memcpy(_Out, _Literals, _LiteralCount);
+		_Out += _LiteralCount;
+
+		if (_MatchLength != 0) {
+			*_Out++ = static_cast<std::byte>(_Offset & 0xFF);
+			*_Out++ = static_cast<std::byte>(_Offset >> 8);
+			if (match >= 15) {
+				_Out = write_length(_Out, match - 15);
+			}
+		}
+		return _Out;
+	}
+
+	/*
+		Compresses the window's message part into an LZ4-layout block.
+
+		@param _State The thread's encoder state; window holds dictionary + message.
+		@param _Start Offset of the message within the window.
+		@param _Out   Destination with room for compressor::bound() bytes.
+		@return The size of the block.
+	 */
+	static std::size_t compress_block(encoder_state& _State, std::size_t _Start, std::byte* _Out) noexcept {
+		const std::byte* base = _State.window.data();
+		const std::size_t end = _State.window.size();
+		std::byte* out = _Out;
+		std::size_t anchor = _Start;
+		std::size_t ip = _Start;
+		//
+		// Positions are stored plus one, so zero marks an empty slot
+		//
+		std::uint32_t* table = _State.table.data();
+		if (end - _Start > match_margin) {
+			const std::size_t limit = end - match_margin;
+			const std::size_t match_limit = end - last_literals;
+			while (ip < limit) {
+				const std::uint32_t h = hash32(read32(base + ip));
+				const std::size_t candidate = table[h];
+				table[h] = static_cast<std::uint32_t>(ip + 1);
+
+				if (candidate == 0 || ip - (candidate - 1) > max_distance || read32(base + candidate - 1) != read32(base + ip)) {
+					//
+					// Skip faster through data that does not match
+					//
+					ip += 1 + ((ip - anchor) >> 6);
+					continue;
+				}
+
+				const std::size_t ref = candidate - 1;
+				std::size_t length = min_match;
+				while (ip + length < match_limit && base[ref + length] == base[ip + length]) {
+					++length;
+				}
+
+				out = write_sequence(out, base + anchor, ip - anchor, ip - ref, length);
+				ip += length;
+				anchor = ip;
+				if (ip >= 2 && ip < limit) {
+					table[hash32(read32(base + ip - 2))] = static_cast<std::uint32_t>(ip - 2 + 1);
+				}
+			}
+		}
+
+		out = write_sequence(out, base + anchor, end - anchor, 0, 0);
+		return static_cast<std::size_t>(out - _Out);
+	}
+
+	/*
+		Reads a length continuation.
+	 */
+	static bool read_length(const std::byte*& _In, const std::byte* _End, std::size_t& _Length) noexcept {
+		for (;;) {
+			if (_In == _End) {
+				return false;
+			}
+			const auto byte = std::to_integer<std::size_t>(*_In++);
+			_Length += byte;
+			if (byte != 255) {
+				return true;
+			}
+		}
+	}
+
+	/*
+		Decompresses an LZ4-layout block.
+
+		@param _In   The block.
+		@param _Dict The dictionary the block was compressed with.
+		@param _Out  Destination sized to the original message size.
+		@return true if the block decoded to exactly _Out.size() bytes.
+	 */
+	static bool decompress_block(std::span<const std::byte> _In, std::span<const std::byte> _Dict, std::span<std::byte> _Out) noexcept {
+		const std::byte* in = _In.data();
+		const std::byte* in_end = in + _In.size();
+		std::size_t op = 0;
+		for (;;) {
+			if (in == in_end) {
+				return false;
+			}
+			const auto token = std::to_integer<std::size_t>(*in++);
+
+			std::size_t literals = token >> 4;
+			if (literals == 15 && !read_length(in, in_end, literals)) {
+				return false;
+			}
+			if (literals > static_cast<std::size_t>(in_end - in) || literals > _Out.size() - op) {
+				return false;
+			}
+			std::memcpy(_Out.data() + op, in, literals);
+			in += literals;
+			op += literals;
+
+			if (in == in_end) {
+				//
+				// The last sequence has no match
+				//
+				return op == _Out.size();
+			}
+
+			if (in_end - in < 2) {
+				return false;
+			}
+			const std::size_t offset = std::to_integer<std::size_t>(in[0]) | std::to_integer<std::size_t>(in[1]) << 8;
+			in += 2;
+
+			std::size_t length = token & 15;
+			if (length == 15 && !read_length(in, in_end, length)) {
+				return false;
+			}
+			length += min_match;
+
+			if (offset == 0 || offset > op + _Dict.size() || length > _Out.size() - op) {
+				return false;
+			}
+
+			if (offset > op) {
+				//
+				// The match starts in the dictionary and may continue into the output
+				//
+				const std::size_t back = offset - op;
+				const std::size_t from_dict = std::min(length, back);
+				std::memcpy(_Out.data() + op, _Dict.data() + _Dict.size() - back, from_dict);
+				op += from_dict;
+				length -= from_dict;
+				for (std::size_t i = 0; i < length; ++i, ++op) {
+					_Out[op] = _Out[i];
+				}
+			} else {
+				//
+				// Byte-wise so that overlapping matches repeat their pattern
+				//
+				for (std::size_t src = op - offset; length > 0; --length) {
+					_Out[op++] = _Out[src++];
+				}
+			}
+		}
+	}
+
+	/*
+		Returns the calling thread's encoder, primed with the current dictionary.
+	 */
+	static encoder_state& encoder() {
+		static thread_local encoder_state state;
+		const std::uint32_t generation = dictionary_generation.load(std::memory_order_acquire);
+		if (state.generation != generation) {
+			state.generation = generation;
+			state.primed.assign(std::size_t{ 1 } << hash_log, 0);
+			for (std::size_t i = 0; i + min_match <= dictionary.size(); ++i) {
+				state.primed[hash32(read32(dictionary.data() + i))] = static_cast<std::uint32_t>(i + 1);
+			}
+		}
+		return state;
+	}
+
+	/*
+		Installs the dictionary used by both directions.
+
+		@param _Dictionary The dictionary bytes.
+		@param _Id         Non-zero ID sent with every frame; 0 removes the dictionary.
+		@return true if the dictionary was installed, false if it is too large.
+	 */
+	bool
+	compressor::set_dictionary(std::span<const std::byte> _Dictionary, std::uint8_t _Id) {
+		if (_Dictionary.size() > max_dictionary) {
+			return false;
+		}
+
+		if (_Id == 0) {
+			dictionary.clear();
+		} else {
+			dictionary.assign(_Dictionary.begin(), _Dictionary.end());
+		}
+		dictionary_id = _Id;
+		dictionary_generation.fetch_add(1, std::memory_order_release);
+		return true;
+	}
+
+	/*
+		Builds a dictionary from sample messages.
+
+		@param _Samples  Captured messages.
+		@param _Capacity Size of the dictionary to build.
+		@return The dictionary bytes.
+	 */
+	std::vector<std::byte>
+	compressor::train(std::span<const std::span<const std::byte>> _Samples, std::size_t _Capacity) {
+		_Capacity = std::min(_Capacity, max_dictionary);
+
+		//
+		// Count every segment once per sample, so a sequence repeated inside
+		// one large message does not outweigh one shared by many messages
+		//
+		struct segment {
+			std::uint32_t count = 0;
+			std::uint32_t last_sample = ~0u;
+			const std::byte* data = nullptr;
+		};
+		std::unordered_map<std::uint64_t, segment> segments;
+		for (std::size_t s = 0; s < _Samples.size(); ++s) {
+			const auto sample = _Samples[s];
+			for (std::size_t i = 0; i + train_segment <= sample.size(); ++i) {
+				std::uint64_t key;
+				std::memcpy(&key, sample.data() + i, sizeof(key));
+				segment& seg = segments[key];
+				if (seg.last_sample != s) {
+					seg.last_sample = static_cast<std::uint32_t>(s);
+					seg.data = sample.data() + i;
+					++seg.count;
+				}
+			}
+		}
+
+		std::vector<const segment*> ranked;
+		ranked.reserve(segments.size());
+		for (const auto& [key, seg] : segments) {
+			if (seg.count > 1) {
+				ranked.push_back(&seg);
+			}
+		}
+		std::ranges::sort(ranked, [](const segment* _A, const segment* _B) {
+			return _A->count != _B->count ? _A->count > _B->count
+				: std::memcmp(_A->data, _B->data, train_segment) < 0; });
+
+		//
+		// Fill from the back so the most frequent segments end up closest
+		//
+		const std::size_t count = std::min(ranked.size(), _Capacity / train_segment);
+		std::vector<std::byte> result(count * train_segment);
+		for (std::size_t i = 0; i < count; ++i) {
+			std::memcpy(result.data() + result.size() - (i + 1) * train_segment, ranked[i]->data, train_segment);
+		}
+		return result;
+	}
+
+	/*
+		Compresses a framed message into a compressed frame.
+
+		@param _Frame The framed message (packet ID and body).
+		@param _Out   Receives the compressed frame.
+		@return true if the frame shrank and _Out holds it, false otherwise.
+	 */
+	bool
+	compressor::pack(const ostream& _Frame, ostream& _Out) {
+		const auto start = std::chrono::steady_clock::now();
+		encoder_state& state = encoder();
+
+		const std::size_t size = _Frame.total_size();
+		if (size > max_frame) {
+			counters.skipped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		state.window.resize(dictionary.size() + size);
+		if (!dictionary.empty()) {
+			std::memcpy(state.window.data(), dictionary.data(), dictionary.size());
+		}
+		_Frame.gather(state.window.data() + dictionary.size());
+		state.table = state.primed;
+
+		state.block.resize(bound(size));
+		const std::size_t packed = compress_block(state, dictionary.size(), state.block.data());
+		const std::size_t frame_size = 2 + ostream::max_varint_size + packed;
+
+		const bool shrank = frame_size < size;
+		if (shrank) {
+			_Out.flush();
+			ostream::cursor out = _Out.reserve_write(frame_size);
+			out.write(compressed_frame_id);
+			out.write(dictionary_id);
+			out.write_varint(size);
+			out.write_bytes(state.block.data(), packed);
+			out.commit();
+
+			counters.packed.fetch_add(1, std::memory_order_relaxed);
+			counters.raw_bytes.fetch_add(size, std::memory_order_relaxed);
+			counters.packed_bytes.fetch_add(_Out.size(), std::memory_order_relaxed);
+		} else {
+			counters.skipped.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+		counters.pack_ns.fetch_add(static_cast<std::uint64_t>(elapsed.count()), std::memory_order_relaxed);
+		return shrank;
+	}
+
+	/*
+		Decompresses a compressed frame.
+
+		The claimed size is checked against max_frame before anything is
+		allocated, so a forged frame cannot make the receiver reserve more.
+
+		@param _Stream Stream positioned just after the compressed_frame_id byte.
+		@param _Out    Receives the original framed message.
+		@return true if the frame was decoded, false otherwise.
+	 */
+	bool
+	compressor::unpack(istream& _Stream, std::vector<std::byte>& _Out) {
+		const auto start = std::chrono::steady_clock::now();
+
+		std::uint8_t id;
+		std::size_t size;
+		bool ok = _Stream.read(id) && id == dictionary_id && _Stream.read_varint(size)
+			&& size != 0 && size <= max_frame && size / 255 <= _Stream.remaining();
+		if (ok) {
+			_Out.resize(size);
+			ok = decompress_block(_Stream.unread(), id != 0 ? std::span<const std::byte>(dictionary) : std::span<const std::byte>{}, _Out);
+		}
+
+		if (ok) {
+			counters.unpacked.fetch_add(1, std::memory_order_relaxed);
+		} else {
+			counters.failures.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+		counters.unpack_ns.fetch_add(static_cast<std::uint64_t>(elapsed.count()), std::memory_order_relaxed);
+		return ok;
+	}
+
+	/*
+		Returns the counters accumulated by all threads.
+	 */
+	compression_stats
+	compressor::stats() noexcept {
+		return {
+			counters.packed.load(std::memory_order_relaxed),
+			counters.skipped.load(std::memory_order_relaxed),
+			counters.raw_bytes.load(std::memory_order_relaxed),
+			counters.packed_bytes.load(std::memory_order_relaxed),
+			counters.pack_ns.load(std::memory_order_relaxed),
+			counters.unpacked.load(std::memory_order_relaxed),
+			counters.unpack_ns.load(std::memory_order_relaxed),
+			counters.failures.load(std::memory_order_relaxed),
+		};
+	}
+}
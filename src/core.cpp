@@ -1,46 +1,200 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include <stdexcept>
+#include <string>
+#include <vector>
 #include <enet/enet.h>
+#include "arena.h"
+#include "batch.h"
 #include "core.h"
 #include "callbacks.h"
+#include "capture.h"
+#include "checksum.h"
+#include "limiter.h"
+#include "metrics.h"
+#include "pool.h"
+#include "shard.h"
+#include "trace.h"
+#include "udp_batch.h"
+#include "worker.h"
 
 namespace cat::core {
 	/*
-		Indicates whether the ENet library has been successfully initialized.
-		Prevents redundant initialization and ensures a proper shutdown sequence.
+		Number of shards that have initialized the ENet library.
+		The library is initialized by the first and shut down by the last.
 	 */
-	static bool initialized = false;
+	static std::uint32_t initialized = 0;
 
 	/*
-		Global pointer to the active ENet host instance.
-		Used by both server and client configurations to manage network operations.
-		Set to nullptr when no active host exists.
+		Serializes library initialization between shards.
 	 */
-	static ENetHost* host = nullptr;
+	static std::mutex library_lock;
 
 	/*
-		Global pointer representing the active peer connection.
-		Used on the client side to maintain the connection to a remote ENet server.
+		Handshake timeout of a client probing the server's integrity mode, in milliseconds.
 	 */
-	static ENetPeer* conn = nullptr;
+	constexpr enet_uint32 integrity_probe_timeout = 2000;
 
+	/*
+		Time a server peer has to send its opening session frame.
+	 */
+	constexpr std::chrono::milliseconds session_hello_timeout{ 5000 };
+
+	/*
+		Packets a server peer may send ahead of its opening session frame.
+		A peer sending more is dropped.
+	 */
+	constexpr std::size_t session_hello_backlog = 64;
+
+	//< Size of a session frame: session_frame_id and the token
+	constexpr std::size_t session_frame_size = 1 + sizeof(session_token);
+
+	/*
+		A server peer that has connected but not yet sent its opening session frame.
+		It owns the packets the peer sent ahead of the frame.
+	 */
+	struct pending_hello {
+		ENetPeer* peer;
+		std::chrono::steady_clock::time_point deadline;
+		std::vector<ENetPacket*> early;
+	};
+
+	/*
+		A received message held back by the rate limiter.
+		It holds a reference on its packet until it is dispatched or dropped.
+	 */
+	struct deferred_message {
+		ENetPeer* peer;
+		const std::uint8_t* data;
+		std::size_t size;
+		ENetPacket* packet;
+	};
+
+	/*
+		Per-shard ENet state.
+
+		Each shard (one thread driving one host) owns its context, so a
+		process can serve several hosts side by side.
+	 */
+	struct core_context {
+		//< The shard's ENet host, nullptr when no host exists
+		ENetHost* host = nullptr;
+
+		//< The client's connection to a remote ENet server, set while connecting or connected
+		ENetPeer* conn = nullptr;
+
+		//< Server name the cached remote address was resolved from
+		std::string remote_name;
+
+		//< The client's resolved server address
+		ENetAddress remote{};
+
+		//< Worker pool receiving decoded events in threaded mode, or nullptr
+		worker_pool* workers = nullptr;
+
+		//< Messages deferred by the rate limiter, in arrival order
+		std::vector<deferred_message> deferred;
+
+		//< Messages being retried this tick, swapped with deferred
+		std::vector<deferred_message> retrying;
+
+		//< Session token the server granted the client's server connection
+		session_token session{};
+
+		//< Whether each server peer is yet to send its opening session frame, indexed by its slot
+		std::vector<bool> awaiting;
+
+		//< Server peers yet to send their opening session frame
+		std::vector<pending_hello> pending;
+
+		//< Integrity check requested for the host
+		integrity checking = integrity::none;
+
+		//< Whether automatic integrity mode has found the server's mode
+		bool negotiated = false;
+
+		//< Whether Core_enet_send() packs small messages into batch frames
+		bool batching = true;
+
+		//< Whether the host is a server host, whose peers open with a session frame
+		bool serving = false;
+
+		//< Whether this shard holds a reference on the ENet library
+		bool started = false;
+	};
+
+	/*
+		Returns the calling shard's context.
+	 */
+	static core_context&
+	context() noexcept {
+		return shard_local<core_context>();
+	}
+
+	/*
+		ENet allocator hooks serving packets, commands and peers from the block pool.
+	 */
+	static void*
+	Core_enet_malloc(std::size_t _Size) {
+		return block_pool::allocate(_Size);
+	}
+
+	static void
+	Core_enet_free(void* _Block) {
+		block_pool::deallocate(_Block);
+	}
+
+	/*
+		ENet checksum hook: CRC-32C over the datagram's buffers, in network
+		byte order like enet_crc32(). ENet fills the checksum field with the
+		peer's connection ID first, so datagrams of a stale connection on a
+		reused port fail the check as well.
+	 */
+	static enet_uint32
+	Core_enet_checksum(const ENetBuffer* _Buffers, std::size_t _Count) {
+		std::uint32_t crc = 0;
+		for (std::size_t i = 0; i < _Count; ++i) {
+			crc = crc32c(_Buffers[i].data, _Buffers[i].dataLength, crc);
+		}
+		return ENET_HOST_TO_NET_32(crc);
+	}
+
+	/*
+		Installs the requested checksum hook on the shard's host.
+	 */
+	static void
+	Core_enet_apply_integrity(core_context& _Ctx) noexcept {
+		if (_Ctx.host != nullptr) {
+			_Ctx.host->checksum = (_Ctx.checking != integrity::none) ? &Core_enet_checksum : nullptr;
+		}
+	}
 
 	/*
 		Initializes the ENet library for networking.
 
-		Must be called before any ENet operations.
+		Must be called before any ENet operations. ENet allocates from
+		the block pool from then on.
 	 */
 	void
 	Core_enet_initialize() {
-		if (initialized) {
+		core_context& ctx = context();
+		if (ctx.started) {
 			return;
 		}
 
-		int res = enet_initialize();
-		if (res != 0) {
-			throw std::runtime_error("An error occurred while initializing ENet.");
+		std::lock_guard guard(library_lock);
+		if (initialized == 0) {
+			const ENetCallbacks callbacks{ &Core_enet_malloc, &Core_enet_free, nullptr };
+			int res = enet_initialize_with_callbacks(ENET_VERSION, &callbacks);
+			if (res != 0) {
+				throw std::runtime_error("An error occurred while initializing ENet.");
+			}
 		}
 
-		initialized = true;
+		++initialized;
+		ctx.started = true;
 	}
 
 	/*
@@ -50,17 +204,35 @@ namespace cat::core {
 	 */
 	void
 	Core_enet_deinitialize() {
-		if (host) {
-			enet_host_destroy(host);
-			host = nullptr;
+		core_context& ctx = context();
+		for (const deferred_message& m : ctx.deferred) {
+			Core_enet_packet_release(m.packet);
+		}
+		ctx.deferred.clear();
+		for (const pending_hello& p : ctx.pending) {
+			std::for_each(p.early.begin(), p.early.end(), enet_packet_destroy);
+		}
+		ctx.pending.clear();
+		if (ctx.host) {
+			enet_host_destroy(ctx.host);
+			ctx.host = nullptr;
 		}
 
-		if (initialized) {
-			enet_deinitialize();
-			initialized = false;
+		ctx.conn = nullptr;
+		ctx.remote_name.clear();
+		ctx.negotiated = false;
+		ctx.serving = false;
+		ctx.session = {};
+		ctx.awaiting.clear();
+		if (!ctx.started) {
+			return;
 		}
 
-		conn = nullptr;
+		ctx.started = false;
+		std::lock_guard guard(library_lock);
+		if (--initialized == 0) {
+			enet_deinitialize();
+		}
 	}
 
 	/*
@@ -69,14 +241,16 @@ namespace cat::core {
 		@param _Host The hostname or IP address to bind the server to.
 		@param _Port The port number on which the server will listen for incoming connections.
 		@param _Cltnum The maximum number of clients that can connect to the server.
+		@param _Chnum The number of channels allocated for each peer.
 	 */
 	void 
-	Core_enet_server_create(std::string_view _Host, std::uint32_t _Port, std::uint32_t _Cltnum) {
-		if (!initialized) {
+	Core_enet_server_create(std::string_view _Host, std::uint32_t _Port, std::uint32_t _Cltnum, std::uint32_t _Chnum) {
+		core_context& ctx = context();
+		if (!ctx.started) {
 			throw std::runtime_error("ENet library is not initialized. Call Core_enet_initialize() first.");
 		}
 
-		if (host != nullptr) {
+		if (ctx.host != nullptr) {
 			throw std::runtime_error("An ENet host already exists. Cannot create a new server host.");
 		}
 
@@ -84,15 +258,25 @@ namespace cat::core {
 		enet_address_set_host(&addr, _Host.data());
 		addr.port = _Port;
 
-		host = enet_host_create(&addr, _Cltnum, 1, 0, 0);
-		if (host == nullptr) {
+		ctx.host = enet_host_create(&addr, _Cltnum, _Chnum, 0, 0);
+		if (ctx.host == nullptr) {
 			throw std::runtime_error("An error occurred while trying to create an ENet server host.");
 		}
+		ctx.serving = true;
+		ctx.awaiting.assign(ctx.host->peerCount, false);
+		ctx.pending.clear();
+		Core_enet_apply_integrity(ctx);
+		//
+		// Serve the whole tick's datagrams with a few syscalls where the build supports it
+		//
+		udp_batch::attach(static_cast<std::intptr_t>(ctx.host->socket));
 	}
 
 	/*
 		Kicks a connected peer from the host.
 
+		Calls into ENet, so it runs on the thread driving the host only.
+
 		@param _Peer The peer to be disconnected.
 	 */
 	void
@@ -105,92 +289,909 @@ namespace cat::core {
 		Creates an ENet client host.
 		
 		@param _Chunm The maximum number of channels to be used for communication.
+		@param _Peers The number of connections the host can hold.
 	 */
 	void 
-	Core_enet_client_create(std::uint32_t _Chunm) {
-		if (!initialized) {
+	Core_enet_client_create(std::uint32_t _Chunm, std::uint32_t _Peers) {
+		core_context& ctx = context();
+		if (!ctx.started) {
 			throw std::runtime_error("ENet library is not initialized. Call Core_enet_initialize() first.");
 		}
 
-		if (host != nullptr) {
+		if (ctx.host != nullptr) {
 			throw std::runtime_error("An ENet host already exists. Cannot create a new client host.");
 		}
 
-		host = enet_host_create(nullptr, 1, _Chunm, 0, 0);
-		if (host == nullptr) {
+		ctx.host = enet_host_create(nullptr, _Peers == 0 ? 1 : _Peers, _Chunm, 0, 0);
+		if (ctx.host == nullptr) {
 			throw std::runtime_error("An error occurred while trying to create an ENet client host.");
 		}
+		ctx.serving = false;
+		ctx.session = {};
+		Core_enet_apply_integrity(ctx);
 	}
 
 	/*
-		Connects the ENet client to a remote server.
-		
+		Selects the integrity check of the shard's host.
+
+		@param _Mode The integrity check to use.
+	 */
+	void
+	Core_enet_set_integrity(integrity _Mode) noexcept {
+		core_context& ctx = context();
+		ctx.checking = _Mode;
+		ctx.negotiated = false;
+		if (ctx.host == nullptr || ctx.host->connectedPeers == 0) {
+			Core_enet_apply_integrity(ctx);
+		}
+	}
+
+	/*
+		Returns whether the shard's host checksums its datagrams.
+	 */
+	bool
+	Core_enet_checksummed() noexcept {
+		const core_context& ctx = context();
+		return ctx.host != nullptr && ctx.host->checksum != nullptr;
+	}
+
+	/*
+		Starts a connection from the client host.
+
+		The resolved address is cached, so reconnecting to the same server
+		does not resolve its name again.
+
 		@param _Server The hostname or IP address of the remote server.
 		@param _Port The port number of the remote server.
+		@param _Chnum The number of channels to request from the server.
+		@param _Data Value delivered to the server with the connection request.
+		@return The new peer.
 	 */
-	void 
-	Core_enet_client_connect(std::string_view _Server, std::uint32_t _Port) {
-		if (host == nullptr) {
+	static ENetPeer*
+	Core_enet_client_start(std::string_view _Server, std::uint32_t _Port, std::uint32_t _Chnum, std::uint32_t _Data) {
+		core_context& ctx = context();
+		if (ctx.host == nullptr) {
 			throw std::runtime_error("ENet client host is not created. Call Core_enet_client_create() first.");
 		}
 
-		ENetAddress addr;
-		enet_address_set_host(&addr, _Server.data());
-		addr.port = _Port;
+		if (ctx.remote_name != _Server) {
+			const std::string name(_Server);
+			if (enet_address_set_host(&ctx.remote, name.c_str()) != 0) {
+				throw std::runtime_error("Failed to resolve the ENet server address.");
+			}
+			ctx.remote_name = name;
+		}
+		ctx.remote.port = static_cast<enet_uint16>(_Port);
 
-		conn = enet_host_connect(host, &addr, 1, 0);
-		if (conn == nullptr) {
+		ENetPeer* peer = enet_host_connect(ctx.host, &ctx.remote, _Chnum, _Data);
+		if (peer == nullptr) {
 			throw std::runtime_error("No available peers for initiating an ENet connection.");
 		}
+		return peer;
+	}
 
-		ENetEvent event;
-		int res = enet_host_service(host, &event, 5000);
-		if (res <= 0 || event.type != ENET_EVENT_TYPE_CONNECT) {
-			enet_peer_reset(conn);
-			conn = nullptr;
-			throw std::runtime_error("Connection to ENet server failed or timed out.");
+	/*
+		Starts connecting the ENet client to a remote server.
+
+		Only issues the connection request; the outcome arrives through
+		Core_enet_poll() as a connect or disconnect event.
+
+		@param _Server The hostname or IP address of the remote server.
+		@param _Port The port number of the remote server.
+		@param _Chnum The number of channels to request from the server.
+		@param _Data Value delivered to the server with the connection request.
+	 */
+	void 
+	Core_enet_client_connect(std::string_view _Server, std::uint32_t _Port, std::uint32_t _Chnum, std::uint32_t _Data) {
+		core_context& ctx = context();
+		if (ctx.conn != nullptr) {
+			throw std::runtime_error("The ENet client is already connected or connecting.");
+		}
+
+		ctx.conn = Core_enet_client_start(_Server, _Port, _Chnum, _Data);
+		//
+		// While probing for the server's integrity mode, give up on a mismatch quickly
+		//
+		if (ctx.checking == integrity::automatic && !ctx.negotiated) {
+			enet_peer_timeout(ctx.conn, 0, integrity_probe_timeout, integrity_probe_timeout);
 		}
 	}
 
+	/*
+		Starts an additional connection from the client host.
+
+		@param _Server The hostname or IP address of the remote server.
+		@param _Port The port number of the remote server.
+		@param _Chnum The number of channels to request from the server.
+		@param _Data Value delivered to the server with the connection request.
+		@return The new peer.
+	 */
+	peer_t
+	Core_enet_client_open(std::string_view _Server, std::uint32_t _Port, std::uint32_t _Chnum, std::uint32_t _Data) {
+		return Core_enet_client_start(_Server, _Port, _Chnum, _Data);
+	}
+
 	/*
 		Disconnects the client from its connected server.
 	 */
 	void
 	Core_enet_client_disconnect() {
-		if (conn == nullptr) {
+		core_context& ctx = context();
+		if (ctx.conn == nullptr) {
 			return;
 		}
 
-		enet_peer_disconnect_now(conn, 0);
-		conn = nullptr;
+		pool_manager::instance().drop(ctx.conn);
+		enet_peer_disconnect_now(ctx.conn, 0);
+		ctx.conn = nullptr;
+	}
+
+	/*
+		Returns the peer representing the client's connection to the server.
+
+		@return The server peer while connecting or connected, otherwise nullptr.
+	 */
+	peer_t
+	Core_enet_client_peer() noexcept {
+		core_context& ctx = context();
+		return ctx.conn;
+	}
+
+	/*
+		Returns the session token the server granted the client's server connection.
+
+		@return The token, all zero until the server granted one.
+	 */
+	const session_token&
+	Core_enet_client_session() noexcept {
+		return context().session;
+	}
+
+	/*
+		Returns an atomic view of a packet's reference count.
+
+		In threaded mode workers release packets while the I/O thread
+		takes references on others sharing nothing but the allocator,
+		so every reference count change goes through here, by way of
+		Core_enet_packet_retain() and Core_enet_packet_release() outside core.
+	 */
+	static std::atomic_ref<std::size_t>
+	Core_enet_refs(ENetPacket* _Packet) noexcept {
+		return std::atomic_ref<std::size_t>(_Packet->referenceCount);
+	}
+
+	/*
+		Hands one received message to its handlers.
+
+		Inline the handlers run at once; in threaded mode the message is
+		posted to the worker owning its peer with a reference of its own,
+		which the worker releases after dispatch. The caller keeps its own
+		reference on the packet.
+
+		@param _Ctx The shard's context.
+		@param _Peer The sender.
+		@param _Data The message.
+		@param _Size The message size in bytes.
+		@param _Packet The packet holding the message.
+	 */
+	static void
+	Core_enet_deliver(core_context& _Ctx, ENetPeer* _Peer, const std::uint8_t* _Data, std::size_t _Size, ENetPacket* _Packet) {
+		if (_Ctx.workers != nullptr) {
+			Core_enet_packet_retain(_Packet);
+			_Ctx.workers->post(_Peer->incomingPeerID, { enet_service::enet_message, _Peer, _Data, _Size, _Packet });
+			return;
+		}
+		OnMessage(_Peer, _Data, _Size, _Packet);
+	}
+
+	/*
+		Applies a rate limiter verdict other than accept.
+
+		@param _Ctx The shard's context.
+		@param _Verdict The limiter's verdict.
+		@param _Message The refused message; a deferred one takes a packet reference.
+	 */
+	static void
+	Core_enet_refuse(core_context& _Ctx, admission _Verdict, const deferred_message& _Message) {
+		metrics::count_limited(_Verdict);
+		switch (_Verdict) {
+		case admission::defer:
+			_Ctx.deferred.push_back(_Message);
+			Core_enet_packet_retain(_Message.packet);
+			break;
+
+		case admission::kick:
+			Core_enet_server_kick(_Message.peer);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	/*
+		Passes one received message through the rate limiter.
+
+		@param _Ctx The shard's context.
+		@param _Message The message; the caller holds a reference on its packet.
+	 */
+	static void
+	Core_enet_admit(core_context& _Ctx, const deferred_message& _Message) {
+		const std::uint8_t id = _Message.size != 0 ? _Message.data[0] : 0;
+		if (id == session_frame_id) {
+			//
+			// Only the server's grant on the client's server connection means anything here
+			//
+			if (!_Ctx.serving && _Message.peer == _Ctx.conn && _Message.size == session_frame_size) {
+				std::copy_n(_Message.data + 1, _Ctx.session.size(), _Ctx.session.begin());
+			}
+			return;
+		}
+		const admission verdict = limiter::admit(_Message.peer->incomingPeerID, id);
+		if (verdict == admission::accept) {
+			Core_enet_deliver(_Ctx, _Message.peer, _Message.data, _Message.size, _Message.packet);
+		} else {
+			Core_enet_refuse(_Ctx, verdict, _Message);
+		}
+	}
+
+	/*
+		Retries the messages deferred by earlier ticks, in arrival order.
+
+		@param _Ctx The shard's context.
+	 */
+	static void
+	Core_enet_retry(core_context& _Ctx) {
+		if (_Ctx.deferred.empty()) {
+			return;
+		}
+
+		_Ctx.retrying.swap(_Ctx.deferred);
+		for (const deferred_message& m : _Ctx.retrying) {
+			const std::uint8_t id = m.size != 0 ? m.data[0] : 0;
+			const admission verdict = limiter::retry(m.peer->incomingPeerID, id);
+			if (verdict == admission::defer) {
+				//
+				// Still over budget; the message keeps its reference and its place
+				//
+				_Ctx.deferred.push_back(m);
+				continue;
+			}
+
+			if (verdict == admission::accept) {
+				Core_enet_deliver(_Ctx, m.peer, m.data, m.size, m.packet);
+			} else {
+				Core_enet_refuse(_Ctx, verdict, m);
+			}
+			Core_enet_packet_release(m.packet);
+		}
+		_Ctx.retrying.clear();
+	}
+
+	/*
+		Drops the deferred messages of a peer whose connection changed.
+
+		@param _Ctx The shard's context.
+		@param _Peer The peer.
+	 */
+	static void
+	Core_enet_forget(core_context& _Ctx, ENetPeer* _Peer) noexcept {
+		std::size_t kept = 0;
+		for (const deferred_message& m : _Ctx.deferred) {
+			if (m.peer == _Peer) {
+				Core_enet_packet_release(m.packet);
+			} else {
+				_Ctx.deferred[kept++] = m;
+			}
+		}
+		_Ctx.deferred.resize(kept);
+		limiter::reset(_Peer->incomingPeerID);
+	}
+
+	/*
+		Dispatches the messages of a received packet.
+
+		A batch frame is split into its messages, each admitted on its own.
+		Handlers parse the packet in place; it is destroyed once neither
+		a handler, a worker nor the deferred queue holds a reference.
+
+		@param _Ctx The shard's context.
+		@param _Event The receive event.
+	 */
+	static void
+	Core_enet_receive(core_context& _Ctx, ENetEvent& _Event) {
+		ENetPacket* packet = _Event.packet;
+		Core_enet_packet_retain(packet);
+		if (packet->dataLength != 0 && packet->data[0] == batch_frame_id) {
+			for_each_batched(packet->data, packet->dataLength, [&](const std::uint8_t* _Data, std::size_t _Size) {
+				Core_enet_admit(_Ctx, { _Event.peer, _Data, _Size, packet });
+			});
+		} else {
+			Core_enet_admit(_Ctx, { _Event.peer, packet->data, packet->dataLength, packet });
+		}
+		Core_enet_packet_release(packet);
+	}
+
+	/*
+		Settles or advances the automatic integrity probe on the client's
+		server connection.
+
+		A handshake that completes fixes the mode and restores the default
+		timeouts. One that fails switches the host to the other mode for
+		the next attempt, as long as no other connection depends on it.
+
+		@param _Ctx   The shard's context.
+		@param _Event The event returned by the host.
+	 */
+	static void
+	Core_enet_negotiate(core_context& _Ctx, const ENetEvent& _Event) noexcept {
+		if (_Ctx.checking != integrity::automatic || _Ctx.negotiated || _Event.peer != _Ctx.conn) {
+			return;
+		}
+
+		if (_Event.type == ENET_EVENT_TYPE_CONNECT) {
+			_Ctx.negotiated = true;
+			enet_peer_timeout(_Event.peer, 0, 0, 0);
+		} else if (_Event.type == ENET_EVENT_TYPE_DISCONNECT && _Ctx.host->connectedPeers == 0) {
+			_Ctx.host->checksum = (_Ctx.host->checksum == nullptr) ? &Core_enet_checksum : nullptr;
+		}
+	}
+
+	/*
+		Opens a client connection with the session frame presenting its token.
+
+		Only the client's server connection presents the token granted
+		earlier; other connections start new sessions.
+
+		@param _Ctx  The shard's context.
+		@param _Peer The newly connected peer.
+	 */
+	static void
+	Core_enet_present(core_context& _Ctx, ENetPeer* _Peer) noexcept {
+		std::array<std::uint8_t, session_frame_size> frame{};
+		frame[0] = session_frame_id;
+		if (_Peer == _Ctx.conn) {
+			std::copy(_Ctx.session.begin(), _Ctx.session.end(), frame.begin() + 1);
+		}
+		//
+		// Without the frame the server drops the connection after session_hello_timeout
+		//
+		ENetPacket* packet = enet_packet_create(frame.data(), frame.size(), ENET_PACKET_FLAG_RELIABLE);
+		if (packet != nullptr && enet_peer_send(_Peer, 0, packet) != 0) {
+			enet_packet_destroy(packet);
+		}
+	}
+
+	/*
+		Returns the pending handshake of a server peer.
+
+		@param _Ctx  The shard's context.
+		@param _Peer The peer, which must be awaited.
+		@return The peer's entry in _Ctx.pending.
+	 */
+	static std::vector<pending_hello>::iterator
+	Core_enet_pending(core_context& _Ctx, ENetPeer* _Peer) noexcept {
+		return std::find_if(_Ctx.pending.begin(), _Ctx.pending.end(),
+			[_Peer](const pending_hello& _Pending) { return _Pending.peer == _Peer; });
+	}
+
+	/*
+		Stops waiting for a server peer's opening session frame.
+
+		@param _Ctx  The shard's context.
+		@param _Peer The peer.
+		@return The packets the peer sent ahead of the frame, in arrival order.
+	 */
+	static std::vector<ENetPacket*>
+	Core_enet_settle(core_context& _Ctx, ENetPeer* _Peer) noexcept {
+		_Ctx.awaiting[_Peer->incomingPeerID] = false;
+		std::vector<ENetPacket*> early;
+		const auto it = Core_enet_pending(_Ctx, _Peer);
+		if (it != _Ctx.pending.end()) {
+			early = std::move(it->early);
+			*it = std::move(_Ctx.pending.back());
+			_Ctx.pending.pop_back();
+		}
+		return early;
+	}
+
+	/*
+		Stops waiting for a server peer that will never connect as far as
+		the callbacks know, destroying the packets it sent ahead.
+
+		@param _Ctx  The shard's context.
+		@param _Peer The peer.
+	 */
+	static void
+	Core_enet_abandon(core_context& _Ctx, ENetPeer* _Peer) noexcept {
+		const std::vector<ENetPacket*> early = Core_enet_settle(_Ctx, _Peer);
+		std::for_each(early.begin(), early.end(), enet_packet_destroy);
+	}
+
+	/*
+		Drops the server peers whose opening session frame is overdue.
+
+		@param _Ctx The shard's context.
+	 */
+	static void
+	Core_enet_expire(core_context& _Ctx) noexcept {
+		if (_Ctx.pending.empty()) {
+			return;
+		}
+
+		const auto now = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < _Ctx.pending.size();) {
+			if (_Ctx.pending[i].deadline > now) {
+				++i;
+				continue;
+			}
+
+			ENetPeer* peer = _Ctx.pending[i].peer;
+			Core_enet_abandon(_Ctx, peer);
+			//
+			// The callbacks never saw the peer, so it leaves without an event
+			//
+			enet_peer_disconnect_now(peer, 0);
+		}
+	}
+
+	/*
+		Runs the session handshake of a connection.
+
+		A client opens each connection with its session frame. A server
+		holds the connect event of a peer back until the peer's session
+		frame arrives and hands the frame on as the peer's connect event,
+		whose packet carries the presented token. Whatever the peer sends before it is
+		held back and replayed after the connect event, so no message is
+		lost to the handshake. A malformed frame or too many packets ahead
+		of it drop the peer, and a peer that leaves before it never
+		connected as far as the callbacks know.
+
+		@param _Ctx   The shard's context.
+		@param _Event The event returned by the host, turned into a connect on the session frame.
+		@param _Early Receives the packets to dispatch after a connect event.
+		@return Whether the event is to be dispatched.
+	 */
+	static bool
+	Core_enet_handshake(core_context& _Ctx, ENetEvent& _Event, std::vector<ENetPacket*>& _Early) {
+		if (!_Ctx.serving) {
+			if (_Event.type == ENET_EVENT_TYPE_CONNECT) {
+				Core_enet_present(_Ctx, _Event.peer);
+			}
+			return true;
+		}
+
+		const std::size_t slot = _Event.peer->incomingPeerID;
+		switch (_Event.type) {
+		case ENET_EVENT_TYPE_CONNECT:
+			_Ctx.awaiting[slot] = true;
+			_Ctx.pending.push_back({ _Event.peer, std::chrono::steady_clock::now() + session_hello_timeout, {} });
+			return false;
+
+		case ENET_EVENT_TYPE_DISCONNECT:
+			if (!_Ctx.awaiting[slot]) {
+				return true;
+			}
+			Core_enet_abandon(_Ctx, _Event.peer);
+			return false;
+
+		case ENET_EVENT_TYPE_RECEIVE: {
+			if (!_Ctx.awaiting[slot]) {
+				return true;
+			}
+
+			ENetPacket* packet = _Event.packet;
+			_Event.packet = nullptr;
+			if (packet->dataLength == 0 || packet->data[0] != session_frame_id) {
+				const auto it = Core_enet_pending(_Ctx, _Event.peer);
+				if (it->early.size() < session_hello_backlog) {
+					it->early.push_back(packet);
+					return false;
+				}
+				enet_packet_destroy(packet);
+				Core_enet_abandon(_Ctx, _Event.peer);
+				enet_peer_disconnect_now(_Event.peer, 0);
+				return false;
+			}
+
+			if (packet->dataLength != session_frame_size) {
+				enet_packet_destroy(packet);
+				Core_enet_abandon(_Ctx, _Event.peer);
+				enet_peer_disconnect_now(_Event.peer, 0);
+				return false;
+			}
+			_Early = Core_enet_settle(_Ctx, _Event.peer);
+			_Event.type = ENET_EVENT_TYPE_CONNECT;
+			_Event.packet = packet;
+			return true;
+		}
+
+		default:
+			return true;
+		}
+	}
+
+	/*
+		Hands a single ENet event to the worker owning its peer.
+
+		The callbacks run on the worker, which also retires the peer's
+		queued sends and clears its data after the disconnect handlers,
+		so replies to messages still in its queue are discarded as well.
+		Deferred messages are dropped here, as they were never posted.
+		Received packets are retained until the worker has dispatched them.
+
+		@param _Event The event returned by the host.
+	 */
+	static void
+	Core_enet_post(ENetEvent& _Event) {
+		core_context& ctx = context();
+		const std::size_t key = _Event.peer->incomingPeerID;
+		switch (_Event.type) {
+		case ENET_EVENT_TYPE_CONNECT: {
+			Core_enet_forget(ctx, _Event.peer);
+			//
+			// The token travels with the event; the worker releases the frame
+			//
+			ENetPacket* frame = _Event.packet;
+			if (frame == nullptr) {
+				ctx.workers->post(key, { enet_service::enet_connect, _Event.peer, nullptr, 0, nullptr });
+				break;
+			}
+			Core_enet_packet_retain(frame);
+			ctx.workers->post(key, { enet_service::enet_connect, _Event.peer, frame->data + 1, sizeof(session_token), frame });
+			break;
+		}
+
+		case ENET_EVENT_TYPE_DISCONNECT:
+			if (_Event.peer == ctx.conn) {
+				ctx.conn = nullptr;
+			}
+			Core_enet_forget(ctx, _Event.peer);
+			ctx.workers->post(key, { enet_service::enet_disconnect, _Event.peer, nullptr, 0, nullptr });
+			break;
+
+		case ENET_EVENT_TYPE_RECEIVE:
+			Core_enet_receive(ctx, _Event);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	/*
+		Appends an ENet event to the shard's traffic capture.
+
+		@param _Event The event returned by the host.
+	 */
+	static void
+	Core_enet_capture(const ENetEvent& _Event) noexcept {
+		const std::uint32_t slot = _Event.peer->incomingPeerID;
+		switch (_Event.type) {
+		case ENET_EVENT_TYPE_CONNECT:
+			capture::record(capture_event::connect, slot);
+			break;
+
+		case ENET_EVENT_TYPE_DISCONNECT:
+			capture::record(capture_event::disconnect, slot);
+			break;
+
+		case ENET_EVENT_TYPE_RECEIVE:
+			capture::record(capture_event::message, slot, _Event.packet->data, _Event.packet->dataLength);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	/*
+		Hands a single ENet event past the handshake to the matching callback.
+
+		@param _Ctx   The shard's context.
+		@param _Event The event.
+	 */
+	static void
+	Core_enet_handle(core_context& _Ctx, ENetEvent& _Event) {
+		if (capture::active()) {
+			Core_enet_capture(_Event);
+		}
+		if (_Ctx.workers != nullptr) {
+			Core_enet_post(_Event);
+			return;
+		}
+
+		switch (_Event.type) {
+		case ENET_EVENT_TYPE_CONNECT:
+			Core_enet_forget(_Ctx, _Event.peer);
+			if (ENetPacket* frame = _Event.packet) {
+				OnConnect(_Event.peer, frame->data + 1, sizeof(session_token));
+				enet_packet_destroy(frame);
+			} else {
+				OnConnect(_Event.peer, nullptr, 0);
+			}
+			break;
+
+		case ENET_EVENT_TYPE_DISCONNECT:
+			//
+			// The client's server connection ended or the attempt failed
+			//
+			if (_Event.peer == _Ctx.conn) {
+				_Ctx.conn = nullptr;
+			}
+			OnDisconnect(_Event.peer);
+			pool_manager::instance().drop(_Event.peer);
+			Core_enet_forget(_Ctx, _Event.peer);
+			_Event.peer->data = nullptr;
+			break;
+
+		case ENET_EVENT_TYPE_RECEIVE:
+			Core_enet_receive(_Ctx, _Event);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	/*
+		Dispatches a single ENet event to the matching callback.
+
+		@param _Event The event returned by the host.
+	 */
+	static void
+	Core_enet_dispatch(ENetEvent& _Event) {
+		core_context& ctx = context();
+		Core_enet_negotiate(ctx, _Event);
+		std::vector<ENetPacket*> early;
+		if (!Core_enet_handshake(ctx, _Event, early)) {
+			return;
+		}
+
+		Core_enet_handle(ctx, _Event);
+		//
+		// Messages that overtook the session frame follow the connect event
+		//
+		for (ENetPacket* packet : early) {
+			ENetEvent message{};
+			message.type = ENET_EVENT_TYPE_RECEIVE;
+			message.peer = _Event.peer;
+			message.packet = packet;
+			Core_enet_handle(ctx, message);
+		}
 	}
 
 	/*
 		Polls for incoming network events such as connections,
 		disconnections, and data packets.
 		
-		This function blocks for a specified duration while waiting
-		for events, then returns control to the caller.
+		Waits up to `_Timeout` milliseconds for the first event, then keeps
+		draining without blocking until no event is left or `_Budget` events
+		have been dispatched. Events beyond the budget stay queued in ENet
+		for the next call.
+
+		Messages the rate limiter deferred are retried first, with the
+		peers' buckets refilled.
+
+		@param _Timeout Maximum time to wait for the first event, in milliseconds.
+		@param _Budget  Maximum number of events to dispatch.
+		@return The number of events dispatched.
 	 */
-	void Core_enet_poll() {
+	std::size_t
+	Core_enet_poll(std::uint32_t _Timeout, std::size_t _Budget) {
+		core_context& ctx = context();
+		if (ctx.host == nullptr || _Budget == 0) {
+			return 0;
+		}
+
+		CAT_TRACE_ZONE("Core_enet_poll");
+
+		limiter::begin_tick();
+		Core_enet_retry(ctx);
+		Core_enet_expire(ctx);
+
+		std::size_t count = 0;
 		ENetEvent event;
-		while (enet_host_service(host, &event, 1000) > 0) {
-			switch (event.type) {
-			case ENET_EVENT_TYPE_CONNECT:
-				OnConnect(event.peer);
+		int res = enet_host_service(ctx.host, &event, _Timeout);
+		while (res > 0) {
+			Core_enet_dispatch(event);
+			if (++count == _Budget) {
 				break;
+			}
+			res = enet_host_service(ctx.host, &event, 0);
+		}
+		//
+		// Acknowledgements ENet queued while servicing leave now
+		//
+		udp_batch::flush();
+		return count;
+	}
 
-			case ENET_EVENT_TYPE_DISCONNECT:
-				OnDisconnect(event.peer);
-				event.peer->data = nullptr;
-				break;
+	/*
+		Switches event dispatch between inline and threaded mode.
 
-			case ENET_EVENT_TYPE_RECEIVE:
-				OnMessage(event.peer, event.packet->data, event.packet->dataLength);
-				enet_packet_destroy(event.packet);
-				break;
+		@param _Pool The worker pool to hand events to, or nullptr for inline dispatch.
+	 */
+	void
+	Core_enet_attach_workers(worker_pool* _Pool) noexcept {
+		core_context& ctx = context();
+		ctx.workers = _Pool;
+		pool_manager::instance().set_concurrent(_Pool != nullptr);
+	}
+
+	/*
+		Enables or disables batching of outgoing messages.
+
+		@param _Enabled Whether to build batch frames.
+	 */
+	void
+	Core_enet_set_batching(bool _Enabled) noexcept {
+		core_context& ctx = context();
+		ctx.batching = _Enabled;
+	}
+
+	/*
+		Returns the application data attached to a peer.
+
+		@param _Peer The peer to query.
+		@return The pointer last stored with Core_enet_peer_set_data(), or nullptr.
+	 */
+	void*
+	Core_enet_peer_data(peer_t _Peer) noexcept {
+		return static_cast<ENetPeer*>(_Peer)->data;
+	}
+
+	/*
+		Attaches application data to a peer.
+
+		@param _Peer The peer to update.
+		@param _Data The pointer to store.
+	 */
+	void
+	Core_enet_peer_set_data(peer_t _Peer, void* _Data) noexcept {
+		static_cast<ENetPeer*>(_Peer)->data = _Data;
+	}
+
+	/*
+		Reads the connection quality of the host's connected peers.
+
+		@param _Out Receives one entry per connected peer, as far as it has room.
+		@return The number of connected peers.
+	 */
+	std::size_t
+	Core_enet_peer_stats(std::span<peer_stats> _Out) noexcept {
+		core_context& ctx = context();
+		if (ctx.host == nullptr) {
+			return 0;
+		}
+
+		std::size_t count = 0;
+		for (std::size_t i = 0; i < ctx.host->peerCount; ++i) {
+			const ENetPeer& peer = ctx.host->peers[i];
+			if (peer.state != ENET_PEER_STATE_CONNECTED) {
+				continue;
 			}
+			if (count < _Out.size()) {
+				_Out[count] = { peer.incomingPeerID, peer.roundTripTime, peer.roundTripTimeVariance,
+					peer.packetLoss, peer.reliableDataInTransit };
+			}
+			++count;
 		}
+		return count;
+	}
+
+	/*
+		Returns the value a peer sent with its connection request.
+
+		@param _Peer The peer to query.
+		@return The connect data, or 0 if none was sent.
+	 */
+	std::uint32_t
+	Core_enet_peer_connect_data(peer_t _Peer) noexcept {
+		return static_cast<ENetPeer*>(_Peer)->eventData;
+	}
+
+	/*
+		Reads the session token a peer presented from its connect event.
+
+		Connect events of client connections and of a capture replay carry
+		no token.
+
+		@param _Data The connect event's data.
+		@param _Size The connect event's size.
+		@return The presented token, all zero for a new session.
+	 */
+	session_token
+	Core_enet_connect_session(pdata_t _Data, std::size_t _Size) noexcept {
+		session_token token{};
+		if (_Data != nullptr && _Size == token.size()) {
+			const auto* bytes = static_cast<const std::uint8_t*>(_Data);
+			std::copy_n(bytes, token.size(), token.begin());
+		}
+		return token;
+	}
+
+	/*
+		Queues the session frame granting a peer its session token.
+
+		@param _Peer  The peer to grant the token to.
+		@param _Token The token the peer must present to resume its session.
+		@return true if the frame was queued, false otherwise.
+	 */
+	bool
+	Core_enet_peer_grant(peer_t _Peer, const session_token& _Token) {
+		std::array<std::uint8_t, session_frame_size> frame;
+		frame[0] = session_frame_id;
+		std::copy(_Token.begin(), _Token.end(), frame.begin() + 1);
+		return pool_manager::instance().push(_Peer, frame.data(), frame.size(), 0, pool_flags::reliable);
+	}
+
+	/*
+		Keeps a received packet alive beyond its OnMessage() dispatch.
+
+		@param _Handle The packet handle passed to OnMessage().
+		@param _Count  The number of references to take.
+	 */
+	void
+	Core_enet_packet_retain(phandle_t _Handle, std::size_t _Count) noexcept {
+		Core_enet_refs(static_cast<ENetPacket*>(_Handle)).fetch_add(_Count, std::memory_order_relaxed);
+	}
+
+	/*
+		Releases a packet previously kept alive by Core_enet_packet_retain().
+
+		@param _Handle The retained packet handle.
+	 */
+	void
+	Core_enet_packet_release(phandle_t _Handle) noexcept {
+		ENetPacket* packet = static_cast<ENetPacket*>(_Handle);
+		if (Core_enet_refs(packet).fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			enet_packet_destroy(packet);
+		}
+	}
+
+	/*
+		Counts the ENet commands queued for a peer, up to a limit.
+
+		@param _Peer The peer to inspect.
+		@param _Limit The count at which to stop walking the queues.
+		@return The number of queued commands, at most _Limit.
+	 */
+	static std::size_t
+	Core_enet_backlog(ENetPeer* _Peer, std::size_t _Limit) noexcept {
+		std::size_t count = 0;
+		for (ENetList* list : { &_Peer->outgoingCommands, &_Peer->outgoingSendReliableCommands }) {
+			for (ENetListIterator it = enet_list_begin(list); it != enet_list_end(list) && count < _Limit; it = enet_list_next(it)) {
+				++count;
+			}
+		}
+		return count;
+	}
+
+	/*
+		Returns whether a peer's send queue has reached the backlog limit.
+
+		@param _Peer The peer to inspect.
+		@return Whether unreliable sends to the peer are being shed.
+	 */
+	bool
+	Core_enet_peer_backlogged(peer_t _Peer) noexcept {
+		const std::size_t limit = limiter::limits().max_backlog;
+		return limit != 0 && Core_enet_backlog(static_cast<ENetPeer*>(_Peer), limit) >= limit;
+	}
+
+	/*
+		Returns whether a queued packet is also queued for or sent to other peers.
+
+		Such a packet, e.g. from pool_manager::multicast(), goes out as is:
+		ENet sends the one packet to every recipient, where batching would
+		copy it into each peer's batch frame.
+
+		@param _Packet The queued packet.
+	 */
+	static bool
+	Core_enet_shared(ENetPacket* _Packet) noexcept {
+		return Core_enet_refs(_Packet).load(std::memory_order_relaxed) > 1;
 	}
 
 	/*
@@ -200,13 +1201,97 @@ namespace cat::core {
 		for both server and client hosts.
 	 */
 	void Core_enet_send() {
-		/*auto res = pool_manager::instance().flush_packets();
-		for (auto& r : res) {
-			ENetPacket* packet = enet_packet_create(r.data.data(), r.data.size(), r.flags);
-			int send_res = enet_peer_send(r.peer, r.channel, packet);
-			if (send_res < 0) {
-				enet_packet_destroy(packet);
+		core_context& ctx = context();
+		if (ctx.host == nullptr) {
+			return;
+		}
+
+		CAT_TRACE_ZONE("Core_enet_send");
+
+		auto& res = pool_manager::instance().flush_packets();
+		const bool shedding = limiter::limits().max_backlog != 0;
+		void* checked = nullptr;
+		bool backlogged = false;
+		for (std::size_t i = 0; i < res.size();) {
+			ENetPacket* packet = static_cast<ENetPacket*>(res[i].packet);
+			if (packet == nullptr) {
+				//
+				// A kick queued by pool_manager::kick(); what was sent before it still leaves
+				//
+				enet_peer_disconnect_later(static_cast<ENetPeer*>(res[i].peer), 0);
+				++i;
+				continue;
+			}
+			if (shedding && !(packet->flags & ENET_PACKET_FLAG_RELIABLE)) {
+				//
+				// A peer that cannot keep up loses its unreliable traffic first;
+				// its queue is only walked once per run of sends
+				//
+				if (res[i].peer != checked) {
+					checked = res[i].peer;
+					backlogged = Core_enet_peer_backlogged(checked);
+				}
+				if (backlogged) {
+					metrics::count_shed();
+					Core_enet_packet_release(packet);
+					++i;
+					continue;
+				}
 			}
-		}*/
+			if (packet->dataLength != 0) {
+				metrics::count_out(packet->data[0], packet->dataLength);
+			}
+			//
+			// Gather the run of small messages queued for the same peer,
+			// channel and delivery flags that fits into one batch frame
+			//
+			std::size_t end = i + 1;
+			std::size_t frame = 1 + batch_record_size(packet->dataLength);
+			if (ctx.batching && batchable(packet->data, packet->dataLength) && !Core_enet_shared(packet)) {
+				while (end < res.size() && res[end].peer == res[i].peer && res[end].channel == res[i].channel) {
+					ENetPacket* next = static_cast<ENetPacket*>(res[end].packet);
+					if (next == nullptr || next->flags != packet->flags || !batchable(next->data, next->dataLength) || Core_enet_shared(next) ||
+						frame + batch_record_size(next->dataLength) > batch_limit) {
+						break;
+					}
+					metrics::count_out(next->data[0], next->dataLength);
+					frame += batch_record_size(next->dataLength);
+					++end;
+				}
+			}
+
+			ENetPacket* batch = end - i > 1 ? enet_packet_create(nullptr, frame, packet->flags) : nullptr;
+			if (batch == nullptr) {
+				//
+				// A lone message, or no memory for the frame: send the messages as they are
+				//
+				for (std::size_t k = i; k < end; ++k) {
+					packet = static_cast<ENetPacket*>(res[k].packet);
+					enet_peer_send(static_cast<ENetPeer*>(res[k].peer), res[k].channel, packet);
+					//
+					// Release the queue's reference; ENet holds its own on success
+					//
+					Core_enet_packet_release(packet);
+				}
+			} else {
+				std::uint8_t* out = batch->data;
+				*out++ = batch_frame_id;
+				for (std::size_t k = i; k < end; ++k) {
+					packet = static_cast<ENetPacket*>(res[k].packet);
+					out = batch_append(out, packet->data, packet->dataLength);
+					Core_enet_packet_release(packet);
+				}
+				if (enet_peer_send(static_cast<ENetPeer*>(res[i].peer), res[i].channel, batch) != 0) {
+					enet_packet_destroy(batch);
+				}
+			}
+			i = end;
+		}
+		res.clear();
+		//
+		// One flush per tick so all queued sends leave in a single burst
+		//
+		enet_host_flush(ctx.host);
+		udp_batch::flush();
 	}
 }
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "limiter.h"
+#include "packet.h"
+#include "shard.h"
+
+namespace cat {
+	/*
+		@brief Rate limiter state of one peer slot.
+
+		@member tokens Tokens left in the bucket.
+		@member handled Messages admitted during the current tick.
+		@member deferred Messages waiting in core's deferred queue.
+		@member blocked Whether a message was deferred this tick, so later ones must wait behind it.
+		@member kicked Whether the peer was kicked; its remaining messages are dropped.
+	 */
+	struct peer_bucket {
+		double tokens = 0;
+		std::uint32_t handled = 0;
+		std::uint32_t deferred = 0;
+		bool blocked = false;
+		bool kicked = false;
+	};
+
+	/*
+		@brief Rate limiter of one shard.
+
+		@member limits The configured limits.
+		@member peers State per peer slot.
+		@member last Time of the previous refill.
+		@member enabled Whether a receive limit is set.
+	 */
+	struct limiter_state {
+		rate_limit limits;
+		std::vector<peer_bucket> peers;
+		std::chrono::steady_clock::time_point last;
+		bool enabled = false;
+	};
+
+	/*
+		@brief Get the calling shard's limiter state.
+	 */
+	static limiter_state& state() noexcept {
+		return shard_local<limiter_state>();
+	}
+
+	/*
+		@brief Get the bucket capacity of the configured limits.
+	 */
+	static double capacity(const rate_limit& _Limits) noexcept {
+		return static_cast<double>(_Limits.burst != 0 ? _Limits.burst : _Limits.rate);
+	}
+
+	/*
+		@brief Apply the overflow policy to a message its sender has no budget for.
+
+		@param _State The shard's limiter state.
+		@param _Peer The sender's bucket.
+		@return The verdict.
+	 */
+	static admission overflow(const limiter_state& _State, peer_bucket& _Peer) noexcept {
+		switch (_State.limits.policy) {
+		case overflow_policy::kick:
+			_Peer.kicked = true;
+			return admission::kick;
+
+		case overflow_policy::defer:
+			if (_Peer.deferred < _State.limits.max_deferred) {
+				++_Peer.deferred;
+				_Peer.blocked = true;
+				return admission::defer;
+			}
+			//
+			// Too much is waiting already; the backlog is shed
+			//
+			return admission::drop;
+
+		default:
+			return admission::drop;
+		}
+	}
+
+	/*
+		@brief Charge a message to its sender, or apply the overflow policy.
+
+		@param _State The shard's limiter state.
+		@param _Peer The sender's bucket.
+		@param _Id The message's packet ID.
+		@return The verdict.
+	 */
+	static admission charge(limiter_state& _State, peer_bucket& _Peer, std::uint8_t _Id) noexcept {
+		const rate_limit& limits = _State.limits;
+		if (limits.per_tick != 0 && _Peer.handled >= limits.per_tick) {
+			return overflow(_State, _Peer);
+		}
+
+		const double cost = packet_registry::qos(_Id).cost;
+		if (limits.rate != 0) {
+			if (_Peer.tokens < cost) {
+				return overflow(_State, _Peer);
+			}
+			_Peer.tokens -= cost;
+		}
+		++_Peer.handled;
+		return admission::accept;
+	}
+
+	/*
+		@brief Set the limits and size the per-peer state.
+
+		@param _Limits The limits to apply.
+		@param _Peers  The number of peer slots of the shard's host.
+	 */
+	void
+	limiter::configure(const rate_limit& _Limits, std::size_t _Peers) {
+		limiter_state& s = state();
+		s.limits = _Limits;
+		s.enabled = _Limits.rate != 0 || _Limits.per_tick != 0;
+
+		peer_bucket fresh;
+		fresh.tokens = capacity(_Limits);
+		s.peers.assign(_Peers, fresh);
+		s.last = std::chrono::steady_clock::now();
+	}
+
+	/*
+		@brief Get the calling shard's limits.
+	 */
+	const rate_limit&
+	limiter::limits() noexcept {
+		return state().limits;
+	}
+
+	/*
+		@brief Check whether any receive limit is set.
+	 */
+	bool
+	limiter::enabled() noexcept {
+		return state().enabled;
+	}
+
+	/*
+		@brief Refill the buckets and restart the per-tick allowances.
+	 */
+	void
+	limiter::begin_tick() noexcept {
+		limiter_state& s = state();
+		if (!s.enabled) {
+			return;
+		}
+
+		const auto now = std::chrono::steady_clock::now();
+		const double refill = std::chrono::duration<double>(now - s.last).count() * s.limits.rate;
+		const double cap = capacity(s.limits);
+		s.last = now;
+		for (peer_bucket& p : s.peers) {
+			p.tokens = std::min(cap, p.tokens + refill);
+			p.handled = 0;
+			p.blocked = false;
+		}
+	}
+
+	/*
+		@brief Decide what to do with a received message.
+
+		@param _Slot The sender's slot.
+		@param _Id   The message's packet ID.
+		@return The verdict.
+	 */
+	admission
+	limiter::admit(std::size_t _Slot, std::uint8_t _Id) noexcept {
+		limiter_state& s = state();
+		if (!s.enabled || _Slot >= s.peers.size()) {
+			return admission::accept;
+		}
+
+		peer_bucket& p = s.peers[_Slot];
+		if (p.kicked) {
+			return admission::drop;
+		}
+		//
+		// Keep the sender's order: nothing overtakes a deferred message
+		//
+		if (p.blocked || p.deferred != 0) {
+			return overflow(s, p);
+		}
+		return charge(s, p, _Id);
+	}
+
+	/*
+		@brief Decide again on a message deferred by an earlier tick.
+
+		@param _Slot The sender's slot.
+		@param _Id   The message's packet ID.
+		@return The verdict.
+	 */
+	admission
+	limiter::retry(std::size_t _Slot, std::uint8_t _Id) noexcept {
+		limiter_state& s = state();
+		if (_Slot >= s.peers.size()) {
+			return admission::accept;
+		}
+
+		peer_bucket& p = s.peers[_Slot];
+		if (p.deferred != 0) {
+			--p.deferred;
+		}
+		if (p.kicked) {
+			return admission::drop;
+		}
+		if (!s.enabled) {
+			return admission::accept;
+		}
+		if (p.blocked) {
+			return overflow(s, p);
+		}
+		return charge(s, p, _Id);
+	}
+
+	/*
+		@brief Forget a slot's state when its peer connects or disconnects.
+
+		@param _Slot The peer's slot.
+	 */
+	void
+	limiter::reset(std::size_t _Slot) noexcept {
+		limiter_state& s = state();
+		if (_Slot < s.peers.size()) {
+			s.peers[_Slot] = {};
+			s.peers[_Slot].tokens = capacity(s.limits);
+		}
+	}
+}
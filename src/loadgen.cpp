@@ -0,0 +1,433 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <print>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <enet/enet.h>
+#include <magic_args/magic_args.hpp>
+#include "arena.h"
+#include "cli.h"
+#include "core.h"
+#include "metrics.h"
+#include "pool.h"
+#include "service.h"
+#include "shard.h"
+
+namespace loadgen {
+	using clock = std::chrono::steady_clock;
+
+	/* One entry of the scripted message mix */
+	struct mix_entry {
+		std::uint8_t	id;
+		std::uint32_t	weight;
+		std::uint32_t	min_size;
+		std::uint32_t	max_size;
+		bool			unreliable;
+	};
+
+	/* Totals shared by every thread */
+	struct totals {
+		std::atomic<std::uint64_t> connected{ 0 };
+		std::atomic<std::uint64_t> failed{ 0 };
+		std::atomic<std::uint64_t> dropped{ 0 };
+		std::atomic<std::uint64_t> sent{ 0 };
+		std::atomic<std::uint64_t> sent_bytes{ 0 };
+		std::atomic<std::uint64_t> received{ 0 };
+		std::atomic<std::uint64_t> received_bytes{ 0 };
+		std::atomic<std::uint64_t> loss_sum{ 0 };
+		std::atomic<std::uint64_t> loss_samples{ 0 };
+
+		//< Time from connect request to connect event, in nanoseconds
+		cat::histogram connect_time;
+
+		//< Peer round-trip times reported by ENet, in milliseconds
+		cat::histogram rtt;
+	};
+
+	/* One simulated client */
+	struct bot {
+		peer_t				peer = nullptr;
+		clock::time_point	opened{};
+		clock::time_point	next_send{};
+		bool				connected = false;
+	};
+
+	/* A client host and the bots it carries, driven by one thread */
+	struct host_state {
+		std::size_t			shard = 0;
+		std::vector<bot>	bots;
+		std::size_t			opened = 0;
+		totals*				sums = nullptr;
+	};
+
+	/*
+		Parses the message mix option.
+
+		@param _Text Entries of the form id:weight:min-max[:u], comma-separated.
+		@return The parsed entries.
+		@throws std::invalid_argument If an entry is malformed.
+	 */
+	static std::vector<mix_entry>
+	parse_mix(std::string_view _Text) {
+		const auto number = [](std::string_view _Field) {
+			std::uint32_t value = 0;
+			const auto [end, ec] = std::from_chars(_Field.data(), _Field.data() + _Field.size(), value);
+			if (ec != std::errc{} || end != _Field.data() + _Field.size()) {
+				throw std::invalid_argument("Malformed number in the message mix.");
+			}
+			return value;
+		};
+
+		std::vector<mix_entry> entries;
+		while (!_Text.empty()) {
+			const std::size_t comma = _Text.find(',');
+			std::string_view item = _Text.substr(0, comma);
+			_Text = comma == std::string_view::npos ? std::string_view{} : _Text.substr(comma + 1);
+
+			std::string_view fields[4];
+			std::size_t count = 0;
+			while (!item.empty() && count < 4) {
+				const std::size_t colon = item.find(':');
+				fields[count++] = item.substr(0, colon);
+				item = colon == std::string_view::npos ? std::string_view{} : item.substr(colon + 1);
+			}
+			const std::size_t dash = count >= 3 ? fields[2].find('-') : std::string_view::npos;
+			if (count < 3 || dash == std::string_view::npos || (count == 4 && fields[3] != "u")) {
+				throw std::invalid_argument("Message mix entries must look like id:weight:min-max[:u].");
+			}
+
+			mix_entry entry{};
+			const std::uint32_t id = number(fields[0]);
+			entry.weight = number(fields[1]);
+			entry.min_size = std::max<std::uint32_t>(number(fields[2].substr(0, dash)), 1);
+			entry.max_size = number(fields[2].substr(dash + 1));
+			entry.unreliable = count == 4;
+			if (id > 0xFF || entry.max_size < entry.min_size) {
+				throw std::invalid_argument("Message mix entry out of range.");
+			}
+			entry.id = static_cast<std::uint8_t>(id);
+			entries.push_back(entry);
+		}
+
+		if (entries.empty()) {
+			throw std::invalid_argument("The message mix is empty.");
+		}
+		return entries;
+	}
+
+	/*
+		Reads the total number of packets a server has received from its
+		metrics endpoint.
+
+		@param _Host The server's address.
+		@param _Port The server's metrics port.
+		@return The sum of csovmware_packets_received_total, or std::nullopt.
+	 */
+	static std::optional<std::uint64_t>
+	scrape_received(const std::string& _Host, std::uint16_t _Port) {
+		ENetAddress addr{};
+		if (enet_address_set_host(&addr, _Host.c_str()) != 0) {
+			return std::nullopt;
+		}
+		addr.port = _Port;
+
+		ENetSocket conn = enet_socket_create(ENET_SOCKET_TYPE_STREAM);
+		if (conn == ENET_SOCKET_NULL) {
+			return std::nullopt;
+		}
+		if (enet_socket_connect(conn, &addr) != 0) {
+			enet_socket_destroy(conn);
+			return std::nullopt;
+		}
+
+		static constexpr char request[] = "GET /metrics HTTP/1.0\r\n\r\n";
+		ENetBuffer out;
+		out.data = const_cast<char*>(request);
+		out.dataLength = sizeof(request) - 1;
+		enet_socket_send(conn, nullptr, &out, 1);
+
+		std::string text;
+		char chunk[4096];
+		for (;;) {
+			enet_uint32 condition = ENET_SOCKET_WAIT_RECEIVE;
+			if (enet_socket_wait(conn, &condition, 1000) != 0 || !(condition & ENET_SOCKET_WAIT_RECEIVE)) {
+				break;
+			}
+			ENetBuffer in;
+			in.data = chunk;
+			in.dataLength = sizeof(chunk);
+			const int res = enet_socket_receive(conn, nullptr, &in, 1);
+			if (res <= 0) {
+				break;
+			}
+			text.append(chunk, static_cast<std::size_t>(res));
+		}
+		enet_socket_destroy(conn);
+
+		constexpr std::string_view metric = "csovmware_packets_received_total{";
+		std::uint64_t total = 0;
+		bool found = false;
+		for (std::size_t pos = text.find(metric); pos != std::string::npos; pos = text.find(metric, pos + 1)) {
+			const std::size_t space = text.find(' ', pos);
+			const std::size_t end = text.find('\n', pos);
+			std::uint64_t value = 0;
+			if (space < end && std::from_chars(text.data() + space + 1, text.data() + end, value).ec == std::errc{}) {
+				total += value;
+				found = true;
+			}
+		}
+		return found ? std::optional(total) : std::nullopt;
+	}
+
+	/*
+		Hooks a host's service so connect, disconnect and message events
+		update its bots. Runs on the host's shard.
+	 */
+	static void
+	hook_events(host_state& _Host) {
+		cat::service::instance()
+			.on(cat::enet_service::enet_connect, [&_Host](cat::enet_event& _Event) {
+				const auto slot = reinterpret_cast<std::uintptr_t>(cat::core::Core_enet_peer_data(_Event.peer));
+				if (slot == 0) {
+					return;
+				}
+				bot& b = _Host.bots[slot - 1];
+				b.connected = true;
+				b.next_send = clock::now();
+				_Host.sums->connect_time.record(clock::now() - b.opened);
+				_Host.sums->connected.fetch_add(1, std::memory_order_relaxed);
+			})
+			.on(cat::enet_service::enet_disconnect, [&_Host](cat::enet_event& _Event) {
+				const auto slot = reinterpret_cast<std::uintptr_t>(cat::core::Core_enet_peer_data(_Event.peer));
+				if (slot == 0) {
+					return;
+				}
+				bot& b = _Host.bots[slot - 1];
+				(b.connected ? _Host.sums->dropped : _Host.sums->failed).fetch_add(1, std::memory_order_relaxed);
+				b.connected = false;
+				b.peer = nullptr;
+			})
+			.on(cat::enet_service::enet_message, [&_Host](cat::enet_event& _Event) {
+				_Host.sums->received.fetch_add(1, std::memory_order_relaxed);
+				_Host.sums->received_bytes.fetch_add(_Event.size, std::memory_order_relaxed);
+			});
+	}
+
+	/*
+		Records the ENet-measured RTT and loss of a host's peers.
+	 */
+	static void
+	sample_peers(host_state& _Host) {
+		static thread_local std::vector<cat::core::peer_stats> stats;
+		stats.resize(_Host.bots.size());
+		const std::size_t count = std::min(cat::core::Core_enet_peer_stats(stats), stats.size());
+		for (std::size_t i = 0; i < count; ++i) {
+			_Host.sums->rtt.record(stats[i].rtt);
+			_Host.sums->loss_sum.fetch_add(stats[i].loss, std::memory_order_relaxed);
+			_Host.sums->loss_samples.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	/*
+		Drives a group of client hosts for the length of the test.
+
+		@param _Args    The parsed command-line arguments.
+		@param _Mix     The scripted message mix.
+		@param _Hosts   The hosts owned by this thread.
+		@param _Ramp    Connections this thread may start per second.
+		@param _End     When the test ends.
+	 */
+	static void
+	run_thread(const cli::load_args& _Args, const std::vector<mix_entry>& _Mix, std::vector<host_state>& _Hosts,
+		double _Ramp, clock::time_point _End) {
+		std::minstd_rand random{ std::random_device{}() };
+		std::vector<std::uint32_t> weights;
+		for (const mix_entry& m : _Mix) {
+			weights.push_back(m.weight);
+		}
+		std::discrete_distribution<std::size_t> pick(weights.begin(), weights.end());
+		std::vector<std::byte> payload(0xFFFF);
+		for (std::size_t i = 0; i < payload.size(); ++i) {
+			payload[i] = static_cast<std::byte>(random());
+		}
+
+		const auto interval = std::chrono::nanoseconds(std::chrono::seconds(1)) / std::max<std::uint32_t>(_Args.rate, 1);
+		const auto start = clock::now();
+		auto next_sample = start + std::chrono::seconds(1);
+		std::size_t started = 0;
+
+		while (clock::now() < _End) {
+			const auto now = clock::now();
+			//
+			// Ramp connections up at the configured rate
+			//
+			const auto allowed = static_cast<std::size_t>(_Ramp * std::chrono::duration<double>(now - start).count()) + 1;
+			for (host_state& h : _Hosts) {
+				cat::set_current_shard(h.shard);
+				while (started < allowed && h.opened < h.bots.size()) {
+					bot& b = h.bots[h.opened];
+					b.opened = now;
+					try {
+						b.peer = cat::core::Core_enet_client_open(_Args.host, _Args.port,
+							static_cast<std::uint32_t>(cat::max_channels));
+						cat::core::Core_enet_peer_set_data(b.peer, reinterpret_cast<void*>(h.opened + 1));
+					}
+					catch (const std::runtime_error&) {
+						//
+						// No free peer or an unresolvable address: the bot never connects
+						//
+						h.sums->failed.fetch_add(1, std::memory_order_relaxed);
+					}
+					++h.opened;
+					++started;
+				}
+			}
+			//
+			// Poll, send each connected bot's due messages, flush
+			//
+			for (host_state& h : _Hosts) {
+				cat::set_current_shard(h.shard);
+				cat::core::Core_enet_poll(0);
+
+				cat::pool_manager& pool = cat::pool_manager::instance();
+				for (bot& b : h.bots) {
+					if (!b.connected) {
+						continue;
+					}
+					while (b.next_send <= now) {
+						const mix_entry& m = _Mix[pick(random)];
+						const std::uint32_t size = std::uniform_int_distribution<std::uint32_t>(m.min_size, m.max_size)(random);
+						payload[0] = std::byte{ m.id };
+						if (pool.push(b.peer, payload.data(), size, 0,
+							m.unreliable ? cat::pool_flags::unreliable_fragment : cat::pool_flags::reliable)) {
+							h.sums->sent.fetch_add(1, std::memory_order_relaxed);
+							h.sums->sent_bytes.fetch_add(size, std::memory_order_relaxed);
+						}
+						b.next_send += interval;
+					}
+				}
+				cat::core::Core_enet_send();
+			}
+			//
+			// The bots' handlers ran inline on this thread
+			//
+			cat::tick_arena::reset();
+
+			if (now >= next_sample) {
+				for (host_state& h : _Hosts) {
+					cat::set_current_shard(h.shard);
+					sample_peers(h);
+				}
+				next_sample += std::chrono::seconds(1);
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+int main(int argc, char** argv) {
+	//
+	// Parse command-line arguments
+	//
+	const auto args = magic_args::parse<cli::load_args>(argc, argv);
+	const auto mix = loadgen::parse_mix(args->mix);
+	cat::core::integrity integrity;
+	if (!cli::parse_integrity(args->integrity, integrity) || integrity == cat::core::integrity::automatic) {
+		std::println("- Unknown integrity mode {}; expected none or crc32c", args->integrity);
+		return 1;
+	}
+	//
+	// Spread the clients over threads x hosts, one shard per host. An ENet
+	// host holds at most ENET_PROTOCOL_MAXIMUM_PEER_ID peers, so more
+	// hosts are added per thread when the requested ones cannot hold them
+	//
+	constexpr std::size_t max_peers = ENET_PROTOCOL_MAXIMUM_PEER_ID;
+	const std::size_t threads = std::clamp<std::size_t>(args->threads, 1, cat::shard_count);
+	const std::size_t max_per_thread = cat::shard_count / threads;
+	const std::size_t clients = std::max<std::size_t>(args->clients, 1);
+	const std::size_t needed = (clients + threads * max_peers - 1) / (threads * max_peers);
+	if (needed > max_per_thread) {
+		std::println("- {} clients exceed the {} peers that {} hosts can hold; lower --clients",
+			clients, threads * max_per_thread * max_peers, threads * max_per_thread);
+		return 1;
+	}
+	const std::size_t per_thread = std::clamp<std::size_t>(args->hosts, needed, max_per_thread);
+	const std::size_t hosts = threads * per_thread;
+	const std::size_t per_host = (clients + hosts - 1) / hosts;
+
+	loadgen::totals sums;
+	std::vector<std::vector<loadgen::host_state>> groups(threads);
+	std::size_t remaining = clients;
+	for (std::size_t t = 0; t < threads; ++t) {
+		for (std::size_t h = 0; h < per_thread; ++h) {
+			loadgen::host_state& state = groups[t].emplace_back();
+			state.shard = t * per_thread + h;
+			state.bots.resize(std::min(per_host, remaining));
+			state.sums = &sums;
+			remaining -= state.bots.size();
+		}
+	}
+
+	for (auto& group : groups) {
+		for (auto& state : group) {
+			cat::set_current_shard(state.shard);
+			cat::core::Core_enet_initialize();
+			cat::core::Core_enet_set_integrity(integrity);
+			cat::core::Core_enet_client_create(static_cast<std::uint32_t>(cat::max_channels),
+				static_cast<std::uint32_t>(std::max<std::size_t>(state.bots.size(), 1)));
+			loadgen::hook_events(state);
+		}
+	}
+	std::println("- {} clients on {} hosts, {} threads, {} msg/s each, against {}:{}",
+		clients, hosts, threads, args->rate, args->host, args->port);
+
+	const auto server_before = args->metrics != 0 ? loadgen::scrape_received(args->host, args->metrics) : std::nullopt;
+	const auto start = loadgen::clock::now();
+	const auto end = start + std::chrono::seconds(args->duration);
+	const double ramp = static_cast<double>(std::max<std::uint32_t>(args->ramp, 1)) / static_cast<double>(threads);
+
+	std::vector<std::thread> workers;
+	for (auto& group : groups) {
+		workers.emplace_back(loadgen::run_thread, std::cref(*args), std::cref(mix), std::ref(group), ramp, end);
+	}
+	for (auto& worker : workers) {
+		worker.join();
+	}
+	const double seconds = std::chrono::duration<double>(loadgen::clock::now() - start).count();
+	const auto server_after = args->metrics != 0 ? loadgen::scrape_received(args->host, args->metrics) : std::nullopt;
+
+	for (auto& group : groups) {
+		for (auto& state : group) {
+			cat::set_current_shard(state.shard);
+			cat::core::Core_enet_deinitialize();
+		}
+	}
+	//
+	// Report
+	//
+	const auto ms = [](std::uint64_t _Ns) { return static_cast<double>(_Ns) / 1e6; };
+	std::println("- connected {} / {}, failed {}, dropped {}", sums.connected.load(), clients, sums.failed.load(), sums.dropped.load());
+	std::println("- connect time p50 {:.2f} ms, p90 {:.2f} ms, p99 {:.2f} ms",
+		ms(sums.connect_time.quantile(0.5)), ms(sums.connect_time.quantile(0.9)), ms(sums.connect_time.quantile(0.99)));
+	std::println("- sent {:.0f} msg/s ({:.2f} MB/s), received {:.0f} msg/s ({:.2f} MB/s)",
+		static_cast<double>(sums.sent.load()) / seconds, static_cast<double>(sums.sent_bytes.load()) / seconds / 1e6,
+		static_cast<double>(sums.received.load()) / seconds, static_cast<double>(sums.received_bytes.load()) / seconds / 1e6);
+	std::println("- rtt p50 {} ms, p90 {} ms, p99 {} ms, mean loss {:.3f} %",
+		sums.rtt.quantile(0.5), sums.rtt.quantile(0.9), sums.rtt.quantile(0.99),
+		sums.loss_samples.load() == 0 ? 0.0 : static_cast<double>(sums.loss_sum.load()) / static_cast<double>(sums.loss_samples.load()) / 65536.0 * 100.0);
+	if (server_before && server_after) {
+		std::println("- server received {:.0f} msg/s", static_cast<double>(*server_after - *server_before) / seconds);
+	} else if (args->metrics != 0) {
+		std::println("- server metrics unavailable on port {}", args->metrics);
+	}
+	std::println("");
+	return 0;
+}
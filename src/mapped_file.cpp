@@ -0,0 +1,252 @@
+#include <utility>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "mapped_file.h"
+
+namespace cat {
+	/*
+		Sets the size of an open file.
+
+		@param _Handle Native file handle or descriptor.
+		@param _Size   The new size in bytes.
+		@return true on success.
+	 */
+	static bool
+	set_file_size(std::intptr_t _Handle, std::size_t _Size) noexcept {
+#ifdef _WIN32
+		LARGE_INTEGER size;
+		size.QuadPart = static_cast<LONGLONG>(_Size);
+		HANDLE file = reinterpret_cast<HANDLE>(_Handle);
+		return SetFilePointerEx(file, size, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+#else
+		return ::ftruncate(static_cast<int>(_Handle), static_cast<off_t>(_Size)) == 0;
+#endif
+	}
+
+	mapped_file::mapped_file(mapped_file&& _Other) noexcept
+		: base(std::exchange(_Other.base, nullptr)), length(std::exchange(_Other.length, 0)),
+		  handle(std::exchange(_Other.handle, invalid)), access(_Other.access) {
+	}
+
+	mapped_file&
+	mapped_file::operator=(mapped_file&& _Other) noexcept {
+		if (this != &_Other) {
+			close();
+			base = std::exchange(_Other.base, nullptr);
+			length = std::exchange(_Other.length, 0);
+			handle = std::exchange(_Other.handle, invalid);
+			access = _Other.access;
+		}
+		return *this;
+	}
+
+	/*
+		Opens and maps a file.
+
+		@param _Path The file to map.
+		@param _Mode Read an existing file, create one for writing, or update one in place.
+		@param _Size Initial size of a writable mapping.
+		@return true if the file is mapped.
+	 */
+	bool
+	mapped_file::open(const std::string& _Path, mode _Mode, std::size_t _Size) {
+		close();
+		access = _Mode;
+#ifdef _WIN32
+		const DWORD disposition = _Mode == mode::write ? CREATE_ALWAYS : _Mode == mode::update ? OPEN_ALWAYS : OPEN_EXISTING;
+		HANDLE file = CreateFileA(_Path.c_str(),
+			_Mode != mode::read ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+			FILE_SHARE_READ, nullptr, disposition, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		handle = reinterpret_cast<std::intptr_t>(file);
+
+		if (_Mode == mode::read) {
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(file, &size)) {
+				close();
+				return false;
+			}
+			_Size = static_cast<std::size_t>(size.QuadPart);
+		}
+#else
+		const int flags = _Mode == mode::write ? O_RDWR | O_CREAT | O_TRUNC : _Mode == mode::update ? O_RDWR | O_CREAT : O_RDONLY;
+		//
+		// Owner only: session snapshots hold the secrets clients resume with
+		//
+		const int fd = ::open(_Path.c_str(), flags, 0600);
+		if (fd < 0) {
+			return false;
+		}
+		handle = fd;
+
+		if (_Mode == mode::read) {
+			struct stat st;
+			if (::fstat(fd, &st) != 0) {
+				close();
+				return false;
+			}
+			_Size = static_cast<std::size_t>(st.st_size);
+		}
+#endif
+		if (_Mode != mode::read) {
+			return resize(_Size);
+		}
+
+		length = _Size;
+		if (!map()) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	/*
+		Grows or shrinks a writable mapping.
+
+		On failure the mapping is restored at its previous size; if even
+		that fails, it is left empty, so bytes() never points at an unmapped
+		range.
+
+		@param _Size The new size in bytes.
+		@return true if the file was resized and remapped.
+	 */
+	bool
+	mapped_file::resize(std::size_t _Size) {
+		if (handle == invalid || access == mode::read) {
+			return false;
+		}
+
+		const std::size_t previous = length;
+		unmap();
+		if (set_file_size(handle, _Size)) {
+			length = _Size;
+			if (map()) {
+				return true;
+			}
+		}
+
+		length = previous;
+		if (!set_file_size(handle, previous) || !map()) {
+			length = 0;
+		}
+		return false;
+	}
+
+	/*
+		Starts writing a range of a writable mapping back to disk.
+
+		@param _Offset Start of the range.
+		@param _Size   Length of the range.
+	 */
+	void
+	mapped_file::flush(std::size_t _Offset, std::size_t _Size) noexcept {
+		if (base == nullptr || access == mode::read || _Offset >= length) {
+			return;
+		}
+		if (_Size > length - _Offset) {
+			_Size = length - _Offset;
+		}
+#ifdef _WIN32
+		FlushViewOfFile(base + _Offset, _Size);
+#else
+		//
+		// msync wants a page-aligned start
+		//
+		const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+		const std::size_t start = _Offset / page * page;
+		::msync(base + start, _Size + (_Offset - start), MS_ASYNC);
+#endif
+	}
+
+	/*
+		Unmaps and closes the file.
+
+		@param _Used For writable mappings, the number of bytes to keep.
+	 */
+	void
+	mapped_file::close(std::size_t _Used) noexcept {
+		unmap();
+		if (handle == invalid) {
+			return;
+		}
+#ifdef _WIN32
+		HANDLE file = reinterpret_cast<HANDLE>(handle);
+		if (access != mode::read && _Used < length) {
+			LARGE_INTEGER size;
+			size.QuadPart = static_cast<LONGLONG>(_Used);
+			SetFilePointerEx(file, size, nullptr, FILE_BEGIN);
+			SetEndOfFile(file);
+		}
+		CloseHandle(file);
+#else
+		if (access != mode::read && _Used < length) {
+			static_cast<void>(::ftruncate(static_cast<int>(handle), static_cast<off_t>(_Used)));
+		}
+		::close(static_cast<int>(handle));
+#endif
+		handle = invalid;
+		length = 0;
+	}
+
+	/*
+		Maps `length` bytes of the open file.
+	 */
+	bool
+	mapped_file::map() noexcept {
+		if (length == 0) {
+			//
+			// Empty files cannot be mapped; an empty span is all there is
+			//
+			return true;
+		}
+#ifdef _WIN32
+		const bool writable = access != mode::read;
+		HANDLE mapping = CreateFileMappingA(reinterpret_cast<HANDLE>(handle), nullptr,
+			writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			return false;
+		}
+		void* view = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, length);
+		//
+		// The view keeps the mapping object alive
+		//
+		CloseHandle(mapping);
+		if (view == nullptr) {
+			return false;
+		}
+#else
+		void* view = ::mmap(nullptr, length, access != mode::read ? PROT_READ | PROT_WRITE : PROT_READ,
+			MAP_SHARED, static_cast<int>(handle), 0);
+		if (view == MAP_FAILED) {
+			return false;
+		}
+#endif
+		base = static_cast<std::byte*>(view);
+		return true;
+	}
+
+	/*
+		Unmaps the file, keeping it open.
+	 */
+	void
+	mapped_file::unmap() noexcept {
+		if (base == nullptr) {
+			return;
+		}
+#ifdef _WIN32
+		UnmapViewOfFile(base);
+#else
+		::munmap(base, length);
+#endif
+		base = nullptr;
+	}
+}
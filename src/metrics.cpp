@@ -0,0 +1,449 @@
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include <enet/enet.h>
+#include "arena.h"
+#include "compress.h"
+#include "core.h"
+#include "metrics.h"
+#include "shard.h"
+#include "udp_batch.h"
+
+namespace cat {
+	/*
+		Returns the value below which a fraction of the samples lie.
+
+		@param _Quantile The fraction, between 0 and 1.
+		@return The upper bound of the bucket holding the quantile, or 0 if empty.
+	 */
+	std::uint64_t
+	histogram::quantile(double _Quantile) const noexcept {
+		const std::uint64_t samples = count();
+		if (samples == 0) {
+			return 0;
+		}
+
+		const auto rank = static_cast<std::uint64_t>(std::ceil(std::clamp(_Quantile, 0.0, 1.0) * static_cast<double>(samples)));
+		std::uint64_t seen = 0;
+		for (std::size_t i = 0; i < bucket_count; ++i) {
+			seen += buckets[i].load(std::memory_order_relaxed);
+			if (seen >= rank && seen != 0) {
+				return i + 1 < bucket_count ? lower_bound(i + 1) - 1 : ~std::uint64_t{ 0 };
+			}
+		}
+		return lower_bound(bucket_count - 1);
+	}
+
+	/*
+		Returns the number of recorded values.
+	 */
+	std::uint64_t
+	histogram::count() const noexcept {
+		std::uint64_t samples = 0;
+		for (const auto& bucket : buckets) {
+			samples += bucket.load(std::memory_order_relaxed);
+		}
+		return samples;
+	}
+
+	/*
+		Traffic of one packet ID.
+	 */
+	struct packet_counters {
+		std::atomic<std::uint64_t> packets_in{ 0 };
+		std::atomic<std::uint64_t> bytes_in{ 0 };
+		std::atomic<std::uint64_t> packets_out{ 0 };
+		std::atomic<std::uint64_t> bytes_out{ 0 };
+	};
+
+	/*
+		Metrics of one shard.
+	 */
+	struct shard_metrics {
+		//< Traffic per packet ID
+		std::array<packet_counters, 256> packets;
+
+		//< Sampled dispatch latency in nanoseconds
+		histogram dispatch;
+
+		//< Tick duration in nanoseconds
+		histogram ticks;
+
+		//< Connected users and user table size
+		std::atomic<std::size_t> users{ 0 };
+		std::atomic<std::size_t> capacity{ 0 };
+
+		//< Messages refused by the rate limiter, by verdict
+		std::array<std::atomic<std::uint64_t>, 4> limited{};
+
+		//< Unreliable sends shed for backlogged peers
+		std::atomic<std::uint64_t> shed{ 0 };
+
+		//< Whether anything has been recorded, so idle shards are not exported
+		std::atomic<bool> used{ false };
+
+		//< Latest peer sample, guarded by lock
+		std::mutex lock;
+		std::vector<core::peer_stats> peers;
+	};
+
+	/*
+		All shards' metrics, readable from the exporter thread.
+	 */
+	static std::array<shard_metrics, shard_count> shards;
+
+	static shard_metrics&
+	local() noexcept {
+		shard_metrics& m = shards[current_shard()];
+		if (!m.used.load(std::memory_order_relaxed)) {
+			m.used.store(true, std::memory_order_relaxed);
+		}
+		return m;
+	}
+
+	/*
+		Counts a received message.
+	 */
+	void
+	metrics::count_in(std::uint8_t _Id, std::size_t _Size) noexcept {
+		packet_counters& c = local().packets[_Id];
+		c.packets_in.fetch_add(1, std::memory_order_relaxed);
+		c.bytes_in.fetch_add(_Size, std::memory_order_relaxed);
+	}
+
+	/*
+		Counts a packet handed to ENet for one peer.
+	 */
+	void
+	metrics::count_out(std::uint8_t _Id, std::size_t _Size) noexcept {
+		packet_counters& c = local().packets[_Id];
+		c.packets_out.fetch_add(1, std::memory_order_relaxed);
+		c.bytes_out.fetch_add(_Size, std::memory_order_relaxed);
+	}
+
+	/*
+		Counts a received message the rate limiter did not accept.
+	 */
+	void
+	metrics::count_limited(admission _Verdict) noexcept {
+		local().limited[static_cast<std::size_t>(_Verdict)].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/*
+		Counts an unreliable send shed because its peer was backlogged.
+	 */
+	void
+	metrics::count_shed() noexcept {
+		local().shed.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/*
+		Records the duration of one sampled message dispatch.
+	 */
+	void
+	metrics::record_dispatch(std::chrono::nanoseconds _Duration) noexcept {
+		local().dispatch.record(_Duration);
+	}
+
+	/*
+		Records the duration of one server tick.
+	 */
+	void
+	metrics::record_tick(std::chrono::nanoseconds _Duration) noexcept {
+		local().ticks.record(_Duration);
+	}
+
+	/*
+		Publishes the shard's user slot occupancy.
+	 */
+	void
+	metrics::set_users(std::size_t _Active, std::size_t _Capacity) noexcept {
+		shard_metrics& m = local();
+		m.users.store(_Active, std::memory_order_relaxed);
+		m.capacity.store(_Capacity, std::memory_order_relaxed);
+	}
+
+	/*
+		Samples the connection quality of the shard's peers.
+	 */
+	void
+	metrics::sample_peers() {
+		static thread_local std::vector<core::peer_stats> scratch;
+		std::size_t count = core::Core_enet_peer_stats(scratch);
+		if (count > scratch.size()) {
+			scratch.resize(count);
+			count = core::Core_enet_peer_stats(scratch);
+		}
+
+		shard_metrics& m = local();
+		std::lock_guard guard(m.lock);
+		m.peers.assign(scratch.begin(), scratch.begin() + static_cast<std::ptrdiff_t>(std::min(count, scratch.size())));
+	}
+
+	/*
+		Appends a histogram as a Prometheus summary in seconds.
+	 */
+	static void
+	render_summary(std::string& _Out, std::string_view _Name, std::size_t _Shard, const histogram& _Histogram) {
+		auto out = std::back_inserter(_Out);
+		for (const double q : { 0.5, 0.9, 0.99, 0.999 }) {
+			std::format_to(out, "{}{{shard=\"{}\",quantile=\"{}\"}} {:.9f}\n", _Name, _Shard, q,
+				static_cast<double>(_Histogram.quantile(q)) * 1e-9);
+		}
+		std::format_to(out, "{}_sum{{shard=\"{}\"}} {:.9f}\n", _Name, _Shard, static_cast<double>(_Histogram.sum()) * 1e-9);
+		std::format_to(out, "{}_count{{shard=\"{}\"}} {}\n", _Name, _Shard, _Histogram.count());
+	}
+
+	/*
+		Formats every metric in the Prometheus text exposition format.
+	 */
+	std::string
+	metrics::render() {
+		std::string text;
+		auto out = std::back_inserter(text);
+		constexpr std::string_view counters[] = {
+			"csovmware_packets_received_total",
+			"csovmware_bytes_received_total",
+			"csovmware_packets_sent_total",
+			"csovmware_bytes_sent_total",
+		};
+		for (std::size_t k = 0; k < std::size(counters); ++k) {
+			std::format_to(out, "# TYPE {} counter\n", counters[k]);
+			for (std::size_t s = 0; s < shard_count; ++s) {
+				if (!shards[s].used.load(std::memory_order_relaxed)) {
+					continue;
+				}
+				for (std::size_t id = 0; id < 256; ++id) {
+					const packet_counters& c = shards[s].packets[id];
+					const std::atomic<std::uint64_t>* fields[] = { &c.packets_in, &c.bytes_in, &c.packets_out, &c.bytes_out };
+					const std::uint64_t value = fields[k]->load(std::memory_order_relaxed);
+					if (value != 0) {
+						std::format_to(out, "{}{{shard=\"{}\",id=\"{}\"}} {}\n", counters[k], s, id, value);
+					}
+				}
+			}
+		}
+
+		text += "# TYPE csovmware_dispatch_seconds summary\n";
+		for (std::size_t s = 0; s < shard_count; ++s) {
+			if (shards[s].used.load(std::memory_order_relaxed)) {
+				render_summary(text, "csovmware_dispatch_seconds", s, shards[s].dispatch);
+			}
+		}
+		text += "# TYPE csovmware_tick_seconds summary\n";
+		for (std::size_t s = 0; s < shard_count; ++s) {
+			if (shards[s].used.load(std::memory_order_relaxed)) {
+				render_summary(text, "csovmware_tick_seconds", s, shards[s].ticks);
+			}
+		}
+
+		//
+		// Every sample of a family follows its own TYPE line, as the
+		// exposition format requires
+		//
+		text += "# TYPE csovmware_users gauge\n";
+		for (std::size_t s = 0; s < shard_count; ++s) {
+			if (shards[s].used.load(std::memory_order_relaxed)) {
+				std::format_to(out, "csovmware_users{{shard=\"{}\"}} {}\n", s, shards[s].users.load(std::memory_order_relaxed));
+			}
+		}
+		text += "# TYPE csovmware_user_capacity gauge\n";
+		for (std::size_t s = 0; s < shard_count; ++s) {
+			if (shards[s].used.load(std::memory_order_relaxed)) {
+				std::format_to(out, "csovmware_user_capacity{{shard=\"{}\"}} {}\n", s, shards[s].capacity.load(std::memory_order_relaxed));
+			}
+		}
+
+		text += "# TYPE csovmware_limited_total counter\n";
+		for (std::size_t s = 0; s < shard_count; ++s) {
+			if (!shards[s].used.load(std::memory_order_relaxed)) {
+				continue;
+			}
+			constexpr std::string_view actions[] = { "accept", "drop", "defer", "kick" };
+			for (std::size_t a = 1; a < std::size(actions); ++a) {
+				std::format_to(out, "csovmware_limited_total{{shard=\"{}\",action=\"{}\"}} {}\n", s, actions[a],
+					shards[s].limited[a].load(std::memory_order_relaxed));
+			}
+		}
+		text += "# TYPE csovmware_shed_total counter\n";
+		for (std::size_t s = 0; s < shard_count; ++s) {
+			if (shards[s].used.load(std::memory_order_relaxed)) {
+				std::format_to(out, "csovmware_shed_total{{shard=\"{}\"}} {}\n", s, shards[s].shed.load(std::memory_order_relaxed));
+			}
+		}
+
+		text += "# TYPE csovmware_peer_rtt_seconds gauge\n";
+		for (std::size_t s = 0; s < shard_count; ++s) {
+			std::lock_guard guard(shards[s].lock);
+			for (const core::peer_stats& p : shards[s].peers) {
+				std::format_to(out, "csovmware_peer_rtt_seconds{{shard=\"{}\",peer=\"{}\"}} {:.3f}\n", s, p.id, p.rtt * 1e-3);
+			}
+		}
+		text += "# TYPE csovmware_peer_rtt_variance_seconds gauge\n";
+		for (std::size_t s = 0; s < shard_count; ++s) {
+			std::lock_guard guard(shards[s].lock);
+			for (const core::peer_stats& p : shards[s].peers) {
+				std::format_to(out, "csovmware_peer_rtt_variance_seconds{{shard=\"{}\",peer=\"{}\"}} {:.3f}\n", s, p.id, p.rtt_variance * 1e-3);
+			}
+		}
+		text += "# TYPE csovmware_peer_packet_loss_ratio gauge\n";
+		for (std::size_t s = 0; s < shard_count; ++s) {
+			std::lock_guard guard(shards[s].lock);
+			for (const core::peer_stats& p : shards[s].peers) {
+				std::format_to(out, "csovmware_peer_packet_loss_ratio{{shard=\"{}\",peer=\"{}\"}} {:.5f}\n", s, p.id, p.loss / 65536.0);
+			}
+		}
+		text += "# TYPE csovmware_peer_in_transit_bytes gauge\n";
+		for (std::size_t s = 0; s < shard_count; ++s) {
+			std::lock_guard guard(shards[s].lock);
+			for (const core::peer_stats& p : shards[s].peers) {
+				std::format_to(out, "csovmware_peer_in_transit_bytes{{shard=\"{}\",peer=\"{}\"}} {}\n", s, p.id, p.in_transit);
+			}
+		}
+
+		const compression_stats c = compressor::stats();
+		std::format_to(out,
+			"# TYPE csovmware_compressed_total counter\ncsovmware_compressed_total {}\n"
+			"# TYPE csovmware_compression_skipped_total counter\ncsovmware_compression_skipped_total {}\n"
+			"# TYPE csovmware_compression_raw_bytes_total counter\ncsovmware_compression_raw_bytes_total {}\n"
+			"# TYPE csovmware_compression_packed_bytes_total counter\ncsovmware_compression_packed_bytes_total {}\n"
+			"# TYPE csovmware_decompressed_total counter\ncsovmware_decompressed_total {}\n"
+			"# TYPE csovmware_decompression_failures_total counter\ncsovmware_decompression_failures_total {}\n"
+			"# TYPE csovmware_compress_seconds_total counter\ncsovmware_compress_seconds_total {:.6f}\n"
+			"# TYPE csovmware_decompress_seconds_total counter\ncsovmware_decompress_seconds_total {:.6f}\n",
+			c.packed, c.skipped, c.raw_bytes, c.packed_bytes, c.unpacked, c.failures, c.pack_ns * 1e-9, c.unpack_ns * 1e-9);
+
+		const block_pool_stats b = block_pool::stats();
+		std::format_to(out,
+			"# TYPE csovmware_block_pool_reserved_bytes gauge\ncsovmware_block_pool_reserved_bytes {}\n"
+			"# TYPE csovmware_block_pool_oversized_total counter\ncsovmware_block_pool_oversized_total {}\n",
+			b.reserved, b.oversized);
+
+		if constexpr (udp_batch::enabled) {
+			const udp_batch_stats u = udp_batch::stats();
+			std::format_to(out,
+				"# TYPE csovmware_udp_receive_calls_total counter\ncsovmware_udp_receive_calls_total {}\n"
+				"# TYPE csovmware_udp_received_total counter\ncsovmware_udp_received_total {}\n"
+				"# TYPE csovmware_udp_send_calls_total counter\ncsovmware_udp_send_calls_total {}\n"
+				"# TYPE csovmware_udp_sent_total counter\ncsovmware_udp_sent_total {}\n"
+				"# TYPE csovmware_udp_segmented_total counter\ncsovmware_udp_segmented_total {}\n"
+				"# TYPE csovmware_udp_dropped_total counter\ncsovmware_udp_dropped_total {}\n",
+				u.receive_calls, u.received, u.send_calls, u.sent, u.segmented, u.dropped);
+		}
+		return text;
+	}
+
+	/*
+		Starts serving metrics.
+
+		@param _Host Address to bind to.
+		@param _Port TCP port to listen on.
+	 */
+	void
+	metrics_exporter::start(std::string_view _Host, std::uint16_t _Port) {
+		if (running.load()) {
+			return;
+		}
+
+		//
+		// Hold a library reference of our own; the shards come and go independently
+		//
+		if (enet_initialize() != 0) {
+			throw std::runtime_error("An error occurred while initializing ENet.");
+		}
+
+		ENetAddress addr{};
+		const std::string host(_Host);
+		ENetSocket listener = ENET_SOCKET_NULL;
+		if (enet_address_set_host(&addr, host.c_str()) == 0) {
+			addr.port = _Port;
+			listener = enet_socket_create(ENET_SOCKET_TYPE_STREAM);
+		}
+		if (listener == ENET_SOCKET_NULL) {
+			enet_deinitialize();
+			throw std::runtime_error("Failed to create the metrics endpoint socket.");
+		}
+
+		enet_socket_set_option(listener, ENET_SOCKOPT_REUSEADDR, 1);
+		if (enet_socket_bind(listener, &addr) != 0 || enet_socket_listen(listener, 8) != 0) {
+			enet_socket_destroy(listener);
+			enet_deinitialize();
+			throw std::runtime_error("Failed to bind the metrics endpoint.");
+		}
+
+		socket = static_cast<std::intptr_t>(listener);
+		running = true;
+		thread = std::thread(&metrics_exporter::run, this);
+	}
+
+	/*
+		Stops serving metrics and closes the socket.
+	 */
+	void
+	metrics_exporter::stop() {
+		if (!running.exchange(false)) {
+			return;
+		}
+
+		thread.join();
+		enet_socket_destroy(static_cast<ENetSocket>(socket));
+		socket = -1;
+		enet_deinitialize();
+	}
+
+	/*
+		Accept loop.
+	 */
+	void
+	metrics_exporter::run() {
+		const auto listener = static_cast<ENetSocket>(socket);
+		while (running.load(std::memory_order_acquire)) {
+			//
+			// Wake up regularly so stop() never waits long
+			//
+			enet_uint32 condition = ENET_SOCKET_WAIT_RECEIVE;
+			if (enet_socket_wait(listener, &condition, 200) != 0 || !(condition & ENET_SOCKET_WAIT_RECEIVE)) {
+				continue;
+			}
+
+			ENetSocket conn = enet_socket_accept(listener, nullptr);
+			if (conn == ENET_SOCKET_NULL) {
+				continue;
+			}
+			//
+			// Read (and ignore) the request so closing does not reset the connection
+			//
+			char request[1024];
+			enet_uint32 readable = ENET_SOCKET_WAIT_RECEIVE;
+			if (enet_socket_wait(conn, &readable, 200) == 0 && (readable & ENET_SOCKET_WAIT_RECEIVE)) {
+				ENetBuffer in;
+				in.data = request;
+				in.dataLength = sizeof(request);
+				enet_socket_receive(conn, nullptr, &in, 1);
+			}
+
+			const std::string body = metrics::render();
+			const std::string response = std::format(
+				"HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: {}\r\nConnection: close\r\n\r\n{}",
+				body.size(), body);
+
+			std::size_t sent = 0;
+			while (sent < response.size()) {
+				ENetBuffer out;
+				out.data = const_cast<char*>(response.data() + sent);
+				out.dataLength = response.size() - sent;
+				const int res = enet_socket_send(conn, nullptr, &out, 1);
+				if (res <= 0) {
+					break;
+				}
+				sent += static_cast<std::size_t>(res);
+			}
+			enet_socket_shutdown(conn, ENET_SOCKET_SHUTDOWN_WRITE);
+			enet_socket_destroy(conn);
+		}
+	}
+}
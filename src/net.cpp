@@ -1,18 +1,96 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <random>
 #include "net.h"
+#include "arena.h"
 #include "core.h"
 #include "const.h"
+#include "packet.h"
 #include "client.h"
 #include "server.h"
+#include "service.h"
+#include "shard.h"
 
 namespace cat {
 	/*
-		Global flag indicating whether a client connection to a remote server
-		is currently active or in progress. Shared between client/server code
-		to track connection state.
+		Flag indicating whether a client connection to a remote server is
+		currently active or in progress, kept per shard. Shared between
+		client/server code to track connection state.
 	 */
-	static bool connecting = false;
+	struct connection_state {
+		bool connecting = false;
+	};
+
+	static bool&
+	connecting() noexcept {
+		return shard_local<connection_state>().connecting;
+	}
 
 
+	/*
+		Reconnect state machine of a client, kept per shard.
+
+		The service handlers only publish the state; the timing and the
+		attempts themselves are driven by client::flush() on the I/O thread.
+	 */
+	struct client_session {
+		//< Current connection state, written by the service handlers too
+		std::atomic<client_state> state{ client_state::disconnected };
+
+		//< Set when a connection ended and the next attempt is not scheduled yet
+		std::atomic<bool> lost{ false };
+
+		//< Failed attempts since the last successful connection
+		std::uint32_t attempts = 0;
+
+		//< Earliest time of the next connection attempt
+		std::chrono::steady_clock::time_point next_attempt{};
+
+		//< Source of the reconnect jitter
+		std::minstd_rand random{ std::random_device{}() };
+
+		//< Whether the client wants to be connected
+		bool active = false;
+
+		//< Whether the service handlers have been registered
+		bool hooked = false;
+	};
+
+	static client_session&
+	session_state() noexcept {
+		return shard_local<client_session>();
+	}
+
+	/*
+		Computes the delay before the next connection attempt.
+
+		Doubles from client::reconnect_base up to client::reconnect_max
+		and picks a random point in the upper half, so clients dropped
+		together do not reconnect in lockstep.
+
+		@param _Session The client's session state.
+		@return The delay in milliseconds.
+	 */
+	static std::uint32_t
+	reconnect_delay(client_session& _Session) noexcept {
+		const std::uint32_t shift = std::min<std::uint32_t>(_Session.attempts, 16);
+		const std::uint64_t ceiling = std::min<std::uint64_t>(std::uint64_t{ client::reconnect_base } << shift, client::reconnect_max);
+		std::uniform_int_distribution<std::uint64_t> jitter(ceiling / 2, ceiling);
+		return static_cast<std::uint32_t>(jitter(_Session.random));
+	}
+
+	/*
+		Issues one connection attempt to the client's server.
+	 */
+	static void
+	attempt_connect(const client& _Client, client_session& _Session) {
+		_Session.state = client_state::connecting;
+		core::Core_enet_client_connect(_Client.host, _Client.port,
+			static_cast<std::uint32_t>(packet_registry::channel_count()));
+	}
+
 	/*
 		Returns whether a client connection attempt is currently active.
 
@@ -21,7 +99,7 @@ namespace cat {
 	 */
 	bool
 	is_connect() noexcept {
-		return connecting;
+		return connecting();
 	}
 
 	/*
@@ -32,9 +110,14 @@ namespace cat {
 	 */
 	void
 	server::connect() const {
+		//
+		// Startup registration is over once the host goes live
+		//
+		packet_registry::freeze();
 		core::Core_enet_initialize();
-		core::Core_enet_server_create(host, port, MAX_USERS);
-		connecting = true;
+		core::Core_enet_server_create(host, port, capacity,
+			static_cast<std::uint32_t>(packet_registry::channel_count()));
+		connecting() = true;
 	}
 
 	/*
@@ -46,7 +129,7 @@ namespace cat {
 	void 
 	server::disconnect() const {
 		core::Core_enet_deinitialize();
-		connecting = false;
+		connecting() = false;
 	}
 
 	/*
@@ -60,20 +143,43 @@ namespace cat {
 	server::flush() const {
 		core::Core_enet_poll();
 		core::Core_enet_send();
+		tick_arena::reset();
 	}
 
 	/*
-		Establishes a connection to the server.
+		Starts connecting to the server.
 		
-		This function performs the necessary initialization and setup,
-		such as creating network hosts and preparing for data transmission.
+		Creates the client host, hooks the reconnect state machine into the
+		service and issues the first attempt without waiting for its outcome.
 	 */
 	void
 	client::connect() const {
+		packet_registry::freeze();
 		core::Core_enet_initialize();
-		core::Core_enet_client_create(1);
-		core::Core_enet_client_connect(host, port);
-		connecting = true;
+		core::Core_enet_client_create(static_cast<std::uint32_t>(packet_registry::channel_count()));
+
+		client_session& session = session_state();
+		if (!session.hooked) {
+			session.hooked = true;
+			service::instance()
+				.on(enet_service::enet_connect, [](enet_event&) {
+					session_state().state = client_state::connected;
+				}, std::numeric_limits<int>::min())
+				.on(enet_service::enet_disconnect, [](enet_event&) {
+					//
+					// Flag the loss first, so flush() never sees the state without it
+					//
+					client_session& s = session_state();
+					s.lost = true;
+					s.state = client_state::disconnected;
+				}, std::numeric_limits<int>::max());
+		}
+
+		session.active = true;
+		session.attempts = 0;
+		session.lost = false;
+		attempt_connect(*this, session);
+		connecting() = true;
 	}
 
 	/*
@@ -84,20 +190,71 @@ namespace cat {
 	 */
 	void
 	client::disconnect() const {
+		client_session& session = session_state();
+		session.active = false;
 		core::Core_enet_client_disconnect();
 		core::Core_enet_deinitialize();
-		connecting = false;
+		session.state = client_state::disconnected;
+		connecting() = false;
 	}
 
 	/*
 		Polls for incoming events or messages from the server.
 		
-		This function checks for any new data or events and processes them
-		accordingly, allowing the client to respond to server communications.
+		Waits at most `timeout` milliseconds for events, then schedules or
+		starts a reconnect if the connection has been lost.
 	 */
 	void
 	client::flush() const {
-		core::Core_enet_poll();
+		core::Core_enet_poll(timeout);
 		core::Core_enet_send();
+		//
+		// Inline handlers are done with their arena memory once the sends are out
+		//
+		tick_arena::reset();
+
+		client_session& session = session_state();
+		if (!session.active) {
+			return;
+		}
+
+		const auto now = std::chrono::steady_clock::now();
+		switch (session.state.load()) {
+		case client_state::connected:
+			session.attempts = 0;
+			break;
+
+		case client_state::disconnected:
+			if (session.lost.exchange(false)) {
+				session.next_attempt = now + std::chrono::milliseconds(reconnect_delay(session));
+				++session.attempts;
+			}
+			//
+			// The core lets go of the old peer before the handlers run
+			//
+			if (now >= session.next_attempt && core::Core_enet_client_peer() == nullptr) {
+				attempt_connect(*this, session);
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	/*
+		Returns the current connection state.
+	 */
+	client_state
+	client::state() const noexcept {
+		return session_state().state;
+	}
+
+	/*
+		Returns the session token the server granted.
+	 */
+	const core::session_token&
+	client::session() const noexcept {
+		return core::Core_enet_client_session();
 	}
 }
\ No newline at end of file
@@ -0,0 +1,426 @@
+#include <vector>
+#include <enet/enet.h>
+#include "core.h"
+#include "pool.h"
+
+namespace cat {
+	/*
+		Pushes held back by the calling thread's open batch.
+	 */
+	struct pool_batch {
+		//< Manager the batch was opened on, nullptr when no batch is open
+		pool_manager* owner = nullptr;
+
+		//< Collected records, each owning a packet reference
+		std::vector<pool_entry> entries;
+	};
+
+	static thread_local pool_batch batch;
+
+	/*
+		Releases the queue references of a set of records.
+	 */
+	static void
+	release_entries(std::span<const pool_entry> _Entries) noexcept {
+		for (const pool_entry& entry : _Entries) {
+			if (entry.packet != nullptr) {
+				core::Core_enet_packet_release(entry.packet);
+			}
+		}
+	}
+
+	/*
+		@brief Queue raw bytes for delivery to a peer.
+
+		The payload is copied into a new ENet packet right away, so the caller's
+		buffer can be reused as soon as this function returns.
+
+		@param _Peer    The peer that should receive the data.
+		@param _Data    Pointer to the payload.
+		@param _Size    Size of the payload in bytes.
+		@param _Channel The ENet channel to send the payload on.
+		@param _Flags   Delivery flags for the payload.
+		@return true if the payload was queued, false otherwise.
+	 */
+	bool
+	pool_manager::push(peer_t _Peer, const void* _Data, std::size_t _Size, std::uint8_t _Channel, pool_flags _Flags) {
+		if (_Peer == nullptr) {
+			return false;
+		}
+
+		ENetPacket* packet = enet_packet_create(_Data, _Size, static_cast<enet_uint32>(_Flags));
+		if (packet == nullptr) {
+			return false;
+		}
+
+		return enqueue(_Peer, packet, _Channel);
+	}
+
+	/*
+		@brief Queue the contents of an output stream for delivery to a peer.
+
+		Inline bytes and referenced fragments are gathered directly into the
+		ENet packet; ENet fragments it further if it exceeds the peer MTU.
+
+		@param _Peer    The peer that should receive the data.
+		@param _Stream  The stream whose contents are sent.
+		@param _Channel The ENet channel to send the payload on.
+		@param _Flags   Delivery flags for the payload.
+		@return true if the payload was queued, false otherwise.
+	 */
+	bool
+	pool_manager::push(peer_t _Peer, const ostream& _Stream, std::uint8_t _Channel, pool_flags _Flags) {
+		if (_Stream.fragments().empty()) {
+			return push(_Peer, _Stream.buffer().data(), _Stream.size(), _Channel, _Flags);
+		}
+
+		if (_Peer == nullptr) {
+			return false;
+		}
+
+		void* packet = make_packet(_Stream, _Flags);
+		if (packet == nullptr) {
+			return false;
+		}
+
+		return enqueue(_Peer, packet, _Channel);
+	}
+
+	/*
+		@brief Queue the same raw bytes for delivery to several peers.
+
+		@param _Peers   The peers that should receive the data.
+		@param _Data    Pointer to the payload.
+		@param _Size    Size of the payload in bytes.
+		@param _Channel The ENet channel to send the payload on.
+		@param _Flags   Delivery flags for the payload.
+		@return The number of peers the payload was queued for.
+	 */
+	std::size_t
+	pool_manager::multicast(std::span<const peer_t> _Peers, const void* _Data, std::size_t _Size, std::uint8_t _Channel, pool_flags _Flags) {
+		if (_Peers.empty()) {
+			return 0;
+		}
+
+		ENetPacket* packet = enet_packet_create(_Data, _Size, static_cast<enet_uint32>(_Flags));
+		if (packet == nullptr) {
+			return 0;
+		}
+
+		return enqueue_many(_Peers, packet, _Channel);
+	}
+
+	/*
+		@brief Queue the contents of an output stream for delivery to several peers.
+
+		@param _Peers   The peers that should receive the data.
+		@param _Stream  The stream whose contents are sent.
+		@param _Channel The ENet channel to send the payload on.
+		@param _Flags   Delivery flags for the payload.
+		@return The number of peers the payload was queued for.
+	 */
+	std::size_t
+	pool_manager::multicast(std::span<const peer_t> _Peers, const ostream& _Stream, std::uint8_t _Channel, pool_flags _Flags) {
+		if (_Peers.empty()) {
+			return 0;
+		}
+
+		void* packet = make_packet(_Stream, _Flags);
+		if (packet == nullptr) {
+			return 0;
+		}
+
+		return enqueue_many(_Peers, packet, _Channel);
+	}
+
+	/*
+		@brief Create an ENet packet holding an output stream's contents.
+
+		@param _Stream The stream whose contents are copied.
+		@param _Flags  Delivery flags for the packet.
+		@return The new packet, or nullptr if it could not be allocated.
+	 */
+	void*
+	pool_manager::make_packet(const ostream& _Stream, pool_flags _Flags) {
+		ENetPacket* packet = enet_packet_create(nullptr, _Stream.total_size(), static_cast<enet_uint32>(_Flags));
+		if (packet != nullptr) {
+			_Stream.gather(packet->data);
+		}
+		return packet;
+	}
+
+	/*
+		@brief Append one shared ENet packet to several peers' queues.
+
+		@param _Peers   The peers that should receive the packet.
+		@param _Packet  The packet to queue; the queues take one reference per peer.
+		@param _Channel The ENet channel to send the packet on.
+		@return The number of peers the packet was queued for.
+	 */
+	std::size_t
+	pool_manager::enqueue_many(std::span<const peer_t> _Peers, void* _Packet, std::uint8_t _Channel) {
+		ENetPacket* packet = static_cast<ENetPacket*>(_Packet);
+		std::size_t queued = 0;
+		if (inbox == nullptr) {
+			for (const peer_t peer : _Peers) {
+				if (peer != nullptr) {
+					core::Core_enet_packet_retain(packet);
+					append({ peer, _Packet, _Channel });
+					++queued;
+				}
+			}
+		} else if (batch.owner == this) {
+			for (const peer_t peer : _Peers) {
+				if (peer != nullptr) {
+					core::Core_enet_packet_retain(packet);
+					batch.entries.push_back({ peer, _Packet, _Channel });
+					++queued;
+				}
+			}
+		} else {
+			//
+			// Take every reference before the batch becomes visible to the I/O thread
+			//
+			std::size_t first = 0;
+			for (const peer_t peer : _Peers) {
+				queued += (peer != nullptr);
+			}
+			core::Core_enet_packet_retain(packet, queued);
+			const bool pushed = inbox->push_bulk(queued, [&](std::size_t) {
+				while (_Peers[first] == nullptr) {
+					++first;
+				}
+				return pool_entry{ _Peers[first++], _Packet, _Channel };
+			});
+			if (!pushed) {
+				//
+				// No other thread saw the references, so the packet goes as a whole
+				//
+				queued = 0;
+			}
+		}
+
+		if (queued == 0) {
+			enet_packet_destroy(packet);
+		}
+		return queued;
+	}
+
+	/*
+		@brief Append an ENet packet to a peer's queue.
+
+		@param _Peer    The peer that should receive the packet.
+		@param _Packet  The packet to queue; the queue takes a reference on it.
+		@param _Channel The ENet channel to send the packet on.
+		@return true if the packet was queued, false if the inbox is full.
+	 */
+	bool
+	pool_manager::enqueue(peer_t _Peer, void* _Packet, std::uint8_t _Channel) {
+		//
+		// The queue keeps its own reference until the packet is handed to ENet
+		//
+		core::Core_enet_packet_retain(_Packet);
+
+		if (inbox == nullptr) {
+			append({ _Peer, _Packet, _Channel });
+			return true;
+		}
+
+		if (batch.owner == this) {
+			batch.entries.push_back({ _Peer, _Packet, _Channel });
+			return true;
+		}
+
+		if (!inbox->push({ _Peer, _Packet, _Channel })) {
+			core::Core_enet_packet_release(_Packet);
+			return false;
+		}
+		return true;
+	}
+
+	/*
+		@brief Append a record to its peer's queue (I/O thread only).
+
+		@param _Entry The record to append; it already owns a packet reference.
+	 */
+	void
+	pool_manager::append(const pool_entry& _Entry) {
+		const std::uint16_t slot = static_cast<ENetPeer*>(_Entry.peer)->incomingPeerID;
+		if (slot >= queues.size()) {
+			queues.resize(slot + 1);
+		}
+
+		auto& queue = queues[slot];
+		if (queue.empty()) {
+			dirty.push_back(slot);
+		}
+
+		queue.push_back(_Entry);
+		++count;
+	}
+
+	/*
+		@brief Take a record off the inbox (I/O thread only).
+
+		@param _Entry The record to append, or a retire() marker to apply.
+	 */
+	void
+	pool_manager::accept(const pool_entry& _Entry) {
+		if (_Entry.packet == nullptr && _Entry.channel == retire_marker) {
+			drop(_Entry.peer);
+		} else {
+			append(_Entry);
+		}
+	}
+
+	/*
+		@brief Enable or disable pushes from multiple threads.
+
+		@param _Concurrent Whether pushes may come from several threads.
+	 */
+	void
+	pool_manager::set_concurrent(bool _Concurrent) {
+		if (_Concurrent) {
+			if (inbox == nullptr) {
+				inbox = std::make_unique<mpsc_ring<pool_entry, inbox_capacity>>();
+			}
+			return;
+		}
+
+		if (inbox != nullptr) {
+			//
+			// Keep anything already posted; it goes out with the next flush
+			//
+			pool_entry entry;
+			while (inbox->pop(entry)) {
+				accept(entry);
+			}
+			inbox.reset();
+		}
+	}
+
+	/*
+		@brief Start collecting the calling thread's pushes into one batch.
+	 */
+	void
+	pool_manager::begin_batch() {
+		if (inbox != nullptr) {
+			batch.owner = this;
+		}
+	}
+
+	/*
+		@brief Publish the pushes collected since begin_batch().
+
+		@return The number of packet records published.
+	 */
+	std::size_t
+	pool_manager::commit_batch() {
+		if (batch.owner != this) {
+			return 0;
+		}
+
+		batch.owner = nullptr;
+		const std::size_t size = batch.entries.size();
+		const bool pushed = size == 0 || (inbox != nullptr && inbox->push_bulk(size, [](std::size_t _Index) {
+			return batch.entries[_Index];
+		}));
+		if (!pushed) {
+			release_entries(batch.entries);
+		}
+		batch.entries.clear();
+		return pushed ? size : 0;
+	}
+
+	/*
+		@brief Discard every packet still queued for a peer.
+
+		@param _Peer The peer whose queue should be dropped.
+	 */
+	void
+	pool_manager::drop(peer_t _Peer) noexcept {
+		const std::uint16_t slot = static_cast<ENetPeer*>(_Peer)->incomingPeerID;
+		if (slot >= queues.size()) {
+			return;
+		}
+
+		release_entries(queues[slot]);
+		count -= queues[slot].size();
+		queues[slot].clear();
+	}
+
+	/*
+		@brief Discard a disconnected peer's queue once its handlers are done.
+
+		@param _Peer The peer that disconnected.
+	 */
+	void
+	pool_manager::retire(peer_t _Peer) {
+		if (inbox == nullptr) {
+			drop(_Peer);
+			return;
+		}
+		post_marker({ _Peer, nullptr, retire_marker });
+	}
+
+	/*
+		@brief Disconnect a peer once the packets queued before are sent.
+
+		@param _Peer The peer to disconnect.
+	 */
+	void
+	pool_manager::kick(peer_t _Peer) {
+		if (_Peer == nullptr) {
+			return;
+		}
+
+		if (inbox == nullptr) {
+			append({ _Peer, nullptr, kick_marker });
+			return;
+		}
+		post_marker({ _Peer, nullptr, kick_marker });
+	}
+
+	/*
+		@brief Queue a control record behind the calling thread's sends.
+
+		@param _Marker The record, whose packet is nullptr.
+	 */
+	void
+	pool_manager::post_marker(const pool_entry& _Marker) {
+		if (batch.owner == this) {
+			batch.entries.push_back(_Marker);
+			return;
+		}
+		//
+		// Waiting for room could deadlock against an I/O thread blocked
+		// posting to this worker, so a full inbox loses the marker like a send
+		//
+		inbox->push(_Marker);
+	}
+
+	/*
+		@brief Move all queued packets out of the per-peer queues.
+
+		@return Reference to the drained packet records, grouped by peer.
+	 */
+	std::vector<pool_entry>&
+	pool_manager::flush_packets() {
+		if (inbox != nullptr) {
+			pool_entry entry;
+			while (inbox->pop(entry)) {
+				accept(entry);
+			}
+		}
+
+		drained.clear();
+		for (const std::uint16_t slot : dirty) {
+			auto& queue = queues[slot];
+			drained.insert(drained.end(), queue.begin(), queue.end());
+			queue.clear();
+		}
+		dirty.clear();
+		count = 0;
+		return drained;
+	}
+}
@@ -0,0 +1,135 @@
+#include <exception>
+#include "core.h"
+#include "pool.h"
+#include "runtime.h"
+#include "shard.h"
+
+namespace cat {
+	/*
+		Leaves a still-running pump alone.
+
+		Only reached at process exit with the pump never stopped; the
+		thread has been terminated by then, so waiting for it would hang
+		under the loader lock.
+	 */
+	client_runtime::~client_runtime() {
+		if (thread.joinable()) {
+			thread.detach();
+		}
+	}
+
+	/*
+		Starts connecting to a server and launches the pump thread.
+
+		@param _Host   The server's host name or IP address.
+		@param _Port   The server's port.
+		@param _Checks The integrity check to use.
+	 */
+	void
+	client_runtime::start(std::string_view _Host, std::uint16_t _Port, core::integrity _Checks) {
+		if (running()) {
+			return;
+		}
+		//
+		// A pump that died still holds the host; tear it down before starting over
+		//
+		stop();
+
+		auto remote = std::make_unique<client>(_Host, _Port, pump_timeout);
+		auto queue = std::make_unique<worker_pool>(1);
+		core::Core_enet_set_integrity(_Checks);
+		try {
+			remote->connect();
+		}
+		catch (...) {
+			remote->disconnect();
+			throw;
+		}
+		//
+		// From here on the pump owns the host and posts every event to the queue
+		//
+		core::Core_enet_attach_workers(queue.get());
+		pool_manager::instance().begin_batch();
+
+		endpoint = std::move(remote);
+		events = std::move(queue);
+		shard = current_shard();
+		stopping = false;
+		finished = false;
+		thread = std::thread(&client_runtime::pump, this);
+	}
+
+	/*
+		Runs one frame on the application thread.
+
+		@param _Budget Maximum number of events to deliver.
+		@return The number of events delivered.
+	 */
+	std::size_t
+	client_runtime::frame(std::size_t _Budget) {
+		if (events == nullptr) {
+			return 0;
+		}
+
+		const std::size_t count = events->drain(_Budget);
+		//
+		// Everything the frame sent leaves in the same pump flush
+		//
+		pool_manager& pool = pool_manager::instance();
+		pool.commit_batch();
+		pool.begin_batch();
+		return count;
+	}
+
+	/*
+		Stops the pump thread and disconnects.
+	 */
+	void
+	client_runtime::stop() {
+		if (endpoint == nullptr) {
+			return;
+		}
+
+		stopping = true;
+		//
+		// Keep draining so a pump blocked on a full queue can finish
+		//
+		while (!finished.load(std::memory_order_acquire)) {
+			events->drain();
+			std::this_thread::yield();
+		}
+		thread.join();
+		//
+		// The host is ours again: deliver what is left, send the last
+		// batch, then tear the connection down
+		//
+		events->drain();
+		pool_manager::instance().commit_batch();
+		core::Core_enet_attach_workers(nullptr);
+		core::Core_enet_send();
+		endpoint->disconnect();
+
+		endpoint.reset();
+		events.reset();
+	}
+
+	/*
+		Pump thread body.
+	 */
+	void
+	client_runtime::pump() {
+		set_current_shard(shard);
+		try {
+			while (!stopping.load(std::memory_order_acquire)) {
+				endpoint->flush();
+			}
+		}
+		catch (const std::exception&) {
+			//
+			// A failed reconnect ends the pump. running() reports it from
+			// here on, and stop() or the next start() cleans up
+			//
+		}
+		finished.store(true, std::memory_order_release);
+	}
+}
@@ -0,0 +1,141 @@
+#include <thread>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <timeapi.h>
+#endif
+#include "arena.h"
+#include "core.h"
+#include "net.h"
+#include "bus.h"
+#include "metrics.h"
+#include "scheduler.h"
+#include "trace.h"
+
+namespace cat {
+	/*
+		Constructs a scheduler.
+
+		@param _TickRate    Ticks per second.
+		@param _EventBudget Maximum network events dispatched per tick.
+	 */
+	scheduler::scheduler(std::uint32_t _TickRate, std::size_t _EventBudget) noexcept
+		: interval(std::chrono::nanoseconds(std::chrono::seconds(1)) / (_TickRate == 0 ? 1 : _TickRate)),
+		  budget(_EventBudget) {
+	}
+
+	/*
+		Registers a hook called once per tick.
+
+		@param _Fn      Function called with the context and the tick number.
+		@param _Context Opaque pointer passed back to the hook.
+	 */
+	void
+	scheduler::on_tick(tick_fn _Fn, void* _Context) {
+		hooks.push_back({ _Fn, _Context });
+	}
+
+	/*
+		Executes a single tick without sleeping.
+	 */
+	void
+	scheduler::tick() {
+		CAT_TRACE_ZONE("scheduler::tick");
+		const auto start = clock::now();
+		//
+		// Drain network events without blocking, bounded by the budget
+		//
+		const std::size_t events = core::Core_enet_poll(0, budget);
+		counters.events += events;
+		if (events == budget) {
+			++counters.budget_hits;
+		}
+		//
+		// Deliver messages posted by other shards
+		//
+		shard_bus::instance().dispatch();
+		//
+		// Run due timers, catching up on any dropped deadlines
+		//
+		wheel.advance(1 + lag);
+		lag = 0;
+		for (const hook& h : hooks) {
+			h.fn(h.context, counters.ticks);
+		}
+		//
+		// Flush everything queued during this tick in one burst
+		//
+		core::Core_enet_send();
+		//
+		// Nothing allocated from the tick arena outlives the tick
+		//
+		tick_arena::reset();
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start);
+		++counters.ticks;
+		counters.last = elapsed;
+		counters.total += elapsed;
+		if (elapsed > counters.max) {
+			counters.max = elapsed;
+		}
+		if (elapsed > interval) {
+			++counters.overruns;
+		}
+
+		metrics::record_tick(elapsed);
+		if (counters.ticks % ticks(std::chrono::seconds(1)) == 0) {
+			metrics::sample_peers();
+		}
+	}
+
+	/*
+		Runs ticks at the configured rate until cat::is_connect() turns false.
+	 */
+	void
+	scheduler::run() {
+#ifdef _WIN32
+		//
+		// Raise the system timer resolution so sleeps are accurate to ~1 ms
+		//
+		timeBeginPeriod(1);
+#endif
+		auto deadline = clock::now();
+		while (is_connect()) {
+			tick();
+			trace::end_tick(counters.last);
+
+			deadline += interval;
+			const auto now = clock::now();
+			if (now - deadline > interval * max_lag) {
+				//
+				// Too far behind: drop the missed deadlines instead of bursting
+				//
+				const auto missed = static_cast<std::uint64_t>((now - deadline) / interval);
+				counters.skipped += missed;
+				lag += missed;
+				deadline = now;
+			} else if (now < deadline) {
+				wait_until(deadline);
+			}
+		}
+#ifdef _WIN32
+		timeEndPeriod(1);
+#endif
+	}
+
+	/*
+		Sleeps until the deadline, finishing the last stretch with a yield loop.
+
+		@param _Deadline The point in time to wake up at.
+	 */
+	void
+	scheduler::wait_until(clock::time_point _Deadline) {
+		constexpr auto spin = std::chrono::milliseconds(1);
+		if (_Deadline - clock::now() > spin) {
+			std::this_thread::sleep_until(_Deadline - spin);
+		}
+		while (clock::now() < _Deadline) {
+			std::this_thread::yield();
+		}
+	}
+}
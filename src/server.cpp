@@ -1,41 +1,265 @@
+#include <algorithm>
+#include <chrono>
+#include <format>
 #include <print>
+#include <string>
+#include <thread>
+#include <vector>
 #include <magic_args/magic_args.hpp>
+#include "bus.h"
+#include "capture.h"
+#include "checksum.h"
 #include "cli.h"
+#include "core.h"
+#include "dispatcher.h"
+#include "limiter.h"
+#include "metrics.h"
+#include "scheduler.h"
+#include "session_store.h"
+#include "shard.h"
+#include "state.h"
+#include "trace.h"
 #include "users.h"
+#include "worker.h"
 #include "server.h"
 
-int main(int argc, char* argv[]) {
+/*
+	Names a shard's capture or snapshot file: the path itself for
+	shard 0, the path with a .<shard> suffix for the others.
+ */
+static std::string shard_file(const std::string& _Path, std::size_t _Shard) {
+	return _Shard == 0 ? _Path : std::format("{}.{}", _Path, _Shard);
+}
+
+/*
+	Reads an overflow policy name.
+
+	@param _Name   drop, defer or kick.
+	@param _Policy Receives the policy.
+	@return Whether the name is known.
+ */
+static bool parse_policy(std::string_view _Name, cat::overflow_policy& _Policy) {
+	if (_Name == "drop") {
+		_Policy = cat::overflow_policy::drop;
+	} else if (_Name == "defer") {
+		_Policy = cat::overflow_policy::defer;
+	} else if (_Name == "kick") {
+		_Policy = cat::overflow_policy::kick;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/*
+	Builds the rate limits from the command line.
+
+	@param _Args The parsed command-line arguments.
+ */
+static cat::rate_limit rate_limits(const cli::cmd_args& _Args) {
+	cat::rate_limit limits;
+	limits.rate = _Args.rate;
+	limits.burst = _Args.burst;
+	limits.per_tick = _Args.pertick;
+	limits.max_backlog = _Args.backlog;
+	parse_policy(_Args.overflow, limits.policy);
+	return limits;
+}
+
+/*
+	Replays a capture through the shard's handlers and reports the run.
+
+	@param _Args  The parsed command-line arguments.
+	@param _Shard The shard index.
+ */
+static void replay_shard(const cli::cmd_args& _Args, std::size_t _Shard) {
+	const std::string path = shard_file(_Args.replay, _Shard);
+	cat::replay replay(path);
+	std::println("- [{}] Replaying {}", _Shard, path);
+
+	const auto res = replay.run(_Args.speed);
+	const double seconds = std::chrono::duration<double>(res.elapsed).count();
+	std::println("- [{}] {} events ({} connects, {} disconnects, {} messages) in {:.3f} s{}",
+		_Shard, res.events, res.connects, res.disconnects, res.messages, seconds,
+		res.truncated ? ", log truncated" : "");
+	if (seconds > 0) {
+		std::println("- [{}] {:.0f} messages/s, {:.1f} MB/s in, {:.1f} MB/s out",
+			_Shard, res.messages / seconds, res.bytes_in / seconds / 1e6, res.bytes_out / seconds / 1e6);
+	}
+}
+
+/*
+	Runs one shard: a host on its own port with its own user table,
+	service, dispatcher and tick loop.
+
+	@param _Args  The parsed command-line arguments.
+	@param _Shard The shard index; the host listens on port + shard.
+ */
+static void run_shard(const cli::cmd_args& _Args, std::size_t _Shard) {
+	cat::set_current_shard(_Shard);
+	cat::trace::name_thread(std::format("shard {}", _Shard));
 	//
-	// Parse command-line arguments
+	// Map the session snapshot first, so the user table resumes from it
 	//
-	const auto args = magic_args::parse<cli::cmd_args>(argc, argv);
+	if (!_Args.sessions.empty() && _Args.replay.empty()) {
+		const std::string path = shard_file(_Args.sessions, _Shard);
+		const bool resumed = cat::session_store::open(path, _Args.maxusers);
+		std::println("- [{}] Sessions {} {}", _Shard, resumed ? "resumed from" : "kept in", path);
+	}
 	//
 	// Initialize user system
 	//
-	cat::setup_user_system();
+	cat::setup_user_system(_Args.maxusers);
 	//
-	// Create a server instance listening on localhost:8080
+	// Route incoming messages through the typed dispatcher
 	//
-	cat::server srv(args->host, args->port);
-	std::println("- Server listening on {}", srv.ipaddress().c_str());
+	cat::dispatcher::attach(cat::service::instance());
+	//
+	// A replay drives the handlers from a capture instead of a host
+	//
+	if (!_Args.replay.empty()) {
+		replay_shard(_Args, _Shard);
+		return;
+	}
+	//
+	// Create a server instance listening on host:port + shard
+	//
+	cat::server srv(_Args.host, static_cast<std::uint16_t>(_Args.port + _Shard), _Args.maxusers);
+	std::println("- [{}] Server listening on {}", _Shard, srv.ipaddress().c_str());
+	//
+	// Keep flooding peers from eating the other peers' tick budget
+	//
+	cat::limiter::configure(rate_limits(_Args), _Args.maxusers);
+	//
+	// Checksum every datagram if asked; clients must use the same mode
+	//
+	cat::core::integrity integrity = cat::core::integrity::none;
+	cli::parse_integrity(_Args.integrity, integrity);
+	cat::core::Core_enet_set_integrity(integrity);
+	if (integrity != cat::core::integrity::none) {
+		std::println("- [{}] Checksumming datagrams with CRC-32C ({})", _Shard,
+			cat::crc32c_accelerated() ? "SSE4.2" : "portable");
+	}
 	//
 	// Connect the server
 	//
 	srv.connect();
-	std::println("- Server connected");
+	std::println("- [{}] Server connected", _Shard);
 	//
-	// Main server loop
+	// Optionally record the host's traffic for later replay
 	//
-	while (cat::is_connect()) {
-		//
-		// Poll for incoming events
-		//
-		srv.flush();
+	if (!_Args.capture.empty()) {
+		cat::capture::start(shard_file(_Args.capture, _Shard));
+		std::println("- [{}] Capturing traffic to {}", _Shard, shard_file(_Args.capture, _Shard));
+	}
+	//
+	// Optionally hand message handling to a worker pool
+	//
+	cat::worker_pool workers(_Args.workers);
+	if (_Args.workers > 0) {
+		workers.start();
+		cat::core::Core_enet_attach_workers(&workers);
+		std::println("- [{}] Handling messages on {} worker threads", _Shard, _Args.workers);
+	}
+	//
+	// Main server loop, running at a fixed tick rate
+	//
+	cat::scheduler scheduler(_Args.tickrate);
+	if (cat::session_store::active()) {
+		scheduler.on_tick([](void* _Context, std::uint64_t _Tick) {
+			if (_Tick % static_cast<cat::scheduler*>(_Context)->ticks(std::chrono::seconds(1)) == 0) {
+				cat::session_store::sync();
+			}
+		}, &scheduler);
+	}
+	//
+	// Close the tick's player state once the handlers have updated it;
+	// with worker threads, once they have handled the tick's events
+	//
+	scheduler.on_tick([](void* _Context, std::uint64_t) {
+		if (_Context != nullptr) {
+			static_cast<const cat::worker_pool*>(_Context)->quiesce();
+		}
+		cat::state_store::commit();
+	}, _Args.workers > 0 ? &workers : nullptr);
+	std::println("- [{}] Server ticking at {} Hz", _Shard, _Args.tickrate);
+	scheduler.run();
+	const auto& stats = scheduler.stats();
+	std::println("- [{}] {} ticks, {} overruns, {} skipped, max tick {} us",
+		_Shard, stats.ticks, stats.overruns, stats.skipped, stats.max.count() / 1000);
+	if (cat::capture::active()) {
+		const std::size_t size = cat::capture::stop();
+		std::println("- [{}] Captured {} bytes{}", _Shard, size,
+			cat::capture::failed() ? ", stopped early: the capture file could not be grown" : "");
+	}
+	//
+	// Let the workers finish pending events before tearing down the host
+	//
+	if (_Args.workers > 0) {
+		workers.stop();
+		cat::core::Core_enet_attach_workers(nullptr);
 	}
 	//
 	// Disconnect the server
 	//
+	cat::shard_bus::instance().close();
 	srv.disconnect();
-	std::println("- Server disconnected\n");
+	cat::session_store::close();
+	std::println("- [{}] Server disconnected", _Shard);
+}
+
+int main(int argc, char* argv[]) {
+	//
+	// Parse command-line arguments
+	//
+	const auto args = magic_args::parse<cli::cmd_args>(argc, argv);
+	cat::overflow_policy policy;
+	if (!parse_policy(args->overflow, policy)) {
+		std::println("- Unknown overflow policy {}; expected drop, defer or kick", args->overflow);
+		return 1;
+	}
+	cat::core::integrity integrity;
+	if (!cli::parse_integrity(args->integrity, integrity) || integrity == cat::core::integrity::automatic) {
+		std::println("- Unknown integrity mode {}; expected none or crc32c", args->integrity);
+		return 1;
+	}
+	//
+	// Optionally serve metrics for the whole process
+	//
+	cat::metrics_exporter exporter;
+	if (args->metrics != 0) {
+		exporter.start(args->host, args->metrics);
+		std::println("- Metrics served on {}:{}", args->host, args->metrics);
+	}
+	//
+	// Optionally keep the trace zones of slow ticks
+	//
+	if (!args->trace.empty() && !cat::trace::enabled) {
+		std::println("- Tracing is not compiled in; rebuild with CSOVMWARE_TRACE");
+	}
+	if (!args->trace.empty() && args->hitch != 0) {
+		cat::trace::watch_hitches(args->trace, std::chrono::milliseconds(args->hitch));
+	}
+	//
+	// A single host runs on the main thread; more get a thread each
+	//
+	const std::size_t shards = std::clamp<std::size_t>(args->shards, 1, cat::shard_count);
+	if (shards == 1) {
+		run_shard(*args, 0);
+	} else {
+		std::vector<std::thread> threads;
+		threads.reserve(shards);
+		for (std::size_t i = 0; i < shards; ++i) {
+			threads.emplace_back(run_shard, std::cref(*args), i);
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	}
+
+	if (!args->trace.empty() && cat::trace::enabled && cat::trace::dump(args->trace)) {
+		std::println("- Trace written to {}", args->trace);
+	}
+	std::println("");
 	return 0;
-}
\ No newline at end of file
+}
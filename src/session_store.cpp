@@ -0,0 +1,163 @@
+#include <cstring>
+#include <stdexcept>
+#include "mapped_file.h"
+#include "session_store.h"
+#include "shard.h"
+
+namespace cat {
+	/*
+		Leading bytes of a snapshot file.
+	 */
+	struct snapshot_header {
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t capacity;
+		std::uint32_t state_size;
+		std::uint32_t reserved;
+	};
+
+	//< File signature
+	static constexpr char snapshot_magic[8] = { 'C', 'S', 'O', 'V', 'S', 'E', 'S', '\0' };
+
+	//< Alignment of the records and state blocks within the file
+	static constexpr std::size_t block_align = 64;
+
+	/*
+		Snapshot of one shard.
+	 */
+	struct store_state {
+		//< The mapped snapshot file
+		mapped_file file;
+
+		//< Slot records within the mapping
+		session_record* records = nullptr;
+
+		//< Session state blocks within the mapping
+		std::byte* state = nullptr;
+
+		//< Number of user slots
+		std::size_t capacity = 0;
+	};
+
+	/*
+		Returns the calling shard's snapshot.
+	 */
+	static store_state&
+	store() noexcept {
+		return shard_local<store_state>();
+	}
+
+	/*
+		Rounds a size up to the block alignment.
+	 */
+	static constexpr std::size_t
+	align_block(std::size_t _Size) noexcept {
+		return (_Size + block_align - 1) / block_align * block_align;
+	}
+
+	/*
+		Returns the offset of the state blocks in a file for a capacity.
+	 */
+	static constexpr std::size_t
+	state_offset(std::size_t _Capacity) noexcept {
+		return align_block(sizeof(snapshot_header)) + align_block(_Capacity * sizeof(session_record));
+	}
+
+	/*
+		Maps a snapshot file, creating or resetting it if it does not match.
+
+		@param _Path     The snapshot file.
+		@param _Capacity The number of user slots.
+		@return true if an earlier snapshot was resumed.
+	 */
+	bool
+	session_store::open(const std::string& _Path, std::size_t _Capacity) {
+		store_state& s = store();
+		close();
+
+		const std::size_t size = state_offset(_Capacity) + _Capacity * state_size;
+		if (!s.file.open(_Path, mapped_file::mode::update, size)) {
+			throw std::runtime_error("Failed to map the session snapshot file.");
+		}
+
+		std::byte* base = s.file.bytes().data();
+		snapshot_header header;
+		std::memcpy(&header, base, sizeof(header));
+		const bool resumed = std::memcmp(header.magic, snapshot_magic, sizeof(snapshot_magic)) == 0 &&
+			header.version == version && header.capacity == _Capacity && header.state_size == state_size;
+		if (!resumed) {
+			//
+			// A new file, another capacity or another build: start from an empty table
+			//
+			std::memset(base, 0, size);
+			header = {};
+			std::memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+			header.version = version;
+			header.capacity = static_cast<std::uint32_t>(_Capacity);
+			header.state_size = static_cast<std::uint32_t>(state_size);
+			std::memcpy(base, &header, sizeof(header));
+		}
+
+		s.records = reinterpret_cast<session_record*>(base + align_block(sizeof(snapshot_header)));
+		s.state = base + state_offset(_Capacity);
+		s.capacity = _Capacity;
+		return resumed;
+	}
+
+	/*
+		Writes the snapshot back and unmaps it.
+	 */
+	void
+	session_store::close() noexcept {
+		store_state& s = store();
+		if (!s.file.is_open()) {
+			return;
+		}
+
+		sync();
+		s.file.close();
+		s.records = nullptr;
+		s.state = nullptr;
+		s.capacity = 0;
+	}
+
+	/*
+		Returns whether a snapshot is mapped.
+	 */
+	bool
+	session_store::active() noexcept {
+		return store().records != nullptr;
+	}
+
+	/*
+		Starts writing changed pages back to disk.
+	 */
+	void
+	session_store::sync() noexcept {
+		store_state& s = store();
+		s.file.flush(0, s.file.size());
+	}
+
+	/*
+		Returns the slot records.
+	 */
+	std::span<session_record>
+	session_store::records() noexcept {
+		store_state& s = store();
+		return { s.records, s.capacity };
+	}
+
+	/*
+		Returns a slot's session state.
+
+		@param _Slot The user slot.
+	 */
+	std::span<std::byte>
+	session_store::state(std::size_t _Slot) noexcept {
+		store_state& s = store();
+		if (_Slot >= s.capacity) {
+			return {};
+		}
+		return { s.state + _Slot * state_size, state_size };
+	}
+}
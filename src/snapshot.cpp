@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <limits>
+#include "snapshot.h"
+
+namespace cat {
+	/*
+		Record kinds, stored in the low two bits of a record header.
+	 */
+	enum class record_kind : std::uint8_t {
+		update	= 0,
+		create	= 1,
+		remove	= 2,
+		end		= 3,
+	};
+
+	//< Upper bound on the encoded size of one record
+	constexpr std::size_t max_record_size = ostream::max_varint_size * (2 + snapshot_fields);
+
+	//< Mask with one bit per entity field
+	constexpr std::uint32_t all_fields = (std::uint64_t{ 1 } << snapshot_fields) - 1;
+
+	static_assert(snapshot_fields <= 32, "field masks are 32 bits wide");
+
+	/*
+		Sorts the entities by ID.
+	 */
+	void
+	snapshot::seal() {
+		std::ranges::sort(entities, {}, &entity_state::id);
+	}
+
+	/*
+		Looks an entity up by ID.
+
+		@param _Id The entity's ID.
+		@return The entity's state, or nullptr if it is not part of the snapshot.
+	 */
+	const entity_state*
+	snapshot::find(std::uint32_t _Id) const noexcept {
+		const auto it = std::ranges::lower_bound(entities, _Id, {}, &entity_state::id);
+		return (it != entities.end() && it->id == _Id) ? &*it : nullptr;
+	}
+
+	/*
+		Writes one entity record.
+
+		@param _Stream The stream receiving the record.
+		@param _Gap    Distance from the previous record's entity ID.
+		@param _Kind   The record kind.
+		@param _State  The entity's new state (update and create only).
+		@param _Base   The state the deltas are relative to.
+		@param _Mask   The fields to write.
+	 */
+	static void
+	write_record(ostream& _Stream, std::uint32_t _Gap, record_kind _Kind,
+		const entity_state* _State, const entity_state& _Base, std::uint32_t _Mask) {
+		ostream::cursor out = _Stream.reserve_write(max_record_size);
+		out.write_varint(std::uint64_t{ _Gap } << 2 | static_cast<std::uint8_t>(_Kind));
+		if (_State == nullptr) {
+			return;
+		}
+
+		out.write_varint(_Mask);
+		for (std::size_t i = 0; i < snapshot_fields; ++i) {
+			if (_Mask & (1u << i)) {
+				out.write_zigzag(std::int64_t{ _State->fields[i] } - _Base.fields[i]);
+			}
+		}
+	}
+
+	/*
+		Returns the mask of fields that differ between two states.
+	 */
+	static std::uint32_t
+	changed_fields(const entity_state& _State, const entity_state& _Base) noexcept {
+		std::uint32_t mask = 0;
+		for (std::size_t i = 0; i < snapshot_fields; ++i) {
+			mask |= static_cast<std::uint32_t>(_State.fields[i] != _Base.fields[i]) << i;
+		}
+		return mask;
+	}
+
+	/*
+		Encodes a snapshot against the peer's acknowledged baseline.
+
+		@param _Current The sealed snapshot to send.
+		@param _Stream  The stream receiving the encoding.
+		@return true if a delta was written, false if it was a full snapshot.
+	 */
+	bool
+	snapshot_encoder::encode(const snapshot& _Current, ostream& _Stream) {
+		static const snapshot empty{};
+		static const entity_state zero{};
+
+		//
+		// Only a baseline still inside the window is known to the peer as well
+		//
+		const snapshot* base = nullptr;
+		const std::uint32_t distance = _Current.sequence - acked;
+		if (acked != 0 && distance != 0 && distance < snapshot_window) {
+			const snapshot& candidate = history[acked & (snapshot_window - 1)];
+			if (candidate.sequence == acked) {
+				base = &candidate;
+			}
+		}
+
+		const snapshot& from = (base != nullptr) ? *base : empty;
+		_Stream.write_varint(_Current.sequence);
+		_Stream.write_varint(base != nullptr ? distance : 0);
+
+		auto cur = _Current.entities.begin();
+		auto old = from.entities.begin();
+		std::uint32_t prev = 0;
+		while (cur != _Current.entities.end() || old != from.entities.end()) {
+			if (old == from.entities.end() || (cur != _Current.entities.end() && cur->id < old->id)) {
+				write_record(_Stream, cur->id - prev, record_kind::create, &*cur, zero, changed_fields(*cur, zero));
+				prev = cur->id;
+				++cur;
+			} else if (cur == _Current.entities.end() || old->id < cur->id) {
+				write_record(_Stream, old->id - prev, record_kind::remove, nullptr, zero, 0);
+				prev = old->id;
+				++old;
+			} else {
+				if (const std::uint32_t mask = changed_fields(*cur, *old); mask != 0) {
+					write_record(_Stream, cur->id - prev, record_kind::update, &*cur, *old, mask);
+					prev = cur->id;
+				}
+				++cur;
+				++old;
+			}
+		}
+		write_record(_Stream, 0, record_kind::end, nullptr, zero, 0);
+
+		history[_Current.sequence & (snapshot_window - 1)] = _Current;
+		last = _Current.sequence;
+		return base != nullptr;
+	}
+
+	/*
+		Records an acknowledgement from the peer.
+
+		@param _Sequence The sequence number the peer received.
+	 */
+	void
+	snapshot_encoder::acknowledge(std::uint32_t _Sequence) noexcept {
+		//
+		// A peer can only have received what was sent and is still in the history
+		//
+		if (_Sequence > acked && _Sequence <= last &&
+			history[_Sequence & (snapshot_window - 1)].sequence == _Sequence) {
+			acked = _Sequence;
+		}
+	}
+
+	/*
+		Forgets the history and the baseline.
+	 */
+	void
+	snapshot_encoder::reset() noexcept {
+		for (snapshot& slot : history) {
+			slot.clear(0);
+		}
+		acked = 0;
+		last = 0;
+	}
+
+	/*
+		Reads the deltas of one record onto a state.
+
+		@param _Stream The stream holding the record.
+		@param _State  The state to update in place.
+		@return true if the field data was valid, false otherwise.
+	 */
+	static bool
+	read_fields(istream& _Stream, entity_state& _State) noexcept {
+		std::uint32_t mask;
+		if (!_Stream.read_varint(mask) || (mask & ~all_fields) != 0) {
+			return false;
+		}
+
+		for (std::size_t i = 0; i < snapshot_fields; ++i) {
+			if ((mask & (1u << i)) == 0) {
+				continue;
+			}
+
+			std::int64_t delta;
+			if (!_Stream.read_zigzag(delta)) {
+				return false;
+			}
+			const std::int64_t value = _State.fields[i] + delta;
+			if (value < std::numeric_limits<std::int32_t>::min() || value > std::numeric_limits<std::int32_t>::max()) {
+				return false;
+			}
+			_State.fields[i] = static_cast<std::int32_t>(value);
+		}
+		return true;
+	}
+
+	/*
+		Applies the records of an encoding to a baseline.
+
+		@param _Stream The stream positioned at the first record.
+		@param _Base   The baseline snapshot (empty for a full snapshot).
+		@param _Out    The snapshot receiving the result.
+		@return true if the records were valid, false otherwise.
+	 */
+	static bool
+	apply_records(istream& _Stream, const snapshot& _Base, snapshot& _Out) {
+		auto old = _Base.entities.begin();
+		std::uint64_t prev = 0;
+		bool first = true;
+		for (;;) {
+			std::uint64_t header;
+			if (!_Stream.read_varint(header)) {
+				return false;
+			}
+
+			const auto kind = static_cast<record_kind>(header & 3);
+			if (kind == record_kind::end) {
+				_Out.entities.insert(_Out.entities.end(), old, _Base.entities.end());
+				return true;
+			}
+
+			const std::uint64_t id = prev + (header >> 2);
+			if (id > std::numeric_limits<std::uint32_t>::max() || (!first && id == prev)) {
+				return false;
+			}
+			prev = id;
+			first = false;
+
+			//
+			// Entities the record skipped over are unchanged
+			//
+			while (old != _Base.entities.end() && old->id < id) {
+				_Out.entities.push_back(*old++);
+			}
+			const bool present = old != _Base.entities.end() && old->id == id;
+
+			switch (kind) {
+			case record_kind::create:
+				if (present) {
+					return false;
+				}
+				if (!read_fields(_Stream, _Out.add(static_cast<std::uint32_t>(id)))) {
+					return false;
+				}
+				break;
+
+			case record_kind::update:
+				if (!present) {
+					return false;
+				}
+				_Out.entities.push_back(*old++);
+				if (!read_fields(_Stream, _Out.entities.back())) {
+					return false;
+				}
+				break;
+
+			default:
+				if (!present) {
+					return false;
+				}
+				++old;
+				break;
+			}
+		}
+	}
+
+	/*
+		Decodes a snapshot written by snapshot_encoder::encode().
+
+		@param _Stream The stream holding the encoding.
+		@return The decoded snapshot, or nullptr if it cannot be decoded.
+	 */
+	const snapshot*
+	snapshot_decoder::decode(istream& _Stream) {
+		static const snapshot empty{};
+
+		std::uint32_t sequence;
+		std::uint32_t distance;
+		if (!_Stream.read_varint(sequence) || !_Stream.read_varint(distance)) {
+			return nullptr;
+		}
+		if (sequence == 0 || sequence <= newest || distance >= snapshot_window || distance >= sequence) {
+			return nullptr;
+		}
+
+		const snapshot* base = &empty;
+		if (distance != 0) {
+			base = &history[(sequence - distance) & (snapshot_window - 1)];
+			if (base->sequence != sequence - distance) {
+				return nullptr;
+			}
+		}
+
+		snapshot& out = history[sequence & (snapshot_window - 1)];
+		out.clear(sequence);
+		if (!apply_records(_Stream, *base, out)) {
+			out.clear(0);
+			return nullptr;
+		}
+
+		newest = sequence;
+		return &out;
+	}
+
+	/*
+		Forgets every decoded snapshot.
+	 */
+	void
+	snapshot_decoder::reset() noexcept {
+		for (snapshot& slot : history) {
+			slot.clear(0);
+		}
+		newest = 0;
+	}
+}
@@ -0,0 +1,382 @@
+#include <array>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+#include "ring.h"
+#include "shard.h"
+#include "state.h"
+#include "users.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CAT_STATE_SSE2 1
+#else
+#define CAT_STATE_SSE2 0
+#endif
+
+namespace cat {
+	//< Field group of every column
+	constexpr std::array<state_field, state_columns> column_field = {
+		state_field::position, state_field::position, state_field::position,
+		state_field::angles, state_field::angles, state_field::angles,
+		state_field::health,
+		state_field::flags,
+	};
+
+	/*
+		@brief Frees a column buffer allocated with cache-line alignment.
+	 */
+	struct column_free {
+		void operator()(std::int32_t* _Columns) const noexcept {
+			::operator delete(_Columns, std::align_val_t{ cache_line });
+		}
+	};
+
+	/*
+		@brief State store of one shard.
+
+		@member columns Current values, state_columns arrays of capacity slots, followed by the previous commit's values.
+		@member owners User ID of every slot.
+		@member occupied Slots owned by a user.
+		@member fresh Slots spawned since the last commit, reported dirty in every field.
+		@member dirty Dirty bitset of every field group.
+		@member capacity Number of slots, a multiple of state_lane.
+	 */
+	struct state_table {
+		std::unique_ptr<std::int32_t, column_free> columns;
+		std::vector<userid_t> owners;
+		std::vector<std::uint64_t> occupied;
+		std::vector<std::uint64_t> fresh;
+		std::array<std::vector<std::uint64_t>, state_fields> dirty;
+		std::size_t capacity = 0;
+	};
+
+	/*
+		@brief Get the calling shard's state table.
+	 */
+	static state_table& table() noexcept {
+		return shard_local<state_table>();
+	}
+
+	/*
+		@brief Get a column of the current values.
+	 */
+	static std::int32_t* current(const state_table& _Table, std::size_t _Column) noexcept {
+		return _Table.columns.get() + _Column * _Table.capacity;
+	}
+
+	/*
+		@brief Get a column of the values at the last commit.
+	 */
+	static std::int32_t* previous(const state_table& _Table, std::size_t _Column) noexcept {
+		return _Table.columns.get() + (state_columns + _Column) * _Table.capacity;
+	}
+
+	/*
+		@brief Find the slot of a user that owns it.
+
+		@return The slot, or capacity if the ID is stale.
+	 */
+	static std::size_t live_slot(const state_table& _Table, userid_t _User) noexcept {
+		const std::size_t slot = user_slot(_User);
+		if (slot >= _Table.capacity || _Table.owners[slot] != _User ||
+			(_Table.occupied[slot / state_store::state_lane] >> (slot % state_store::state_lane) & 1) == 0) {
+			return _Table.capacity;
+		}
+		return slot;
+	}
+
+	/*
+		@brief Compare one word of slots of a column against its baseline and advance the baseline.
+
+		@param _Current   The current values of the word's slots, cache-line aligned.
+		@param _Previous  The values at the last commit, overwritten with the current ones.
+		@return One bit per slot whose value changed.
+	 */
+	static std::uint64_t compare_word(const std::int32_t* _Current, std::int32_t* _Previous) noexcept {
+		std::uint64_t changed = 0;
+#if CAT_STATE_SSE2
+		for (std::size_t i = 0; i < state_store::state_lane; i += 4) {
+			const __m128i now = _mm_load_si128(reinterpret_cast<const __m128i*>(_Current + i));
+			const __m128i then = _mm_load_si128(reinterpret_cast<const __m128i*>(_Previous + i));
+			const int same = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(now, then)));
+			changed |= static_cast<std::uint64_t>(~same & 0xF) << i;
+			_mm_store_si128(reinterpret_cast<__m128i*>(_Previous + i), now);
+		}
+#else
+		for (std::size_t i = 0; i < state_store::state_lane; ++i) {
+			changed |= static_cast<std::uint64_t>(_Current[i] != _Previous[i]) << i;
+		}
+		std::memcpy(_Previous, _Current, state_store::state_lane * sizeof(std::int32_t));
+#endif
+		return changed;
+	}
+
+	/*
+		Sizes the store and despawns every slot.
+
+		@param _Capacity The number of user slots.
+	 */
+	void
+	state_store::setup(std::size_t _Capacity) {
+		state_table& t = table();
+		const std::size_t capacity = (_Capacity + state_lane - 1) / state_lane * state_lane;
+		const std::size_t words = capacity / state_lane;
+		const std::size_t bytes = 2 * state_columns * capacity * sizeof(std::int32_t);
+
+		std::unique_ptr<std::int32_t, column_free> columns(
+			static_cast<std::int32_t*>(::operator new(bytes, std::align_val_t{ cache_line })));
+		std::memset(columns.get(), 0, bytes);
+
+		t.owners.assign(capacity, 0);
+		t.occupied.assign(words, 0);
+		t.fresh.assign(words, 0);
+		for (std::vector<std::uint64_t>& bits : t.dirty) {
+			bits.assign(words, 0);
+		}
+		t.columns = std::move(columns);
+		t.capacity = capacity;
+	}
+
+	/*
+		Zeroes a user's columns and marks every field dirty.
+
+		@param _User The user taking the slot.
+	 */
+	void
+	state_store::spawn(userid_t _User) noexcept {
+		state_table& t = table();
+		const std::size_t slot = user_slot(_User);
+		if (slot >= t.capacity) {
+			return;
+		}
+
+		for (std::size_t c = 0; c < state_columns; ++c) {
+			current(t, c)[slot] = 0;
+		}
+		t.owners[slot] = _User;
+		t.occupied[slot / state_lane] |= std::uint64_t{ 1 } << (slot % state_lane);
+		t.fresh[slot / state_lane] |= std::uint64_t{ 1 } << (slot % state_lane);
+	}
+
+	/*
+		Frees a user's slot.
+
+		@param _User The user leaving the slot.
+	 */
+	void
+	state_store::despawn(userid_t _User) noexcept {
+		state_table& t = table();
+		const std::size_t slot = live_slot(t, _User);
+		if (slot == t.capacity) {
+			return;
+		}
+
+		const std::uint64_t keep = ~(std::uint64_t{ 1 } << (slot % state_lane));
+		t.occupied[slot / state_lane] &= keep;
+		t.fresh[slot / state_lane] &= keep;
+		for (std::vector<std::uint64_t>& bits : t.dirty) {
+			bits[slot / state_lane] &= keep;
+		}
+	}
+
+	/*
+		Returns whether a user currently owns its slot.
+	 */
+	bool
+	state_store::alive(userid_t _User) noexcept {
+		const state_table& t = table();
+		return live_slot(t, _User) != t.capacity;
+	}
+
+	/*
+		Returns the number of slots.
+	 */
+	std::size_t
+	state_store::capacity() noexcept {
+		return table().capacity;
+	}
+
+	/*
+		Returns a column, indexed by user slot.
+	 */
+	std::span<std::int32_t>
+	state_store::column(state_column _Column) noexcept {
+		const state_table& t = table();
+		if (t.capacity == 0) {
+			return {};
+		}
+		return { current(t, static_cast<std::size_t>(_Column)), t.capacity };
+	}
+
+	/*
+		Returns the occupancy bitset.
+	 */
+	std::span<const std::uint64_t>
+	state_store::occupied() noexcept {
+		return table().occupied;
+	}
+
+	/*
+		Returns the user owning a slot.
+	 */
+	userid_t
+	state_store::owner(std::size_t _Slot) noexcept {
+		return table().owners[_Slot];
+	}
+
+	/*
+		Sets a user's position.
+	 */
+	bool
+	state_store::set_position(userid_t _User, std::int32_t _X, std::int32_t _Y, std::int32_t _Z) noexcept {
+		const state_table& t = table();
+		const std::size_t slot = live_slot(t, _User);
+		if (slot == t.capacity) {
+			return false;
+		}
+
+		current(t, static_cast<std::size_t>(state_column::position_x))[slot] = _X;
+		current(t, static_cast<std::size_t>(state_column::position_y))[slot] = _Y;
+		current(t, static_cast<std::size_t>(state_column::position_z))[slot] = _Z;
+		return true;
+	}
+
+	/*
+		Sets a user's view angles.
+	 */
+	bool
+	state_store::set_angles(userid_t _User, std::int32_t _Pitch, std::int32_t _Yaw, std::int32_t _Roll) noexcept {
+		const state_table& t = table();
+		const std::size_t slot = live_slot(t, _User);
+		if (slot == t.capacity) {
+			return false;
+		}
+
+		current(t, static_cast<std::size_t>(state_column::pitch))[slot] = _Pitch;
+		current(t, static_cast<std::size_t>(state_column::yaw))[slot] = _Yaw;
+		current(t, static_cast<std::size_t>(state_column::roll))[slot] = _Roll;
+		return true;
+	}
+
+	/*
+		Sets a user's health.
+	 */
+	bool
+	state_store::set_health(userid_t _User, std::int32_t _Health) noexcept {
+		const state_table& t = table();
+		const std::size_t slot = live_slot(t, _User);
+		if (slot == t.capacity) {
+			return false;
+		}
+
+		current(t, static_cast<std::size_t>(state_column::health))[slot] = _Health;
+		return true;
+	}
+
+	/*
+		Sets a user's flags.
+	 */
+	bool
+	state_store::set_flags(userid_t _User, std::uint32_t _Flags) noexcept {
+		const state_table& t = table();
+		const std::size_t slot = live_slot(t, _User);
+		if (slot == t.capacity) {
+			return false;
+		}
+
+		current(t, static_cast<std::size_t>(state_column::flags))[slot] = static_cast<std::int32_t>(_Flags);
+		return true;
+	}
+
+	/*
+		Rebuilds the dirty bitsets and advances the baseline.
+
+		Words without an occupied slot are skipped; their baseline goes
+		stale, which is harmless as a spawned slot is dirty regardless.
+
+		@return The number of users with at least one dirty field.
+	 */
+	std::size_t
+	state_store::commit() noexcept {
+		state_table& t = table();
+		const std::size_t words = t.capacity / state_lane;
+		std::size_t count = 0;
+		for (std::size_t w = 0; w < words; ++w) {
+			const std::uint64_t occupied = t.occupied[w];
+			if (occupied == 0) {
+				for (std::vector<std::uint64_t>& bits : t.dirty) {
+					bits[w] = 0;
+				}
+				t.fresh[w] = 0;
+				continue;
+			}
+
+			std::uint64_t changes[state_fields]{};
+			const std::size_t base = w * state_lane;
+			for (std::size_t c = 0; c < state_columns; ++c) {
+				changes[static_cast<std::size_t>(column_field[c])] |= compare_word(current(t, c) + base, previous(t, c) + base);
+			}
+
+			std::uint64_t any = 0;
+			for (std::size_t f = 0; f < state_fields; ++f) {
+				t.dirty[f][w] = (changes[f] | t.fresh[w]) & occupied;
+				any |= t.dirty[f][w];
+			}
+			t.fresh[w] = 0;
+			count += static_cast<std::size_t>(std::popcount(any));
+		}
+		return count;
+	}
+
+	/*
+		Returns the dirty bitset of a field group.
+	 */
+	std::span<const std::uint64_t>
+	state_store::dirty(state_field _Field) noexcept {
+		return table().dirty[static_cast<std::size_t>(_Field)];
+	}
+
+	/*
+		Returns the field groups of a user that changed in the last commit().
+	 */
+	state_mask
+	state_store::changed(userid_t _User) noexcept {
+		const state_table& t = table();
+		const std::size_t slot = live_slot(t, _User);
+		if (slot == t.capacity) {
+			return 0;
+		}
+
+		state_mask fields = 0;
+		for (std::size_t f = 0; f < state_fields; ++f) {
+			fields |= static_cast<state_mask>(t.dirty[f][slot / state_lane] >> (slot % state_lane) & 1) << f;
+		}
+		return fields;
+	}
+
+	/*
+		Writes the state of every occupied slot into a snapshot.
+
+		@param _Out      The snapshot to fill.
+		@param _Sequence The snapshot's sequence number.
+	 */
+	void
+	state_store::capture(snapshot& _Out, std::uint32_t _Sequence) {
+		const state_table& t = table();
+		_Out.clear(_Sequence);
+
+		const std::size_t words = t.capacity / state_lane;
+		for (std::size_t w = 0; w < words; ++w) {
+			for (std::uint64_t bits = t.occupied[w]; bits != 0; bits &= bits - 1) {
+				const std::size_t slot = w * state_lane + static_cast<std::size_t>(std::countr_zero(bits));
+				entity_state& entity = _Out.add(static_cast<std::uint32_t>(slot));
+				for (std::size_t c = 0; c < state_columns; ++c) {
+					entity.fields[c] = current(t, c)[slot];
+				}
+				entity.fields[state_owner_field] = static_cast<std::int32_t>(t.owners[slot]);
+			}
+		}
+	}
+}
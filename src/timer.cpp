@@ -0,0 +1,225 @@
+#include "timer.h"
+
+namespace cat {
+	/*
+		@brief Construct an empty timer wheel positioned at tick 0.
+	 */
+	timer_wheel::timer_wheel() {
+		heads.fill(npos);
+	}
+
+	/*
+		@brief Schedule a callback.
+
+		@param _Delay    Ticks from now until the first expiry.
+		@param _Callback Function to call on expiry.
+		@param _Context  Opaque pointer passed to the callback.
+		@param _Interval Reload interval in ticks, or 0 for one-shot.
+		@return A handle that can be passed to cancel().
+	 */
+	timer_id
+	timer_wheel::schedule(std::uint64_t _Delay, callback_t _Callback, void* _Context, std::uint64_t _Interval) {
+		std::uint32_t index;
+		if (free_head != npos) {
+			index = free_head;
+			free_head = nodes[index].next;
+		} else {
+			index = static_cast<std::uint32_t>(nodes.size());
+			nodes.emplace_back();
+		}
+
+		node& n = nodes[index];
+		n.expires = current + (_Delay == 0 ? 1 : _Delay);
+		n.interval = _Interval;
+		n.callback = _Callback;
+		n.context = _Context;
+		n.active = true;
+		link(index);
+		++pending;
+		return { index, n.generation };
+	}
+
+	/*
+		@brief Cancel a pending timer.
+
+		@param _Id The handle returned by schedule().
+		@return true if the timer was pending and has been cancelled.
+	 */
+	bool
+	timer_wheel::cancel(timer_id _Id) noexcept {
+		if (_Id.index >= nodes.size()) {
+			return false;
+		}
+
+		node& n = nodes[_Id.index];
+		if (!n.active || n.generation != _Id.generation) {
+			return false;
+		}
+
+		unlink(_Id.index);
+		release(_Id.index);
+		return true;
+	}
+
+	/*
+		@brief Advance the wheel, firing every timer that comes due.
+
+		@param _Ticks Number of ticks to advance.
+		@return The number of callbacks invoked.
+	 */
+	std::size_t
+	timer_wheel::advance(std::uint64_t _Ticks) {
+		std::size_t fired = 0;
+		while (_Ticks-- > 0) {
+			++current;
+			//
+			// Refill lower levels from the next level up whenever a level wraps
+			//
+			for (std::size_t level = 1; level < levels; ++level) {
+				if ((current & ((std::uint64_t{ 1 } << (slot_bits * level)) - 1)) != 0) {
+					break;
+				}
+				cascade(level);
+			}
+			fired += fire(current & (slots - 1));
+		}
+		return fired;
+	}
+
+	/*
+		@brief File a node into the slot matching its expiry.
+
+		@param _Index The node to link.
+	 */
+	void
+	timer_wheel::link(std::uint32_t _Index) {
+		node& n = nodes[_Index];
+		const std::uint64_t delta = n.expires - current;
+
+		std::size_t level = 0;
+		while (level + 1 < levels && delta >= (std::uint64_t{ 1 } << (slot_bits * (level + 1)))) {
+			++level;
+		}
+
+		std::uint64_t at = n.expires;
+		if (level + 1 == levels && delta >= (std::uint64_t{ 1 } << (slot_bits * levels))) {
+			//
+			// Beyond the wheel's range: park in the farthest slot and re-file later
+			//
+			at = current + (std::uint64_t{ 1 } << (slot_bits * levels)) - 1;
+		}
+
+		const std::size_t slot = level * slots + ((at >> (slot_bits * level)) & (slots - 1));
+		n.slot = static_cast<std::uint16_t>(slot);
+		n.prev = npos;
+		n.next = heads[slot];
+		if (n.next != npos) {
+			nodes[n.next].prev = _Index;
+		}
+		heads[slot] = _Index;
+	}
+
+	/*
+		@brief Remove a node from its slot list.
+
+		@param _Index The node to unlink.
+	 */
+	void
+	timer_wheel::unlink(std::uint32_t _Index) noexcept {
+		node& n = nodes[_Index];
+		if (n.slot == detached) {
+			return;
+		}
+		if (n.prev != npos) {
+			nodes[n.prev].next = n.next;
+		} else {
+			heads[n.slot] = n.next;
+		}
+		if (n.next != npos) {
+			nodes[n.next].prev = n.prev;
+		}
+		n.prev = n.next = npos;
+	}
+
+	/*
+		@brief Re-file every timer of the current slot of a level.
+
+		@param _Level The level whose current slot is emptied into lower levels.
+	 */
+	void
+	timer_wheel::cascade(std::size_t _Level) {
+		const std::size_t slot = _Level * slots + ((current >> (slot_bits * _Level)) & (slots - 1));
+		std::uint32_t index = heads[slot];
+		heads[slot] = npos;
+		while (index != npos) {
+			const std::uint32_t next = nodes[index].next;
+			link(index);
+			index = next;
+		}
+	}
+
+	/*
+		@brief Run every timer filed in a level-0 slot.
+
+		@param _Slot The level-0 slot that is due.
+		@return The number of callbacks invoked.
+	 */
+	std::size_t
+	timer_wheel::fire(std::size_t _Slot) {
+		//
+		// Detach the slot first so callbacks can freely schedule
+		// into it or cancel timers that are about to run
+		//
+		due.clear();
+		for (std::uint32_t index = heads[_Slot]; index != npos;) {
+			node& n = nodes[index];
+			due.push_back({ index, n.generation });
+			index = n.next;
+			n.prev = n.next = npos;
+			n.slot = detached;
+		}
+		heads[_Slot] = npos;
+
+		std::size_t fired = 0;
+		for (const timer_id id : due) {
+			node& n = nodes[id.index];
+			if (!n.active || n.generation != id.generation) {
+				continue;
+			}
+
+			if (n.expires > current) {
+				link(id.index);
+				continue;
+			}
+
+			const callback_t callback = n.callback;
+			void* const context = n.context;
+			if (n.interval != 0) {
+				n.expires = current + n.interval;
+				link(id.index);
+			} else {
+				release(id.index);
+			}
+
+			callback(context);
+			++fired;
+		}
+		return fired;
+	}
+
+	/*
+		@brief Return a node to the free list.
+
+		@param _Index The node to release.
+	 */
+	void
+	timer_wheel::release(std::uint32_t _Index) noexcept {
+		node& n = nodes[_Index];
+		n.active = false;
+		++n.generation;
+		n.slot = detached;
+		n.next = free_head;
+		free_head = _Index;
+		--pending;
+	}
+}
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <array>
+#include <format>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "trace.h"
+
+namespace cat {
+	/*
+		@brief One recorded zone.
+
+		The fields are relaxed atomics so a dump may read a ring while its
+		thread keeps writing; torn records are discarded by the dump.
+	 */
+	struct zone_record {
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<std::uint64_t> start{ 0 };
+		std::atomic<std::uint64_t> end{ 0 };
+	};
+
+	/*
+		@brief Zone ring of one thread.
+
+		@member zones The most recent zones, indexed by head modulo ring_size.
+		@member head Number of zones ever recorded; only the owner thread writes it.
+		@member name Thread name shown in dumps, guarded by the registry lock.
+		@member tid Thread number shown in dumps.
+	 */
+	struct thread_ring {
+		std::array<zone_record, trace::ring_size> zones;
+		std::atomic<std::uint64_t> head{ 0 };
+		std::string name;
+		std::uint32_t tid = 0;
+	};
+
+	//< Every thread's ring; rings live until the process exits so dumps can read them
+	static std::vector<std::unique_ptr<thread_ring>> rings;
+
+	//< Guards rings, the ring names and the hitch settings
+	static std::mutex registry_lock;
+
+	//< The calling thread's ring, nullptr until it records its first zone or names itself
+	static thread_local thread_ring* local_ring = nullptr;
+
+	//< Hitch dump file prefix
+	static std::string hitch_path;
+
+	//< Time of the previous hitch dump
+	static std::chrono::steady_clock::time_point last_hitch;
+
+	//< Hitch dumps written so far
+	static std::uint32_t hitch_dumps = 0;
+
+	//< The hitch dump being written in the background, if any
+	static std::future<bool> hitch_writer;
+
+	/*
+		@brief Zones and thread names copied out of the rings for one dump.
+	 */
+	struct dump_data {
+		struct zone {
+			const char* name;
+			std::uint64_t start;
+			std::uint64_t end;
+			std::uint32_t tid;
+		};
+
+		struct thread {
+			std::uint32_t tid;
+			std::string name;
+		};
+
+		std::vector<zone> zones;
+		std::vector<thread> threads;
+	};
+
+	/*
+		@brief Get the calling thread's ring, registering it on first use.
+
+		@return The ring, or nullptr if it could not be allocated.
+	 */
+	static thread_ring* ring() noexcept {
+		if (local_ring != nullptr) {
+			return local_ring;
+		}
+		try {
+			auto fresh = std::make_unique<thread_ring>();
+			std::lock_guard guard(registry_lock);
+			fresh->tid = static_cast<std::uint32_t>(rings.size() + 1);
+			rings.push_back(std::move(fresh));
+			local_ring = rings.back().get();
+		}
+		catch (const std::bad_alloc&) {
+		}
+		return local_ring;
+	}
+
+	/*
+		@brief Record a finished zone into the calling thread's ring.
+
+		@param _Name  The zone name.
+		@param _Start Start time from now().
+		@param _End   End time from now().
+	 */
+	void
+	trace::record(const char* _Name, std::uint64_t _Start, std::uint64_t _End) noexcept {
+		thread_ring* r = ring();
+		if (r == nullptr) {
+			return;
+		}
+
+		const std::uint64_t head = r->head.load(std::memory_order_relaxed);
+		zone_record& z = r->zones[head & (ring_size - 1)];
+		z.name.store(_Name, std::memory_order_relaxed);
+		z.start.store(_Start, std::memory_order_relaxed);
+		z.end.store(_End, std::memory_order_relaxed);
+		r->head.store(head + 1, std::memory_order_release);
+	}
+
+	/*
+		@brief Name the calling thread in dumps.
+
+		@param _Name The thread's name.
+	 */
+	void
+	trace::name_thread(const std::string& _Name) {
+#if defined(CSOVMWARE_TRACE_TRACY)
+		tracy::SetThreadName(_Name.c_str());
+#endif
+		if constexpr (enabled) {
+			thread_ring* r = ring();
+			if (r != nullptr) {
+				std::lock_guard guard(registry_lock);
+				r->name = _Name;
+			}
+		}
+	}
+
+	/*
+		@brief Copy the recorded zones and thread names out of the rings.
+
+		The registry lock must be held.
+
+		@return The copy.
+	 */
+	static dump_data collect_dump() {
+		dump_data data;
+		std::vector<dump_data::zone>& zones = data.zones;
+		for (const auto& r : rings) {
+			const std::uint64_t head = r->head.load(std::memory_order_acquire);
+			const std::uint64_t first = head > trace::ring_size ? head - trace::ring_size : 0;
+			const std::size_t begin = zones.size();
+			for (std::uint64_t i = first; i < head; ++i) {
+				const zone_record& z = r->zones[i & (trace::ring_size - 1)];
+				zones.push_back({ z.name.load(std::memory_order_relaxed),
+					z.start.load(std::memory_order_relaxed), z.end.load(std::memory_order_relaxed), r->tid });
+			}
+			//
+			// Drop the records the thread may have overwritten while they were
+			// copied, including the one it may be writing at index now
+			//
+			const std::uint64_t now = r->head.load(std::memory_order_acquire);
+			const std::uint64_t overwritten = now + 1 > trace::ring_size ? now + 1 - trace::ring_size : 0;
+			if (overwritten > first) {
+				const auto lost = static_cast<std::size_t>(std::min(overwritten - first, head - first));
+				zones.erase(zones.begin() + static_cast<std::ptrdiff_t>(begin),
+					zones.begin() + static_cast<std::ptrdiff_t>(begin + lost));
+			}
+			if (!r->name.empty()) {
+				data.threads.push_back({ r->tid, r->name });
+			}
+		}
+		return data;
+	}
+
+	/*
+		@brief Write collected zones as Chrome trace JSON.
+
+		Needs no lock, so it may run on any thread.
+
+		@param _Data The zones and thread names.
+		@param _Path The file to write.
+		@return true if the file was written.
+	 */
+	static bool write_dump(const dump_data& _Data, const std::string& _Path) {
+		std::uint64_t origin = UINT64_MAX;
+		for (const dump_data::zone& z : _Data.zones) {
+			origin = std::min(origin, z.start);
+		}
+
+		std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+		bool first = true;
+		for (const dump_data::thread& t : _Data.threads) {
+			std::format_to(std::back_inserter(out),
+				"{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+				first ? "" : ",", t.tid, t.name);
+			first = false;
+		}
+		for (const dump_data::zone& z : _Data.zones) {
+			if (z.name == nullptr || z.end < z.start) {
+				continue;
+			}
+			std::format_to(std::back_inserter(out),
+				"{}{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+				first ? "" : ",", z.name, z.tid, (z.start - origin) / 1e3, (z.end - z.start) / 1e3);
+			first = false;
+		}
+		out += "]}\n";
+
+		std::ofstream file(_Path, std::ios::binary | std::ios::trunc);
+		file.write(out.data(), static_cast<std::streamsize>(out.size()));
+		return static_cast<bool>(file);
+	}
+
+	/*
+		@brief Write the recorded zones of every thread as Chrome trace JSON.
+
+		@param _Path The file to write.
+		@return true if the file was written.
+	 */
+	bool
+	trace::dump(const std::string& _Path) {
+		dump_data data;
+		{
+			std::lock_guard guard(registry_lock);
+			data = collect_dump();
+		}
+		return write_dump(data, _Path);
+	}
+
+	/*
+		@brief Dump the zones automatically when a tick runs long.
+
+		@param _Path      Prefix of the dump files.
+		@param _Threshold Tick duration that counts as a hitch, 0 to stop watching.
+	 */
+	void
+	trace::watch_hitches(const std::string& _Path, std::chrono::nanoseconds _Threshold) {
+		std::lock_guard guard(registry_lock);
+		hitch_path = _Path;
+		hitch_threshold.store(_Path.empty() ? 0 : _Threshold.count(), std::memory_order_relaxed);
+	}
+
+	/*
+		@brief Start a hitch dump, rate limited by hitch_interval.
+
+		Only the copy of the rings runs on the calling tick thread; the
+		file is formatted and written on a background thread. A hitch
+		while the previous dump is still being written is not dumped.
+
+		@param _Elapsed The duration of the slow tick.
+	 */
+	void
+	trace::hitch(std::chrono::nanoseconds _Elapsed) {
+		const auto now = std::chrono::steady_clock::now();
+		std::lock_guard guard(registry_lock);
+		if (hitch_dumps >= max_hitch_dumps || (hitch_dumps != 0 && now - last_hitch < hitch_interval)) {
+			return;
+		}
+		if (hitch_writer.valid() && hitch_writer.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+			return;
+		}
+		last_hitch = now;
+		//
+		// The slow tick's own zones are already in the ring; name the dump after it
+		//
+		std::string path = std::format("{}.hitch{}-{}ms.json", hitch_path, hitch_dumps,
+			std::chrono::duration_cast<std::chrono::milliseconds>(_Elapsed).count());
+		try {
+			hitch_writer = std::async(std::launch::async, [](dump_data _Data, std::string _Path) {
+				return write_dump(_Data, _Path);
+			}, collect_dump(), std::move(path));
+			++hitch_dumps;
+		}
+		catch (const std::system_error&) {
+			//
+			// No thread to write it on; losing one dump beats stalling the tick
+			//
+		}
+	}
+}
@@ -0,0 +1,439 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <enet/enet.h>
+#include "udp_batch.h"
+
+#if defined(CSOVMWARE_UDP_BATCH)
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+/*
+	ENet's own socket functions, reached through the linker's --wrap.
+ */
+extern "C" {
+	int __real_enet_socket_receive(ENetSocket, ENetAddress*, ENetBuffer*, size_t);
+	int __real_enet_socket_send(ENetSocket, const ENetAddress*, const ENetBuffer*, size_t);
+	int __real_enet_socket_wait(ENetSocket, enet_uint32*, enet_uint32);
+	void __real_enet_socket_destroy(ENetSocket);
+}
+#endif
+
+namespace cat {
+	/*
+		Process-wide counters, readable from the metrics exporter.
+	 */
+	static struct {
+		std::atomic<std::uint64_t> receive_calls{ 0 };
+		std::atomic<std::uint64_t> received{ 0 };
+		std::atomic<std::uint64_t> send_calls{ 0 };
+		std::atomic<std::uint64_t> sent{ 0 };
+		std::atomic<std::uint64_t> segmented{ 0 };
+		std::atomic<std::uint64_t> dropped{ 0 };
+	} counters;
+
+#if defined(CSOVMWARE_UDP_BATCH)
+	//< Largest datagram a slot holds
+	static constexpr std::size_t datagram_size = ENET_PROTOCOL_MAXIMUM_MTU;
+
+	//< Most segments the kernel accepts in one GSO send
+	static constexpr std::size_t max_segments = 64;
+
+	//< Largest IPv4 UDP payload, the limit of one GSO send
+	static constexpr std::size_t max_payload = 65507;
+
+	/*
+		Ancillary data carrying the UDP_SEGMENT size of one message.
+	 */
+	struct segment_control {
+		alignas(cmsghdr) unsigned char data[CMSG_SPACE(sizeof(std::uint16_t))];
+	};
+
+	/*
+		Batched I/O state of one attached socket.
+	 */
+	struct batch_socket {
+		//< The attached socket
+		ENetSocket socket = ENET_SOCKET_NULL;
+
+		//< Receive ring: headers, buffers and senders of the last recvmmsg()
+		std::array<mmsghdr, udp_batch::recv_batch> in_msgs{};
+		std::array<iovec, udp_batch::recv_batch> in_iov{};
+		std::array<sockaddr_in, udp_batch::recv_batch> in_addr{};
+		std::vector<std::uint8_t> in_data;
+
+		//< Datagrams in the ring, and the next one to hand to ENet
+		std::size_t in_count = 0;
+		std::size_t in_next = 0;
+
+		//< Send stage: payloads, sizes and destinations of staged datagrams
+		std::vector<std::uint8_t> out_data;
+		std::array<std::size_t, udp_batch::send_batch> out_size{};
+		std::array<sockaddr_in, udp_batch::send_batch> out_addr{};
+		std::size_t out_count = 0;
+
+		//< Messages built from the stage for sendmmsg()
+		std::array<mmsghdr, udp_batch::send_batch> out_msgs{};
+		std::array<iovec, udp_batch::send_batch> out_iov{};
+		std::array<segment_control, udp_batch::send_batch> out_control{};
+
+		//< First staged datagram of each built message, plus one past the last
+		std::array<std::size_t, udp_batch::send_batch + 1> out_first{};
+
+		//< Cleared once the kernel rejects UDP_SEGMENT
+		bool gso = true;
+	};
+
+	/*
+		Sockets attached by the calling thread.
+	 */
+	static thread_local std::vector<std::unique_ptr<batch_socket>> sockets;
+
+	/*
+		Finds the calling thread's state of a socket.
+
+		@param _Socket The socket.
+		@return The state, or nullptr if the socket is not attached here.
+	 */
+	static batch_socket*
+	find(ENetSocket _Socket) noexcept {
+		for (const auto& b : sockets) {
+			if (b->socket == _Socket) {
+				return b.get();
+			}
+		}
+		return nullptr;
+	}
+
+	/*
+		Returns whether two staged datagrams go to the same address.
+	 */
+	static bool
+	same_destination(const batch_socket& _Batch, std::size_t _A, std::size_t _B) noexcept {
+		return _Batch.out_addr[_A].sin_addr.s_addr == _Batch.out_addr[_B].sin_addr.s_addr &&
+			_Batch.out_addr[_A].sin_port == _Batch.out_addr[_B].sin_port;
+	}
+
+	/*
+		Builds the sendmmsg() messages for the staged datagrams from one on.
+
+		With GSO, a run of datagrams to the same address whose sizes all
+		equal the first's, except for a smaller last one, becomes one
+		message the kernel splits into segments.
+
+		@param _Batch The socket's state.
+		@param _From The first staged datagram to send.
+		@return The number of messages built.
+	 */
+	static std::size_t
+	build(batch_socket& _Batch, std::size_t _From) noexcept {
+		std::size_t msgs = 0;
+		for (std::size_t i = _From; i < _Batch.out_count; ++msgs) {
+			const std::size_t size = _Batch.out_size[i];
+			std::size_t end = i + 1;
+			if (_Batch.gso) {
+				while (end < _Batch.out_count && end - i < max_segments && (end - i + 1) * size <= max_payload &&
+					_Batch.out_size[end - 1] == size && _Batch.out_size[end] <= size && same_destination(_Batch, i, end)) {
+					++end;
+				}
+			}
+
+			for (std::size_t k = i; k < end; ++k) {
+				_Batch.out_iov[k] = { _Batch.out_data.data() + k * datagram_size, _Batch.out_size[k] };
+			}
+
+			msghdr& hdr = _Batch.out_msgs[msgs].msg_hdr;
+			hdr = {};
+			hdr.msg_name = &_Batch.out_addr[i];
+			hdr.msg_namelen = sizeof(sockaddr_in);
+			hdr.msg_iov = &_Batch.out_iov[i];
+			hdr.msg_iovlen = end - i;
+			if (end - i > 1) {
+				hdr.msg_control = _Batch.out_control[msgs].data;
+				hdr.msg_controllen = sizeof(segment_control::data);
+				cmsghdr* cm = CMSG_FIRSTHDR(&hdr);
+				cm->cmsg_level = SOL_UDP;
+				cm->cmsg_type = UDP_SEGMENT;
+				cm->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+				const auto segment = static_cast<std::uint16_t>(size);
+				std::memcpy(CMSG_DATA(cm), &segment, sizeof(segment));
+			}
+			_Batch.out_first[msgs] = i;
+			i = end;
+		}
+		_Batch.out_first[msgs] = _Batch.out_count;
+		return msgs;
+	}
+
+	/*
+		Sends every staged datagram of a socket.
+
+		Like ENet's own sends, datagrams the kernel refuses are lost
+		rather than retried; the reliable layer above resends what matters.
+
+		@param _Batch The socket's state.
+	 */
+	static void
+	send_staged(batch_socket& _Batch) noexcept {
+		std::size_t from = 0;
+		while (from < _Batch.out_count) {
+			const std::size_t msgs = build(_Batch, from);
+			const int res = sendmmsg(_Batch.socket, _Batch.out_msgs.data(), static_cast<unsigned>(msgs), MSG_NOSIGNAL);
+			counters.send_calls.fetch_add(1, std::memory_order_relaxed);
+			if (res > 0) {
+				const std::size_t next = _Batch.out_first[static_cast<std::size_t>(res)];
+				for (std::size_t m = 0; m < static_cast<std::size_t>(res); ++m) {
+					if (_Batch.out_msgs[m].msg_hdr.msg_iovlen > 1) {
+						counters.segmented.fetch_add(_Batch.out_msgs[m].msg_hdr.msg_iovlen, std::memory_order_relaxed);
+					}
+				}
+				counters.sent.fetch_add(next - from, std::memory_order_relaxed);
+				from = next;
+				continue;
+			}
+
+			if (errno == EINTR) {
+				continue;
+			}
+			//
+			// No GSO on this kernel or device: send the segments one by one from now on
+			//
+			if (_Batch.gso && _Batch.out_msgs[0].msg_hdr.msg_iovlen > 1 && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT)) {
+				_Batch.gso = false;
+				continue;
+			}
+			//
+			// A full socket buffer loses the rest of the stage; other errors just this message
+			//
+			const std::size_t next = errno == EAGAIN || errno == EWOULDBLOCK ? _Batch.out_count : _Batch.out_first[1];
+			counters.dropped.fetch_add(next - from, std::memory_order_relaxed);
+			from = next;
+		}
+		_Batch.out_count = 0;
+	}
+
+	/*
+		Hands ENet the next received datagram, refilling the ring when empty.
+
+		Mirrors enet_socket_receive(): 0 when nothing is pending, -1 on
+		errors and truncated datagrams.
+
+		@param _Batch The socket's state.
+		@param _Address Receives the sender.
+		@param _Buffers The buffers to fill.
+		@param _Count The number of buffers.
+		@return The datagram size, 0 or -1.
+	 */
+	static int
+	receive(batch_socket& _Batch, ENetAddress* _Address, ENetBuffer* _Buffers, std::size_t _Count) noexcept {
+		if (_Batch.in_next == _Batch.in_count) {
+			_Batch.in_next = 0;
+			_Batch.in_count = 0;
+			for (mmsghdr& m : _Batch.in_msgs) {
+				m.msg_hdr.msg_namelen = sizeof(sockaddr_in);
+				m.msg_hdr.msg_flags = 0;
+			}
+
+			const int res = recvmmsg(_Batch.socket, _Batch.in_msgs.data(), udp_batch::recv_batch, MSG_DONTWAIT, nullptr);
+			if (res < 0) {
+				return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+			}
+			if (res == 0) {
+				return 0;
+			}
+			counters.receive_calls.fetch_add(1, std::memory_order_relaxed);
+			counters.received.fetch_add(static_cast<std::uint64_t>(res), std::memory_order_relaxed);
+			_Batch.in_count = static_cast<std::size_t>(res);
+		}
+
+		const std::size_t slot = _Batch.in_next++;
+		const mmsghdr& m = _Batch.in_msgs[slot];
+		if (m.msg_hdr.msg_flags & MSG_TRUNC) {
+			return -1;
+		}
+
+		const std::uint8_t* in = _Batch.in_data.data() + slot * datagram_size;
+		std::size_t left = m.msg_len;
+		for (std::size_t i = 0; i < _Count && left != 0; ++i) {
+			const std::size_t n = std::min(left, _Buffers[i].dataLength);
+			std::memcpy(_Buffers[i].data, in, n);
+			in += n;
+			left -= n;
+		}
+		if (left != 0) {
+			return -1;
+		}
+
+		if (_Address != nullptr) {
+			_Address->host = _Batch.in_addr[slot].sin_addr.s_addr;
+			_Address->port = ntohs(_Batch.in_addr[slot].sin_port);
+		}
+		return static_cast<int>(m.msg_len);
+	}
+
+	/*
+		Copies a datagram ENet is sending into the stage.
+
+		@param _Batch The socket's state.
+		@param _Address The destination.
+		@param _Buffers The datagram's pieces.
+		@param _Count The number of pieces.
+		@return The datagram size, or -1 if it does not fit a slot.
+	 */
+	static int
+	stage(batch_socket& _Batch, const ENetAddress* _Address, const ENetBuffer* _Buffers, std::size_t _Count) noexcept {
+		std::size_t size = 0;
+		for (std::size_t i = 0; i < _Count; ++i) {
+			size += _Buffers[i].dataLength;
+		}
+		if (size > datagram_size) {
+			return -1;
+		}
+
+		if (_Batch.out_count == udp_batch::send_batch) {
+			send_staged(_Batch);
+		}
+
+		const std::size_t slot = _Batch.out_count++;
+		std::uint8_t* out = _Batch.out_data.data() + slot * datagram_size;
+		for (std::size_t i = 0; i < _Count; ++i) {
+			std::memcpy(out, _Buffers[i].data, _Buffers[i].dataLength);
+			out += _Buffers[i].dataLength;
+		}
+
+		sockaddr_in& addr = _Batch.out_addr[slot];
+		addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(_Address->port);
+		addr.sin_addr.s_addr = _Address->host;
+		_Batch.out_size[slot] = size;
+		return static_cast<int>(size);
+	}
+#endif
+
+	/*
+		Routes a host socket through the batched layer.
+
+		@param _Socket The host's ENetSocket.
+	 */
+	void
+	udp_batch::attach([[maybe_unused]] std::intptr_t _Socket) {
+#if defined(CSOVMWARE_UDP_BATCH)
+		const auto socket = static_cast<ENetSocket>(_Socket);
+		if (find(socket) != nullptr) {
+			return;
+		}
+
+		auto b = std::make_unique<batch_socket>();
+		b->socket = socket;
+		b->in_data.resize(recv_batch * datagram_size);
+		b->out_data.resize(send_batch * datagram_size);
+		for (std::size_t i = 0; i < recv_batch; ++i) {
+			b->in_iov[i] = { b->in_data.data() + i * datagram_size, datagram_size };
+			msghdr& hdr = b->in_msgs[i].msg_hdr;
+			hdr.msg_name = &b->in_addr[i];
+			hdr.msg_namelen = sizeof(sockaddr_in);
+			hdr.msg_iov = &b->in_iov[i];
+			hdr.msg_iovlen = 1;
+		}
+		sockets.push_back(std::move(b));
+#endif
+	}
+
+	/*
+		Sends the datagrams staged on the calling thread's sockets.
+	 */
+	void
+	udp_batch::flush() noexcept {
+#if defined(CSOVMWARE_UDP_BATCH)
+		for (const auto& b : sockets) {
+			if (b->out_count != 0) {
+				send_staged(*b);
+			}
+		}
+#endif
+	}
+
+	/*
+		Returns the counters of every attached socket so far.
+	 */
+	udp_batch_stats
+	udp_batch::stats() noexcept {
+		return {
+			counters.receive_calls.load(std::memory_order_relaxed),
+			counters.received.load(std::memory_order_relaxed),
+			counters.send_calls.load(std::memory_order_relaxed),
+			counters.sent.load(std::memory_order_relaxed),
+			counters.segmented.load(std::memory_order_relaxed),
+			counters.dropped.load(std::memory_order_relaxed),
+		};
+	}
+}
+
+#if defined(CSOVMWARE_UDP_BATCH)
+/*
+	Replacements the linker binds ENet's socket calls to. Sockets not
+	attached on the calling thread, such as the metrics endpoint's, go
+	straight to ENet's implementation.
+ */
+extern "C" {
+	int
+	__wrap_enet_socket_receive(ENetSocket _Socket, ENetAddress* _Address, ENetBuffer* _Buffers, size_t _Count) {
+		cat::batch_socket* b = cat::find(_Socket);
+		return b != nullptr ? cat::receive(*b, _Address, _Buffers, _Count) : __real_enet_socket_receive(_Socket, _Address, _Buffers, _Count);
+	}
+
+	int
+	__wrap_enet_socket_send(ENetSocket _Socket, const ENetAddress* _Address, const ENetBuffer* _Buffers, size_t _Count) {
+		cat::batch_socket* b = cat::find(_Socket);
+		if (b == nullptr || _Address == nullptr) {
+			return __real_enet_socket_send(_Socket, _Address, _Buffers, _Count);
+		}
+		return cat::stage(*b, _Address, _Buffers, _Count);
+	}
+
+	int
+	__wrap_enet_socket_wait(ENetSocket _Socket, enet_uint32* _Condition, enet_uint32 _Timeout) {
+		cat::batch_socket* b = cat::find(_Socket);
+		if (b != nullptr) {
+			//
+			// Nothing may sit in the stage while the thread sleeps, and a
+			// filled ring is readable whatever the socket says
+			//
+			if (b->out_count != 0) {
+				cat::send_staged(*b);
+			}
+			if (b->in_next != b->in_count && (*_Condition & ENET_SOCKET_WAIT_RECEIVE)) {
+				*_Condition = ENET_SOCKET_WAIT_RECEIVE;
+				return 0;
+			}
+		}
+		return __real_enet_socket_wait(_Socket, _Condition, _Timeout);
+	}
+
+	void
+	__wrap_enet_socket_destroy(ENetSocket _Socket) {
+		const auto it = std::find_if(cat::sockets.begin(), cat::sockets.end(), [&](const auto& _Batch) {
+			return _Batch->socket == _Socket;
+		});
+		if (it != cat::sockets.end()) {
+			cat::send_staged(**it);
+			cat::sockets.erase(it);
+		}
+		__real_enet_socket_destroy(_Socket);
+	}
+}
+#endif
@@ -1,97 +1,487 @@
-#include <array>
-#include <ranges>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include <enet/enet.h>
 #include "const.h"
+#include "core.h"
+#include "metrics.h"
+#include "pool.h"
+#include "service.h"
+#include "session_store.h"
+#include "shard.h"
+#include "state.h"
 #include "users.h"
 
 namespace cat {
+	static_assert(max_user_capacity == ENET_PROTOCOL_MAXIMUM_PEER_ID, "a user slot per ENet peer");
+	static_assert(max_user_capacity <= 0x10000, "slots must fit the 16-bit index of a user ID");
+
 	/*
 		@brief Structure to hold user entry information.
 
-		@member active Indicates whether the user entry is currently active.
 		@member peer The peer associated with the user entry.
+		@member session Session token granted to the last peer that held the slot, all zero if none.
+		@member generation Number of times the slot has been released.
+		@member index Position of the user in the active list, or in the free list while inactive.
+		@member active Indicates whether the user entry is currently active.
+		@member resumed Whether the current user took over its session's previous slot.
 	 */
 	struct user_entry {
-		bool active;
-		peer_t peer;
+		peer_t peer = nullptr;
+		core::session_token session{};
+		std::uint16_t generation = 0;
+		std::uint32_t index = 0;
+		bool active = false;
+		bool resumed = false;
+	};
+
+	/*
+		@brief User table of one shard.
+
+		@member users User slots, sized by setup_user_system().
+		@member active Dense list of active user IDs, backing get_users().
+		@member free_slots Stack of free slot indices.
+		@member sessions Slot last held by each session token, keyed by the token's first eight bytes.
+		@member random Source of the session tokens.
+		@member lock Serializes acquire and release when callbacks run on worker threads.
+		@member hooked Whether the service handlers have been registered.
+	 */
+	struct user_table {
+		std::vector<user_entry> users;
+		std::vector<userid_t> active;
+		std::vector<std::uint32_t> free_slots;
+		std::unordered_map<std::uint64_t, std::uint32_t> sessions;
+		std::random_device random;
+		std::mutex lock;
+		bool hooked = false;
 	};
 
 	/*
-		Array to hold user entries.
-		Size is defined by MAX_USERS constant.
+		@brief Get the calling shard's user table.
+	 */
+	static user_table& table() noexcept {
+		return shard_local<user_table>();
+	}
+
+	/*
+		@brief Compose a user ID from a slot and its generation.
+	 */
+	static constexpr userid_t make_id(std::uint32_t _Slot, std::uint16_t _Generation) noexcept {
+		return static_cast<userid_t>(_Generation) << 16 | _Slot;
+	}
+
+	/*
+		@brief Find the slot recorded in a peer's data pointer.
+
+		The pointer holds the slot index plus one, so nullptr means no user.
+
+		@param _Peer The peer whose slot is to be found.
+		@return The slot index, or std::nullopt if the peer has no user.
+	 */
+	static std::optional<std::uint32_t> find_slot(const peer_t _Peer) noexcept {
+		user_table& t = table();
+		const auto tag = reinterpret_cast<std::uintptr_t>(core::Core_enet_peer_data(_Peer));
+		if (tag == 0 || tag > t.users.size()) {
+			return std::nullopt;
+		}
+
+		const auto slot = static_cast<std::uint32_t>(tag - 1);
+		if (!t.users[slot].active || t.users[slot].peer != _Peer) {
+			return std::nullopt;
+		}
+		return slot;
+	}
+
+	/*
+		@brief Get the key of a session token in the session map.
+	 */
+	static std::uint64_t session_key(const core::session_token& _Token) noexcept {
+		std::uint64_t key;
+		std::memcpy(&key, _Token.data(), sizeof(key));
+		return key;
+	}
+
+	/*
+		@brief Check whether a session token is set.
+	 */
+	static bool has_session(const core::session_token& _Token) noexcept {
+		return std::any_of(_Token.begin(), _Token.end(), [](std::uint8_t _Byte) { return _Byte != 0; });
+	}
+
+	/*
+		@brief Compare two session tokens in time independent of where they differ.
 	 */
-	static std::array<user_entry, MAX_USERS> users;
+	static bool same_session(const core::session_token& _Left, const core::session_token& _Right) noexcept {
+		std::uint8_t diff = 0;
+		for (std::size_t i = 0; i < _Left.size(); ++i) {
+			diff |= _Left[i] ^ _Right[i];
+		}
+		return diff == 0;
+	}
+
+	/*
+		@brief Draw a new session token.
+
+		@param _Table The user table, locked.
+		@return The token, or all zero if no randomness is available.
+	 */
+	static core::session_token new_session(user_table& _Table) noexcept {
+		core::session_token token{};
+		try {
+			for (std::size_t i = 0; i < token.size(); i += sizeof(std::uint32_t)) {
+				const auto word = static_cast<std::uint32_t>(_Table.random());
+				std::memcpy(token.data() + i, &word, sizeof(word));
+			}
+		}
+		catch (const std::exception&) {
+			//
+			// A session without a token simply cannot be resumed
+			//
+			return {};
+		}
+		return token;
+	}
+
+	/*
+		@brief Write a slot's session and generation to the session snapshot, if one is mapped.
 
+		@param _Table The user table.
+		@param _Slot The slot that changed.
+	 */
+	static void persist_slot(const user_table& _Table, std::uint32_t _Slot) noexcept {
+		const std::span<session_record> records = session_store::records();
+		if (_Slot < records.size()) {
+			records[_Slot] = { _Table.users[_Slot].session, _Table.users[_Slot].generation, 0 };
+		}
+	}
 
 	/*
-		@brief Find the user entry associated with a given peer.
+		@brief Take a free slot, preferring the one a session held last.
+
+		The presented token must match the one granted for the slot in
+		full; a guessed or stale token gets a fresh slot.
 
-		@param peer The peer whose user entry is to be found.
-		@return An iterator to the user entry if found, otherwise users.end().
+		The table lock must be held and the free list must not be empty.
+
+		@param _Table The user table.
+		@param _Session The session token the connecting peer presented.
+		@param _Resumed Set to whether the slot is the session's previous one.
+		@return The slot, removed from the free list.
 	 */
-	static auto find_entry(const peer_t _Peer) noexcept {
-		return std::ranges::find_if(users, [_Peer](const auto& _Entry) {
-			return _Entry.active && _Entry.peer == _Peer; });
+	static std::uint32_t take_slot(user_table& _Table, const core::session_token& _Session, bool& _Resumed) noexcept {
+		std::uint32_t slot = _Table.free_slots.back();
+		_Resumed = false;
+		if (has_session(_Session)) {
+			const auto it = _Table.sessions.find(session_key(_Session));
+			if (it != _Table.sessions.end() && !_Table.users[it->second].active &&
+				same_session(_Table.users[it->second].session, _Session)) {
+				slot = it->second;
+				_Resumed = true;
+			}
+		}
+		//
+		// Swap the last free slot into the taken position
+		//
+		const std::uint32_t last = _Table.free_slots.back();
+		const std::uint32_t index = _Table.users[slot].index;
+		_Table.free_slots[index] = last;
+		_Table.users[last].index = index;
+		_Table.free_slots.pop_back();
+		return slot;
+	}
+
+	/*
+		@brief Record that a slot now belongs to a session.
+
+		@param _Table The user table.
+		@param _Slot The slot being handed out.
+		@param _Session The new holder's session token, all zero for none.
+	 */
+	static void remember_session(user_table& _Table, std::uint32_t _Slot, const core::session_token& _Session) noexcept {
+		user_entry& entry = _Table.users[_Slot];
+		if (has_session(entry.session)) {
+			const auto it = _Table.sessions.find(session_key(entry.session));
+			if (it != _Table.sessions.end() && it->second == _Slot) {
+				_Table.sessions.erase(it);
+			}
+		}
+
+		entry.session = _Session;
+		if (!has_session(_Session)) {
+			return;
+		}
+		//
+		// Resumption is best effort; without memory the session is just not remembered
+		//
+		try {
+			_Table.sessions.insert_or_assign(session_key(_Session), _Slot);
+		}
+		catch (const std::bad_alloc&) {
+		}
+	}
+
+	/*
+		@brief Initialize the user table and hook it into the service.
+
+		@param _Capacity The maximum number of concurrent users.
+	 */
+	void
+	setup_user_system(std::size_t _Capacity) {
+		user_table& t = table();
+		if (_Capacity == 0 || _Capacity > max_user_capacity) {
+			throw std::invalid_argument("User capacity must be between 1 and 4095.");
+		}
+
+		{
+			std::lock_guard guard(t.lock);
+			t.users.assign(_Capacity, user_entry{});
+			t.active.clear();
+			t.active.reserve(_Capacity);
+			t.free_slots.clear();
+			t.free_slots.reserve(_Capacity);
+			t.sessions.clear();
+			t.sessions.reserve(_Capacity);
+			//
+			// Reverse order so the lowest slots are handed out first
+			//
+			for (std::size_t i = _Capacity; i-- > 0;) {
+				t.users[i].index = static_cast<std::uint32_t>(t.free_slots.size());
+				t.free_slots.push_back(static_cast<std::uint32_t>(i));
+			}
+			//
+			// Pick up the sessions of a snapshot left by an earlier run; a
+			// client still has to present the granted token to resume one
+			//
+			const std::span<const session_record> records = session_store::records();
+			if (records.size() == _Capacity) {
+				for (std::uint32_t i = 0; i < _Capacity; ++i) {
+					t.users[i].session = records[i].session;
+					t.users[i].generation = records[i].generation;
+					if (has_session(records[i].session)) {
+						t.sessions.insert_or_assign(session_key(records[i].session), i);
+					}
+				}
+			}
+			state_store::setup(_Capacity);
+			metrics::set_users(0, _Capacity);
+		}
+
+		if (t.hooked) {
+			return;
+		}
+		t.hooked = true;
+
+		service::instance()
+			.on(enet_service::enet_connect, [](enet_event& _Event) {
+				const auto id = acquire_user(_Event.peer, core::Core_enet_connect_session(_Event.data, _Event.size));
+				if (!id) {
+					//
+					// The handler may run on a worker, which must not call into ENet
+					//
+					pool_manager::instance().kick(_Event.peer);
+					return;
+				}
+				//
+				// The peer presents the granted token when it reconnects
+				//
+				const core::session_token token = user_session(*id);
+				if (has_session(token)) {
+					core::Core_enet_peer_grant(_Event.peer, token);
+				}
+			}, std::numeric_limits<int>::min())
+			.on(enet_service::enet_disconnect, [](enet_event& _Event) {
+				release_user(_Event.peer);
+			}, std::numeric_limits<int>::max());
+	}
+
+	/*
+		@brief Get the maximum number of concurrent users.
+
+		@return The capacity passed to setup_user_system().
+	 */
+	std::size_t
+	user_capacity() noexcept {
+		user_table& t = table();
+		return t.users.size();
 	}
 
 	/*
 		@brief Acquire a user ID for a given peer.
-		
+
 		@param _Peer The peer for which to acquire a user ID.
+		@param _Presented The session token the peer presented.
 		@return The acquired user ID, or std::nullopt if acquisition failed.
 	 */
-	std::optional<userid_t> 
-	acquire_user(const peer_t _Peer) noexcept {
-		auto it = std::ranges::find_if(users, [](const user_entry& entry) {
-			return !entry.active; });
-		if (it != users.end()) {
-			it->active = true;
-			it->peer = _Peer;
-			return static_cast<userid_t>(std::distance(users.begin(), it));
+	std::optional<userid_t>
+	acquire_user(const peer_t _Peer, const core::session_token& _Presented) noexcept {
+		user_table& t = table();
+		std::lock_guard guard(t.lock);
+		if (auto slot = find_slot(_Peer)) {
+			return make_id(*slot, t.users[*slot].generation);
+		}
+
+		if (t.free_slots.empty()) {
+			return std::nullopt;
+		}
+
+		bool resumed = false;
+		const std::uint32_t slot = take_slot(t, _Presented, resumed);
+
+		user_entry& entry = t.users[slot];
+		entry.resumed = resumed;
+		if (!entry.resumed) {
+			//
+			// Another session's state must not leak into the new one
+			//
+			const std::span<std::byte> state = session_store::state(slot);
+			std::fill(state.begin(), state.end(), std::byte{ 0 });
+		}
+		//
+		// Every connection gets a fresh token, so a presented one works once
+		//
+		remember_session(t, slot, new_session(t));
+		persist_slot(t, slot);
+		entry.active = true;
+		entry.peer = _Peer;
+		entry.index = static_cast<std::uint32_t>(t.active.size());
+
+		const userid_t id = make_id(slot, entry.generation);
+		t.active.push_back(id);
+		state_store::spawn(id);
+		metrics::set_users(t.active.size(), t.users.size());
+		core::Core_enet_peer_set_data(_Peer, reinterpret_cast<void*>(std::uintptr_t{ slot } + 1));
+		return id;
+	}
+
+	/*
+		@brief Get the user ID of a given peer.
+
+		@param _Peer The peer whose user ID is to be retrieved.
+		@return The peer's user ID, or std::nullopt if the peer has no user.
+	 */
+	std::optional<userid_t>
+	find_user(const peer_t _Peer) noexcept {
+		user_table& t = table();
+		if (auto slot = find_slot(_Peer)) {
+			return make_id(*slot, t.users[*slot].generation);
 		}
 		return std::nullopt;
 	}
 
 	/*
 		@brief Get the peer associated with a given user ID.
-		
+
 		@param _User The user ID whose peer is to be retrieved.
 		@return The peer associated with the given user ID, or std::nullopt if not found.
 	 */
-	std::optional<peer_t> 
+	std::optional<peer_t>
 	get_peer(const userid_t _User) noexcept {
-		if (_User < static_cast<userid_t>(users.size()) && users[_User].active) {
-			return users[_User].peer;
+		user_table& t = table();
+		const std::size_t slot = user_slot(_User);
+		if (slot < t.users.size() && t.users[slot].active && make_id(static_cast<std::uint32_t>(slot), t.users[slot].generation) == _User) {
+			return t.users[slot].peer;
 		}
 
 		return std::nullopt;
 	}
 
 	/*
-		@brief Get a list of all user IDs.
-		
-		@return A vector containing all user IDs.
+		@brief Get the session token granted to a user.
+
+		@param _User The user ID to query.
+		@return The token the user resumes with, or all zero.
 	 */
-	std::vector<userid_t> 
-	get_users() noexcept {
-		std::vector<userid_t> userids;
-		for (userid_t i = 0; i < static_cast<userid_t>(users.size()); ++i) {
-			if (users[i].active) {
-				userids.push_back(i);
-			}
+	core::session_token
+	user_session(const userid_t _User) noexcept {
+		user_table& t = table();
+		const std::size_t slot = user_slot(_User);
+		if (slot < t.users.size() && t.users[slot].active && make_id(static_cast<std::uint32_t>(slot), t.users[slot].generation) == _User) {
+			return t.users[slot].session;
 		}
-		return userids;
+		return {};
+	}
+
+	/*
+		@brief Check whether a user took over its session's previous slot.
+
+		@param _User The user ID to query.
+		@return true if the user resumed a session.
+	 */
+	bool
+	user_resumed(const userid_t _User) noexcept {
+		user_table& t = table();
+		const std::size_t slot = user_slot(_User);
+		if (slot < t.users.size() && t.users[slot].active && make_id(static_cast<std::uint32_t>(slot), t.users[slot].generation) == _User) {
+			return t.users[slot].resumed;
+		}
+		return false;
+	}
+
+	/*
+		@brief Get the session state kept for a user across reconnects and restarts.
+
+		@param _User The user ID to query.
+		@return The user's state block, or an empty span.
+	 */
+	std::span<std::byte>
+	session_state(const userid_t _User) noexcept {
+		user_table& t = table();
+		const std::size_t slot = user_slot(_User);
+		if (slot < t.users.size() && t.users[slot].active && make_id(static_cast<std::uint32_t>(slot), t.users[slot].generation) == _User) {
+			return session_store::state(slot);
+		}
+		return {};
+	}
+
+	/*
+		@brief Get the IDs of all active users.
+
+		@return A view of all active user IDs.
+	 */
+	std::span<const userid_t>
+	get_users() noexcept {
+		return table().active;
 	}
 
 	/*
 		@brief Release the user ID associated with a given peer.
-		
+
 		@param _Peer The peer whose user ID is to be released.
 	 */
-	void 
+	void
 	release_user(const peer_t _Peer) noexcept {
-		if (auto it = find_entry(_Peer); it != users.end()) {
-			it->active = false;
-			it->peer = nullptr;
+		user_table& t = table();
+		std::lock_guard guard(t.lock);
+		const auto slot = find_slot(_Peer);
+		if (!slot) {
+			return;
 		}
+
+		//
+		// Swap the last active user into the released position
+		//
+		user_entry& entry = t.users[*slot];
+		const userid_t last = t.active.back();
+		t.active[entry.index] = last;
+		t.users[user_slot(last)].index = entry.index;
+		t.active.pop_back();
+
+		state_store::despawn(make_id(*slot, entry.generation));
+		entry.active = false;
+		entry.peer = nullptr;
+		entry.resumed = false;
+		++entry.generation;
+		persist_slot(t, *slot);
+		entry.index = static_cast<std::uint32_t>(t.free_slots.size());
+		t.free_slots.push_back(*slot);
+		metrics::set_users(t.active.size(), t.users.size());
+		core::Core_enet_peer_set_data(_Peer, nullptr);
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,224 @@
+#include <format>
+#include "arena.h"
+#include "callbacks.h"
+#include "core.h"
+#include "pool.h"
+#include "shard.h"
+#include "trace.h"
+#include "worker.h"
+
+namespace cat {
+	/*
+		Delivers an event to the callbacks on the calling worker thread.
+
+		@param _Event The event to deliver.
+	 */
+	static void
+	deliver(const net_event& _Event) {
+		switch (_Event.type) {
+		case enet_service::enet_connect:
+			core::OnConnect(_Event.peer, _Event.data, _Event.size);
+			//
+			// A server's connect event holds the session frame carrying the token
+			//
+			if (_Event.handle != nullptr) {
+				core::Core_enet_packet_release(_Event.handle);
+			}
+			break;
+
+		case enet_service::enet_disconnect:
+			core::OnDisconnect(_Event.peer);
+			//
+			// Replies the handlers queued before now must not reach the slot's next connection
+			//
+			pool_manager::instance().retire(_Event.peer);
+			core::Core_enet_peer_set_data(_Event.peer, nullptr);
+			break;
+
+		case enet_service::enet_message:
+			core::OnMessage(_Event.peer, _Event.data, _Event.size, _Event.handle);
+			//
+			// Drop the reference the I/O thread took when posting the packet
+			//
+			core::Core_enet_packet_release(_Event.handle);
+			break;
+		}
+	}
+
+	/*
+		Constructs a pool of idle workers.
+
+		@param _Workers Number of worker threads.
+	 */
+	worker_pool::worker_pool(std::size_t _Workers)
+		: shard(current_shard()) {
+		const std::size_t count = _Workers == 0 ? 1 : _Workers;
+		workers.reserve(count);
+		for (std::size_t i = 0; i < count; ++i) {
+			workers.push_back(std::make_unique<worker>());
+		}
+	}
+
+	worker_pool::~worker_pool() {
+		stop();
+	}
+
+	/*
+		Starts the worker threads.
+	 */
+	void
+	worker_pool::start() {
+		if (running.exchange(true)) {
+			return;
+		}
+
+		for (auto& w : workers) {
+			w->thread = std::thread(&worker_pool::run, this, std::ref(*w));
+		}
+	}
+
+	/*
+		Stops the worker threads after they have drained their queues.
+	 */
+	void
+	worker_pool::stop() {
+		if (!running.exchange(false)) {
+			return;
+		}
+
+		for (auto& w : workers) {
+			w->signal.fetch_add(1, std::memory_order_release);
+			w->signal.notify_one();
+		}
+		for (auto& w : workers) {
+			if (w->thread.joinable()) {
+				w->thread.join();
+			}
+		}
+	}
+
+	/*
+		Posts an event to the worker owning an affinity key.
+
+		@param _Key   Affinity key.
+		@param _Event The event to deliver.
+	 */
+	void
+	worker_pool::post(std::size_t _Key, const net_event& _Event) {
+		worker& w = *workers[_Key % workers.size()];
+		while (!w.queue.push(_Event)) {
+			std::this_thread::yield();
+		}
+		++w.posted;
+		//
+		// Pairs with the fence in run(): either the worker sees the new
+		// event before sleeping, or we see it sleeping and wake it up
+		//
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (w.sleeping.load(std::memory_order_relaxed)) {
+			w.signal.fetch_add(1, std::memory_order_release);
+			w.signal.notify_one();
+		}
+	}
+
+	/*
+		Delivers queued events on the calling thread.
+
+		@param _Budget Maximum number of events to deliver.
+		@return The number of events delivered.
+	 */
+	std::size_t
+	worker_pool::drain(std::size_t _Budget) {
+		set_current_shard(shard);
+
+		std::size_t count = 0;
+		net_event event;
+		for (auto& w : workers) {
+			while (count < _Budget && w->queue.pop(event)) {
+				deliver(event);
+				w->delivered.fetch_add(1, std::memory_order_release);
+				++count;
+			}
+		}
+		//
+		// The calling thread is the worker, so the frame's arena memory dies here
+		//
+		tick_arena::reset();
+		return count;
+	}
+
+	/*
+		Waits until the workers have delivered every event posted so far.
+	 */
+	void
+	worker_pool::quiesce() const {
+		if (!running.load(std::memory_order_relaxed)) {
+			return;
+		}
+
+		CAT_TRACE_ZONE("worker_pool::quiesce");
+		for (const auto& w : workers) {
+			//
+			// Pairs with the release in run(): the handlers' writes are visible from here on
+			//
+			while (w->delivered.load(std::memory_order_acquire) != w->posted) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	/*
+		Worker thread body.
+
+		@param _Worker The worker this thread serves.
+	 */
+	void
+	worker_pool::run(worker& _Worker) {
+		set_current_shard(shard);
+		for (std::size_t i = 0; i < workers.size(); ++i) {
+			if (workers[i].get() == &_Worker) {
+				trace::name_thread(std::format("shard {} worker {}", shard, i));
+			}
+		}
+
+		constexpr int spins = 64;
+		net_event event;
+		for (;;) {
+			int idle = 0;
+			while (_Worker.queue.pop(event)) {
+				deliver(event);
+				_Worker.delivered.fetch_add(1, std::memory_order_release);
+			}
+			//
+			// A dry queue ends the worker's share of the tick
+			//
+			tick_arena::reset();
+
+			if (!running.load(std::memory_order_acquire)) {
+				//
+				// Finish whatever the I/O thread posted before stopping
+				//
+				while (_Worker.queue.pop(event)) {
+					deliver(event);
+					_Worker.delivered.fetch_add(1, std::memory_order_release);
+				}
+				return;
+			}
+
+			while (idle++ < spins && _Worker.queue.empty()) {
+				std::this_thread::yield();
+			}
+			if (!_Worker.queue.empty()) {
+				continue;
+			}
+
+			const std::uint32_t seen = _Worker.signal.load(std::memory_order_acquire);
+			_Worker.sleeping.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (_Worker.queue.empty() && running.load(std::memory_order_acquire)) {
+				_Worker.signal.wait(seen, std::memory_order_acquire);
+			}
+			_Worker.sleeping.store(false, std::memory_order_relaxed);
+		}
+	}
+}
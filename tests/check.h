@@ -0,0 +1,47 @@
+/***
+* MIT License
+*
+* Copyright (c) 2026 moubiecat
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+***/
+
+#pragma once
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+#include <cstdio>
+
+namespace cat::test {
+	//< Number of failed checks in the running test
+	inline int failures = 0;
+}
+
+/*
+ * Records a failed check with its location; the test keeps running.
+ */
+#define CAT_CHECK(_Expr)																\
+	do {																				\
+		if (!(_Expr)) {																	\
+			std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #_Expr);	\
+			++cat::test::failures;														\
+		}																				\
+	} while (false)
+
+#endif // ^^^ !_CHECK_H_
@@ -0,0 +1,125 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <span>
+#include <vector>
+#include "check.h"
+#include "compress.h"
+#include "packet.h"
+#include "stream.h"
+
+//
+// Largest allocation seen by the replaced global operator new
+//
+static std::size_t largest_allocation = 0;
+
+void* operator new(std::size_t _Size) {
+	largest_allocation = _Size > largest_allocation ? _Size : largest_allocation;
+	if (void* ptr = std::malloc(_Size == 0 ? 1 : _Size)) {
+		return ptr;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* _Ptr) noexcept {
+	std::free(_Ptr);
+}
+
+void operator delete(void* _Ptr, std::size_t) noexcept {
+	std::free(_Ptr);
+}
+
+namespace {
+	/*
+		Builds a compressible framed message, shaped like a state update.
+	 */
+	cat::ostream
+	make_frame(std::uint32_t _Seed) {
+		cat::ostream frame;
+		frame.write(std::uint8_t{ 0x10 });
+		for (std::uint32_t i = 0; i < 64; ++i) {
+			frame.write(0x00010000u | (i + _Seed));
+			frame.write_str("player");
+			frame.write(static_cast<float>(i) * 1.5f);
+		}
+		return frame;
+	}
+
+	/*
+		Packs a frame and unpacks it again.
+	 */
+	void
+	round_trip(const cat::ostream& _Frame) {
+		cat::ostream packed;
+		CAT_CHECK(cat::compressor::pack(_Frame, packed));
+		CAT_CHECK(packed.size() < _Frame.total_size());
+		CAT_CHECK(packed.size() != 0 && packed.buffer()[0] == std::byte{ cat::compressed_frame_id });
+
+		cat::istream in = cat::istream::view_of(packed.buffer().data() + 1, packed.size() - 1);
+		std::vector<std::byte> out;
+		CAT_CHECK(cat::compressor::unpack(in, out));
+		CAT_CHECK(out == _Frame.buffer());
+	}
+
+	/*
+		Unpacks a hand-made frame body.
+	 */
+	bool
+	unpack(const std::vector<std::uint8_t>& _Body) {
+		cat::istream in = cat::istream::view_of(_Body.data(), _Body.size());
+		std::vector<std::byte> out;
+		return cat::compressor::unpack(in, out);
+	}
+}
+
+int main() {
+	//
+	// Without and with a dictionary trained on similar messages
+	//
+	round_trip(make_frame(0));
+
+	std::vector<cat::ostream> samples;
+	std::vector<std::span<const std::byte>> views;
+	for (std::uint32_t i = 1; i <= 8; ++i) {
+		samples.push_back(make_frame(i * 7));
+	}
+	for (const cat::ostream& sample : samples) {
+		views.emplace_back(sample.buffer());
+	}
+	const std::vector<std::byte> dictionary = cat::compressor::train(views, 4096);
+	CAT_CHECK(!dictionary.empty());
+	CAT_CHECK(cat::compressor::set_dictionary(dictionary, 1));
+	round_trip(make_frame(3));
+	//
+	// A frame packed against another dictionary is refused
+	//
+	cat::ostream packed;
+	CAT_CHECK(cat::compressor::pack(make_frame(5), packed));
+	CAT_CHECK(cat::compressor::set_dictionary({}, 0));
+	{
+		cat::istream in = cat::istream::view_of(packed.buffer().data() + 1, packed.size() - 1);
+		std::vector<std::byte> out;
+		CAT_CHECK(!cat::compressor::unpack(in, out));
+	}
+	//
+	// Messages that do not shrink are left alone
+	//
+	cat::ostream tiny;
+	tiny.write(std::uint8_t{ 0x10 });
+	tiny.write(std::uint32_t{ 0x12345678 });
+	CAT_CHECK(!cat::compressor::pack(tiny, packed));
+	//
+	// Forged sizes are rejected before anything is allocated
+	//
+	CAT_CHECK(!unpack({ 0x00 }));
+	CAT_CHECK(!unpack({ 0x00, 0x00, 0x00 }));
+	CAT_CHECK(!unpack({ 0x00, 0x80, 0x80, 0x80, 0x80, 0x01, 0x00 }));
+	static_assert(cat::compressor::max_frame == 0x100000, "the size below is meant to be just above max_frame");
+	std::vector<std::uint8_t> oversized{ 0x00, 0x81, 0x80, 0x40 };
+	oversized.resize(oversized.size() + 0x100001 / 255 + 1, 0x00);
+	largest_allocation = 0;
+	CAT_CHECK(!unpack(oversized));
+	CAT_CHECK(largest_allocation < cat::compressor::max_frame);
+	return cat::test::failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#include <cstdint>
+#include "check.h"
+#include "snapshot.h"
+#include "stream.h"
+
+namespace {
+	/*
+		Fills a snapshot with a few moving entities.
+	 */
+	void
+	fill(cat::snapshot& _Out, std::uint32_t _Sequence, std::uint32_t _Entities) {
+		_Out.clear(_Sequence);
+		for (std::uint32_t id = _Entities; id > 0; --id) {
+			cat::entity_state& state = _Out.add(id * 3);
+			state.fields[0] = static_cast<std::int32_t>(id * 100 + _Sequence);
+			state.fields[1] = -static_cast<std::int32_t>(id);
+			state.fields[5] = (id % 2 == 0) ? static_cast<std::int32_t>(_Sequence) : 7;
+		}
+		_Out.seal();
+	}
+
+	/*
+		Returns whether two snapshots hold the same entities.
+	 */
+	bool
+	same(const cat::snapshot& _A, const cat::snapshot& _B) {
+		if (_A.sequence != _B.sequence || _A.entities.size() != _B.entities.size()) {
+			return false;
+		}
+		for (std::size_t i = 0; i < _A.entities.size(); ++i) {
+			if (_A.entities[i].id != _B.entities[i].id || _A.entities[i].fields != _B.entities[i].fields) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/*
+		Encodes a snapshot and decodes it on the other side.
+
+		@return Whether the encoding was a delta.
+	 */
+	bool
+	send(cat::snapshot_encoder& _Encoder, cat::snapshot_decoder& _Decoder, const cat::snapshot& _Current) {
+		cat::ostream out;
+		const bool delta = _Encoder.encode(_Current, out);
+		cat::istream in = cat::istream::view_of(out.buffer().data(), out.size());
+		const cat::snapshot* decoded = _Decoder.decode(in);
+		CAT_CHECK(decoded != nullptr && same(*decoded, _Current));
+		return delta;
+	}
+}
+
+int main() {
+	cat::snapshot_encoder encoder;
+	cat::snapshot_decoder decoder;
+	cat::snapshot current;
+	//
+	// Nothing acknowledged yet: a full snapshot
+	//
+	fill(current, 1, 8);
+	CAT_CHECK(!send(encoder, decoder, current));
+	//
+	// Deltas against the acknowledged baseline, with entities coming and going
+	//
+	encoder.acknowledge(1);
+	CAT_CHECK(encoder.baseline() == 1);
+	fill(current, 2, 10);
+	CAT_CHECK(send(encoder, decoder, current));
+	fill(current, 3, 4);
+	CAT_CHECK(send(encoder, decoder, current));
+	fill(current, 4, 0);
+	CAT_CHECK(send(encoder, decoder, current));
+	//
+	// Acks for sequences never sent, stale or duplicated, leave the baseline alone
+	//
+	encoder.acknowledge(9);
+	CAT_CHECK(encoder.baseline() == 1);
+	encoder.acknowledge(0);
+	CAT_CHECK(encoder.baseline() == 1);
+	encoder.acknowledge(3);
+	CAT_CHECK(encoder.baseline() == 3);
+	encoder.acknowledge(2);
+	encoder.acknowledge(3);
+	CAT_CHECK(encoder.baseline() == 3);
+	encoder.acknowledge(5);
+	CAT_CHECK(encoder.baseline() == 3);
+	//
+	// An ack whose history slot was overwritten by a newer snapshot is ignored
+	//
+	for (std::uint32_t sequence = 5; sequence < 5 + cat::snapshot_window; ++sequence) {
+		fill(current, sequence, 6);
+		send(encoder, decoder, current);
+	}
+	encoder.acknowledge(4);
+	CAT_CHECK(encoder.baseline() == 3);
+	//
+	// The baseline fell out of the window, so the next one is full again
+	//
+	fill(current, 5 + cat::snapshot_window, 6);
+	CAT_CHECK(!send(encoder, decoder, current));
+	//
+	// Stale and malformed encodings are refused
+	//
+	cat::ostream out;
+	encoder.encode(current, out);
+	cat::istream replay = cat::istream::view_of(out.buffer().data(), out.size());
+	CAT_CHECK(decoder.decode(replay) == nullptr);
+	const std::uint8_t truncated[] = { 0x7F };
+	cat::istream broken = cat::istream::view_of(truncated, sizeof(truncated));
+	CAT_CHECK(decoder.decode(broken) == nullptr);
+	//
+	// After a reset the encoder starts over with a full snapshot
+	//
+	encoder.reset();
+	CAT_CHECK(encoder.baseline() == 0);
+	encoder.acknowledge(5 + cat::snapshot_window);
+	CAT_CHECK(encoder.baseline() == 0);
+	return cat::test::failures == 0 ? 0 : 1;
+}
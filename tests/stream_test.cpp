@@ -0,0 +1,84 @@
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include "batch.h"
+#include "check.h"
+#include "stream.h"
+
+namespace {
+	/*
+		Writes a value as a varint and reads it back.
+	 */
+	void
+	round_trip(std::uint64_t _Value) {
+		cat::ostream out;
+		out.write_varint(_Value);
+		CAT_CHECK(out.size() <= cat::ostream::max_varint_size);
+
+		cat::istream in = cat::istream::view_of(out.buffer().data(), out.size());
+		std::uint64_t value = 0;
+		CAT_CHECK(in.read_varint(value));
+		CAT_CHECK(value == _Value);
+		CAT_CHECK(in.remaining() == 0);
+	}
+
+	/*
+		Reads a varint from raw bytes.
+	 */
+	template<class _Ty>
+	bool
+	read(const std::vector<std::uint8_t>& _Bytes, _Ty& _Value, std::size_t& _Remaining) {
+		cat::istream in = cat::istream::view_of(_Bytes.data(), _Bytes.size());
+		const bool ok = in.read_varint(_Value);
+		_Remaining = in.remaining();
+		return ok;
+	}
+}
+
+int main() {
+	//
+	// Round trips across every encoded length
+	//
+	for (const std::uint64_t value : { std::uint64_t{ 0 }, std::uint64_t{ 1 }, std::uint64_t{ 0x7F }, std::uint64_t{ 0x80 },
+		std::uint64_t{ 0x3FFF }, std::uint64_t{ 0x4000 }, std::uint64_t{ 0xFFFFFFFF },
+		std::uint64_t{ 1 } << 63, std::numeric_limits<std::uint64_t>::max() }) {
+		round_trip(value);
+	}
+
+	std::size_t remaining = 0;
+	std::uint64_t wide = 0;
+	//
+	// The tenth byte carries bit 63 only
+	//
+	std::vector<std::uint8_t> bytes(9, 0xFF);
+	bytes.push_back(0x01);
+	CAT_CHECK(read(bytes, wide, remaining) && wide == std::numeric_limits<std::uint64_t>::max());
+	bytes.back() = 0x02;
+	CAT_CHECK(!read(bytes, wide, remaining) && remaining == bytes.size());
+	bytes.back() = 0x7F;
+	CAT_CHECK(!read(bytes, wide, remaining));
+	//
+	// Truncated, overlong and out-of-range varints leave the stream untouched
+	//
+	CAT_CHECK(!read(std::vector<std::uint8_t>{ 0x80, 0x80 }, wide, remaining) && remaining == 2);
+	CAT_CHECK(!read(std::vector<std::uint8_t>(11, 0x80), wide, remaining));
+	std::uint32_t narrow = 0;
+	CAT_CHECK(!read(std::vector<std::uint8_t>{ 0x80, 0x80, 0x80, 0x80, 0x10 }, narrow, remaining) && remaining == 5);
+	CAT_CHECK(read(std::vector<std::uint8_t>{ 0xFF, 0xFF, 0xFF, 0xFF, 0x0F }, narrow, remaining) && narrow == 0xFFFFFFFF);
+	//
+	// Batch frame lengths: the fifth byte carries bits 28 to 31 only
+	//
+	std::size_t messages = 0;
+	const auto count = [&](const std::uint8_t*, std::size_t) { ++messages; };
+	const std::array<std::uint8_t, 5> batch{ cat::batch_frame_id, 0x02, 0x01, 0x02, 0x00 };
+	CAT_CHECK(!cat::for_each_batched(batch.data(), batch.size(), count));
+	CAT_CHECK(messages == 1);
+	const std::array<std::uint8_t, 4> valid{ cat::batch_frame_id, 0x02, 0x01, 0x02 };
+	messages = 0;
+	CAT_CHECK(cat::for_each_batched(valid.data(), valid.size(), count) && messages == 1);
+	const std::array<std::uint8_t, 7> overflow{ cat::batch_frame_id, 0x81, 0x80, 0x80, 0x80, 0x10, 0x01 };
+	messages = 0;
+	CAT_CHECK(!cat::for_each_batched(overflow.data(), overflow.size(), count) && messages == 0);
+	return cat::test::failures == 0 ? 0 : 1;
+}